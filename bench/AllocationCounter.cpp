@@ -0,0 +1,101 @@
+#include "Benchmark.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions for the whole cppcord_bench
+// process so the runner can report heap allocations per operation. Qt
+// containers allocate with malloc rather than operator new, so on glibc
+// malloc itself is interposed as well and forwarded to the C library.
+
+#if defined(__GLIBC__)
+extern "C" void *__libc_malloc(std::size_t size);
+extern "C" void *__libc_calloc(std::size_t count, std::size_t size);
+extern "C" void *__libc_realloc(void *pointer, std::size_t size);
+#endif
+
+namespace
+{
+std::atomic<qint64> s_allocations{0};
+
+void *countedMalloc(std::size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+#if defined(__GLIBC__)
+    return __libc_malloc(size ? size : 1);
+#else
+    return std::malloc(size ? size : 1);
+#endif
+}
+
+void *countedNew(std::size_t size)
+{
+    if (void *pointer = countedMalloc(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+}
+
+qint64 allocationCount()
+{
+    return s_allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t size)
+{
+    return countedNew(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return countedNew(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedMalloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedMalloc(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+#if defined(__GLIBC__)
+extern "C" void *malloc(std::size_t size) noexcept
+{
+    return countedMalloc(size);
+}
+
+extern "C" void *calloc(std::size_t count, std::size_t size) noexcept
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, std::size_t size) noexcept
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+#endif
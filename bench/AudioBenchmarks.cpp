@@ -0,0 +1,356 @@
+#include "Benchmark.h"
+#include <QByteArray>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include "audio/OpusCodec.h"
+#include "audio/DspKernels.h"
+#include "audio/Resampler.h"
+#include "audio/PlaybackBuffer.h"
+#include "audio/NoiseSuppressor.h"
+#include "audio/AutomaticGainControl.h"
+#include "audio/EchoReference.h"
+#include "audio/EchoCanceller.h"
+#include "audio/AudioManager.h"
+#include "audio/AudioMixer.h"
+#include "BenchmarkAccess.h"
+
+namespace
+{
+constexpr int FRAME_SAMPLES = OPUS_FRAME_SIZE * OPUS_CHANNELS;
+constexpr int SIGNAL_FRAMES = 50; // One second, looped
+
+// Speech-like test signal: a few harmonics under a syllable-rate envelope,
+// over a low noise floor
+std::vector<float> testSignal(int frames, int channels, int sampleRate = OPUS_SAMPLE_RATE)
+{
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 0.01f);
+    std::vector<float> signal(static_cast<size_t>(frames) * channels);
+    const double pi = std::acos(-1.0);
+    for (int i = 0; i < frames; ++i)
+    {
+        double t = static_cast<double>(i) / sampleRate;
+        double envelope = 0.5 + 0.5 * std::sin(2.0 * pi * 4.0 * t);
+        double voice = 0.0;
+        for (int harmonic = 1; harmonic <= 5; ++harmonic)
+            voice += std::sin(2.0 * pi * 180.0 * harmonic * t) / harmonic;
+        float sample = static_cast<float>(0.25 * envelope * voice) + noise(rng);
+        for (int channel = 0; channel < channels; ++channel)
+            signal[static_cast<size_t>(i) * channels + channel] = sample;
+    }
+    return signal;
+}
+
+std::vector<opus_int16> toInt16(const std::vector<float> &samples)
+{
+    std::vector<opus_int16> pcm(samples.size());
+    DspKernels::floatToInt16(samples.data(), pcm.data(), static_cast<int>(samples.size()));
+    return pcm;
+}
+
+// Run body with one kernel set, restoring the previous selection afterwards
+template <typename Body>
+BenchmarkRunner::Function withIsa(DspKernels::Isa isa, Body body)
+{
+    return [isa, body](qint64 iterations) {
+        DspKernels::Isa previous = DspKernels::activeIsa();
+        DspKernels::setIsa(isa);
+        body(iterations);
+        DspKernels::setIsa(previous);
+    };
+}
+
+void registerKernelBenchmarks(BenchmarkRunner &runner)
+{
+    // One 20ms stereo frame per operation
+    auto signal = std::make_shared<std::vector<float>>(testSignal(OPUS_FRAME_SIZE, OPUS_CHANNELS));
+    auto pcm = std::make_shared<std::vector<opus_int16>>(toInt16(*signal));
+    auto scratch = std::make_shared<std::vector<float>>(FRAME_SAMPLES);
+    auto pcmOut = std::make_shared<std::vector<opus_int16>>(FRAME_SAMPLES);
+
+    const DspKernels::Isa isas[] = {DspKernels::Isa::Scalar, DspKernels::Isa::Sse2, DspKernels::Isa::Avx2,
+                                    DspKernels::Isa::Neon};
+    for (DspKernels::Isa isa : isas)
+    {
+        if (!DspKernels::isSupported(isa))
+            continue;
+        QString suffix = QString::fromLatin1(DspKernels::isaName(isa)).toLower();
+
+        runner.add("dsp/int16_to_float/" + suffix, withIsa(isa, [=](qint64 iterations) {
+                       for (qint64 i = 0; i < iterations; ++i)
+                       {
+                           DspKernels::int16ToFloat(pcm->data(), scratch->data(), FRAME_SAMPLES);
+                           doNotOptimize(scratch->data()[0]);
+                       }
+                   }),
+                   FRAME_SAMPLES * sizeof(opus_int16));
+
+        runner.add("dsp/float_to_int16/" + suffix, withIsa(isa, [=](qint64 iterations) {
+                       for (qint64 i = 0; i < iterations; ++i)
+                       {
+                           DspKernels::floatToInt16(signal->data(), pcmOut->data(), FRAME_SAMPLES);
+                           doNotOptimize(pcmOut->data()[0]);
+                       }
+                   }),
+                   FRAME_SAMPLES * sizeof(float));
+
+        runner.add("dsp/mix_accumulate/" + suffix, withIsa(isa, [=](qint64 iterations) {
+                       std::fill(scratch->begin(), scratch->end(), 0.0f);
+                       for (qint64 i = 0; i < iterations; ++i)
+                       {
+                           DspKernels::mixAccumulate(scratch->data(), signal->data(), FRAME_SAMPLES, 0.5f);
+                           doNotOptimize(scratch->data()[0]);
+                       }
+                   }),
+                   FRAME_SAMPLES * sizeof(float));
+
+        // Alternating gains keep the frame in range across iterations
+        runner.add("dsp/apply_gain/" + suffix, withIsa(isa, [=](qint64 iterations) {
+                       std::memcpy(scratch->data(), signal->data(), FRAME_SAMPLES * sizeof(float));
+                       for (qint64 i = 0; i < iterations; ++i)
+                       {
+                           DspKernels::applyGain(scratch->data(), FRAME_SAMPLES, (i & 1) ? 2.0f : 0.5f);
+                           doNotOptimize(scratch->data()[0]);
+                       }
+                   }),
+                   FRAME_SAMPLES * sizeof(float));
+
+        // Includes refreshing the frame, so the clipper keeps seeing overs
+        runner.add("dsp/soft_clip/" + suffix, withIsa(isa, [=](qint64 iterations) {
+                       for (qint64 i = 0; i < iterations; ++i)
+                       {
+                           std::memcpy(scratch->data(), signal->data(), FRAME_SAMPLES * sizeof(float));
+                           DspKernels::applyGain(scratch->data(), FRAME_SAMPLES, 4.0f);
+                           DspKernels::softClip(scratch->data(), FRAME_SAMPLES);
+                           doNotOptimize(scratch->data()[0]);
+                       }
+                   }),
+                   FRAME_SAMPLES * sizeof(float));
+
+        runner.add("dsp/measure_int16/" + suffix, withIsa(isa, [=](qint64 iterations) {
+                       for (qint64 i = 0; i < iterations; ++i)
+                       {
+                           DspKernels::Level level = DspKernels::measure(pcm->data(), FRAME_SAMPLES);
+                           doNotOptimize(level.rms);
+                       }
+                   }),
+                   FRAME_SAMPLES * sizeof(opus_int16));
+
+        runner.add("dsp/measure_float/" + suffix, withIsa(isa, [=](qint64 iterations) {
+                       for (qint64 i = 0; i < iterations; ++i)
+                       {
+                           DspKernels::Level level = DspKernels::measure(signal->data(), FRAME_SAMPLES);
+                           doNotOptimize(level.rms);
+                       }
+                   }),
+                   FRAME_SAMPLES * sizeof(float));
+
+        // One resampler output sample
+        runner.add("dsp/dot_product_64/" + suffix, withIsa(isa, [=](qint64 iterations) {
+                       for (qint64 i = 0; i < iterations; ++i)
+                       {
+                           float sum = DspKernels::dotProduct(signal->data(), signal->data() + 64 + (i & 7), 64);
+                           doNotOptimize(sum);
+                       }
+                   }),
+                   64 * 2 * sizeof(float));
+    }
+}
+
+void registerOpusBenchmarks(BenchmarkRunner &runner)
+{
+    auto pcm = std::make_shared<std::vector<opus_int16>>(toInt16(testSignal(OPUS_FRAME_SIZE * SIGNAL_FRAMES, OPUS_CHANNELS)));
+
+    auto encoder = std::make_shared<OpusEncoder>();
+    encoder->initialize();
+    auto packet = std::make_shared<QByteArray>();
+    packet->reserve(OPUS_MAX_PACKET_SIZE);
+
+    runner.add("opus/encode_20ms", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            int size = encoder->encode(pcm->data() + (i % SIGNAL_FRAMES) * FRAME_SAMPLES, *packet);
+            doNotOptimize(size);
+        }
+    }, FRAME_SAMPLES * sizeof(opus_int16));
+
+    // Decode a second of real packets from the same encoder settings
+    auto packets = std::make_shared<QList<QByteArray>>();
+    OpusEncoder packetEncoder;
+    packetEncoder.initialize();
+    for (int frame = 0; frame < SIGNAL_FRAMES; ++frame)
+    {
+        QByteArray encoded;
+        packetEncoder.encode(pcm->data() + frame * FRAME_SAMPLES, encoded);
+        packets->append(encoded);
+    }
+
+    auto decoder = std::make_shared<OpusDecoder>();
+    decoder->initialize();
+    auto decoded = std::make_shared<std::vector<opus_int16>>(FRAME_SAMPLES);
+
+    runner.add("opus/decode_20ms", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            int samples = decoder->decode(packets->at(i % SIGNAL_FRAMES), decoded->data(), OPUS_FRAME_SIZE);
+            doNotOptimize(samples);
+        }
+    }, FRAME_SAMPLES * sizeof(opus_int16));
+}
+
+void addResampleBenchmark(BenchmarkRunner &runner, int inputRate, int outputRate)
+{
+    // 20ms of stereo input per operation
+    int inputFrames = inputRate / 50;
+    auto resampler = std::make_shared<Resampler>();
+    resampler->configure(inputRate, outputRate, OPUS_CHANNELS);
+    auto input = std::make_shared<std::vector<float>>(testSignal(inputFrames, OPUS_CHANNELS, inputRate));
+    auto output = std::make_shared<std::vector<float>>(resampler->maxOutputFrames(inputFrames) * OPUS_CHANNELS);
+
+    runner.add(QString("resample/%1_to_%2/20ms").arg(inputRate).arg(outputRate), [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            int frames = resampler->process(input->data(), inputFrames, output->data());
+            doNotOptimize(frames);
+        }
+    }, inputFrames * OPUS_CHANNELS * sizeof(float));
+}
+
+void addCaptureStageBenchmark(BenchmarkRunner &runner, const QString &name, std::shared_ptr<CaptureStage> stage)
+{
+    // One 20ms mono frame per operation, as the capture chain runs them
+    auto signal = std::make_shared<std::vector<float>>(testSignal(OPUS_FRAME_SIZE * SIGNAL_FRAMES, 1));
+    auto frame = std::make_shared<std::vector<float>>(OPUS_FRAME_SIZE);
+
+    runner.add("capture/" + name, [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            std::memcpy(frame->data(), signal->data() + (i % SIGNAL_FRAMES) * OPUS_FRAME_SIZE, OPUS_FRAME_SIZE * sizeof(float));
+            stage->process(frame->data(), OPUS_FRAME_SIZE);
+            doNotOptimize(frame->data()[0]);
+        }
+    }, OPUS_FRAME_SIZE * sizeof(float));
+}
+
+void registerEchoCancellerBenchmark(BenchmarkRunner &runner)
+{
+    // Far end only: the microphone hears an attenuated, delayed copy of the
+    // speaker, so the filter adapts on every block (the expensive path)
+    struct State
+    {
+        EchoReference reference;
+        EchoCanceller canceller{&reference};
+        std::vector<float> far = testSignal(OPUS_FRAME_SIZE * SIGNAL_FRAMES, 1);
+        std::vector<float> mic = std::vector<float>(OPUS_FRAME_SIZE);
+        qint64 frame = 0;
+    };
+    auto state = std::make_shared<State>();
+
+    runner.add("capture/echo_cancellation", [=](qint64 iterations) {
+        const int frames = SIGNAL_FRAMES;
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            qint64 index = state->frame++;
+            state->reference.write(state->far.data() + (index % frames) * OPUS_FRAME_SIZE, OPUS_FRAME_SIZE);
+
+            const float *echo = state->far.data() + ((index + frames - 3) % frames) * OPUS_FRAME_SIZE;
+            for (int n = 0; n < OPUS_FRAME_SIZE; ++n)
+                state->mic[n] = 0.2f * echo[n];
+
+            state->canceller.process(state->mic.data(), OPUS_FRAME_SIZE);
+            doNotOptimize(state->mic[0]);
+        }
+    }, OPUS_FRAME_SIZE * sizeof(float));
+}
+
+void registerPlaybackBenchmarks(BenchmarkRunner &runner)
+{
+    auto buffer = std::make_shared<PlaybackBuffer>();
+    auto pcm = std::make_shared<std::vector<opus_int16>>(toInt16(testSignal(OPUS_FRAME_SIZE, OPUS_CHANNELS)));
+    auto out = std::make_shared<std::vector<opus_int16>>(FRAME_SAMPLES);
+
+    // Steady state: one decoded frame in, one resampled frame out
+    runner.add("playback/buffer_write_render_20ms", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            buffer->writeFrames(pcm->data(), OPUS_FRAME_SIZE);
+            bool rendered = buffer->render(out->data(), OPUS_FRAME_SIZE);
+            doNotOptimize(rendered);
+        }
+    }, FRAME_SAMPLES * sizeof(opus_int16));
+}
+
+// Both sides of the device clock, which must not touch the heap once warm
+void registerRealtimePathBenchmarks(BenchmarkRunner &runner)
+{
+    struct Capture
+    {
+        AudioManager manager;
+        std::vector<opus_int16> signal = toInt16(testSignal(OPUS_FRAME_SIZE * SIGNAL_FRAMES, OPUS_CHANNELS));
+        std::vector<opus_int16> frame = std::vector<opus_int16>(FRAME_SAMPLES);
+    };
+    auto capture = std::make_shared<Capture>();
+    capture->manager.initialize();
+
+    // Capture chain, VAD, pooled encode and both signals, as the ring runs it
+    runner.addAllocationFree("audio/capture_frame", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            std::memcpy(capture->frame.data(), capture->signal.data() + (i % SIGNAL_FRAMES) * FRAME_SAMPLES,
+                        FRAME_SAMPLES * sizeof(opus_int16));
+            BenchmarkAccess::processCaptureFrame(capture->manager, capture->frame.data());
+            doNotOptimize(capture->frame[0]);
+        }
+    }, FRAME_SAMPLES * sizeof(opus_int16));
+
+    struct Playback
+    {
+        EchoReference reference;
+        AudioMixer mixer;
+        QList<QByteArray> packets;
+        std::vector<char> out = std::vector<char>(FRAME_SAMPLES * sizeof(opus_int16));
+    };
+    auto playback = std::make_shared<Playback>();
+    playback->mixer.setEchoReference(&playback->reference);
+    OpusEncoder encoder;
+    encoder.initialize();
+    for (int frame = 0; frame < SIGNAL_FRAMES; ++frame)
+    {
+        QByteArray packet;
+        encoder.encode(capture->signal.data() + frame * FRAME_SAMPLES, packet);
+        playback->packets.append(packet);
+    }
+
+    // One packet decoded into its stream, one chunk mixed out for the sink
+    runner.addAllocationFree("audio/playback_pull_20ms", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            playback->mixer.addPacket(1234, playback->packets.at(i % SIGNAL_FRAMES));
+            qint64 bytes = BenchmarkAccess::pullPlayback(playback->mixer, playback->out.data(),
+                                                         static_cast<qint64>(playback->out.size()));
+            doNotOptimize(bytes);
+        }
+    }, FRAME_SAMPLES * sizeof(opus_int16));
+}
+}
+
+void registerAudioBenchmarks(BenchmarkRunner &runner)
+{
+    registerKernelBenchmarks(runner);
+    registerOpusBenchmarks(runner);
+
+    addResampleBenchmark(runner, 44100, OPUS_SAMPLE_RATE);
+    addResampleBenchmark(runner, OPUS_SAMPLE_RATE, 44100);
+    addResampleBenchmark(runner, 96000, OPUS_SAMPLE_RATE);
+
+    addCaptureStageBenchmark(runner, "noise_suppression", std::make_shared<NoiseSuppressor>());
+    addCaptureStageBenchmark(runner, "agc", std::make_shared<AutomaticGainControl>());
+    registerEchoCancellerBenchmark(runner);
+
+    registerPlaybackBenchmarks(runner);
+    registerRealtimePathBenchmarks(runner);
+}
@@ -0,0 +1,152 @@
+#include "Benchmark.h"
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <algorithm>
+#include <cstdio>
+#include "audio/DspKernels.h"
+
+void BenchmarkRunner::add(const QString &name, Function function, double bytesPerOp)
+{
+    m_entries.append({name, std::move(function), bytesPerOp, false});
+}
+
+void BenchmarkRunner::addAllocationFree(const QString &name, Function function, double bytesPerOp)
+{
+    m_entries.append({name, std::move(function), bytesPerOp, true});
+}
+
+QStringList BenchmarkRunner::names() const
+{
+    QStringList names;
+    for (const Entry &entry : m_entries)
+        names.append(entry.name);
+    return names;
+}
+
+BenchmarkRunner::Result BenchmarkRunner::measure(const Entry &entry, const Options &options) const
+{
+    QElapsedTimer timer;
+
+    // Warm up and find a batch size that runs long enough to time reliably
+    qint64 iterations = 1;
+    for (;;)
+    {
+        timer.start();
+        entry.function(iterations);
+        qint64 elapsed = timer.nsecsElapsed();
+        if (elapsed >= options.minBatchNs || iterations >= (qint64(1) << 40))
+            break;
+
+        // Jump close to the target once the timing means something
+        if (elapsed > options.minBatchNs / 100)
+            iterations = qMax(iterations + 1, static_cast<qint64>(iterations * 1.2 * options.minBatchNs / elapsed));
+        else
+            iterations *= 10;
+    }
+
+    // The warm-up above has already paid for lazy setup, so anything the
+    // timed batches allocate is steady-state cost
+    QList<double> samples;
+    samples.reserve(options.batches);
+    qint64 allocations = 0;
+    for (int batch = 0; batch < options.batches; ++batch)
+    {
+        qint64 allocationsBefore = allocationCount();
+        timer.start();
+        entry.function(iterations);
+        qint64 elapsed = timer.nsecsElapsed();
+        allocations += allocationCount() - allocationsBefore;
+        samples.append(static_cast<double>(elapsed) / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name = entry.name;
+    result.iterations = iterations;
+    result.nsPerOp = samples[samples.size() / 2];
+    result.nsPerOpMin = samples.first();
+    result.bytesPerOp = entry.bytesPerOp;
+    result.allocsPerOp = static_cast<double>(allocations) / (iterations * options.batches);
+    return result;
+}
+
+int BenchmarkRunner::run(const Options &options)
+{
+    m_results.clear();
+    bool allocated = false;
+    std::printf("%-48s %14s %14s %12s %12s %10s\n", "benchmark", "ns/op", "min ns/op", "ops/s", "MB/s", "allocs/op");
+
+    for (const Entry &entry : std::as_const(m_entries))
+    {
+        if (!options.filter.isEmpty() && !entry.name.contains(options.filter))
+            continue;
+
+        Result result = measure(entry, options);
+        m_results.append(result);
+
+        QString throughput = result.bytesPerOp > 0.0
+                                 ? QString::number(result.bytesPerOp / result.nsPerOp * 1e3, 'f', 1)
+                                 : QStringLiteral("-");
+        std::printf("%-48s %14.1f %14.1f %12.0f %12s %10.2f\n", qPrintable(result.name), result.nsPerOp,
+                    result.nsPerOpMin, 1e9 / result.nsPerOp, qPrintable(throughput), result.allocsPerOp);
+        std::fflush(stdout);
+
+        if (entry.allocationFree && result.allocsPerOp > 0.0)
+        {
+            std::fprintf(stderr, "%s must not allocate, but made %.2f allocations per operation\n",
+                         qPrintable(result.name), result.allocsPerOp);
+            allocated = true;
+        }
+    }
+
+    if (!options.jsonPath.isEmpty() && !writeJson(options.jsonPath))
+    {
+        std::fprintf(stderr, "Failed to write %s\n", qPrintable(options.jsonPath));
+        return -1;
+    }
+    return allocated ? -1 : m_results.size();
+}
+
+bool BenchmarkRunner::writeJson(const QString &path) const
+{
+    QJsonObject context;
+    context["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    context["host"] = QSysInfo::machineHostName();
+    context["cpu_arch"] = QSysInfo::currentCpuArchitecture();
+    context["os"] = QSysInfo::prettyProductName();
+    context["qt_version"] = QString::fromLatin1(qVersion());
+    context["dsp_isa"] = QString::fromLatin1(DspKernels::isaName(DspKernels::activeIsa()));
+#ifdef NDEBUG
+    context["build"] = "release";
+#else
+    context["build"] = "debug";
+#endif
+
+    QJsonArray benchmarks;
+    for (const Result &result : m_results)
+    {
+        QJsonObject entry;
+        entry["name"] = result.name;
+        entry["iterations"] = result.iterations;
+        entry["ns_per_op"] = result.nsPerOp;
+        entry["ns_per_op_min"] = result.nsPerOpMin;
+        entry["allocs_per_op"] = result.allocsPerOp;
+        if (result.bytesPerOp > 0.0)
+            entry["bytes_per_second"] = result.bytesPerOp / result.nsPerOp * 1e9;
+        benchmarks.append(entry);
+    }
+
+    QJsonObject root;
+    root["context"] = context;
+    root["benchmarks"] = benchmarks;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(QJsonDocument(root).toJson()) > 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QString>
+#include <QList>
+#include <functional>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Minimal microbenchmark runner for cppcord_bench.
+//
+// A benchmark is a function that performs its operation `iterations` times.
+// The runner doubles the iteration count until one batch takes at least the
+// minimum batch time, then times several batches and reports the median
+// cost per operation along with the heap allocations made per operation.
+// Results are printed as a table and can also be written as JSON for
+// regression tracking.
+class BenchmarkRunner
+{
+public:
+    using Function = std::function<void(qint64 iterations)>;
+
+    struct Options
+    {
+        QString filter;          // Substring of the names to run
+        int batches = 5;
+        qint64 minBatchNs = 100000000;
+        QString jsonPath;        // Empty: no JSON output
+    };
+
+    struct Result
+    {
+        QString name;
+        qint64 iterations = 0;   // Per batch
+        double nsPerOp = 0.0;    // Median over batches
+        double nsPerOpMin = 0.0;
+        double bytesPerOp = 0.0; // 0 when throughput doesn't apply
+        double allocsPerOp = 0.0; // Over the timed batches
+    };
+
+    // bytesPerOp > 0 adds throughput to the report
+    void add(const QString &name, Function function, double bytesPerOp = 0.0);
+
+    // For real-time paths: the run fails if a timed batch allocates at all
+    void addAllocationFree(const QString &name, Function function, double bytesPerOp = 0.0);
+
+    QStringList names() const;
+
+    // Returns the number of benchmarks run, or -1 if an allocation-free
+    // benchmark allocated or the JSON could not be written
+    int run(const Options &options);
+    const QList<Result> &results() const { return m_results; }
+
+private:
+    struct Entry
+    {
+        QString name;
+        Function function;
+        double bytesPerOp = 0.0;
+        bool allocationFree = false;
+    };
+
+    Result measure(const Entry &entry, const Options &options) const;
+    bool writeJson(const QString &path) const;
+
+    QList<Entry> m_entries;
+    QList<Result> m_results;
+};
+
+// Heap allocations made by any thread of the process so far
+// (AllocationCounter.cpp)
+qint64 allocationCount();
+
+// Keep the compiler from discarding a computed value
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    // No inline asm: publish the address and fence the compiler instead of
+    // copying the value, which T may not even support
+    static const void *volatile sink;
+    sink = &value;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+// Suites, one per area of cppcord_core
+void registerAudioBenchmarks(BenchmarkRunner &runner);
+void registerNetworkBenchmarks(BenchmarkRunner &runner);
+void registerClientBenchmarks(BenchmarkRunner &runner);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "audio/AudioManager.h"
+#include "audio/AudioMixer.h"
+#include "network/DiscordClient.h"
+
+// Reaches the private hot paths the benchmarks drive directly. The classes
+// involved name it as a friend; only bench/ includes this header.
+struct BenchmarkAccess
+{
+    static void processCaptureFrame(AudioManager &manager, opus_int16 *frame)
+    {
+        manager.processCaptureFrame(frame);
+    }
+
+    // What the sink's read() lands on, without QIODevice's buffering
+    static qint64 pullPlayback(AudioMixer &mixer, char *data, qint64 maxSize)
+    {
+        return mixer.readData(data, maxSize);
+    }
+
+    // Event handlers without a gateway connection
+    static void handleGatewayEvent(DiscordClient &client, const QString &eventName, const QJsonObject &data)
+    {
+        client.handleGatewayEvent(eventName, data);
+    }
+};
@@ -0,0 +1,214 @@
+#include "Benchmark.h"
+#include <QBuffer>
+#include <QImage>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <memory>
+#include "network/DiscordClient.h"
+#include "utils/AvatarCache.h"
+#include "utils/DiscordMarkdown.h"
+#include "utils/LruCache.h"
+#include "utils/Metrics.h"
+#include "utils/Trace.h"
+#include "SyntheticPayloads.h"
+#include "BenchmarkAccess.h"
+
+namespace
+{
+// Default shape: a user in a handful of medium-sized servers
+QByteArray readyPayload()
+{
+    return QJsonDocument(SyntheticPayloads::ready(SyntheticPayloads::ReadyShape())).toJson(QJsonDocument::Compact);
+}
+
+void registerParseBenchmarks(BenchmarkRunner &runner)
+{
+    auto payload = std::make_shared<QByteArray>(readyPayload());
+
+    runner.add("json/parse_ready", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            QJsonDocument document = QJsonDocument::fromJson(*payload);
+            doNotOptimize(document.isObject());
+        }
+    }, payload->size());
+
+    // The event handler alone, on an already parsed object
+    auto ready = std::make_shared<QJsonObject>(QJsonDocument::fromJson(*payload).object());
+    auto client = std::make_shared<DiscordClient>();
+
+    runner.add("client/handle_ready", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            BenchmarkAccess::handleGatewayEvent(*client, "READY", *ready);
+            doNotOptimize(client->getGuilds().size());
+        }
+    }, payload->size());
+}
+
+void registerPermissionBenchmarks(BenchmarkRunner &runner)
+{
+    auto client = std::make_shared<DiscordClient>();
+    BenchmarkAccess::handleGatewayEvent(*client, "READY", QJsonDocument::fromJson(readyPayload()).object());
+
+    // One operation is one check against one channel, cycling through all of them
+    using Check = QPair<const Guild *, const Channel *>;
+    auto checks = std::make_shared<QList<Check>>();
+    for (const Guild &guild : client->getGuilds())
+    {
+        for (const Channel &channel : guild.channels)
+            checks->append(Check(&guild, &channel));
+    }
+    if (checks->isEmpty())
+        return;
+
+    runner.add("permissions/can_view_channel", [=](qint64 iterations) {
+        const int count = checks->size();
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            const Check &check = checks->at(i % count);
+            doNotOptimize(client->canViewChannel(*check.first, *check.second));
+        }
+    });
+
+    runner.add("permissions/can_send_messages", [=](qint64 iterations) {
+        const int count = checks->size();
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            const Check &check = checks->at(i % count);
+            doNotOptimize(client->canSendMessages(*check.first, *check.second));
+        }
+    });
+}
+
+void registerMarkdownBenchmarks(BenchmarkRunner &runner)
+{
+    auto messages = std::make_shared<QStringList>(SyntheticPayloads::sampleMessages());
+    qint64 totalBytes = 0;
+    for (const QString &message : *messages)
+        totalBytes += message.toUtf8().size();
+
+    // One operation renders every sample message once
+    runner.add("markdown/to_html", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            for (const QString &message : *messages)
+            {
+                QString html = DiscordMarkdown::toHtml(message);
+                doNotOptimize(html.size());
+            }
+        }
+    }, totalBytes);
+}
+
+// Cost of one TraceScope. Restarting before the thread's buffer fills keeps
+// the recording case from turning into the drop path.
+void registerTraceBenchmarks(BenchmarkRunner &runner)
+{
+    runner.add("trace/scope_stopped", [](qint64 iterations) {
+        Tracer::stop();
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            TraceScope scope("bench", "scope");
+            doNotOptimize(i);
+        }
+    });
+
+    runner.add("trace/scope_recording", [](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            if (i % (Tracer::EVENTS_PER_THREAD / 2) == 0)
+                Tracer::start();
+            TraceScope scope("bench", "scope");
+            doNotOptimize(i);
+        }
+        Tracer::stop();
+    });
+}
+
+// The avatar cache's access pattern: a hit per rendered message, and a
+// miss that evicts once full. Cost should not grow with the entry count.
+void registerLruBenchmarks(BenchmarkRunner &runner, int entries)
+{
+    using Cache = LruCache<Snowflake, QByteArray>;
+    auto cache = std::make_shared<Cache>();
+    for (int i = 0; i < entries; ++i)
+        cache->insert(Snowflake(i), QByteArray());
+
+    // Strided so consecutive hits aren't already at the front
+    runner.add(QString("lru/touch_%1").arg(entries), [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+            doNotOptimize(cache->find(Snowflake((i * 7919) % entries)));
+    });
+
+    // Keys keep counting up across batches so every insert is new
+    auto next = std::make_shared<Snowflake>(entries);
+    runner.add(QString("lru/insert_evict_%1").arg(entries), [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            cache->removeOldest();
+            cache->insert((*next)++, QByteArray());
+        }
+        doNotOptimize(cache->size());
+    });
+}
+
+// Per-avatar work that used to run on the GUI thread inside getAvatar: a
+// 64 px CDN PNG decoded, scaled and masked to the rendered circle
+void registerAvatarDecodeBenchmark(BenchmarkRunner &runner)
+{
+    QImage source(64, 64, QImage::Format_ARGB32);
+    for (int y = 0; y < source.height(); ++y)
+    {
+        for (int x = 0; x < source.width(); ++x)
+            source.setPixel(x, y, qRgb(x * 4, y * 4, (x ^ y) * 4));
+    }
+
+    auto png = std::make_shared<QByteArray>();
+    QBuffer buffer(png.get());
+    buffer.open(QIODevice::WriteOnly);
+    source.save(&buffer, "PNG");
+
+    runner.add("avatar/decode_circular", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+            doNotOptimize(AvatarCache::decodeAvatar(*png).width());
+    }, png->size());
+
+    // The message view's data URL, built on the same worker after decoding
+    auto decoded = std::make_shared<QImage>(AvatarCache::decodeAvatar(*png));
+    runner.add("avatar/encode_data_url", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+            doNotOptimize(AvatarCache::encodeDataUrl(*decoded).size());
+    });
+}
+
+void registerMetricsBenchmarks(BenchmarkRunner &runner)
+{
+    runner.add("metrics/counter_add", [](qint64 iterations) {
+        MetricCounter &counter = Metrics::counter("bench.counter");
+        for (qint64 i = 0; i < iterations; ++i)
+            counter.add();
+        doNotOptimize(counter.value());
+    });
+
+    // Spread over the whole range so every bucket group is exercised
+    runner.add("metrics/histogram_record", [](qint64 iterations) {
+        LatencyHistogram &histogram = Metrics::histogram("bench.histogram");
+        for (qint64 i = 0; i < iterations; ++i)
+            histogram.record((i * 2654435761LL) & ((qint64(1) << 32) - 1));
+        doNotOptimize(histogram.snapshot().count);
+    });
+}
+}
+
+void registerClientBenchmarks(BenchmarkRunner &runner)
+{
+    registerParseBenchmarks(runner);
+    registerPermissionBenchmarks(runner);
+    registerMarkdownBenchmarks(runner);
+    registerTraceBenchmarks(runner);
+    registerMetricsBenchmarks(runner);
+    registerLruBenchmarks(runner, 300);
+    registerLruBenchmarks(runner, 5000);
+    registerAvatarDecodeBenchmark(runner);
+}
@@ -0,0 +1,146 @@
+#include "Benchmark.h"
+#include <QByteArray>
+#include <memory>
+#include <sodium.h>
+#include "network/VoiceCipher.h"
+#include "network/RtpPacket.h"
+#include "network/RtpPacketBuilder.h"
+#include "network/RtpReceiveStats.h"
+
+namespace
+{
+constexpr int PAYLOAD_SIZE = 120; // A typical 20ms Opus voice frame at 64kbps
+constexpr int AAD_SIZE = RtpPacketBuilder::RTP_HEADER_SIZE;
+
+QByteArray testBytes(int size, int seed)
+{
+    QByteArray bytes(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i)
+        bytes[i] = static_cast<char>((i * 131 + seed * 17) & 0xff);
+    return bytes;
+}
+
+void registerCipherBenchmarks(BenchmarkRunner &runner, VoiceCipher::Mode mode)
+{
+    struct State
+    {
+        VoiceCipher cipher;
+        QByteArray plaintext = testBytes(PAYLOAD_SIZE, 1);
+        QByteArray aad = testBytes(AAD_SIZE, 2);
+        unsigned char ciphertext[PAYLOAD_SIZE];
+        unsigned char decrypted[PAYLOAD_SIZE];
+        unsigned char tag[VoiceCipher::TAG_SIZE];
+        unsigned char nonce[VoiceCipher::NONCE_SIZE] = {};
+    };
+    auto state = std::make_shared<State>();
+    if (!state->cipher.setSession(mode, testBytes(VoiceCipher::KEY_SIZE, 3)))
+        return;
+
+    const auto *plaintext = reinterpret_cast<const unsigned char *>(state->plaintext.constData());
+    const auto *aad = reinterpret_cast<const unsigned char *>(state->aad.constData());
+    QString prefix = "aead/" + VoiceCipher::modeName(mode);
+
+    runner.add(prefix + "/encrypt", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            int result = state->cipher.encrypt(state->ciphertext, state->tag, plaintext, PAYLOAD_SIZE,
+                                               aad, AAD_SIZE, state->nonce);
+            doNotOptimize(result);
+        }
+    }, PAYLOAD_SIZE);
+
+    // Decrypt a valid packet each time so the full tag check runs
+    state->cipher.encrypt(state->ciphertext, state->tag, plaintext, PAYLOAD_SIZE, aad, AAD_SIZE, state->nonce);
+    runner.add(prefix + "/decrypt", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            int result = state->cipher.decrypt(state->decrypted, state->ciphertext, PAYLOAD_SIZE, state->tag,
+                                               aad, AAD_SIZE, state->nonce);
+            doNotOptimize(result);
+        }
+    }, PAYLOAD_SIZE);
+}
+
+void registerBuildPacketBenchmark(BenchmarkRunner &runner, VoiceCipher::Mode mode)
+{
+    struct State
+    {
+        VoiceCipher cipher;
+        RtpPacketBuilder builder;
+        QByteArray payload = testBytes(PAYLOAD_SIZE, 4);
+    };
+    auto state = std::make_shared<State>();
+    if (!state->cipher.setSession(mode, testBytes(VoiceCipher::KEY_SIZE, 5)))
+        return;
+    state->builder.setSession(&state->cipher, 0x1234);
+
+    // Header, encryption, tag and nonce for one outgoing frame
+    runner.add("rtp/" + VoiceCipher::modeName(mode) + "/build_packet", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            int size = state->builder.build(state->payload.constData(), PAYLOAD_SIZE, static_cast<quint16>(i),
+                                            static_cast<quint32>(i * OPUS_FRAME_SIZE));
+            doNotOptimize(size);
+        }
+    }, PAYLOAD_SIZE);
+}
+
+void registerRtpBenchmarks(BenchmarkRunner &runner)
+{
+    struct State
+    {
+        VoiceCipher cipher;
+        RtpPacketBuilder builder;
+        QByteArray payload = testBytes(PAYLOAD_SIZE, 4);
+        QByteArray datagram;
+        RtpReceiveStats receiveStats;
+        qint64 arrivals = 0; // Carried across batches so sequences keep advancing
+    };
+    auto state = std::make_shared<State>();
+    if (!state->cipher.setSession(VoiceCipher::Mode::XChaCha20, testBytes(VoiceCipher::KEY_SIZE, 5)))
+        return;
+    state->builder.setSession(&state->cipher, 0x1234);
+
+    int size = state->builder.build(state->payload.constData(), PAYLOAD_SIZE, 1, OPUS_FRAME_SIZE);
+    state->datagram = QByteArray(state->builder.data(), size);
+
+    runner.add("rtp/classify_and_parse", [=](qint64 iterations) {
+        const auto *data = reinterpret_cast<const uchar *>(state->datagram.constData());
+        const int length = state->datagram.size();
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            RtpPacketView view;
+            bool ok = classifyVoiceDatagram(data, length) == VoiceDatagramType::Rtp && view.parse(data, length);
+            doNotOptimize(ok);
+            doNotOptimize(view.payloadSize());
+        }
+    }, size);
+
+    // In-order arrival from one source, 20ms apart
+    runner.add("rtp/receive_stats_update", [=](qint64 iterations) {
+        for (qint64 i = 0; i < iterations; ++i)
+        {
+            qint64 n = state->arrivals++;
+            state->receiveStats.update(0x1234, static_cast<quint16>(n), static_cast<quint32>(n * OPUS_FRAME_SIZE),
+                                       n * 20000000);
+        }
+        doNotOptimize(state->receiveStats.report(0x1234).received);
+    });
+}
+}
+
+void registerNetworkBenchmarks(BenchmarkRunner &runner)
+{
+    if (sodium_init() < 0)
+        return;
+
+    registerCipherBenchmarks(runner, VoiceCipher::Mode::XChaCha20);
+    registerBuildPacketBenchmark(runner, VoiceCipher::Mode::XChaCha20);
+    if (VoiceCipher::isAesGcmAvailable())
+    {
+        registerCipherBenchmarks(runner, VoiceCipher::Mode::AesGcm);
+        registerBuildPacketBenchmark(runner, VoiceCipher::Mode::AesGcm);
+    }
+
+    registerRtpBenchmarks(runner);
+}
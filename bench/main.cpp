@@ -0,0 +1,64 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <cstdio>
+#include "Benchmark.h"
+
+namespace
+{
+// The core logs freely; keep it out of the table and the timings
+void quietMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context);
+    if (type == QtCriticalMsg || type == QtFatalMsg)
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("cppcord_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Microbenchmarks for the cppcord core hot paths");
+    parser.addHelpOption();
+    QCommandLineOption filterOption("filter", "Only run benchmarks whose name contains <text>.", "text");
+    QCommandLineOption jsonOption("json", "Also write results as JSON to <file>.", "file");
+    QCommandLineOption batchesOption("batches", "Timed batches per benchmark (default 5).", "count", "5");
+    QCommandLineOption minTimeOption("min-time-ms", "Minimum duration of one batch (default 100).", "ms", "100");
+    QCommandLineOption listOption("list", "List benchmark names and exit.");
+    QCommandLineOption verboseOption("verbose", "Keep the core's log output.");
+    parser.addOptions({filterOption, jsonOption, batchesOption, minTimeOption, listOption, verboseOption});
+    parser.process(app);
+
+    BenchmarkRunner runner;
+    registerAudioBenchmarks(runner);
+    registerNetworkBenchmarks(runner);
+    registerClientBenchmarks(runner);
+
+    if (parser.isSet(listOption))
+    {
+        for (const QString &name : runner.names())
+            std::printf("%s\n", qPrintable(name));
+        return 0;
+    }
+
+    if (!parser.isSet(verboseOption))
+        qInstallMessageHandler(quietMessageHandler);
+
+    BenchmarkRunner::Options options;
+    options.filter = parser.value(filterOption);
+    options.jsonPath = parser.value(jsonOption);
+    options.batches = qMax(1, parser.value(batchesOption).toInt());
+    options.minBatchNs = qMax(1, parser.value(minTimeOption).toInt()) * qint64(1000000);
+
+    int count = runner.run(options);
+    if (count < 0)
+        return 1;
+    if (count == 0)
+    {
+        std::fprintf(stderr, "No benchmark matches \"%s\"\n", qPrintable(options.filter));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,280 @@
+#include "AudioFormatConverter.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+#include "DspKernels.h"
+
+QAudioFormat AudioFormatConverter::opusFormat()
+{
+    QAudioFormat format;
+    format.setSampleRate(OPUS_SAMPLE_RATE);
+    format.setChannelCount(OPUS_CHANNELS);
+    format.setSampleFormat(QAudioFormat::Int16);
+    return format;
+}
+
+QAudioFormat AudioFormatConverter::negotiate(const QAudioDevice &device)
+{
+    QAudioFormat format = opusFormat();
+    if (device.isFormatSupported(format))
+        return format;
+
+    // Keep as much of the Opus format as the device allows: 48kHz avoids
+    // resampling, stereo avoids channel mapping, Int16 avoids rescaling
+    const QAudioFormat preferred = device.preferredFormat();
+    const int rates[] = {OPUS_SAMPLE_RATE, preferred.sampleRate()};
+    const int channelCounts[] = {OPUS_CHANNELS, 1, preferred.channelCount()};
+    const QAudioFormat::SampleFormat sampleFormats[] = {QAudioFormat::Int16, QAudioFormat::Float,
+                                                        QAudioFormat::Int32, preferred.sampleFormat()};
+
+    for (int rate : rates)
+    {
+        for (int channels : channelCounts)
+        {
+            for (QAudioFormat::SampleFormat sampleFormat : sampleFormats)
+            {
+                format.setSampleRate(rate);
+                format.setChannelCount(channels);
+                format.setSampleFormat(sampleFormat);
+                if (isConvertible(format) && device.isFormatSupported(format))
+                    return format;
+            }
+        }
+    }
+
+    if (isConvertible(preferred))
+        return preferred;
+
+    qWarning() << "No usable audio format for device" << device.description() << "- preferred:" << preferred;
+    return QAudioFormat();
+}
+
+bool AudioFormatConverter::isConvertible(const QAudioFormat &format)
+{
+    return format.sampleFormat() != QAudioFormat::Unknown &&
+           format.channelCount() >= 1 && format.channelCount() <= MAX_DEVICE_CHANNELS &&
+           Resampler::isSupported(format.sampleRate(), OPUS_SAMPLE_RATE);
+}
+
+bool AudioFormatConverter::configure(const QAudioFormat &deviceFormat, Direction direction)
+{
+    if (!isConvertible(deviceFormat))
+        return false;
+
+    m_format = deviceFormat;
+    m_bytesPerFrame = deviceFormat.bytesPerFrame();
+    m_passthrough = deviceFormat.sampleRate() == OPUS_SAMPLE_RATE &&
+                    deviceFormat.channelCount() == OPUS_CHANNELS &&
+                    deviceFormat.sampleFormat() == QAudioFormat::Int16;
+
+    bool capture = direction == Direction::Capture;
+    int inputRate = capture ? deviceFormat.sampleRate() : OPUS_SAMPLE_RATE;
+    int outputRate = capture ? OPUS_SAMPLE_RATE : deviceFormat.sampleRate();
+    if (!m_resampler.configure(inputRate, outputRate, OPUS_CHANNELS))
+        return false;
+
+    int chunkFrames = capture ? PUSH_CHUNK_FRAMES : PULL_CHUNK_FRAMES;
+    int resampledFrames = m_resampler.maxOutputFrames(chunkFrames);
+    m_input.assign(chunkFrames * OPUS_CHANNELS, 0.0f);
+    m_resampled.assign(resampledFrames * OPUS_CHANNELS, 0.0f);
+    m_pcm.assign((capture ? resampledFrames : chunkFrames) * OPUS_CHANNELS, 0);
+    m_pending.assign(capture ? 0 : resampledFrames * m_bytesPerFrame, 0);
+
+    reset();
+    return true;
+}
+
+void AudioFormatConverter::reset()
+{
+    m_resampler.reset();
+    m_partialSize = 0;
+    m_pendingOffset = 0;
+    m_pendingSize = 0;
+    m_stats = Stats();
+}
+
+void AudioFormatConverter::push(const char *data, qint64 bytes, const Sink &sink)
+{
+    // Complete a device frame split across reads
+    if (m_partialSize > 0)
+    {
+        int take = static_cast<int>(qMin<qint64>(m_bytesPerFrame - m_partialSize, bytes));
+        std::memcpy(m_partialFrame + m_partialSize, data, take);
+        m_partialSize += take;
+        data += take;
+        bytes -= take;
+        if (m_partialSize < m_bytesPerFrame)
+            return;
+
+        convertFromDevice(m_partialFrame, 1, sink);
+        m_partialSize = 0;
+    }
+
+    int frames = static_cast<int>(bytes / m_bytesPerFrame);
+    for (int done = 0; done < frames; done += PUSH_CHUNK_FRAMES)
+    {
+        convertFromDevice(data + static_cast<qint64>(done) * m_bytesPerFrame, qMin(PUSH_CHUNK_FRAMES, frames - done), sink);
+    }
+
+    m_partialSize = static_cast<int>(bytes - static_cast<qint64>(frames) * m_bytesPerFrame);
+    std::memcpy(m_partialFrame, data + static_cast<qint64>(frames) * m_bytesPerFrame, m_partialSize);
+}
+
+void AudioFormatConverter::convertFromDevice(const char *data, int frames, const Sink &sink)
+{
+    if (m_passthrough)
+    {
+        // Completing a split frame in push() can leave data at an odd
+        // address; only an aligned buffer may be read as opus_int16
+        if (reinterpret_cast<quintptr>(data) % alignof(opus_int16) == 0)
+        {
+            sink(reinterpret_cast<const opus_int16 *>(data), frames);
+            return;
+        }
+        std::memcpy(m_pcm.data(), data, static_cast<size_t>(frames) * m_bytesPerFrame);
+        sink(m_pcm.data(), frames);
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    readDeviceSamples(data, frames, m_input.data());
+    const float *stereo = m_input.data();
+    if (!m_resampler.isPassthrough())
+    {
+        frames = m_resampler.process(m_input.data(), frames, m_resampled.data());
+        stereo = m_resampled.data();
+    }
+    DspKernels::floatToInt16(stereo, m_pcm.data(), frames * OPUS_CHANNELS);
+
+    m_stats.frames += frames;
+    m_stats.nsTotal += timer.nsecsElapsed();
+
+    if (frames > 0)
+        sink(m_pcm.data(), frames);
+}
+
+qint64 AudioFormatConverter::pull(char *data, qint64 maxSize, const Source &source)
+{
+    qint64 wanted = maxSize / m_bytesPerFrame * m_bytesPerFrame;
+    if (m_passthrough)
+    {
+        if (reinterpret_cast<quintptr>(data) % alignof(opus_int16) == 0)
+        {
+            source(reinterpret_cast<opus_int16 *>(data), static_cast<int>(wanted / m_bytesPerFrame));
+            return wanted;
+        }
+
+        // A sink buffer at an odd address is rendered through m_pcm instead
+        for (qint64 done = 0; done < wanted;)
+        {
+            int frames = static_cast<int>(qMin<qint64>(PULL_CHUNK_FRAMES, (wanted - done) / m_bytesPerFrame));
+            source(m_pcm.data(), frames);
+            std::memcpy(data + done, m_pcm.data(), static_cast<size_t>(frames) * m_bytesPerFrame);
+            done += static_cast<qint64>(frames) * m_bytesPerFrame;
+        }
+        return wanted;
+    }
+
+    qint64 done = 0;
+    while (done < wanted)
+    {
+        if (m_pendingOffset == m_pendingSize)
+        {
+            // Render small chunks so at most 5ms sits here between pulls
+            source(m_pcm.data(), PULL_CHUNK_FRAMES);
+
+            QElapsedTimer timer;
+            timer.start();
+
+            DspKernels::int16ToFloat(m_pcm.data(), m_input.data(), PULL_CHUNK_FRAMES * OPUS_CHANNELS);
+            const float *stereo = m_input.data();
+            int frames = PULL_CHUNK_FRAMES;
+            if (!m_resampler.isPassthrough())
+            {
+                frames = m_resampler.process(m_input.data(), PULL_CHUNK_FRAMES, m_resampled.data());
+                stereo = m_resampled.data();
+            }
+            writeDeviceSamples(stereo, frames, m_pending.data());
+            m_pendingOffset = 0;
+            m_pendingSize = frames * m_bytesPerFrame;
+
+            m_stats.frames += PULL_CHUNK_FRAMES;
+            m_stats.nsTotal += timer.nsecsElapsed();
+            continue;
+        }
+
+        int bytes = static_cast<int>(qMin<qint64>(m_pendingSize - m_pendingOffset, wanted - done));
+        std::memcpy(data + done, m_pending.data() + m_pendingOffset, bytes);
+        m_pendingOffset += bytes;
+        done += bytes;
+    }
+    return wanted;
+}
+
+void AudioFormatConverter::readDeviceSamples(const char *data, int frames, float *stereo) const
+{
+    // Mono is duplicated; beyond stereo only the front pair is used
+    int bytesPerSample = m_format.bytesPerSample();
+    bool mono = m_format.channelCount() == 1;
+    for (int i = 0; i < frames; ++i)
+    {
+        const char *frame = data + static_cast<qint64>(i) * m_bytesPerFrame;
+        float left = m_format.normalizedSampleValue(frame);
+        stereo[i * 2] = left;
+        stereo[i * 2 + 1] = mono ? left : m_format.normalizedSampleValue(frame + bytesPerSample);
+    }
+}
+
+void AudioFormatConverter::writeDeviceSamples(const float *stereo, int frames, char *data) const
+{
+    int channels = m_format.channelCount();
+    int bytesPerSample = m_format.bytesPerSample();
+    for (int i = 0; i < frames; ++i)
+    {
+        float left = stereo[i * 2];
+        float right = stereo[i * 2 + 1];
+        for (int channel = 0; channel < channels; ++channel)
+        {
+            // Mono gets the downmix; channels past the front pair stay silent
+            float value = 0.0f;
+            if (channels == 1)
+                value = 0.5f * (left + right);
+            else if (channel == 0)
+                value = left;
+            else if (channel == 1)
+                value = right;
+            value = qBound(-1.0f, value, 1.0f);
+            char *sample = data + static_cast<qint64>(i) * m_bytesPerFrame + channel * bytesPerSample;
+
+            switch (m_format.sampleFormat())
+            {
+            case QAudioFormat::UInt8:
+            {
+                quint8 v = static_cast<quint8>(qBound(0L, std::lrint(value * 128.0f) + 128, 255L));
+                std::memcpy(sample, &v, sizeof(v));
+                break;
+            }
+            case QAudioFormat::Int16:
+            {
+                qint16 v = static_cast<qint16>(qBound(-32768L, std::lrint(value * 32768.0f), 32767L));
+                std::memcpy(sample, &v, sizeof(v));
+                break;
+            }
+            case QAudioFormat::Int32:
+            {
+                qint32 v = static_cast<qint32>(qBound(-2147483648.0, std::nearbyint(value * 2147483648.0), 2147483647.0));
+                std::memcpy(sample, &v, sizeof(v));
+                break;
+            }
+            case QAudioFormat::Float:
+                std::memcpy(sample, &value, sizeof(value));
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <functional>
+#include <vector>
+#include <opus.h>
+#include "OpusCodec.h"
+#include "Resampler.h"
+
+// Bridges an audio device's native format and the Opus domain (48kHz
+// interleaved stereo Int16).
+//
+// negotiate() opens devices in the Opus format when they take it and
+// otherwise in the closest format they support: any rate the resampler can
+// tabulate, mono or stereo (extra channels are ignored), Int16, Int32,
+// Float or UInt8 samples. One converter serves one direction: push() turns
+// captured device bytes into Opus-domain frames, pull() fills a sink's
+// request from an Opus-domain source. In the Opus format both are a plain
+// pass-through with no copies, unless a buffer isn't aligned for Int16.
+class AudioFormatConverter
+{
+public:
+    enum class Direction
+    {
+        Capture,  // Device -> Opus domain
+        Playback  // Opus domain -> device
+    };
+
+    struct Stats
+    {
+        qint64 frames = 0;  // Opus-domain frames converted
+        qint64 nsTotal = 0;
+    };
+
+    // Opus-domain audio; frames are stereo Int16 at OPUS_SAMPLE_RATE
+    using Sink = std::function<void(const opus_int16 *pcm, int frames)>;
+    using Source = std::function<void(opus_int16 *pcm, int frames)>;
+
+    static QAudioFormat opusFormat();
+    static QAudioFormat negotiate(const QAudioDevice &device);
+    static bool isConvertible(const QAudioFormat &format);
+
+    bool configure(const QAudioFormat &deviceFormat, Direction direction);
+    void reset();
+
+    const QAudioFormat &deviceFormat() const { return m_format; }
+    bool isPassthrough() const { return m_passthrough; }
+
+    // Capture: convert device bytes (any length; a trailing partial frame is
+    // kept for the next call) and hand the result to sink in chunks
+    void push(const char *data, qint64 bytes, const Sink &sink);
+
+    // Playback: fill up to maxSize bytes of whole device frames, rendering
+    // Opus-domain audio from source as needed. Returns the bytes written.
+    qint64 pull(char *data, qint64 maxSize, const Source &source);
+
+    const Stats &stats() const { return m_stats; }
+
+private:
+    static constexpr int MAX_DEVICE_CHANNELS = 8;
+    static constexpr int PUSH_CHUNK_FRAMES = 1024; // Device frames per conversion
+    static constexpr int PULL_CHUNK_FRAMES = 240;  // 5ms, bounds the extra buffering
+
+    void convertFromDevice(const char *data, int frames, const Sink &sink);
+    void readDeviceSamples(const char *data, int frames, float *stereo) const;
+    void writeDeviceSamples(const float *stereo, int frames, char *data) const;
+
+    QAudioFormat m_format;
+    bool m_passthrough = true;
+    int m_bytesPerFrame = 0;
+    Resampler m_resampler;
+    Stats m_stats;
+
+    // Capture: bytes of an incomplete device frame left from the last push
+    alignas(float) char m_partialFrame[MAX_DEVICE_CHANNELS * sizeof(float)];
+    int m_partialSize = 0;
+
+    // Playback: converted device bytes not yet handed to the sink
+    std::vector<char> m_pending;
+    int m_pendingOffset = 0;
+    int m_pendingSize = 0;
+
+    // Scratch, sized in configure()
+    std::vector<float> m_input;
+    std::vector<float> m_resampled;
+    std::vector<opus_int16> m_pcm;
+};
@@ -1,11 +1,45 @@
 #include "AudioManager.h"
 #include <QAudioDevice>
 #include <QMediaDevices>
+#include <QElapsedTimer>
+#include <QSettings>
 #include <QDebug>
+#include <cstring>
+#include "NoiseSuppressor.h"
+#include "AutomaticGainControl.h"
+#include "utils/Metrics.h"
+
+namespace
+{
+MetricCounter &s_framesCapturedMetric = Metrics::counter("audio.frames_captured");
+MetricCounter &s_framesSuppressedMetric = Metrics::counter("audio.frames_suppressed");
+MetricCounter &s_framesEncodedMetric = Metrics::counter("audio.frames_encoded");
+LatencyHistogram &s_encodeMetric = Metrics::histogram("audio.opus_encode");
+MetricGauge &s_bitrateMetric = Metrics::gauge("audio.encoder_bitrate_kbps");
+}
 
 AudioManager::AudioManager(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      m_mixer(new AudioMixer(this))
 {
+    // Echo cancellation needs the raw microphone signal (the echo path must
+    // look linear), then noise suppression so the AGC levels speech rather
+    // than noise
+    m_echoCanceller = new EchoCanceller(&m_echoReference);
+    m_mixer->setEchoReference(&m_echoReference);
+    m_captureChain.addStage(m_echoCanceller);
+    m_captureChain.addStage(new NoiseSuppressor);
+    m_captureChain.addStage(new AutomaticGainControl);
+
+    // e.g. CPPCORD_CAPTURE_BYPASS=echo-cancellation,agc to profile stages
+    const QStringList bypassed = qEnvironmentVariable("CPPCORD_CAPTURE_BYPASS").split(',', Qt::SkipEmptyParts);
+    for (const QString &stage : bypassed)
+    {
+        if (!m_captureChain.setStageEnabled(stage.trimmed(), false))
+        {
+            qWarning() << "Unknown capture stage in CPPCORD_CAPTURE_BYPASS:" << stage;
+        }
+    }
 }
 
 AudioManager::~AudioManager()
@@ -14,30 +48,15 @@ AudioManager::~AudioManager()
     stopPlayback();
 }
 
-QAudioFormat AudioManager::createAudioFormat()
-{
-    QAudioFormat format;
-    format.setSampleRate(OPUS_SAMPLE_RATE);
-    format.setChannelCount(OPUS_CHANNELS);
-    format.setSampleFormat(QAudioFormat::Int16); // 16-bit PCM
-    return format;
-}
-
 bool AudioManager::initialize()
 {
-    // Initialize Opus encoder and decoder
+    // Initialize the Opus encoder; decoders are created per remote stream
     if (!m_encoder.initialize())
     {
         qWarning() << "Failed to initialize Opus encoder";
         return false;
     }
 
-    if (!m_decoder.initialize())
-    {
-        qWarning() << "Failed to initialize Opus decoder";
-        return false;
-    }
-
     qDebug() << "AudioManager initialized successfully";
     return true;
 }
@@ -50,13 +69,12 @@ bool AudioManager::startCapture()
         return false;
     }
 
-    QAudioFormat format = createAudioFormat();
     QAudioDevice inputDevice = QMediaDevices::defaultAudioInput();
+    QAudioFormat format = AudioFormatConverter::negotiate(inputDevice);
 
-    if (!inputDevice.isFormatSupported(format))
+    if (!m_captureConverter.configure(format, AudioFormatConverter::Direction::Capture))
     {
-        qWarning() << "Audio format not supported by input device";
-        qWarning() << "Requested:" << format;
+        qWarning() << "No supported audio format for input device" << inputDevice.description();
         return false;
     }
 
@@ -73,10 +91,20 @@ bool AudioManager::startCapture()
 
     connect(m_captureDevice, &QIODevice::readyRead, this, &AudioManager::onCaptureReady);
     m_capturing = true;
-    m_captureBuffer.clear();
+    m_captureRing.clear();
+    m_captureChain.reset();
+    m_captureChain.resetStats();
+    m_vad.reset();
+    m_vadStats = VadStats();
+
+    // A new call starts from the default rung, not where the last one ended
+    m_encoderController.reset();
+    m_encoder.applySettings(m_encoderController.settings());
+    s_bitrateMetric.set(m_encoderController.settings().bitrate / 1000.0);
 
     qDebug() << "Audio capture started on device:" << inputDevice.description();
-    qDebug() << "Audio format:" << format.sampleRate() << "Hz," << format.channelCount() << "channels";
+    qDebug() << "Audio format:" << format.sampleRate() << "Hz," << format.channelCount() << "channels,"
+             << format.sampleFormat() << (m_captureConverter.isPassthrough() ? "" : "(converted)");
     return true;
 }
 
@@ -90,9 +118,15 @@ void AudioManager::stopCapture()
     m_audioSource = nullptr;
     m_captureDevice = nullptr;
     m_capturing = false;
-    m_captureBuffer.clear();
+    m_captureRing.clear();
+    setTransmitting(false);
 
     qDebug() << "Audio capture stopped";
+    logConversionStats("Capture", m_captureConverter.stats());
+    logVadStats();
+    m_captureChain.logStats();
+    qDebug() << "Echo canceller: delay" << m_echoCanceller->delaySamples() / (OPUS_SAMPLE_RATE / 1000)
+             << "ms, ERLE" << m_echoCanceller->erleDb() << "dB";
 }
 
 void AudioManager::onCaptureReady()
@@ -100,35 +134,156 @@ void AudioManager::onCaptureReady()
     if (!m_captureDevice)
         return;
 
-    // Read available audio data
-    QByteArray data = m_captureDevice->readAll();
-    m_captureBuffer.append(data);
+    if (!m_captureConverter.isPassthrough())
+    {
+        // Native device format: convert into the Opus domain first
+        for (;;)
+        {
+            qint64 bytesRead = m_captureDevice->read(m_captureBytes, sizeof(m_captureBytes));
+            if (bytesRead <= 0)
+                break;
 
-    // Process complete Opus frames (20ms = 960 samples * 2 channels * 2 bytes)
-    int frameSize = OPUS_FRAME_SIZE * OPUS_CHANNELS * sizeof(opus_int16);
+            m_captureConverter.push(m_captureBytes, bytesRead,
+                                    [this](const opus_int16 *pcm, int frames) { writeCaptureFrames(pcm, frames); });
+        }
+        return;
+    }
 
-    while (m_captureBuffer.size() >= frameSize)
+    // Read straight into the current frame slot. readAll() plus append/remove
+    // cost an allocation and a memmove of the remaining buffer on every frame.
+    for (;;)
     {
-        QByteArray frame = m_captureBuffer.left(frameSize);
-        m_captureBuffer.remove(0, frameSize);
-
-        // Emit raw PCM
-        emit pcmDataReady(frame);
+        qint64 bytesRead = m_captureDevice->read(m_captureRing.writePointer(), m_captureRing.writeSpace());
+        if (bytesRead <= 0)
+            break;
 
-        // Encode to Opus
-        QByteArray opus = m_encoder.encode(frame);
-        if (!opus.isEmpty())
+        opus_int16 *frame = m_captureRing.commit(static_cast<int>(bytesRead));
+        if (frame)
         {
-            qDebug() << "Emitting Opus data:" << opus.size() << "bytes";
-            emit opusDataReady(opus);
+            processCaptureFrame(frame);
         }
-        else
+    }
+}
+
+void AudioManager::writeCaptureFrames(const opus_int16 *pcm, int frames)
+{
+    const char *data = reinterpret_cast<const char *>(pcm);
+    int remaining = frames * OPUS_CHANNELS * static_cast<int>(sizeof(opus_int16));
+    while (remaining > 0)
+    {
+        int bytes = qMin(remaining, m_captureRing.writeSpace());
+        std::memcpy(m_captureRing.writePointer(), data, bytes);
+        data += bytes;
+        remaining -= bytes;
+
+        opus_int16 *frame = m_captureRing.commit(bytes);
+        if (frame)
         {
-            qDebug() << "Warning: Opus encoding returned empty data";
+            processCaptureFrame(frame);
         }
     }
 }
 
+void AudioManager::logConversionStats(const char *direction, const AudioFormatConverter::Stats &stats) const
+{
+    if (stats.frames == 0)
+        return;
+
+    // Per 20ms frame, to compare against the real-time budget
+    double usPerFrame = stats.nsTotal / 1e3 / (static_cast<double>(stats.frames) / OPUS_FRAME_SIZE);
+    qDebug().noquote() << direction << "format conversion:" << QString::number(usPerFrame, 'f', 1) << "us per 20ms frame";
+}
+
+void AudioManager::processCaptureFrame(opus_int16 *frame)
+{
+    // Clean up the frame in place inside its ring slot
+    m_captureChain.process(frame);
+
+    // Emit raw PCM. fromRawData wraps the slot without copying it, so the
+    // array is only valid during the emit (see pcmDataReady)
+    emit pcmDataReady(QByteArray::fromRawData(reinterpret_cast<const char *>(frame), CaptureFrameRing::FRAME_BYTES));
+
+    // Drop silence before it costs an encode, encryption and a datagram
+    m_vadStats.framesCaptured++;
+    s_framesCapturedMetric.add();
+    setTransmitting(m_vad.process(frame, OPUS_FRAME_SIZE));
+    if (!m_transmitting)
+    {
+        m_vadStats.framesSuppressed++;
+        s_framesSuppressedMetric.add();
+        return;
+    }
+
+    // Encode to Opus into a pooled buffer
+    QElapsedTimer encodeTimer;
+    encodeTimer.start();
+    QByteArray &opus = m_packetPool.acquire();
+    int encodedBytes = m_encoder.encode(frame, opus);
+    qint64 encodeNs = encodeTimer.nsecsElapsed();
+    m_vadStats.encodeNsTotal += encodeNs;
+    s_encodeMetric.record(encodeNs);
+
+    m_encoderController.updateEncodeTime(encodeNs);
+    if (m_encoderController.takeChanged())
+    {
+        m_encoder.applySettings(m_encoderController.settings());
+        s_bitrateMetric.set(m_encoderController.settings().bitrate / 1000.0);
+    }
+
+    if (encodedBytes > 0)
+    {
+        s_framesEncodedMetric.add();
+        emit opusDataReady(opus);
+    }
+    else
+    {
+        qDebug() << "Warning: Opus encoding returned empty data";
+    }
+}
+
+bool AudioManager::setCaptureStageEnabled(const QString &stage, bool enabled)
+{
+    return m_captureChain.setStageEnabled(stage, enabled);
+}
+
+void AudioManager::updateNetworkStats(double lossFraction, int rttMs)
+{
+    m_encoderController.updateNetwork(lossFraction, rttMs);
+    if (m_encoderController.takeChanged())
+    {
+        m_encoder.applySettings(m_encoderController.settings());
+        s_bitrateMetric.set(m_encoderController.settings().bitrate / 1000.0);
+    }
+}
+
+void AudioManager::setTransmitting(bool transmitting)
+{
+    if (transmitting == m_transmitting)
+        return;
+
+    m_transmitting = transmitting;
+    emit speakingChanged(transmitting);
+}
+
+void AudioManager::logVadStats() const
+{
+    if (m_vadStats.framesCaptured == 0)
+        return;
+
+    qint64 framesSent = m_vadStats.framesCaptured - m_vadStats.framesSuppressed;
+    double suppressedPercent = 100.0 * m_vadStats.framesSuppressed / m_vadStats.framesCaptured;
+
+    // Suppressed frames skip the encoder entirely, so the saving is their share
+    // of the encode time measured on the frames that were actually sent
+    double avgEncodeMs = framesSent > 0 ? m_vadStats.encodeNsTotal / 1e6 / framesSent : 0.0;
+    double savedMs = avgEncodeMs * m_vadStats.framesSuppressed;
+
+    qDebug().noquote() << "VAD: suppressed" << m_vadStats.framesSuppressed << "of" << m_vadStats.framesCaptured
+             << "frames (" << QString::number(suppressedPercent, 'f', 1) << "%), saved ~"
+             << QString::number(savedMs, 'f', 1) << "ms encode time (avg"
+             << QString::number(avgEncodeMs, 'f', 3) << "ms/frame)";
+}
+
 bool AudioManager::startPlayback()
 {
     if (m_playing)
@@ -137,28 +292,37 @@ bool AudioManager::startPlayback()
         return false;
     }
 
-    QAudioFormat format = createAudioFormat();
     QAudioDevice outputDevice = QMediaDevices::defaultAudioOutput();
+    QAudioFormat format = AudioFormatConverter::negotiate(outputDevice);
 
-    if (!outputDevice.isFormatSupported(format))
+    if (!m_mixer->setOutputFormat(format))
     {
-        qWarning() << "Audio format not supported by output device";
+        qWarning() << "No supported audio format for output device" << outputDevice.description();
         return false;
     }
 
+    m_mixer->clear();
+    m_mixer->open(QIODevice::ReadOnly);
+
+    // Pull mode: the sink reads from the ring at its own pace. Keep the
+    // device buffer small; the ring provides the jitter margin.
     m_audioSink = new QAudioSink(outputDevice, format, this);
-    m_playbackDevice = m_audioSink->start();
+    m_audioSink->setBufferSize(format.bytesForDuration(40000));
+    m_audioSink->start(m_mixer);
 
-    if (!m_playbackDevice)
+    if (m_audioSink->error() != QAudio::NoError)
     {
-        qWarning() << "Failed to start audio playback";
+        qWarning() << "Failed to start audio playback:" << m_audioSink->error();
         delete m_audioSink;
         m_audioSink = nullptr;
+        m_mixer->close();
         return false;
     }
 
     m_playing = true;
     qDebug() << "Audio playback started on device:" << outputDevice.description();
+    qDebug() << "Audio format:" << format.sampleRate() << "Hz," << format.channelCount() << "channels,"
+             << format.sampleFormat();
     return true;
 }
 
@@ -170,42 +334,108 @@ void AudioManager::stopPlayback()
     m_audioSink->stop();
     delete m_audioSink;
     m_audioSink = nullptr;
-    m_playbackDevice = nullptr;
+    m_mixer->close();
     m_playing = false;
-    m_playbackQueue.clear();
+
+    logPlaybackStats();
+    logConversionStats("Playback", m_mixer->outputConversionStats());
+    m_mixer->clear();
 
     qDebug() << "Audio playback stopped";
 }
 
-void AudioManager::addOpusData(const QByteArray &opus)
+void AudioManager::addOpusData(quint32 ssrc, const QByteArray &opus)
+{
+    if (!m_playing)
+        return;
+
+    m_mixer->addPacket(ssrc, opus);
+}
+
+void AudioManager::setUserVolume(Snowflake userId, float volume)
 {
-    qDebug() << "addOpusData called with" << opus.size() << "bytes";
+    volume = qBound(0.0f, volume, 2.0f);
+    m_userVolumes.insert(userId, volume);
 
-    if (!m_playing || !m_playbackDevice)
+    auto it = m_userSsrcs.constFind(userId);
+    if (it != m_userSsrcs.constEnd())
     {
-        qDebug() << "Not playing or no playback device";
-        return;
+        m_mixer->setStreamGain(it.value(), volume);
     }
+}
+
+void AudioManager::setOutputVolume(float volume)
+{
+    m_mixer->setMasterGain(qBound(0.0f, volume, 2.0f));
+}
 
-    // Decode Opus to PCM
-    QByteArray pcm = m_decoder.decode(opus);
-    if (pcm.isEmpty())
+void AudioManager::loadVolumeSettings()
+{
+    QSettings settings;
+    setOutputVolume(settings.value("audio/output_volume", 1.0f).toFloat());
+
+    settings.beginGroup("audio/user_volume");
+    const QStringList users = settings.childKeys();
+    for (const QString &user : users)
     {
-        qDebug() << "Opus decode returned empty";
-        return;
+        bool ok = false;
+        Snowflake userId = user.toULongLong(&ok);
+        if (ok)
+            setUserVolume(userId, settings.value(user).toFloat());
     }
+    settings.endGroup();
+}
 
-    qDebug() << "Decoded" << opus.size() << "bytes Opus to" << pcm.size() << "bytes PCM";
+void AudioManager::saveVolumeSettings() const
+{
+    QSettings settings;
+    settings.setValue("audio/output_volume", outputVolume());
 
-    // Write directly to audio sink
-    qint64 written = m_playbackDevice->write(pcm);
-    if (written < pcm.size())
+    // Unity is the default, so only adjusted users are stored
+    settings.remove("audio/user_volume");
+    settings.beginGroup("audio/user_volume");
+    for (auto it = m_userVolumes.constBegin(); it != m_userVolumes.constEnd(); ++it)
     {
-        qWarning() << "Audio playback buffer full, dropped" << (pcm.size() - written) << "bytes";
+        if (!qFuzzyCompare(it.value(), 1.0f))
+            settings.setValue(QString::number(it.key()), it.value());
     }
+    settings.endGroup();
+}
+
+float AudioManager::userLevel(Snowflake userId) const
+{
+    auto it = m_userSsrcs.constFind(userId);
+    return it != m_userSsrcs.constEnd() ? m_mixer->streamLevel(it.value()) : 0.0f;
+}
+
+void AudioManager::mapUserSsrc(Snowflake userId, quint32 ssrc)
+{
+    bool added = !m_userSsrcs.contains(userId);
+    m_userSsrcs.insert(userId, ssrc);
+    m_mixer->setStreamGain(ssrc, userVolume(userId));
+    if (added)
+        emit voiceUsersChanged();
+}
+
+void AudioManager::removeUser(Snowflake userId)
+{
+    auto it = m_userSsrcs.find(userId);
+    if (it == m_userSsrcs.end())
+        return;
+
+    m_mixer->removeStream(it.value());
+    m_userSsrcs.erase(it);
+    emit voiceUsersChanged();
 }
 
-void AudioManager::processPlaybackQueue()
+void AudioManager::logPlaybackStats() const
 {
-    // Reserved for future buffering implementation if needed
+    const QHash<quint32, PlaybackBuffer::Stats> streams = m_mixer->streamStats();
+    for (auto it = streams.constBegin(); it != streams.constEnd(); ++it)
+    {
+        const PlaybackBuffer::Stats &stats = it.value();
+        qDebug() << "Playback stats for SSRC" << it.key() << "- underruns:" << stats.underruns
+                 << "overflow frames:" << stats.overflows << "latency resets:" << stats.skips
+                 << "drift correction:" << QString::number((stats.ratio - 1.0) * 1e6, 'f', 0) << "ppm";
+    }
 }
@@ -7,6 +7,14 @@
 #include <QBuffer>
 #include <QAudioFormat>
 #include "OpusCodec.h"
+#include "CaptureFrameRing.h"
+#include "VoiceActivityDetector.h"
+#include "AudioMixer.h"
+#include "AudioFormatConverter.h"
+#include "CaptureChain.h"
+#include "EchoReference.h"
+#include "EchoCanceller.h"
+#include "models/Snowflake.h"
 
 class AudioManager : public QObject
 {
@@ -28,31 +36,95 @@ public:
     void stopPlayback();
     bool isPlaying() const { return m_playing; }
 
-    // Add incoming opus data for playback
-    void addOpusData(const QByteArray &opus);
+    // Add incoming opus data for playback, per sender SSRC
+    void addOpusData(quint32 ssrc, const QByteArray &opus);
+
+    // Per-user and master output volume (1.0 = unity, up to 2.0)
+    void setUserVolume(Snowflake userId, float volume);
+    float userVolume(Snowflake userId) const { return m_userVolumes.value(userId, 1.0f); }
+    void setOutputVolume(float volume);
+    float outputVolume() const { return m_mixer->masterGain(); }
+
+    // Volumes kept in QSettings under "audio/"; the app loads them once at
+    // startup and saves whenever the user changes one
+    void loadVolumeSettings();
+    void saveVolumeSettings() const;
+
+    // Remote users whose streams the voice connection has mapped
+    QList<Snowflake> voiceUsers() const { return m_userSsrcs.keys(); }
+
+    // Peak levels (0..1) for meters
+    float outputLevel() const { return m_mixer->outputLevel(); }
+    float userLevel(Snowflake userId) const;
+
+    // Voice activity statistics for the current (or last) capture session
+    struct VadStats
+    {
+        qint64 framesCaptured = 0;
+        qint64 framesSuppressed = 0;
+        qint64 encodeNsTotal = 0; // Time spent encoding the frames that were sent
+    };
+    const VadStats &vadStats() const { return m_vadStats; }
+
+    // Pre-encode processing ("echo-cancellation", "noise-suppression",
+    // "agc"); each stage can be bypassed to measure its cost
+    bool setCaptureStageEnabled(const QString &stage, bool enabled);
+    QList<CaptureChain::StageStats> captureStageStats() const { return m_captureChain.stats(); }
+    float echoReturnLossEnhancementDb() const { return m_echoCanceller->erleDb(); }
+
+public slots:
+    // Network feedback for the encoder (lossFraction < 0 when unknown)
+    void updateNetworkStats(double lossFraction, int rttMs);
+
+    // Remote users announce their SSRC through the voice gateway
+    void mapUserSsrc(Snowflake userId, quint32 ssrc);
+    void removeUser(Snowflake userId);
 
 signals:
-    void pcmDataReady(const QByteArray &pcm);   // Raw PCM from microphone
+    // Processed PCM from the microphone, one 20ms frame. The array wraps the
+    // capture ring slot without copying it and is only valid until the slot
+    // returns; the ring reuses it a few frames later. Connect directly and
+    // copy (QByteArray(pcm.constData(), pcm.size())) anything kept or handed
+    // to another thread; a queued connection would share the same slot.
+    void pcmDataReady(const QByteArray &pcm);
     void opusDataReady(const QByteArray &opus); // Encoded Opus from microphone
+    void speakingChanged(bool speaking);        // Voice activity started/stopped
+    void voiceUsersChanged();                   // A remote user was mapped or removed
 
 private slots:
     void onCaptureReady();
-    void processPlaybackQueue();
 
 private:
-    QAudioFormat createAudioFormat();
+    friend struct BenchmarkAccess; // bench/BenchmarkAccess.h
+
+    void writeCaptureFrames(const opus_int16 *pcm, int frames);
+    void processCaptureFrame(opus_int16 *frame);
+    void setTransmitting(bool transmitting);
+    void logVadStats() const;
+    void logPlaybackStats() const;
+    void logConversionStats(const char *direction, const AudioFormatConverter::Stats &stats) const;
 
     // Capture (microphone)
     QAudioSource *m_audioSource = nullptr;
     QIODevice *m_captureDevice = nullptr;
     OpusEncoder m_encoder;
-    QByteArray m_captureBuffer;
+    EncoderController m_encoderController;
+    AudioFormatConverter m_captureConverter;
+    char m_captureBytes[8192]; // Device-format reads when converting
+    CaptureFrameRing m_captureRing;
+    CaptureChain m_captureChain;
+    EchoCanceller *m_echoCanceller = nullptr; // Owned by m_captureChain
+    OpusPacketPool m_packetPool;
+    VoiceActivityDetector m_vad;
+    VadStats m_vadStats;
+    bool m_transmitting = false;
     bool m_capturing = false;
 
     // Playback (speakers)
     QAudioSink *m_audioSink = nullptr;
-    QIODevice *m_playbackDevice = nullptr;
-    OpusDecoder m_decoder;
-    QList<QByteArray> m_playbackQueue;
+    AudioMixer *m_mixer = nullptr; // Pulled by the sink at the device clock
+    EchoReference m_echoReference; // What the mixer played, for the canceller
+    QHash<Snowflake, float> m_userVolumes;
+    QHash<Snowflake, quint32> m_userSsrcs;
     bool m_playing = false;
 };
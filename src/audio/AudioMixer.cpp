@@ -0,0 +1,192 @@
+#include "AudioMixer.h"
+#include <QMutexLocker>
+#include <QDebug>
+#include <cstring>
+
+AudioMixer::AudioMixer(QObject *parent)
+    : QIODevice(parent)
+{
+    m_outputConverter.configure(AudioFormatConverter::opusFormat(), AudioFormatConverter::Direction::Playback);
+}
+
+bool AudioMixer::setOutputFormat(const QAudioFormat &format)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_outputConverter.configure(format, AudioFormatConverter::Direction::Playback);
+}
+
+AudioFormatConverter::Stats AudioMixer::outputConversionStats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_outputConverter.stats();
+}
+
+AudioMixer::~AudioMixer()
+{
+    clear();
+}
+
+AudioMixer::Stream *AudioMixer::findOrCreateStream(quint32 ssrc)
+{
+    QMutexLocker locker(&m_mutex);
+
+    Stream *stream = m_streams.value(ssrc, nullptr);
+    if (stream)
+        return stream;
+
+    stream = new Stream;
+    if (!stream->decoder.initialize())
+    {
+        qWarning() << "Failed to create Opus decoder for SSRC" << ssrc;
+        delete stream;
+        return nullptr;
+    }
+
+    stream->gain.store(m_pendingGains.value(ssrc, 1.0f), std::memory_order_relaxed);
+    m_streams.insert(ssrc, stream);
+    qDebug() << "New playback stream for SSRC" << ssrc;
+    return stream;
+}
+
+bool AudioMixer::addPacket(quint32 ssrc, const QByteArray &opus)
+{
+    // Streams are only removed from this (the producer's) thread, so the
+    // pointer stays valid after the lookup releases the lock
+    Stream *stream = findOrCreateStream(ssrc);
+    if (!stream)
+        return false;
+
+    int samples = stream->decoder.decode(opus, m_decodeBuffer, CHUNK_FRAMES);
+    if (samples <= 0)
+        return false;
+
+    // The sink pulls from the ring; if it has stalled, drop rather than block
+    return stream->buffer.writeFrames(m_decodeBuffer, samples);
+}
+
+void AudioMixer::removeStream(quint32 ssrc)
+{
+    QMutexLocker locker(&m_mutex);
+    delete m_streams.take(ssrc);
+    m_pendingGains.remove(ssrc);
+}
+
+void AudioMixer::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    qDeleteAll(m_streams);
+    m_streams.clear();
+    m_outputPeak.store(0.0f, std::memory_order_relaxed);
+}
+
+void AudioMixer::setStreamGain(quint32 ssrc, float gain)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pendingGains.insert(ssrc, gain);
+    if (Stream *stream = m_streams.value(ssrc, nullptr))
+    {
+        stream->gain.store(gain, std::memory_order_relaxed);
+    }
+}
+
+float AudioMixer::streamLevel(quint32 ssrc) const
+{
+    QMutexLocker locker(&m_mutex);
+    Stream *stream = m_streams.value(ssrc, nullptr);
+    return stream ? stream->peak.load(std::memory_order_relaxed) : 0.0f;
+}
+
+QHash<quint32, PlaybackBuffer::Stats> AudioMixer::streamStats() const
+{
+    QMutexLocker locker(&m_mutex);
+    QHash<quint32, PlaybackBuffer::Stats> stats;
+    for (auto it = m_streams.constBegin(); it != m_streams.constEnd(); ++it)
+    {
+        stats.insert(it.key(), it.value()->buffer.stats());
+    }
+    return stats;
+}
+
+qint64 AudioMixer::bytesAvailable() const
+{
+    // readData() always fills the request (with silence if need be), so the
+    // sink can pull whenever it wants
+    return PlaybackBuffer::CAPACITY_FRAMES * PlaybackBuffer::BYTES_PER_FRAME + QIODevice::bytesAvailable();
+}
+
+qint64 AudioMixer::readData(char *data, qint64 maxSize)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_outputConverter.pull(data, maxSize, [this](qint16 *out, int frames) { render(out, frames); });
+}
+
+void AudioMixer::render(qint16 *out, int frames)
+{
+    for (int done = 0; done < frames; done += CHUNK_FRAMES)
+    {
+        mixChunk(out + done * OPUS_CHANNELS, qMin(CHUNK_FRAMES, frames - done));
+    }
+}
+
+qint64 AudioMixer::writeData(const char *data, qint64 maxSize)
+{
+    // Only the sink reads this device; producers use addPacket()
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+void AudioMixer::mixChunk(qint16 *out, int frames)
+{
+    int samples = frames * OPUS_CHANNELS;
+    std::memset(m_mix, 0, samples * sizeof(float));
+
+    int active = 0;
+    for (Stream *stream : std::as_const(m_streams))
+    {
+        if (!stream->buffer.render(m_streamPcm, frames))
+        {
+            stream->peak.store(0.0f, std::memory_order_relaxed);
+            continue;
+        }
+
+        float gain = stream->gain.load(std::memory_order_relaxed);
+        DspKernels::int16ToFloat(m_streamPcm, m_streamFloat, samples);
+        DspKernels::mixAccumulate(m_mix, m_streamFloat, samples, gain);
+        stream->peak.store(DspKernels::measure(m_streamPcm, samples).peak * gain, std::memory_order_relaxed);
+        active++;
+    }
+
+    if (active == 0)
+    {
+        std::memset(out, 0, samples * sizeof(qint16));
+        m_outputPeak.store(0.0f, std::memory_order_relaxed);
+        writeEchoReference(nullptr, frames);
+        return;
+    }
+
+    // Several loud talkers (or boosted gains) can sum past full scale
+    DspKernels::applyGain(m_mix, samples, m_masterGain.load(std::memory_order_relaxed));
+    DspKernels::softClip(m_mix, samples);
+    m_outputPeak.store(DspKernels::measure(m_mix, samples).peak, std::memory_order_relaxed);
+    DspKernels::floatToInt16(m_mix, out, samples);
+    writeEchoReference(m_mix, frames);
+}
+
+void AudioMixer::writeEchoReference(const float *mix, int frames)
+{
+    if (!m_echoReference)
+        return;
+
+    // Silence is written too so the playback timeline has no gaps
+    if (!mix)
+    {
+        std::memset(m_echoMono, 0, frames * sizeof(float));
+    }
+    else
+    {
+        for (int i = 0; i < frames; ++i)
+            m_echoMono[i] = 0.5f * (mix[i * 2] + mix[i * 2 + 1]);
+    }
+    m_echoReference->write(m_echoMono, frames);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QIODevice>
+#include <QHash>
+#include <QMutex>
+#include <atomic>
+#include "OpusCodec.h"
+#include "PlaybackBuffer.h"
+#include "DspKernels.h"
+#include "EchoReference.h"
+#include "AudioFormatConverter.h"
+
+// Pull-model output device that mixes every remote stream.
+//
+// Each SSRC gets its own Opus decoder (decoder state is per stream) and its
+// own drift-compensated PlaybackBuffer. When the sink pulls, active streams
+// are converted to float, scaled by their per-user gain and accumulated,
+// then master gain and a soft clipper are applied before converting back to
+// int16. Stream membership is guarded by a mutex that the pulling side only
+// holds while mixing; the sample data itself is exchanged lock-free.
+// Everything handed to the sink is also appended, downmixed to mono, to the
+// echo reference so the capture side can cancel it. Mixing always happens in
+// the Opus domain; devices in other formats are served through a converter.
+class AudioMixer : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    static constexpr int CHUNK_FRAMES = OPUS_FRAME_SIZE;
+    static constexpr int CHUNK_SAMPLES = CHUNK_FRAMES * OPUS_CHANNELS;
+
+    explicit AudioMixer(QObject *parent = nullptr);
+    ~AudioMixer();
+
+    // Producer side: decode one packet into the sender's ring, creating the
+    // stream on first use. Returns false if the packet was dropped.
+    bool addPacket(quint32 ssrc, const QByteArray &opus);
+    void removeStream(quint32 ssrc);
+    void clear();
+
+    void setStreamGain(quint32 ssrc, float gain);
+    void setMasterGain(float gain) { m_masterGain.store(gain, std::memory_order_relaxed); }
+    float masterGain() const { return m_masterGain.load(std::memory_order_relaxed); }
+
+    // Set before the sink starts pulling
+    void setEchoReference(EchoReference *reference) { m_echoReference = reference; }
+    bool setOutputFormat(const QAudioFormat &format);
+    AudioFormatConverter::Stats outputConversionStats() const;
+
+    // Peak level (0..1) of the most recently mixed chunk
+    float streamLevel(quint32 ssrc) const;
+    float outputLevel() const { return m_outputPeak.load(std::memory_order_relaxed); }
+
+    QHash<quint32, PlaybackBuffer::Stats> streamStats() const;
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    friend struct BenchmarkAccess; // bench/BenchmarkAccess.h
+
+    struct Stream
+    {
+        OpusDecoder decoder;
+        PlaybackBuffer buffer;
+        std::atomic<float> gain{1.0f};
+        std::atomic<float> peak{0.0f};
+    };
+
+    Stream *findOrCreateStream(quint32 ssrc);
+    void render(qint16 *out, int frames);
+    void mixChunk(qint16 *out, int frames);
+    void writeEchoReference(const float *mix, int frames);
+
+    mutable QMutex m_mutex; // Guards m_streams membership
+    QHash<quint32, Stream *> m_streams;
+    QHash<quint32, float> m_pendingGains; // Gains set before the stream's first packet
+    std::atomic<float> m_masterGain{1.0f};
+    std::atomic<float> m_outputPeak{0.0f};
+    EchoReference *m_echoReference = nullptr;
+    AudioFormatConverter m_outputConverter; // Consumer side, under m_mutex
+
+    // Producer-only decode scratch
+    alignas(16) opus_int16 m_decodeBuffer[CHUNK_SAMPLES];
+
+    // Consumer-only mix scratch
+    alignas(32) qint16 m_streamPcm[CHUNK_SAMPLES];
+    alignas(32) float m_streamFloat[CHUNK_SAMPLES];
+    alignas(32) float m_mix[CHUNK_SAMPLES];
+    float m_echoMono[CHUNK_FRAMES];
+};
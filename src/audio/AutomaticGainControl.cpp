@@ -0,0 +1,42 @@
+#include "AutomaticGainControl.h"
+#include "DspKernels.h"
+#include <algorithm>
+#include <cmath>
+
+void AutomaticGainControl::reset()
+{
+    m_gainDb = 0.0f;
+    m_appliedGain = 1.0f;
+}
+
+void AutomaticGainControl::process(float *samples, int count)
+{
+    DspKernels::Level level = DspKernels::measure(samples, count);
+    float levelDb = 20.0f * std::log10(std::max(level.rms, 1e-6f));
+
+    if (levelDb > GATE_DBFS)
+    {
+        float desired = std::clamp(TARGET_DBFS - levelDb, MIN_GAIN_DB, MAX_GAIN_DB);
+        if (desired < m_gainDb)
+            m_gainDb = std::max(desired, m_gainDb - ATTACK_DB_PER_FRAME);
+        else
+            m_gainDb = std::min(desired, m_gainDb + RELEASE_DB_PER_FRAME);
+    }
+
+    // Never let the gain push this frame's peak into the clipper
+    if (level.peak > 0.0f)
+    {
+        float ceilingDb = 20.0f * std::log10(PEAK_CEILING / level.peak);
+        m_gainDb = std::min(m_gainDb, ceilingDb);
+    }
+
+    float target = std::pow(10.0f, m_gainDb / 20.0f);
+    float step = (target - m_appliedGain) / count;
+    float gain = m_appliedGain;
+    for (int i = 0; i < count; ++i)
+    {
+        gain += step;
+        samples[i] *= gain;
+    }
+    m_appliedGain = target;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CaptureChain.h"
+
+// Digital AGC for the capture chain.
+//
+// Steers speech towards TARGET_DBFS: gain drops quickly when the talker is
+// too loud and rises slowly when they are quiet. Frames below GATE_DBFS
+// (silence, background) leave the gain alone so pauses aren't amplified into
+// noise. Gain is ramped across each frame to avoid zipper noise, and capped
+// so the frame peak stays below full scale.
+class AutomaticGainControl : public CaptureStage
+{
+public:
+    static constexpr float TARGET_DBFS = -18.0f;
+    static constexpr float GATE_DBFS = -50.0f;
+    static constexpr float MAX_GAIN_DB = 20.0f;
+    static constexpr float MIN_GAIN_DB = -12.0f;
+    static constexpr float ATTACK_DB_PER_FRAME = 1.0f;   // Gain reduction speed
+    static constexpr float RELEASE_DB_PER_FRAME = 0.15f; // Gain increase speed (~7.5 dB/s)
+    static constexpr float PEAK_CEILING = 0.95f;
+
+    const char *name() const override { return "agc"; }
+    void reset() override;
+    void process(float *samples, int count) override;
+
+    float gainDb() const { return m_gainDb; }
+
+private:
+    float m_gainDb = 0.0f;
+    float m_appliedGain = 1.0f; // Linear gain at the end of the previous frame
+};
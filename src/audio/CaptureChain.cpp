@@ -0,0 +1,129 @@
+#include "CaptureChain.h"
+#include "DspKernels.h"
+#include <QElapsedTimer>
+#include <QDebug>
+
+CaptureChain::~CaptureChain()
+{
+    for (const Entry &entry : std::as_const(m_stages))
+    {
+        delete entry.stage;
+    }
+}
+
+void CaptureChain::addStage(CaptureStage *stage)
+{
+    Entry entry;
+    entry.stage = stage;
+    m_stages.append(entry);
+}
+
+bool CaptureChain::setStageEnabled(const QString &name, bool enabled)
+{
+    for (Entry &entry : m_stages)
+    {
+        if (name == QLatin1String(entry.stage->name()))
+        {
+            // A stage picks up stale state while bypassed; start it clean
+            if (enabled && !entry.enabled)
+                entry.stage->reset();
+            entry.enabled = enabled;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CaptureChain::process(opus_int16 *frame)
+{
+    bool anyEnabled = false;
+    for (const Entry &entry : std::as_const(m_stages))
+        anyEnabled |= entry.enabled;
+
+    // Fully bypassed: leave the microphone frame untouched
+    if (!anyEnabled)
+        return;
+
+    constexpr float scale = 0.5f / 32768.0f;
+    for (int i = 0; i < OPUS_FRAME_SIZE; ++i)
+    {
+        m_mono[i] = (frame[2 * i] + frame[2 * i + 1]) * scale;
+    }
+
+    QElapsedTimer timer;
+    for (Entry &entry : m_stages)
+    {
+        if (!entry.enabled)
+            continue;
+
+        timer.start();
+        entry.stage->process(m_mono, OPUS_FRAME_SIZE);
+        qint64 ns = timer.nsecsElapsed();
+
+        entry.frames++;
+        entry.nsTotal += ns;
+        entry.nsMax = qMax(entry.nsMax, ns);
+    }
+
+    // Gain stages may push peaks past full scale
+    DspKernels::softClip(m_mono, OPUS_FRAME_SIZE);
+    DspKernels::floatToInt16(m_mono, m_monoPcm, OPUS_FRAME_SIZE);
+    for (int i = 0; i < OPUS_FRAME_SIZE; ++i)
+    {
+        frame[2 * i] = m_monoPcm[i];
+        frame[2 * i + 1] = m_monoPcm[i];
+    }
+}
+
+void CaptureChain::reset()
+{
+    for (Entry &entry : m_stages)
+    {
+        entry.stage->reset();
+    }
+}
+
+QList<CaptureChain::StageStats> CaptureChain::stats() const
+{
+    QList<StageStats> result;
+    for (const Entry &entry : m_stages)
+    {
+        StageStats stats;
+        stats.name = QLatin1String(entry.stage->name());
+        stats.enabled = entry.enabled;
+        stats.frames = entry.frames;
+        stats.nsTotal = entry.nsTotal;
+        stats.nsMax = entry.nsMax;
+        result.append(stats);
+    }
+    return result;
+}
+
+void CaptureChain::resetStats()
+{
+    for (Entry &entry : m_stages)
+    {
+        entry.frames = 0;
+        entry.nsTotal = 0;
+        entry.nsMax = 0;
+    }
+}
+
+void CaptureChain::logStats() const
+{
+    constexpr double frameBudgetNs = 20e6;
+    for (const StageStats &stats : this->stats())
+    {
+        if (!stats.enabled || stats.frames == 0)
+        {
+            qDebug().noquote() << "Capture stage" << stats.name << "bypassed";
+            continue;
+        }
+
+        double avgNs = static_cast<double>(stats.nsTotal) / stats.frames;
+        qDebug().noquote() << "Capture stage" << stats.name << "- avg"
+                           << QString::number(avgNs / 1e3, 'f', 1) << "us/frame ("
+                           << QString::number(100.0 * avgNs / frameBudgetNs, 'f', 2) << "% of real time), max"
+                           << QString::number(stats.nsMax / 1e3, 'f', 1) << "us";
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <opus.h>
+#include "OpusCodec.h"
+
+// One pre-encode processing step. Stages work in place on a mono float
+// frame of OPUS_FRAME_SIZE samples (full scale +-1.0).
+class CaptureStage
+{
+public:
+    virtual ~CaptureStage() = default;
+
+    virtual const char *name() const = 0;
+    virtual void reset() = 0;
+    virtual void process(float *samples, int count) = 0;
+};
+
+// Ordered chain of capture stages run on every 20ms microphone frame.
+//
+// The interleaved stereo frame is downmixed to mono (voice input is mono in
+// practice, and it halves the cost of every stage), run through each enabled
+// stage and written back to both channels. Each stage can be bypassed on its
+// own, and its processing time is recorded so the cost of every stage can be
+// read against the 20ms real-time budget.
+class CaptureChain
+{
+public:
+    struct StageStats
+    {
+        QString name;
+        bool enabled = true;
+        qint64 frames = 0;
+        qint64 nsTotal = 0;
+        qint64 nsMax = 0;
+    };
+
+    CaptureChain() = default;
+    ~CaptureChain();
+    CaptureChain(const CaptureChain &) = delete;
+    CaptureChain &operator=(const CaptureChain &) = delete;
+
+    void addStage(CaptureStage *stage); // Takes ownership
+    bool setStageEnabled(const QString &name, bool enabled);
+
+    // Process one interleaved stereo frame in place
+    void process(opus_int16 *frame);
+    void reset();
+
+    QList<StageStats> stats() const;
+    void resetStats();
+    void logStats() const;
+
+private:
+    struct Entry
+    {
+        CaptureStage *stage = nullptr;
+        bool enabled = true;
+        qint64 frames = 0;
+        qint64 nsTotal = 0;
+        qint64 nsMax = 0;
+    };
+
+    QList<Entry> m_stages;
+    alignas(32) float m_mono[OPUS_FRAME_SIZE];
+    alignas(32) opus_int16 m_monoPcm[OPUS_FRAME_SIZE];
+};
@@ -0,0 +1,19 @@
+#include "CaptureFrameRing.h"
+
+opus_int16 *CaptureFrameRing::commit(int bytes)
+{
+    m_fill += bytes;
+    if (m_fill < FRAME_BYTES)
+        return nullptr;
+
+    opus_int16 *frame = m_slots[m_writeSlot];
+    m_writeSlot = (m_writeSlot + 1) % SLOT_COUNT;
+    m_fill = 0;
+    return frame;
+}
+
+void CaptureFrameRing::clear()
+{
+    m_writeSlot = 0;
+    m_fill = 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <opus.h>
+#include "OpusCodec.h"
+
+// Fixed circular buffer of PCM frame slots for microphone capture.
+// The capture device is read straight into the slot being filled; once a slot
+// holds a complete 20ms frame it is handed out and the ring advances to the
+// next slot. Nothing is allocated or moved after construction.
+class CaptureFrameRing
+{
+public:
+    static constexpr int SLOT_COUNT = 4;
+    static constexpr int FRAME_SAMPLES = OPUS_FRAME_SIZE * OPUS_CHANNELS;
+    static constexpr int FRAME_BYTES = FRAME_SAMPLES * sizeof(opus_int16);
+
+    // Where the next read from the device should land, and how much fits
+    char *writePointer() { return reinterpret_cast<char *>(m_slots[m_writeSlot]) + m_fill; }
+    int writeSpace() const { return FRAME_BYTES - m_fill; }
+
+    // Record bytes written at writePointer(). Returns the completed frame when
+    // this write filled the current slot, otherwise nullptr. The returned frame
+    // stays valid until SLOT_COUNT - 1 further frames have been completed.
+    opus_int16 *commit(int bytes);
+
+    void clear();
+
+private:
+    alignas(16) opus_int16 m_slots[SLOT_COUNT][FRAME_SAMPLES];
+    int m_writeSlot = 0;
+    int m_fill = 0; // Bytes already written into the current slot
+};
@@ -0,0 +1,103 @@
+#include "DelayEstimator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr float FRAME_DECAY = 0.98f;      // ~1s correlation memory at 20ms frames
+constexpr float MIN_PEAK_RATIO = 4.0f;    // Peak vs. mean |correlation|
+constexpr float MIN_REFERENCE_ENERGY = 1e-4f;
+constexpr int LAG_TOLERANCE = 2;          // 0.5ms at 4kHz
+constexpr int REQUIRED_HITS = 5;
+}
+
+DelayEstimator::DelayEstimator()
+{
+    reset();
+}
+
+void DelayEstimator::reset()
+{
+    std::memset(m_correlation, 0, sizeof(m_correlation));
+    std::memset(m_referenceHistory, 0, sizeof(m_referenceHistory));
+    m_position = 0;
+    m_referenceEnergy = 0.0f;
+    m_candidate = -1;
+    m_candidateHits = 0;
+    m_delay = -1;
+}
+
+void DelayEstimator::process(const float *mic, const float *reference, int count)
+{
+    for (int lag = 0; lag <= MAX_LAG; ++lag)
+        m_correlation[lag] *= FRAME_DECAY;
+    m_referenceEnergy *= FRAME_DECAY;
+
+    for (int block = 0; block + DECIMATION <= count; block += DECIMATION)
+    {
+        // Box-car average as a cheap low-pass before decimating
+        float m = 0.0f;
+        float r = 0.0f;
+        for (int i = 0; i < DECIMATION; ++i)
+        {
+            m += mic[block + i];
+            r += reference[block + i];
+        }
+        m /= DECIMATION;
+        r /= DECIMATION;
+
+        m_referenceHistory[m_position & HISTORY_MASK] = r;
+        m_referenceEnergy += r * r;
+
+        // Echo at lag L: mic[n] correlates with reference[n - L]
+        int lags = static_cast<int>(std::min<qint64>(MAX_LAG, m_position));
+        for (int lag = 0; lag <= lags; ++lag)
+        {
+            m_correlation[lag] += m * m_referenceHistory[(m_position - lag) & HISTORY_MASK];
+        }
+        m_position++;
+    }
+
+    updateEstimate();
+}
+
+void DelayEstimator::updateEstimate()
+{
+    // Without far-end audio there is nothing to lock on to; keep the last delay
+    if (m_referenceEnergy < MIN_REFERENCE_ENERGY)
+        return;
+
+    int best = 0;
+    float bestValue = 0.0f;
+    double total = 0.0;
+    for (int lag = 0; lag <= MAX_LAG; ++lag)
+    {
+        float value = std::fabs(m_correlation[lag]);
+        total += value;
+        if (value > bestValue)
+        {
+            bestValue = value;
+            best = lag;
+        }
+    }
+
+    float mean = static_cast<float>(total / (MAX_LAG + 1));
+    if (bestValue < MIN_PEAK_RATIO * mean)
+        return;
+
+    if (m_candidate >= 0 && std::abs(best - m_candidate) <= LAG_TOLERANCE)
+    {
+        m_candidateHits++;
+    }
+    else
+    {
+        m_candidate = best;
+        m_candidateHits = 1;
+    }
+
+    if (m_candidateHits >= REQUIRED_HITS)
+    {
+        m_delay = m_candidate * DECIMATION;
+    }
+}
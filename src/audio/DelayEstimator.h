@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Estimates the bulk delay between the playback reference and the echo of
+// it in the microphone signal.
+//
+// Both signals are low-passed and decimated to 4kHz, and a running
+// cross-correlation is kept for every lag up to MAX_DELAY_MS. A lag is only
+// reported once its correlation peak stands well clear of the rest and has
+// been stable over several updates.
+class DelayEstimator
+{
+public:
+    static constexpr int DECIMATION = 12; // 48kHz -> 4kHz
+    static constexpr int MAX_DELAY_MS = 500;
+    static constexpr int MAX_LAG = 4000 * MAX_DELAY_MS / 1000;
+
+    DelayEstimator();
+
+    // Feed one block of microphone samples and the reference samples that
+    // were played over the same span (at zero delay). count must be a
+    // multiple of DECIMATION.
+    void process(const float *mic, const float *reference, int count);
+    void reset();
+
+    // Delay in 48kHz samples, or -1 while unknown
+    int delay() const { return m_delay; }
+
+private:
+    static constexpr int HISTORY = 4096; // Decimated reference, power of two
+    static constexpr int HISTORY_MASK = HISTORY - 1;
+
+    void updateEstimate();
+
+    float m_correlation[MAX_LAG + 1];
+    float m_referenceHistory[HISTORY];
+    qint64 m_position = 0; // Decimated samples seen
+    float m_referenceEnergy = 0.0f;
+    int m_candidate = -1;
+    int m_candidateHits = 0;
+    int m_delay = -1;
+};
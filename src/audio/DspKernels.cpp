@@ -0,0 +1,716 @@
+#include "DspKernels.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DSP_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define DSP_TARGET_AVX2
+#else
+#define DSP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace DspKernels
+{
+namespace
+{
+constexpr float INT16_TO_FLOAT = 1.0f / 32768.0f;
+
+struct Table
+{
+    Isa isa;
+    void (*int16ToFloat)(const qint16 *, float *, int);
+    void (*floatToInt16)(const float *, qint16 *, int);
+    void (*applyGain)(float *, int, float);
+    void (*mixAccumulate)(float *, const float *, int, float);
+    void (*softClip)(float *, int);
+    Level (*measureInt16)(const qint16 *, int);
+    Level (*measureFloat)(const float *, int);
+    float (*dotProduct)(const float *, const float *, int);
+};
+
+// Scalar reference implementations; the vector versions use these for tails
+
+void int16ToFloatScalar(const qint16 *in, float *out, int count)
+{
+    for (int i = 0; i < count; ++i)
+        out[i] = in[i] * INT16_TO_FLOAT;
+}
+
+void floatToInt16Scalar(const float *in, qint16 *out, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        float v = in[i] * 32768.0f;
+        v = v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v);
+        out[i] = static_cast<qint16>(std::lrintf(v));
+    }
+}
+
+void applyGainScalar(float *samples, int count, float gain)
+{
+    for (int i = 0; i < count; ++i)
+        samples[i] *= gain;
+}
+
+void mixAccumulateScalar(float *accumulator, const float *in, int count, float gain)
+{
+    for (int i = 0; i < count; ++i)
+        accumulator[i] += in[i] * gain;
+}
+
+float dotProductScalar(const float *a, const float *b, int count)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < count; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+// Above the knee, the overshoot is compressed with a Pade approximation of
+// tanh, x(27 + x^2) / (27 + 9x^2), which reaches 1 at x = 3
+inline float softClipSample(float x)
+{
+    float a = std::fabs(x);
+    if (a <= SOFT_CLIP_KNEE)
+        return x;
+
+    constexpr float range = 1.0f - SOFT_CLIP_KNEE;
+    float t = std::fmin((a - SOFT_CLIP_KNEE) / range, 3.0f);
+    float shaped = t * (27.0f + t * t) / (27.0f + 9.0f * t * t);
+    return std::copysign(SOFT_CLIP_KNEE + range * shaped, x);
+}
+
+void softClipScalar(float *samples, int count)
+{
+    for (int i = 0; i < count; ++i)
+        samples[i] = softClipSample(samples[i]);
+}
+
+// Peak and sum of squares over a range, folded into running totals
+void accumulateLevel(const qint16 *samples, int count, int &peak, qint64 &sumSquares)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        int v = samples[i];
+        peak = qMax(peak, v < 0 ? -v : v);
+        sumSquares += v * v;
+    }
+}
+
+void accumulateLevel(const float *samples, int count, float &peak, double &sumSquares)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        peak = std::fmax(peak, std::fabs(samples[i]));
+        sumSquares += samples[i] * samples[i];
+    }
+}
+
+Level finishLevel(float peak, double sumSquares, int count)
+{
+    Level level;
+    level.peak = peak;
+    level.rms = count > 0 ? static_cast<float>(std::sqrt(sumSquares / count)) : 0.0f;
+    return level;
+}
+
+Level finishLevel(int peak, qint64 sumSquares, int count)
+{
+    return finishLevel(peak * INT16_TO_FLOAT, sumSquares * static_cast<double>(INT16_TO_FLOAT) * INT16_TO_FLOAT, count);
+}
+
+Level measureInt16Scalar(const qint16 *samples, int count)
+{
+    int peak = 0;
+    qint64 sum = 0;
+    accumulateLevel(samples, count, peak, sum);
+    return finishLevel(peak, sum, count);
+}
+
+Level measureFloatScalar(const float *samples, int count)
+{
+    float peak = 0.0f;
+    double sum = 0.0;
+    accumulateLevel(samples, count, peak, sum);
+    return finishLevel(peak, sum, count);
+}
+
+const Table SCALAR_TABLE = {Isa::Scalar, int16ToFloatScalar, floatToInt16Scalar, applyGainScalar,
+                            mixAccumulateScalar, softClipScalar, measureInt16Scalar, measureFloatScalar,
+                            dotProductScalar};
+
+#ifdef DSP_X86
+
+// ---- SSE2 (baseline on x86-64) ----
+
+void int16ToFloatSse2(const qint16 *in, float *out, int count)
+{
+    const __m128 scale = _mm_set1_ps(INT16_TO_FLOAT);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        // Sign-extend by unpacking into the high half and shifting back down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    int16ToFloatScalar(in + i, out + i, count - i);
+}
+
+void floatToInt16Sse2(const float *in, qint16 *out, int count)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 maxValue = _mm_set1_ps(32767.0f);
+    const __m128 minValue = _mm_set1_ps(-32768.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // Clamp before converting: out-of-range floats convert to INT_MIN
+        __m128 a = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), maxValue), minValue);
+        __m128 b = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), maxValue), minValue);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+    }
+    floatToInt16Scalar(in + i, out + i, count - i);
+}
+
+void applyGainSse2(float *samples, int count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+    applyGainScalar(samples + i, count - i, gain);
+}
+
+void mixAccumulateSse2(float *accumulator, const float *in, int count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(accumulator + i), _mm_mul_ps(_mm_loadu_ps(in + i), g));
+        _mm_storeu_ps(accumulator + i, sum);
+    }
+    mixAccumulateScalar(accumulator + i, in + i, count - i, gain);
+}
+
+float dotProductSse2(const float *a, const float *b, int count)
+{
+    // Two accumulators hide the add latency
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 sum = _mm_add_ps(sum0, sum1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(sum) + dotProductScalar(a + i, b + i, count - i);
+}
+
+inline __m128 softClipSse2(__m128 x)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 knee = _mm_set1_ps(SOFT_CLIP_KNEE);
+    const __m128 range = _mm_set1_ps(1.0f - SOFT_CLIP_KNEE);
+    const __m128 invRange = _mm_set1_ps(1.0f / (1.0f - SOFT_CLIP_KNEE));
+    const __m128 c27 = _mm_set1_ps(27.0f);
+    const __m128 c9 = _mm_set1_ps(9.0f);
+
+    __m128 sign = _mm_and_ps(x, signMask);
+    __m128 a = _mm_andnot_ps(signMask, x);
+    __m128 t = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(a, knee), invRange), _mm_set1_ps(3.0f));
+    __m128 t2 = _mm_mul_ps(t, t);
+    __m128 shaped = _mm_div_ps(_mm_mul_ps(t, _mm_add_ps(c27, t2)), _mm_add_ps(c27, _mm_mul_ps(c9, t2)));
+    __m128 clipped = _mm_or_ps(_mm_add_ps(knee, _mm_mul_ps(range, shaped)), sign);
+
+    __m128 above = _mm_cmpgt_ps(a, knee);
+    return _mm_or_ps(_mm_and_ps(above, clipped), _mm_andnot_ps(above, x));
+}
+
+void softClipSse2(float *samples, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(samples + i, softClipSse2(_mm_loadu_ps(samples + i)));
+    softClipScalar(samples + i, count - i);
+}
+
+float horizontalMax(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+double horizontalSum(__m128 v)
+{
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, v);
+    return static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+Level measureFloatSse2(const float *samples, int count)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 peak = _mm_setzero_ps();
+    __m128 sum = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(samples + i);
+        peak = _mm_max_ps(peak, _mm_andnot_ps(signMask, v));
+        sum = _mm_add_ps(sum, _mm_mul_ps(v, v));
+    }
+    float peakValue = horizontalMax(peak);
+    double sumSquares = horizontalSum(sum);
+    accumulateLevel(samples + i, count - i, peakValue, sumSquares);
+    return finishLevel(peakValue, sumSquares, count);
+}
+
+Level measureInt16Sse2(const qint16 *samples, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i peak = zero;
+    __m128i sum = zero; // Two 64-bit lanes
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+        // |v| with -32768 saturating to 32767 is close enough for a meter
+        peak = _mm_max_epi16(peak, _mm_max_epi16(v, _mm_subs_epi16(zero, v)));
+        // madd sums pairs of squares; (-32768)^2 * 2 = 2^31 only fits
+        // unsigned, so halve it with a logical shift before widening
+        __m128i squares = _mm_srli_epi32(_mm_madd_epi16(v, v), 1);
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(squares, zero));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(squares, zero));
+    }
+
+    alignas(16) qint16 peaks[8];
+    alignas(16) qint64 sums[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(peaks), peak);
+    _mm_store_si128(reinterpret_cast<__m128i *>(sums), sum);
+
+    int peakValue = 0;
+    for (qint16 p : peaks)
+        peakValue = qMax(peakValue, static_cast<int>(p));
+    qint64 sumSquares = (sums[0] + sums[1]) * 2;
+
+    accumulateLevel(samples + i, count - i, peakValue, sumSquares);
+    return finishLevel(peakValue, sumSquares, count);
+}
+
+const Table SSE2_TABLE = {Isa::Sse2, int16ToFloatSse2, floatToInt16Sse2, applyGainSse2,
+                          mixAccumulateSse2, softClipSse2, measureInt16Sse2, measureFloatSse2,
+                          dotProductSse2};
+
+// ---- AVX2 (selected at runtime) ----
+//
+// Tails fall back to the SSE2/scalar versions, which are not VEX-encoded:
+// clear the upper register halves first, or the AVX-SSE transition penalty
+// dominates short calls such as the resampler's dot products.
+
+DSP_TARGET_AVX2 void int16ToFloatAvx2(const qint16 *in, float *out, int count)
+{
+    const __m256 scale = _mm256_set1_ps(INT16_TO_FLOAT);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+    _mm256_zeroupper();
+    int16ToFloatSse2(in + i, out + i, count - i);
+}
+
+DSP_TARGET_AVX2 void floatToInt16Avx2(const float *in, qint16 *out, int count)
+{
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    const __m256 maxValue = _mm256_set1_ps(32767.0f);
+    const __m256 minValue = _mm256_set1_ps(-32768.0f);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256 a = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), maxValue), minValue);
+        __m256 b = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale), maxValue), minValue);
+        // packs works per 128-bit lane; permute to restore sample order
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+    }
+    _mm256_zeroupper();
+    floatToInt16Sse2(in + i, out + i, count - i);
+}
+
+DSP_TARGET_AVX2 void applyGainAvx2(float *samples, int count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+    _mm256_zeroupper();
+    applyGainScalar(samples + i, count - i, gain);
+}
+
+DSP_TARGET_AVX2 void mixAccumulateAvx2(float *accumulator, const float *in, int count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 sum = _mm256_add_ps(_mm256_loadu_ps(accumulator + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), g));
+        _mm256_storeu_ps(accumulator + i, sum);
+    }
+    _mm256_zeroupper();
+    mixAccumulateScalar(accumulator + i, in + i, count - i, gain);
+}
+
+DSP_TARGET_AVX2 float dotProductAvx2(const float *a, const float *b, int count)
+{
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    __m256 sum8 = _mm256_add_ps(sum0, sum1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum8), _mm256_extractf128_ps(sum8, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    float head = _mm_cvtss_f32(sum);
+    _mm256_zeroupper();
+    return head + dotProductSse2(a + i, b + i, count - i);
+}
+
+DSP_TARGET_AVX2 void softClipAvx2(float *samples, int count)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 knee = _mm256_set1_ps(SOFT_CLIP_KNEE);
+    const __m256 range = _mm256_set1_ps(1.0f - SOFT_CLIP_KNEE);
+    const __m256 invRange = _mm256_set1_ps(1.0f / (1.0f - SOFT_CLIP_KNEE));
+    const __m256 c27 = _mm256_set1_ps(27.0f);
+    const __m256 c9 = _mm256_set1_ps(9.0f);
+    const __m256 c3 = _mm256_set1_ps(3.0f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(samples + i);
+        __m256 sign = _mm256_and_ps(x, signMask);
+        __m256 a = _mm256_andnot_ps(signMask, x);
+        __m256 t = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(a, knee), invRange), c3);
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 shaped = _mm256_div_ps(_mm256_mul_ps(t, _mm256_add_ps(c27, t2)), _mm256_add_ps(c27, _mm256_mul_ps(c9, t2)));
+        __m256 clipped = _mm256_or_ps(_mm256_add_ps(knee, _mm256_mul_ps(range, shaped)), sign);
+        __m256 above = _mm256_cmp_ps(a, knee, _CMP_GT_OQ);
+        _mm256_storeu_ps(samples + i, _mm256_blendv_ps(x, clipped, above));
+    }
+    _mm256_zeroupper();
+    softClipSse2(samples + i, count - i);
+}
+
+DSP_TARGET_AVX2 Level measureFloatAvx2(const float *samples, int count)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 peak = _mm256_setzero_ps();
+    __m256 sum = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(samples + i);
+        peak = _mm256_max_ps(peak, _mm256_andnot_ps(signMask, v));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(v, v));
+    }
+    __m128 peak4 = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+
+    float peakValue = horizontalMax(peak4);
+    double sumSquares = horizontalSum(sum4);
+    _mm256_zeroupper();
+    accumulateLevel(samples + i, count - i, peakValue, sumSquares);
+    return finishLevel(peakValue, sumSquares, count);
+}
+
+DSP_TARGET_AVX2 Level measureInt16Avx2(const qint16 *samples, int count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i peak = zero;
+    __m256i sum = zero; // Four 64-bit lanes
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples + i));
+        // abs(-32768) is 0x8000, which is right when read as unsigned
+        peak = _mm256_max_epu16(peak, _mm256_abs_epi16(v));
+        __m256i squares = _mm256_srli_epi32(_mm256_madd_epi16(v, v), 1);
+        sum = _mm256_add_epi64(sum, _mm256_unpacklo_epi32(squares, zero));
+        sum = _mm256_add_epi64(sum, _mm256_unpackhi_epi32(squares, zero));
+    }
+
+    alignas(32) quint16 peaks[16];
+    alignas(32) qint64 sums[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(peaks), peak);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(sums), sum);
+
+    int peakValue = 0;
+    for (quint16 p : peaks)
+        peakValue = qMax(peakValue, static_cast<int>(p));
+    qint64 sumSquares = (sums[0] + sums[1] + sums[2] + sums[3]) * 2;
+
+    _mm256_zeroupper();
+    accumulateLevel(samples + i, count - i, peakValue, sumSquares);
+    return finishLevel(peakValue, sumSquares, count);
+}
+
+const Table AVX2_TABLE = {Isa::Avx2, int16ToFloatAvx2, floatToInt16Avx2, applyGainAvx2,
+                          mixAccumulateAvx2, softClipAvx2, measureInt16Avx2, measureFloatAvx2,
+                          dotProductAvx2};
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    // May run from a static initialiser, before libgcc has probed the CPU
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // DSP_X86
+
+#ifdef DSP_NEON
+
+void int16ToFloatNeon(const qint16 *in, float *out, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t v = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), INT16_TO_FLOAT));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), INT16_TO_FLOAT));
+    }
+    int16ToFloatScalar(in + i, out + i, count - i);
+}
+
+void floatToInt16Neon(const float *in, qint16 *out, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // vcvtnq rounds to nearest and saturates to int32; vqmovn saturates to int16
+        int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i), 32768.0f));
+        int32x4_t b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i + 4), 32768.0f));
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+    }
+    floatToInt16Scalar(in + i, out + i, count - i);
+}
+
+void applyGainNeon(float *samples, int count, float gain)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(samples + i, vmulq_n_f32(vld1q_f32(samples + i), gain));
+    applyGainScalar(samples + i, count - i, gain);
+}
+
+void mixAccumulateNeon(float *accumulator, const float *in, int count, float gain)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(accumulator + i, vmlaq_n_f32(vld1q_f32(accumulator + i), vld1q_f32(in + i), gain));
+    mixAccumulateScalar(accumulator + i, in + i, count - i, gain);
+}
+
+float dotProductNeon(const float *a, const float *b, int count)
+{
+    float32x4_t sum0 = vdupq_n_f32(0.0f);
+    float32x4_t sum1 = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    return vaddvq_f32(vaddq_f32(sum0, sum1)) + dotProductScalar(a + i, b + i, count - i);
+}
+
+void softClipNeon(float *samples, int count)
+{
+    const float32x4_t knee = vdupq_n_f32(SOFT_CLIP_KNEE);
+    const float32x4_t c27 = vdupq_n_f32(27.0f);
+    constexpr float range = 1.0f - SOFT_CLIP_KNEE;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t x = vld1q_f32(samples + i);
+        float32x4_t a = vabsq_f32(x);
+        float32x4_t t = vminq_f32(vmulq_n_f32(vsubq_f32(a, knee), 1.0f / range), vdupq_n_f32(3.0f));
+        float32x4_t t2 = vmulq_f32(t, t);
+        float32x4_t shaped = vdivq_f32(vmulq_f32(t, vaddq_f32(c27, t2)), vmlaq_n_f32(c27, t2, 9.0f));
+        float32x4_t magnitude = vmlaq_n_f32(knee, shaped, range);
+        // Copy the sign bit of x onto the clipped magnitude
+        float32x4_t clipped = vbslq_f32(vdupq_n_u32(0x80000000u), x, magnitude);
+        vst1q_f32(samples + i, vbslq_f32(vcgtq_f32(a, knee), clipped, x));
+    }
+    softClipScalar(samples + i, count - i);
+}
+
+Level measureFloatNeon(const float *samples, int count)
+{
+    float32x4_t peak = vdupq_n_f32(0.0f);
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t v = vld1q_f32(samples + i);
+        peak = vmaxq_f32(peak, vabsq_f32(v));
+        sum = vmlaq_f32(sum, v, v);
+    }
+    float peakValue = vmaxvq_f32(peak);
+    double sumSquares = vaddvq_f32(sum);
+    accumulateLevel(samples + i, count - i, peakValue, sumSquares);
+    return finishLevel(peakValue, sumSquares, count);
+}
+
+Level measureInt16Neon(const qint16 *samples, int count)
+{
+    uint16x8_t peak = vdupq_n_u16(0);
+    int64x2_t sum = vdupq_n_s64(0);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t v = vld1q_s16(samples + i);
+        // abs(-32768) is 0x8000, which is right when read as unsigned
+        peak = vmaxq_u16(peak, vreinterpretq_u16_s16(vabsq_s16(v)));
+        sum = vpadalq_s32(sum, vmull_s16(vget_low_s16(v), vget_low_s16(v)));
+        sum = vpadalq_s32(sum, vmull_s16(vget_high_s16(v), vget_high_s16(v)));
+    }
+
+    int peakValue = vmaxvq_u16(peak);
+    qint64 sumSquares = vaddvq_s64(sum);
+    accumulateLevel(samples + i, count - i, peakValue, sumSquares);
+    return finishLevel(peakValue, sumSquares, count);
+}
+
+const Table NEON_TABLE = {Isa::Neon, int16ToFloatNeon, floatToInt16Neon, applyGainNeon,
+                          mixAccumulateNeon, softClipNeon, measureInt16Neon, measureFloatNeon,
+                          dotProductNeon};
+
+#endif // DSP_NEON
+
+const Table *bestTable()
+{
+#if defined(DSP_X86)
+    return cpuHasAvx2() ? &AVX2_TABLE : &SSE2_TABLE;
+#elif defined(DSP_NEON)
+    return &NEON_TABLE;
+#else
+    return &SCALAR_TABLE;
+#endif
+}
+
+const Table *s_table = bestTable();
+} // namespace
+
+void int16ToFloat(const qint16 *in, float *out, int count) { s_table->int16ToFloat(in, out, count); }
+void floatToInt16(const float *in, qint16 *out, int count) { s_table->floatToInt16(in, out, count); }
+void applyGain(float *samples, int count, float gain) { s_table->applyGain(samples, count, gain); }
+void mixAccumulate(float *accumulator, const float *in, int count, float gain) { s_table->mixAccumulate(accumulator, in, count, gain); }
+void softClip(float *samples, int count) { s_table->softClip(samples, count); }
+Level measure(const qint16 *samples, int count) { return s_table->measureInt16(samples, count); }
+Level measure(const float *samples, int count) { return s_table->measureFloat(samples, count); }
+float dotProduct(const float *a, const float *b, int count) { return s_table->dotProduct(a, b, count); }
+
+Isa activeIsa()
+{
+    return s_table->isa;
+}
+
+bool isSupported(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Scalar:
+        return true;
+#ifdef DSP_X86
+    case Isa::Sse2:
+        return true;
+    case Isa::Avx2:
+        return cpuHasAvx2();
+#endif
+#ifdef DSP_NEON
+    case Isa::Neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+bool setIsa(Isa isa)
+{
+    if (!isSupported(isa))
+        return false;
+
+    switch (isa)
+    {
+#ifdef DSP_X86
+    case Isa::Sse2:
+        s_table = &SSE2_TABLE;
+        break;
+    case Isa::Avx2:
+        s_table = &AVX2_TABLE;
+        break;
+#endif
+#ifdef DSP_NEON
+    case Isa::Neon:
+        s_table = &NEON_TABLE;
+        break;
+#endif
+    default:
+        s_table = &SCALAR_TABLE;
+        break;
+    }
+    return true;
+}
+
+const char *isaName(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Sse2:
+        return "SSE2";
+    case Isa::Avx2:
+        return "AVX2";
+    case Isa::Neon:
+        return "NEON";
+    default:
+        return "scalar";
+    }
+}
+} // namespace DspKernels
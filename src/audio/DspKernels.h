@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Vectorised sample-processing kernels for the audio paths.
+//
+// Every kernel has a scalar reference implementation plus SSE2 and AVX2
+// (x86) or NEON (AArch64) versions. The fastest variant the CPU supports is
+// picked once, on first use, and called through a table of function
+// pointers. Float samples use a full scale of +-1.0.
+namespace DspKernels
+{
+enum class Isa
+{
+    Scalar,
+    Sse2,
+    Avx2,
+    Neon
+};
+
+struct Level
+{
+    float peak = 0.0f;
+    float rms = 0.0f;
+};
+
+void int16ToFloat(const qint16 *in, float *out, int count);
+void floatToInt16(const float *in, qint16 *out, int count); // Rounds and saturates
+void applyGain(float *samples, int count, float gain);
+void mixAccumulate(float *accumulator, const float *in, int count, float gain);
+
+// Transparent below SOFT_CLIP_KNEE, then bends smoothly towards +-1.0
+constexpr float SOFT_CLIP_KNEE = 0.8f;
+void softClip(float *samples, int count);
+
+Level measure(const qint16 *samples, int count);
+Level measure(const float *samples, int count);
+
+// Sum of a[i] * b[i], for FIR filters
+float dotProduct(const float *a, const float *b, int count);
+
+// Implementation selection, mainly for benchmarks and comparisons
+Isa activeIsa();
+bool isSupported(Isa isa);
+bool setIsa(Isa isa);
+const char *isaName(Isa isa);
+} // namespace DspKernels
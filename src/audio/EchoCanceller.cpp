@@ -0,0 +1,234 @@
+#include "EchoCanceller.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr float STEP = 0.5f;                 // NLMS step
+constexpr float REGULARISATION = 1e-3f;
+constexpr float GEIGEL_THRESHOLD = 0.5f;     // Near-end louder than this * far-end peak
+constexpr int DOUBLE_TALK_HOLD_BLOCKS = 30;  // ~40ms
+constexpr float MIN_REFERENCE_PEAK = 1e-3f;  // -60 dBFS: far end considered silent
+constexpr int CONSTRAINTS_PER_BLOCK = 4;
+constexpr float ERLE_SMOOTHING = 0.995f;
+
+// The reference for a capture frame is taken this far before the latest
+// playback sample, which absorbs the sink's pull jitter. The real echo path
+// (sink buffer + acoustics + capture buffer) is always longer than this.
+constexpr int BASE_DELAY = 960;
+constexpr int DELAY_MARGIN = 240;            // Start the filter 5ms early
+constexpr int DELAY_CHANGE_THRESHOLD = 96;   // 2ms; smaller shifts are tracked by the filter
+constexpr int RESYNC_SAMPLES = 4800;         // Timeline slip that forces realignment
+}
+
+EchoCanceller::EchoCanceller(const EchoReference *reference)
+    : m_reference(reference),
+      m_fft(FFT_SIZE)
+{
+    reset();
+}
+
+void EchoCanceller::reset()
+{
+    m_delayEstimator.reset();
+    m_captureCount = 0;
+    m_offset = 0;
+    m_aligned = false;
+    m_delay = 0;
+    m_micEnergy = 0.0f;
+    m_errorEnergy = 0.0f;
+    resetFilter();
+}
+
+void EchoCanceller::resetFilter()
+{
+    std::fill(&m_referenceSpectra[0][0], &m_referenceSpectra[0][0] + PARTITIONS * BINS, std::complex<float>());
+    std::fill(&m_weights[0][0], &m_weights[0][0] + PARTITIONS * BINS, std::complex<float>());
+    std::fill(std::begin(m_referencePeaks), std::end(m_referencePeaks), 0.0f);
+    std::fill(std::begin(m_previousReference), std::end(m_previousReference), 0.0f);
+    m_newest = 0;
+    m_nextConstraint = 0;
+    m_doubleTalkHold = 0;
+}
+
+float EchoCanceller::erleDb() const
+{
+    if (m_errorEnergy <= 0.0f || m_micEnergy <= 0.0f)
+        return 0.0f;
+    return 10.0f * std::log10(m_micEnergy / m_errorEnergy);
+}
+
+void EchoCanceller::process(float *samples, int count)
+{
+    qint64 written = m_reference->written();
+    if (written == 0)
+    {
+        // Nothing has been played yet
+        m_captureCount += count;
+        return;
+    }
+
+    // Map this frame onto the playback timeline. The mapping is fixed once
+    // made so the filter sees a consistent delay; it is only redone when the
+    // two clocks have slipped too far apart (or playback restarted).
+    qint64 frameEnd = m_captureCount + count + m_offset;
+    if (!m_aligned || std::llabs(written - BASE_DELAY - frameEnd) > RESYNC_SAMPLES)
+    {
+        m_offset = written - BASE_DELAY - count - m_captureCount;
+        m_aligned = true;
+        m_delayEstimator.reset();
+        m_delay = 0;
+        resetFilter();
+        frameEnd = written - BASE_DELAY;
+    }
+    qint64 frameStart = frameEnd - count;
+    m_captureCount += count;
+
+    if (m_reference->read(frameStart, m_frameReference, count))
+    {
+        m_delayEstimator.process(samples, m_frameReference, count);
+
+        int estimate = m_delayEstimator.delay();
+        if (estimate >= 0)
+        {
+            int delay = std::max(estimate - DELAY_MARGIN, 0);
+            if (std::abs(delay - m_delay) > DELAY_CHANGE_THRESHOLD)
+            {
+                m_delay = delay;
+                resetFilter();
+            }
+        }
+    }
+
+    if (!m_reference->read(frameStart - m_delay, m_frameReference, count))
+        return;
+
+    for (int offset = 0; offset + BLOCK <= count; offset += BLOCK)
+    {
+        processBlock(m_frameReference + offset, samples + offset);
+    }
+}
+
+void EchoCanceller::processBlock(const float *reference, float *samples)
+{
+    // Overlap-save: reference spectrum over [previous block, this block]
+    float referencePeak = 0.0f;
+    for (int i = 0; i < BLOCK; ++i)
+    {
+        m_buffer[i] = m_previousReference[i];
+        m_buffer[BLOCK + i] = reference[i];
+        referencePeak = std::max(referencePeak, std::fabs(reference[i]));
+    }
+    std::memcpy(m_previousReference, reference, sizeof(m_previousReference));
+    m_fft.forward(m_buffer);
+
+    m_newest = (m_newest + PARTITIONS - 1) % PARTITIONS;
+    std::copy(m_buffer, m_buffer + BINS, m_referenceSpectra[m_newest]);
+    m_referencePeaks[m_newest] = referencePeak;
+
+    // Echo estimate: sum of every partition's weights times its delayed block
+    std::fill(m_buffer, m_buffer + FFT_SIZE, std::complex<float>());
+    for (int k = 0; k < PARTITIONS; ++k)
+    {
+        const std::complex<float> *x = m_referenceSpectra[(m_newest + k) % PARTITIONS];
+        const std::complex<float> *w = m_weights[k];
+        for (int bin = 0; bin < BINS; ++bin)
+            m_buffer[bin] += w[bin] * x[bin];
+    }
+    for (int bin = 1; bin < BLOCK; ++bin)
+        m_buffer[FFT_SIZE - bin] = std::conj(m_buffer[bin]);
+    m_fft.inverse(m_buffer);
+
+    float error[BLOCK];
+    float micPeak = 0.0f;
+    float micEnergy = 0.0f;
+    float errorEnergy = 0.0f;
+    for (int i = 0; i < BLOCK; ++i)
+    {
+        error[i] = samples[i] - m_buffer[BLOCK + i].real();
+        micPeak = std::max(micPeak, std::fabs(samples[i]));
+        micEnergy += samples[i] * samples[i];
+        errorEnergy += error[i] * error[i];
+    }
+
+    // A filter that makes things worse has diverged (usually an echo path
+    // change the delay estimator hasn't caught yet); start over
+    if (errorEnergy > 4.0f * micEnergy + 1e-6f)
+    {
+        resetFilter();
+        return;
+    }
+
+    float farPeak = *std::max_element(std::begin(m_referencePeaks), std::end(m_referencePeaks));
+    if (micPeak > GEIGEL_THRESHOLD * farPeak)
+        m_doubleTalkHold = DOUBLE_TALK_HOLD_BLOCKS;
+    else if (m_doubleTalkHold > 0)
+        m_doubleTalkHold--;
+
+    bool farEndOnly = farPeak > MIN_REFERENCE_PEAK && m_doubleTalkHold == 0;
+    if (farEndOnly)
+    {
+        m_micEnergy = ERLE_SMOOTHING * m_micEnergy + micEnergy;
+        m_errorEnergy = ERLE_SMOOTHING * m_errorEnergy + errorEnergy;
+    }
+
+    std::memcpy(samples, error, sizeof(error));
+
+    if (!farEndOnly)
+        return;
+
+    // Error spectrum over [zeros, error]
+    for (int i = 0; i < BLOCK; ++i)
+    {
+        m_buffer[i] = 0.0f;
+        m_buffer[BLOCK + i] = error[i];
+    }
+    m_fft.forward(m_buffer);
+
+    // Normalise by the reference power across the whole filter span, not
+    // just the newest block, or a fading far end makes the step explode
+    float stepPerBin[BINS] = {};
+    for (int k = 0; k < PARTITIONS; ++k)
+    {
+        const std::complex<float> *x = m_referenceSpectra[k];
+        for (int bin = 0; bin < BINS; ++bin)
+            stepPerBin[bin] += std::norm(x[bin]);
+    }
+    for (int bin = 0; bin < BINS; ++bin)
+        stepPerBin[bin] = STEP / (stepPerBin[bin] + REGULARISATION);
+
+    for (int k = 0; k < PARTITIONS; ++k)
+    {
+        const std::complex<float> *x = m_referenceSpectra[(m_newest + k) % PARTITIONS];
+        std::complex<float> *w = m_weights[k];
+        for (int bin = 0; bin < BINS; ++bin)
+            w[bin] += stepPerBin[bin] * std::conj(x[bin]) * m_buffer[bin];
+    }
+
+    // The unconstrained update lets weights wrap around in time; constrain a
+    // few partitions per block in rotation to keep them causal
+    for (int i = 0; i < CONSTRAINTS_PER_BLOCK; ++i)
+    {
+        constrainPartition(m_nextConstraint);
+        m_nextConstraint = (m_nextConstraint + 1) % PARTITIONS;
+    }
+}
+
+void EchoCanceller::constrainPartition(int partition)
+{
+    std::complex<float> *w = m_weights[partition];
+
+    std::copy(w, w + BINS, m_buffer);
+    for (int bin = 1; bin < BLOCK; ++bin)
+        m_buffer[FFT_SIZE - bin] = std::conj(w[bin]);
+    m_fft.inverse(m_buffer);
+
+    for (int i = BLOCK; i < FFT_SIZE; ++i)
+        m_buffer[i] = 0.0f;
+    for (int i = 0; i < BLOCK; ++i)
+        m_buffer[i] = m_buffer[i].real();
+
+    m_fft.forward(m_buffer);
+    std::copy(m_buffer, m_buffer + BINS, w);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <complex>
+#include "CaptureChain.h"
+#include "DelayEstimator.h"
+#include "EchoReference.h"
+#include "Fft.h"
+
+// Acoustic echo cancellation for the capture chain.
+//
+// The speaker signal comes from the mixer through EchoReference. Capture
+// frames are mapped onto the playback timeline by sample count, the
+// DelayEstimator finds where the echo actually sits on it, and a
+// partitioned-block frequency-domain NLMS filter (64-sample blocks,
+// PARTITIONS blocks of tail) models the speaker-to-mic path from that point
+// on. The filter's echo estimate is subtracted from the microphone signal.
+// Blocks divide the 20ms frame evenly, so no latency is added.
+//
+// Adaptation is frozen during double talk (Geigel detector, which assumes
+// the echo path attenuates by at least 6 dB) and while the far end is
+// silent. ERLE is measured on far-end-only blocks.
+class EchoCanceller : public CaptureStage
+{
+public:
+    static constexpr int BLOCK = 64;
+    static constexpr int FFT_SIZE = 2 * BLOCK;
+    static constexpr int BINS = BLOCK + 1;
+    static constexpr int PARTITIONS = 48; // 64ms of echo tail after the bulk delay
+
+    explicit EchoCanceller(const EchoReference *reference);
+
+    const char *name() const override { return "echo-cancellation"; }
+    void reset() override;
+    void process(float *samples, int count) override;
+
+    // Echo return loss enhancement over recent far-end-only audio
+    float erleDb() const;
+    int delaySamples() const { return m_delay; }
+
+private:
+    void resetFilter();
+    void processBlock(const float *reference, float *samples);
+    void constrainPartition(int partition);
+
+    const EchoReference *m_reference;
+    Fft m_fft;
+    DelayEstimator m_delayEstimator;
+
+    // Playback timeline mapping
+    qint64 m_captureCount = 0;
+    qint64 m_offset = 0; // Reference index = capture index + m_offset, before delay
+    bool m_aligned = false;
+    int m_delay = 0;     // Reference delay the filter currently runs at
+
+    // Frequency-domain delay line; slot (m_newest + k) % PARTITIONS holds the
+    // spectrum of the block k blocks ago
+    std::complex<float> m_referenceSpectra[PARTITIONS][BINS];
+    std::complex<float> m_weights[PARTITIONS][BINS];
+    float m_referencePeaks[PARTITIONS];
+    float m_previousReference[BLOCK];
+    int m_newest = 0;
+    int m_nextConstraint = 0;
+    int m_doubleTalkHold = 0;
+
+    std::complex<float> m_buffer[FFT_SIZE];
+    float m_frameReference[OPUS_FRAME_SIZE];
+
+    float m_micEnergy = 0.0f;
+    float m_errorEnergy = 0.0f;
+};
@@ -0,0 +1,33 @@
+#include "EchoReference.h"
+#include <cstring>
+
+void EchoReference::write(const float *samples, int count)
+{
+    qint64 position = m_written.load(std::memory_order_relaxed);
+    int start = static_cast<int>(position & MASK);
+    int first = qMin(count, CAPACITY - start);
+    std::memcpy(m_samples + start, samples, first * sizeof(float));
+    if (first < count)
+    {
+        std::memcpy(m_samples, samples + first, (count - first) * sizeof(float));
+    }
+    m_written.store(position + count, std::memory_order_release);
+}
+
+bool EchoReference::read(qint64 start, float *out, int count) const
+{
+    qint64 written = m_written.load(std::memory_order_acquire);
+
+    // Leave a margin for the writer to keep appending while we copy
+    if (start < 0 || start + count > written || start < written - (CAPACITY - 4096))
+        return false;
+
+    int offset = static_cast<int>(start & MASK);
+    int first = qMin(count, CAPACITY - offset);
+    std::memcpy(out, m_samples + offset, first * sizeof(float));
+    if (first < count)
+    {
+        std::memcpy(out + first, m_samples, (count - first) * sizeof(float));
+    }
+    return true;
+}
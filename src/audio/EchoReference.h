@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QtGlobal>
+#include <atomic>
+
+// Timeline of what was sent to the speakers, for echo cancellation.
+//
+// The mixer appends every mono output sample it hands the sink (silence
+// included, so the timeline never has gaps) and the capture side reads back
+// older stretches by absolute sample index. Single producer, single
+// consumer; the reader stays well behind the writer, so only the write
+// counter needs to be shared.
+class EchoReference
+{
+public:
+    static constexpr int CAPACITY = 1 << 16; // ~1.4s at 48kHz
+
+    void write(const float *samples, int count);
+
+    // Total samples ever written
+    qint64 written() const { return m_written.load(std::memory_order_acquire); }
+
+    // Copy [start, start + count). Returns false if that range has not been
+    // written yet or has already been overwritten.
+    bool read(qint64 start, float *out, int count) const;
+
+private:
+    static constexpr int MASK = CAPACITY - 1;
+
+    float m_samples[CAPACITY] = {};
+    std::atomic<qint64> m_written{0};
+};
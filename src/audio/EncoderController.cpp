@@ -0,0 +1,131 @@
+#include "EncoderController.h"
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+EncoderController::EncoderController()
+{
+    reset();
+}
+
+void EncoderController::reset()
+{
+    m_settings = EncoderSettings();
+    m_changed = false;
+    m_smoothedLoss = 0.0;
+    m_smoothedRtt = 0.0;
+    m_haveRttSample = false;
+    m_haveLossSample = false;
+    m_rung = 0;
+    m_goodReports = 0;
+    m_smoothedEncodeNs = 0.0;
+    m_framesWithHeadroom = 0;
+}
+
+bool EncoderController::takeChanged()
+{
+    bool changed = m_changed;
+    m_changed = false;
+    return changed;
+}
+
+void EncoderController::updateNetwork(double lossFraction, int rttMs)
+{
+    if (lossFraction >= 0.0)
+    {
+        lossFraction = std::min(lossFraction, 1.0);
+        m_smoothedLoss = m_haveLossSample ? m_smoothedLoss + (lossFraction - m_smoothedLoss) * 0.3 : lossFraction;
+        m_haveLossSample = true;
+    }
+
+    // rttMs < 0 until the first voice heartbeat ACK; that is no data, not a
+    // fast link
+    if (rttMs >= 0)
+    {
+        m_smoothedRtt = m_haveRttSample ? m_smoothedRtt + (rttMs - m_smoothedRtt) * 0.3 : rttMs;
+        m_haveRttSample = true;
+    }
+
+    bool bad = m_smoothedLoss > BAD_LOSS || (m_haveRttSample && m_smoothedRtt > BAD_RTT_MS);
+    bool good = m_smoothedLoss < GOOD_LOSS && m_haveRttSample && m_smoothedRtt < GOOD_RTT_MS;
+
+    int previousRung = m_rung;
+    if (bad)
+    {
+        m_goodReports = 0;
+        m_rung = std::min(m_rung + 1, LADDER_SIZE - 1);
+    }
+    else if (good)
+    {
+        if (++m_goodReports >= GOOD_REPORTS_TO_STEP_UP && m_rung > 0)
+        {
+            m_rung--;
+            m_goodReports = 0;
+        }
+    }
+    else
+    {
+        // In between: hold the current rung
+        m_goodReports = 0;
+    }
+
+    EncoderSettings before = m_settings;
+
+    if (m_rung != previousRung)
+    {
+        applyRung();
+    }
+
+    // FEC hint tracks smoothed loss with some margin, quantised to 5% so
+    // small fluctuations don't reconfigure the encoder on every report
+    if (m_haveLossSample)
+    {
+        int lossPercent = static_cast<int>(std::ceil(m_smoothedLoss * 100.0 * 1.5 / 5.0)) * 5;
+        lossPercent = std::clamp(lossPercent, 0, 30);
+        m_settings.packetLossPercent = lossPercent;
+        m_settings.inbandFec = lossPercent > 0;
+    }
+
+    if (m_settings != before)
+    {
+        m_changed = true;
+        qDebug() << "Encoder controller: loss" << m_smoothedLoss << "rtt" << m_smoothedRtt
+                 << "-> bitrate" << m_settings.bitrate << "fec loss%" << m_settings.packetLossPercent
+                 << "dtx" << m_settings.dtx;
+    }
+}
+
+void EncoderController::updateEncodeTime(qint64 encodeNs)
+{
+    m_smoothedEncodeNs += (encodeNs - m_smoothedEncodeNs) * 0.05;
+
+    if (m_smoothedEncodeNs > ENCODE_HIGH_NS && m_settings.complexity > MIN_COMPLEXITY)
+    {
+        m_settings.complexity = std::max(m_settings.complexity - 2, MIN_COMPLEXITY);
+        m_smoothedEncodeNs = ENCODE_HIGH_NS / 2; // Let the average settle at the new level
+        m_framesWithHeadroom = 0;
+        m_changed = true;
+        qDebug() << "Encoder controller: encode time over budget, complexity ->" << m_settings.complexity;
+        return;
+    }
+
+    if (m_smoothedEncodeNs < ENCODE_LOW_NS && m_settings.complexity < MAX_COMPLEXITY)
+    {
+        if (++m_framesWithHeadroom >= FRAMES_TO_RAISE_COMPLEXITY)
+        {
+            m_settings.complexity++;
+            m_framesWithHeadroom = 0;
+            m_changed = true;
+        }
+    }
+    else
+    {
+        m_framesWithHeadroom = 0;
+    }
+}
+
+void EncoderController::applyRung()
+{
+    m_settings.bitrate = BITRATE_LADDER[m_rung];
+    m_settings.dtx = m_rung >= DTX_FROM_RUNG;
+}
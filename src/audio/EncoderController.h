@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QtGlobal>
+
+struct EncoderSettings
+{
+    int bitrate = 64000;
+    int complexity = 10;
+    int packetLossPercent = 15; // Expected loss hint for in-band FEC
+    bool inbandFec = true;
+    bool dtx = false;
+
+    bool operator==(const EncoderSettings &other) const
+    {
+        return bitrate == other.bitrate && complexity == other.complexity &&
+               packetLossPercent == other.packetLossPercent &&
+               inbandFec == other.inbandFec && dtx == other.dtx;
+    }
+    bool operator!=(const EncoderSettings &other) const { return !(*this == other); }
+};
+
+// Adapts Opus encoder settings to measured network and CPU conditions.
+//
+// Network reports (loss fraction and RTT) move the bitrate along a fixed
+// ladder: one bad report steps down immediately, while stepping back up needs
+// several consecutive good reports, so a flapping link does not make the
+// bitrate oscillate. The FEC loss hint follows smoothed loss in 5% steps and
+// DTX is enabled on the lower rungs. Per-frame encode time drives complexity
+// the same way: down quickly when the frame budget is at risk, up slowly.
+class EncoderController
+{
+public:
+    EncoderController();
+
+    // lossFraction < 0 or rttMs < 0 means that figure is not known yet and
+    // is left out; stepping up needs a measured RTT
+    void updateNetwork(double lossFraction, int rttMs);
+    void updateEncodeTime(qint64 encodeNs);
+
+    const EncoderSettings &settings() const { return m_settings; }
+
+    // True once if settings changed since the last call
+    bool takeChanged();
+
+    void reset();
+
+private:
+    static constexpr int BITRATE_LADDER[] = {64000, 48000, 32000, 24000, 16000};
+    static constexpr int LADDER_SIZE = sizeof(BITRATE_LADDER) / sizeof(BITRATE_LADDER[0]);
+    static constexpr int DTX_FROM_RUNG = 2;
+    static constexpr int GOOD_REPORTS_TO_STEP_UP = 5;
+
+    static constexpr double BAD_LOSS = 0.08;
+    static constexpr double GOOD_LOSS = 0.02;
+    static constexpr int BAD_RTT_MS = 400;
+    static constexpr int GOOD_RTT_MS = 200;
+
+    static constexpr qint64 FRAME_BUDGET_NS = 20000000;     // 20ms
+    static constexpr qint64 ENCODE_HIGH_NS = FRAME_BUDGET_NS / 4; // Back off above 25%
+    static constexpr qint64 ENCODE_LOW_NS = FRAME_BUDGET_NS / 16; // Headroom below ~6%
+    static constexpr int FRAMES_TO_RAISE_COMPLEXITY = 250;       // 5s of headroom
+    static constexpr int MIN_COMPLEXITY = 3;
+    static constexpr int MAX_COMPLEXITY = 10;
+
+    void applyRung();
+
+    EncoderSettings m_settings;
+    bool m_changed = false;
+
+    double m_smoothedLoss = 0.0;
+    double m_smoothedRtt = 0.0;
+    bool m_haveRttSample = false;
+    bool m_haveLossSample = false;
+    int m_rung = 0;
+    int m_goodReports = 0;
+
+    double m_smoothedEncodeNs = 0.0;
+    int m_framesWithHeadroom = 0;
+};
@@ -0,0 +1,74 @@
+#include "Fft.h"
+#include <cmath>
+#include <utility>
+
+Fft::Fft(int size)
+    : m_size(size),
+      m_twiddles(size / 2),
+      m_bitReverse(size)
+{
+    const double pi = std::acos(-1.0);
+    for (int k = 0; k < size / 2; ++k)
+    {
+        double angle = -2.0 * pi * k / size;
+        m_twiddles[k] = std::complex<float>(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+    }
+
+    int bits = 0;
+    while ((1 << bits) < size)
+        bits++;
+
+    for (int i = 0; i < size; ++i)
+    {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b)
+        {
+            if (i & (1 << b))
+                reversed |= 1 << (bits - 1 - b);
+        }
+        m_bitReverse[i] = reversed;
+    }
+}
+
+void Fft::forward(std::complex<float> *data) const
+{
+    transform(data, false);
+}
+
+void Fft::inverse(std::complex<float> *data) const
+{
+    transform(data, true);
+
+    const float scale = 1.0f / m_size;
+    for (int i = 0; i < m_size; ++i)
+        data[i] *= scale;
+}
+
+void Fft::transform(std::complex<float> *data, bool inverse) const
+{
+    for (int i = 0; i < m_size; ++i)
+    {
+        int j = m_bitReverse[i];
+        if (i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    for (int length = 2; length <= m_size; length <<= 1)
+    {
+        int half = length / 2;
+        int stride = m_size / length;
+        for (int start = 0; start < m_size; start += length)
+        {
+            for (int k = 0; k < half; ++k)
+            {
+                std::complex<float> w = m_twiddles[k * stride];
+                if (inverse)
+                    w = std::conj(w);
+
+                std::complex<float> odd = data[start + k + half] * w;
+                data[start + k + half] = data[start + k] - odd;
+                data[start + k] += odd;
+            }
+        }
+    }
+}
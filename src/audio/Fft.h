@@ -0,0 +1,24 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+// In-place iterative radix-2 complex FFT for the capture processing stages.
+// Twiddles and the bit-reversal permutation are computed once per size.
+class Fft
+{
+public:
+    explicit Fft(int size); // Must be a power of two
+
+    int size() const { return m_size; }
+
+    void forward(std::complex<float> *data) const;
+    void inverse(std::complex<float> *data) const; // Scaled by 1/size
+
+private:
+    void transform(std::complex<float> *data, bool inverse) const;
+
+    int m_size;
+    std::vector<std::complex<float>> m_twiddles; // e^(-2 pi i k / size), k < size / 2
+    std::vector<int> m_bitReverse;
+};
@@ -0,0 +1,103 @@
+#include "NoiseSuppressor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr float POWER_SMOOTHING = 0.7f;  // Per-bin power averaging
+constexpr float NOISE_RISE = 1.003f;     // ~1.3 dB/s upward drift of the minimum power
+constexpr float NOISE_BIAS = 2.0f;       // The tracked minimum sits below the mean
+constexpr float PRIOR_SMOOTHING = 0.98f; // Decision-directed weighting
+constexpr int STARTUP_HOPS = 20;         // Average instead of track for the first 200ms
+constexpr float POWER_FLOOR = 1e-12f;
+}
+
+NoiseSuppressor::NoiseSuppressor()
+    : m_fft(FFT_SIZE)
+{
+    // sqrt-Hann: analysis and synthesis windows multiply to a Hann window,
+    // which sums to one at 50% overlap
+    const double pi = std::acos(-1.0);
+    for (int i = 0; i < WINDOW; ++i)
+    {
+        m_window[i] = static_cast<float>(std::sqrt(0.5 * (1.0 - std::cos(2.0 * pi * i / WINDOW))));
+    }
+    reset();
+}
+
+void NoiseSuppressor::reset()
+{
+    std::memset(m_input, 0, sizeof(m_input));
+    std::memset(m_overlap, 0, sizeof(m_overlap));
+    std::fill(std::begin(m_smoothedPower), std::end(m_smoothedPower), 0.0f);
+    std::fill(std::begin(m_noise), std::end(m_noise), 0.0f);
+    std::fill(std::begin(m_previousGain), std::end(m_previousGain), 1.0f);
+    std::fill(std::begin(m_previousPosterior), std::end(m_previousPosterior), 1.0f);
+    m_hops = 0;
+}
+
+void NoiseSuppressor::process(float *samples, int count)
+{
+    for (int offset = 0; offset + HOP <= count; offset += HOP)
+    {
+        processHop(samples + offset);
+    }
+}
+
+void NoiseSuppressor::processHop(float *samples)
+{
+    // Slide the analysis buffer along by one hop
+    std::memcpy(m_input, m_input + HOP, HOP * sizeof(float));
+    std::memcpy(m_input + HOP, samples, HOP * sizeof(float));
+
+    for (int i = 0; i < WINDOW; ++i)
+        m_spectrum[i] = std::complex<float>(m_input[i] * m_window[i], 0.0f);
+    std::fill(m_spectrum + WINDOW, m_spectrum + FFT_SIZE, std::complex<float>());
+
+    m_fft.forward(m_spectrum);
+
+    m_hops++;
+    for (int bin = 0; bin < BINS; ++bin)
+    {
+        float power = std::norm(m_spectrum[bin]);
+        m_smoothedPower[bin] = POWER_SMOOTHING * m_smoothedPower[bin] + (1.0f - POWER_SMOOTHING) * power;
+
+        if (m_hops <= STARTUP_HOPS)
+        {
+            // Assume the first moments are mostly background and average them
+            m_noise[bin] += (power - m_noise[bin]) / m_hops;
+        }
+        else if (m_smoothedPower[bin] < m_noise[bin])
+        {
+            m_noise[bin] = m_smoothedPower[bin];
+        }
+        else
+        {
+            m_noise[bin] *= NOISE_RISE;
+        }
+
+        float noise = std::max(m_noise[bin] * NOISE_BIAS, POWER_FLOOR);
+        float posterior = power / noise;
+        float prior = PRIOR_SMOOTHING * m_previousGain[bin] * m_previousGain[bin] * m_previousPosterior[bin] +
+                      (1.0f - PRIOR_SMOOTHING) * std::max(posterior - 1.0f, 0.0f);
+        float gain = std::max(prior / (1.0f + prior), MIN_GAIN);
+
+        m_previousGain[bin] = gain;
+        m_previousPosterior[bin] = posterior;
+
+        m_spectrum[bin] *= gain;
+        if (bin > 0 && bin < FFT_SIZE / 2)
+            m_spectrum[FFT_SIZE - bin] = std::conj(m_spectrum[bin]);
+    }
+
+    m_fft.inverse(m_spectrum);
+
+    // Overlap-add: this hop's output is the tail of the previous window plus
+    // the head of this one
+    for (int i = 0; i < HOP; ++i)
+    {
+        samples[i] = m_overlap[i] + m_spectrum[i].real() * m_window[i];
+        m_overlap[i] = m_spectrum[HOP + i].real() * m_window[HOP + i];
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <complex>
+#include "CaptureChain.h"
+#include "Fft.h"
+
+// Spectral noise suppression for the capture chain.
+//
+// Audio is analysed in 20ms sqrt-Hann windows with 50% overlap (10ms hop,
+// zero-padded to a 1024-point FFT), which adds one hop of latency. The noise
+// spectrum is tracked per bin by following the minimum of the smoothed
+// power, which keeps adapting while the user talks. Each bin gets a Wiener
+// gain from a decision-directed a-priori SNR estimate, floored at MIN_GAIN
+// to avoid musical noise.
+class NoiseSuppressor : public CaptureStage
+{
+public:
+    static constexpr int HOP = OPUS_FRAME_SIZE / 2;
+    static constexpr int WINDOW = 2 * HOP;
+    static constexpr int FFT_SIZE = 1024;
+    static constexpr int BINS = FFT_SIZE / 2 + 1;
+    static constexpr float MIN_GAIN = 0.1f; // -20 dB maximum attenuation
+
+    NoiseSuppressor();
+
+    const char *name() const override { return "noise-suppression"; }
+    void reset() override;
+    void process(float *samples, int count) override;
+
+private:
+    void processHop(float *samples);
+
+    Fft m_fft;
+    float m_window[WINDOW];
+    float m_input[WINDOW];   // Previous hop followed by the current one
+    float m_overlap[HOP];    // Second half of the previous synthesis window
+    std::complex<float> m_spectrum[FFT_SIZE];
+
+    float m_smoothedPower[BINS];
+    float m_noise[BINS];
+    float m_previousGain[BINS];
+    float m_previousPosterior[BINS];
+    int m_hops = 0;
+};
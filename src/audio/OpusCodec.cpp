@@ -1,4 +1,5 @@
 #include "OpusCodec.h"
+#include "utils/Trace.h"
 #include <QDebug>
 
 OpusEncoder::OpusEncoder()
@@ -25,24 +26,19 @@ bool OpusEncoder::initialize()
         return false;
     }
 
-    // Configure encoder for Discord voice
-    opus_encoder_ctl(m_encoder, OPUS_SET_BITRATE(OPUS_BITRATE));
+    // Configure encoder for Discord voice; EncoderController adapts the rest at runtime
     opus_encoder_ctl(m_encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
-    opus_encoder_ctl(m_encoder, OPUS_SET_COMPLEXITY(10));       // Max quality
-    opus_encoder_ctl(m_encoder, OPUS_SET_PACKET_LOSS_PERC(15)); // Expect some packet loss
+    applySettings(EncoderSettings());
 
-    qDebug() << "Opus encoder initialized:" << OPUS_SAMPLE_RATE << "Hz," << OPUS_CHANNELS << "channels," << OPUS_BITRATE << "bps";
+    // Ask the encoder rather than trust a constant; the controller owns the rate
+    opus_int32 bitrate = 0;
+    opus_encoder_ctl(m_encoder, OPUS_GET_BITRATE(&bitrate));
+    qDebug() << "Opus encoder initialized:" << OPUS_SAMPLE_RATE << "Hz," << OPUS_CHANNELS << "channels," << bitrate << "bps";
     return true;
 }
 
 QByteArray OpusEncoder::encode(const QByteArray &pcm)
 {
-    if (!m_encoder)
-    {
-        qWarning() << "Opus encoder not initialized";
-        return QByteArray();
-    }
-
     // PCM data should be 16-bit signed integers (2 bytes per sample)
     int expectedSize = OPUS_FRAME_SIZE * OPUS_CHANNELS * sizeof(opus_int16);
     if (pcm.size() != expectedSize)
@@ -51,12 +47,31 @@ QByteArray OpusEncoder::encode(const QByteArray &pcm)
         return QByteArray();
     }
 
-    // Allocate output buffer (max Opus packet size)
-    QByteArray output(4000, 0);
+    QByteArray output;
+    output.reserve(OPUS_MAX_PACKET_SIZE);
+    if (encode(reinterpret_cast<const opus_int16 *>(pcm.constData()), output) < 0)
+    {
+        return QByteArray();
+    }
+
+    return output;
+}
+
+int OpusEncoder::encode(const opus_int16 *pcm, QByteArray &output)
+{
+    TRACE_SCOPE("audio", "opus_encode");
+    if (!m_encoder)
+    {
+        qWarning() << "Opus encoder not initialized";
+        return -1;
+    }
+
+    // Grow to the max packet size; within existing capacity this is free
+    output.resize(OPUS_MAX_PACKET_SIZE);
 
     int encodedBytes = opus_encode(
         m_encoder,
-        reinterpret_cast<const opus_int16 *>(pcm.constData()),
+        pcm,
         OPUS_FRAME_SIZE,
         reinterpret_cast<unsigned char *>(output.data()),
         output.size());
@@ -64,11 +79,54 @@ QByteArray OpusEncoder::encode(const QByteArray &pcm)
     if (encodedBytes < 0)
     {
         qWarning() << "Opus encoding failed:" << opus_strerror(encodedBytes);
-        return QByteArray();
+        output.resize(0);
+        return -1;
     }
 
     output.resize(encodedBytes);
-    return output;
+    return encodedBytes;
+}
+
+void OpusEncoder::applySettings(const EncoderSettings &settings)
+{
+    if (!m_encoder)
+        return;
+
+    opus_encoder_ctl(m_encoder, OPUS_SET_BITRATE(settings.bitrate));
+    opus_encoder_ctl(m_encoder, OPUS_SET_COMPLEXITY(settings.complexity));
+    opus_encoder_ctl(m_encoder, OPUS_SET_INBAND_FEC(settings.inbandFec ? 1 : 0));
+    opus_encoder_ctl(m_encoder, OPUS_SET_PACKET_LOSS_PERC(settings.packetLossPercent));
+    opus_encoder_ctl(m_encoder, OPUS_SET_DTX(settings.dtx ? 1 : 0));
+}
+
+OpusPacketPool::OpusPacketPool(int size)
+{
+    m_buffers.resize(size);
+    for (QByteArray &buffer : m_buffers)
+    {
+        buffer.reserve(OPUS_MAX_PACKET_SIZE);
+    }
+}
+
+QByteArray &OpusPacketPool::acquire()
+{
+    // Prefer a buffer nobody else references so writing to it won't detach
+    for (int i = 0; i < m_buffers.size(); ++i)
+    {
+        QByteArray &buffer = m_buffers[m_next];
+        m_next = (m_next + 1) % m_buffers.size();
+        if (buffer.isDetached())
+        {
+            return buffer;
+        }
+    }
+
+    // Every buffer is still held downstream; replace one rather than block
+    QByteArray &buffer = m_buffers[m_next];
+    m_next = (m_next + 1) % m_buffers.size();
+    buffer = QByteArray();
+    buffer.reserve(OPUS_MAX_PACKET_SIZE);
+    return buffer;
 }
 
 OpusDecoder::OpusDecoder()
@@ -101,32 +159,43 @@ bool OpusDecoder::initialize()
 
 QByteArray OpusDecoder::decode(const QByteArray &opus)
 {
-    if (!m_decoder)
+    // Allocate output buffer for PCM data
+    QByteArray output(OPUS_FRAME_SIZE * OPUS_CHANNELS * sizeof(opus_int16), Qt::Uninitialized);
+
+    int decodedSamples = decode(opus, reinterpret_cast<opus_int16 *>(output.data()), OPUS_FRAME_SIZE);
+    if (decodedSamples < 0)
     {
-        qWarning() << "Opus decoder not initialized";
         return QByteArray();
     }
 
-    // Allocate output buffer for PCM data
-    int maxFrameSize = OPUS_FRAME_SIZE * OPUS_CHANNELS * sizeof(opus_int16);
-    QByteArray output(maxFrameSize, 0);
+    // Resize to actual decoded size
+    output.resize(decodedSamples * OPUS_CHANNELS * sizeof(opus_int16));
+    return output;
+}
+
+int OpusDecoder::decode(const QByteArray &opus, opus_int16 *pcm, int maxFrameSize)
+{
+    TRACE_SCOPE("audio", "opus_decode");
+    if (!m_decoder)
+    {
+        qWarning() << "Opus decoder not initialized";
+        return -1;
+    }
 
     int decodedSamples = opus_decode(
         m_decoder,
         reinterpret_cast<const unsigned char *>(opus.constData()),
         opus.size(),
-        reinterpret_cast<opus_int16 *>(output.data()),
-        OPUS_FRAME_SIZE,
+        pcm,
+        maxFrameSize,
         0 // FEC disabled
     );
 
     if (decodedSamples < 0)
     {
         qWarning() << "Opus decoding failed:" << opus_strerror(decodedSamples);
-        return QByteArray();
+        return -1;
     }
 
-    // Resize to actual decoded size
-    output.resize(decodedSamples * OPUS_CHANNELS * sizeof(opus_int16));
-    return output;
+    return decodedSamples;
 }
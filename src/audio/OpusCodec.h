@@ -1,13 +1,16 @@
 #pragma once
 
 #include <QByteArray>
+#include <QList>
 #include <opus.h>
+#include "EncoderController.h"
 
 // Discord voice uses Opus at 48kHz stereo with 20ms frames
 constexpr int OPUS_SAMPLE_RATE = 48000;
 constexpr int OPUS_CHANNELS = 2;
 constexpr int OPUS_FRAME_SIZE = 960; // 20ms at 48kHz
 constexpr int OPUS_BITRATE = 64000;  // 64kbps
+constexpr int OPUS_MAX_PACKET_SIZE = 4000;
 
 class OpusEncoder
 {
@@ -19,10 +22,32 @@ public:
     QByteArray encode(const QByteArray &pcm);
     bool isValid() const { return m_encoder != nullptr; }
 
+    // Encode one 20ms frame into a caller-owned buffer. Returns the packet size,
+    // or -1 on failure. Does not allocate when output already has the capacity.
+    int encode(const opus_int16 *pcm, QByteArray &output);
+
+    // Reconfigure bitrate, complexity, FEC and DTX on a live encoder
+    void applySettings(const EncoderSettings &settings);
+
 private:
     ::OpusEncoder *m_encoder = nullptr;
 };
 
+// Small pool of preallocated buffers for encoded packets. A buffer is only
+// handed out again once every receiver has dropped its reference to it, so
+// packets can travel through signals without being copied or reallocated.
+class OpusPacketPool
+{
+public:
+    explicit OpusPacketPool(int size = 8);
+
+    QByteArray &acquire();
+
+private:
+    QList<QByteArray> m_buffers;
+    int m_next = 0;
+};
+
 class OpusDecoder
 {
 public:
@@ -31,6 +56,8 @@ public:
 
     bool initialize();
     QByteArray decode(const QByteArray &opus);
+    // Decode into caller-owned PCM; returns samples per channel, or -1 on error
+    int decode(const QByteArray &opus, opus_int16 *pcm, int maxFrameSize);
     bool isValid() const { return m_decoder != nullptr; }
 
 private:
@@ -0,0 +1,138 @@
+#include "PlaybackBuffer.h"
+#include <QtGlobal>
+#include <cstring>
+#include "utils/Metrics.h"
+
+namespace
+{
+// Totals over every stream, for the diagnostics view
+MetricCounter &s_underrunsMetric = Metrics::counter("audio.playback_underruns");
+MetricCounter &s_overflowFramesMetric = Metrics::counter("audio.playback_overflow_frames");
+MetricCounter &s_skipsMetric = Metrics::counter("audio.playback_skips");
+}
+
+bool PlaybackBuffer::writeFrames(const opus_int16 *pcm, int frames)
+{
+    quint32 writePos = m_writePos.load(std::memory_order_relaxed);
+    quint32 readPos = m_readPos.load(std::memory_order_acquire);
+
+    if (frames > CAPACITY_FRAMES - static_cast<int>(writePos - readPos))
+    {
+        m_overflows.fetch_add(frames, std::memory_order_relaxed);
+        s_overflowFramesMetric.add(frames);
+        return false;
+    }
+
+    // Copy in up to two pieces around the end of the ring
+    int start = writePos & MASK;
+    int first = qMin(frames, CAPACITY_FRAMES - start);
+    std::memcpy(m_ring + start * CHANNELS, pcm, first * BYTES_PER_FRAME);
+    if (first < frames)
+    {
+        std::memcpy(m_ring, pcm + first * CHANNELS, (frames - first) * BYTES_PER_FRAME);
+    }
+
+    m_writePos.store(writePos + frames, std::memory_order_release);
+    return true;
+}
+
+void PlaybackBuffer::clear()
+{
+    m_readPos.store(m_writePos.load(std::memory_order_acquire), std::memory_order_release);
+    m_primed = false;
+    m_phase = 0.0;
+    m_ratio = 1.0;
+    m_smoothedFill = TARGET_FRAMES;
+    m_underruns.store(0, std::memory_order_relaxed);
+    m_overflows.store(0, std::memory_order_relaxed);
+    m_skips.store(0, std::memory_order_relaxed);
+    m_publishedRatio.store(1.0, std::memory_order_relaxed);
+}
+
+int PlaybackBuffer::bufferedFrames() const
+{
+    return static_cast<int>(m_writePos.load(std::memory_order_acquire) - m_readPos.load(std::memory_order_acquire));
+}
+
+PlaybackBuffer::Stats PlaybackBuffer::stats() const
+{
+    Stats stats;
+    stats.underruns = m_underruns.load(std::memory_order_relaxed);
+    stats.overflows = m_overflows.load(std::memory_order_relaxed);
+    stats.skips = m_skips.load(std::memory_order_relaxed);
+    stats.ratio = m_publishedRatio.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void PlaybackBuffer::updateRatio(int available)
+{
+    // Average out per-packet jitter so only the long-term trend (clock
+    // drift, or a burst that needs draining) moves the playback rate
+    m_smoothedFill += (available - m_smoothedFill) * 0.02;
+
+    double error = (m_smoothedFill - TARGET_FRAMES) / TARGET_FRAMES;
+    m_ratio = 1.0 + qBound(-MAX_CORRECTION, error * 0.01, MAX_CORRECTION);
+    m_publishedRatio.store(m_ratio, std::memory_order_relaxed);
+}
+
+bool PlaybackBuffer::render(opus_int16 *out, int frames)
+{
+    quint32 readPos = m_readPos.load(std::memory_order_relaxed);
+    int available = static_cast<int>(m_writePos.load(std::memory_order_acquire) - readPos);
+
+    // Wait for a jitter margin before starting (again)
+    if (!m_primed)
+    {
+        if (available < TARGET_FRAMES)
+            return false;
+        m_primed = true;
+        m_phase = 0.0;
+        m_smoothedFill = available;
+    }
+
+    // A burst left far more buffered than we want; drop back to the target
+    // instead of carrying the extra latency for the rest of the call
+    if (available > MAX_FRAMES)
+    {
+        readPos += available - TARGET_FRAMES;
+        available = TARGET_FRAMES;
+        m_smoothedFill = TARGET_FRAMES;
+        m_skips.fetch_add(1, std::memory_order_relaxed);
+        s_skipsMetric.add();
+    }
+
+    updateRatio(available);
+
+    int produced = 0;
+    while (produced < frames)
+    {
+        // Linear interpolation needs this frame and the next
+        if (available < 2)
+        {
+            m_underruns.fetch_add(1, std::memory_order_relaxed);
+            s_underrunsMetric.add();
+            m_primed = false;
+            std::memset(out + produced * CHANNELS, 0, (frames - produced) * BYTES_PER_FRAME);
+            break;
+        }
+
+        const opus_int16 *s0 = m_ring + (readPos & MASK) * CHANNELS;
+        const opus_int16 *s1 = m_ring + ((readPos + 1) & MASK) * CHANNELS;
+        for (int c = 0; c < CHANNELS; ++c)
+        {
+            out[produced * CHANNELS + c] = static_cast<opus_int16>(s0[c] + (s1[c] - s0[c]) * m_phase);
+        }
+        produced++;
+
+        m_phase += m_ratio;
+        while (m_phase >= 1.0)
+        {
+            m_phase -= 1.0;
+            readPos++;
+            available--;
+        }
+    }
+
+    m_readPos.store(readPos, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QtGlobal>
+#include <atomic>
+#include <opus.h>
+#include "OpusCodec.h"
+
+// Playback ring for one remote stream, fed by the decode path.
+//
+// Decoded PCM is pushed into a single-producer/single-consumer ring and the
+// mixer pulls from render() at the device clock. Because the remote
+// sender's sample clock never runs at exactly the device's rate, the reader
+// resamples asynchronously: a slow controller nudges the playback ratio so
+// the ring hovers around TARGET_FRAMES. Long calls then neither accumulate
+// latency nor run dry. Underruns play silence and re-prime the buffer.
+class PlaybackBuffer
+{
+public:
+    static constexpr int CHANNELS = OPUS_CHANNELS;
+    static constexpr int BYTES_PER_FRAME = CHANNELS * sizeof(opus_int16);
+    static constexpr int CAPACITY_FRAMES = 1 << 15;                  // ~680ms, power of two
+    static constexpr int TARGET_FRAMES = OPUS_SAMPLE_RATE * 60 / 1000; // Jitter margin
+    static constexpr int MAX_FRAMES = TARGET_FRAMES * 4;             // Beyond this, skip ahead
+    static constexpr double MAX_CORRECTION = 0.005;                  // +-0.5% playback rate
+
+    struct Stats
+    {
+        int underruns = 0;
+        int overflows = 0; // Frames rejected because the ring was full
+        int skips = 0;     // Latency resets after a burst
+        double ratio = 1.0;
+    };
+
+    // Producer side: append interleaved PCM. Returns false if it didn't fit.
+    bool writeFrames(const opus_int16 *pcm, int frames);
+
+    // Drop buffered audio; only call while the sink is stopped
+    void clear();
+
+    int bufferedFrames() const;
+    Stats stats() const;
+
+    // Consumer side: produce exactly `frames` output frames. Returns false
+    // (and writes nothing) while there is no audio to play.
+    bool render(opus_int16 *out, int frames);
+
+private:
+    static constexpr int MASK = CAPACITY_FRAMES - 1;
+
+    void updateRatio(int available);
+
+    alignas(16) opus_int16 m_ring[CAPACITY_FRAMES * CHANNELS];
+    std::atomic<quint32> m_writePos{0}; // Frame counters; index = pos & MASK
+    std::atomic<quint32> m_readPos{0};
+
+    // Consumer-only state
+    bool m_primed = false;
+    double m_phase = 0.0; // Fractional position between m_readPos and the next frame
+    double m_ratio = 1.0; // Input frames consumed per output frame
+    double m_smoothedFill = TARGET_FRAMES;
+
+    std::atomic<int> m_underruns{0};
+    std::atomic<int> m_overflows{0};
+    std::atomic<int> m_skips{0};
+    std::atomic<double> m_publishedRatio{1.0};
+};
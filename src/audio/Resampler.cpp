@@ -0,0 +1,186 @@
+#include "Resampler.h"
+#include "DspKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+constexpr int BASE_TAPS = 64;
+constexpr double STOPBAND_DB = 80.0;
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; ++k)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+}
+
+bool Resampler::isSupported(int inputRate, int outputRate)
+{
+    if (inputRate <= 0 || outputRate <= 0)
+        return false;
+
+    int divisor = std::gcd(inputRate, outputRate);
+    return outputRate / divisor <= MAX_PHASES && inputRate / divisor <= MAX_PHASES;
+}
+
+bool Resampler::configure(int inputRate, int outputRate, int channels)
+{
+    if (!isSupported(inputRate, outputRate) || channels < 1 || channels > MAX_CHANNELS)
+        return false;
+
+    m_inputRate = inputRate;
+    m_outputRate = outputRate;
+    m_channels = channels;
+
+    int divisor = std::gcd(inputRate, outputRate);
+    m_interpolation = outputRate / divisor;
+    m_decimation = inputRate / divisor;
+
+    // Keep the transition band the same width relative to the output rate
+    // when decimating; round up for the vector kernels
+    int taps = BASE_TAPS;
+    if (m_decimation > m_interpolation)
+        taps = (BASE_TAPS * m_decimation + m_interpolation - 1) / m_interpolation;
+    m_taps = (taps + 7) & ~7;
+
+    designFilter();
+
+    for (int channel = 0; channel < MAX_CHANNELS; ++channel)
+    {
+        if (channel < m_channels)
+            m_history[channel].assign(m_taps - 1 + MAX_INPUT_FRAMES, 0.0f);
+        else
+            m_history[channel].clear();
+    }
+
+    reset();
+    return true;
+}
+
+void Resampler::designFilter()
+{
+    int length = m_taps * m_interpolation;
+    const double pi = std::acos(-1.0);
+
+    // Kaiser's formulas: beta for the stopband, transition width for the
+    // filter length (as a fraction of the input rate)
+    double beta = 0.1102 * (STOPBAND_DB - 8.7);
+    double transition = (STOPBAND_DB - 8.0) / (2.285 * 2.0 * pi * m_taps);
+
+    // Cut-off centred so the stopband begins at the lower Nyquist frequency,
+    // normalised to the prototype rate (L times the input rate)
+    double nyquist = 0.5 * std::min(1.0, static_cast<double>(m_interpolation) / m_decimation);
+    double cutoff = (nyquist - 0.5 * transition) / m_interpolation;
+
+    std::vector<double> prototype(length);
+    double centre = 0.5 * (length - 1);
+    double windowNorm = besselI0(beta);
+    double sum = 0.0;
+    for (int i = 0; i < length; ++i)
+    {
+        double t = i - centre;
+        double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * pi * cutoff * t) / (pi * t);
+        double r = 2.0 * i / (length - 1) - 1.0;
+        double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / windowNorm;
+        prototype[i] = sinc * window;
+        sum += prototype[i];
+    }
+
+    // Unity passband gain; the phases share the prototype's gain of L
+    double gain = m_interpolation / sum;
+
+    m_coefficients.assign(static_cast<size_t>(length), 0.0f);
+    for (int phase = 0; phase < m_interpolation; ++phase)
+    {
+        float *coefficients = m_coefficients.data() + static_cast<size_t>(phase) * m_taps;
+        for (int tap = 0; tap < m_taps; ++tap)
+        {
+            coefficients[m_taps - 1 - tap] = static_cast<float>(prototype[tap * m_interpolation + phase] * gain);
+        }
+    }
+}
+
+void Resampler::reset()
+{
+    for (int channel = 0; channel < m_channels; ++channel)
+    {
+        std::fill(m_history[channel].begin(), m_history[channel].end(), 0.0f);
+    }
+    m_fill = m_taps - 1;
+    m_position = m_taps - 1;
+    m_phase = 0;
+}
+
+int Resampler::maxOutputFrames(int inputFrames) const
+{
+    return static_cast<int>((static_cast<qint64>(inputFrames) * m_interpolation) / m_decimation) + 2;
+}
+
+int Resampler::process(const float *input, int inputFrames, float *output)
+{
+    // The history buffer has room for one chunk of new input at a time
+    int produced = 0;
+    while (inputFrames > 0)
+    {
+        int chunk = std::min(inputFrames, MAX_INPUT_FRAMES);
+        produced += processChunk(input, chunk, output + static_cast<size_t>(produced) * m_channels);
+        input += static_cast<size_t>(chunk) * m_channels;
+        inputFrames -= chunk;
+    }
+    return produced;
+}
+
+int Resampler::processChunk(const float *input, int inputFrames, float *output)
+{
+    for (int channel = 0; channel < m_channels; ++channel)
+    {
+        float *history = m_history[channel].data() + m_fill;
+        for (int i = 0; i < inputFrames; ++i)
+            history[i] = input[i * m_channels + channel];
+    }
+    m_fill += inputFrames;
+
+    int produced = 0;
+    while (m_position < m_fill)
+    {
+        const float *coefficients = m_coefficients.data() + static_cast<size_t>(m_phase) * m_taps;
+        int start = m_position - (m_taps - 1);
+        for (int channel = 0; channel < m_channels; ++channel)
+        {
+            output[produced * m_channels + channel] =
+                DspKernels::dotProduct(coefficients, m_history[channel].data() + start, m_taps);
+        }
+        produced++;
+
+        m_phase += m_decimation;
+        m_position += m_phase / m_interpolation;
+        m_phase %= m_interpolation;
+    }
+
+    // Keep only the history the next output needs
+    int discard = std::min(m_position - (m_taps - 1), m_fill);
+    if (discard > 0)
+    {
+        for (int channel = 0; channel < m_channels; ++channel)
+        {
+            float *history = m_history[channel].data();
+            std::memmove(history, history + discard, (m_fill - discard) * sizeof(float));
+        }
+        m_fill -= discard;
+        m_position -= discard;
+    }
+
+    return produced;
+}
@@ -0,0 +1,60 @@
+#include "VoiceActivityDetector.h"
+#include <cmath>
+
+bool VoiceActivityDetector::process(const opus_int16 *frame, int samplesPerChannel)
+{
+    if (samplesPerChannel <= 0)
+        return isActive();
+
+    // Work on the mono downmix, normalised to [-1, 1]
+    double totalEnergy = 0.0;
+    double bandEnergy = 0.0;
+    for (int i = 0; i < samplesPerChannel; ++i)
+    {
+        float mono = (frame[i * 2] + frame[i * 2 + 1]) * (0.5f / 32768.0f);
+        float band = m_lowPass.process(m_highPass.process(mono));
+        totalEnergy += mono * mono;
+        bandEnergy += band * band;
+    }
+
+    float energyDb = 10.0f * std::log10(static_cast<float>(totalEnergy / samplesPerChannel) + 1e-12f);
+    float bandRatio = totalEnergy > 0.0 ? static_cast<float>(bandEnergy / totalEnergy) : 0.0f;
+
+    bool speech = energyDb > MIN_SPEECH_DB &&
+                  energyDb > m_noiseFloorDb + ENERGY_MARGIN_DB &&
+                  bandRatio > MIN_SPEECH_BAND_RATIO;
+
+    // Noise floor follows quiet frames down quickly and creeps up slowly, so a
+    // raised room level is learned within a few seconds but speech is not
+    if (energyDb < m_noiseFloorDb)
+    {
+        m_noiseFloorDb += (energyDb - m_noiseFloorDb) * 0.5f;
+    }
+    else if (!speech)
+    {
+        m_noiseFloorDb += (energyDb - m_noiseFloorDb) * 0.02f;
+    }
+    else
+    {
+        m_noiseFloorDb += 0.01f;
+    }
+
+    if (speech)
+    {
+        m_hangover = HANGOVER_FRAMES;
+    }
+    else if (m_hangover > 0)
+    {
+        --m_hangover;
+    }
+
+    return isActive();
+}
+
+void VoiceActivityDetector::reset()
+{
+    m_highPass.z1 = m_highPass.z2 = 0.0f;
+    m_lowPass.z1 = m_lowPass.z2 = 0.0f;
+    m_noiseFloorDb = -60.0f;
+    m_hangover = 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <opus.h>
+
+// Decides per 20ms frame whether the microphone carries speech.
+//
+// Two features are combined: frame energy against an adaptive noise floor,
+// and the share of that energy inside the speech band (300-3400 Hz). Loud
+// broadband or rumble noise fails the second test even when it clears the
+// first. A hangover keeps transmission open for a short while after the last
+// speech frame so word endings and short pauses are not clipped.
+class VoiceActivityDetector
+{
+public:
+    static constexpr int HANGOVER_FRAMES = 15;        // 300ms of trailing silence
+    static constexpr float ENERGY_MARGIN_DB = 9.0f;   // Required rise above noise floor
+    static constexpr float MIN_SPEECH_DB = -55.0f;    // Absolute floor (dBFS)
+    static constexpr float MIN_SPEECH_BAND_RATIO = 0.35f;
+
+    // Analyse one interleaved stereo frame. Returns true while audio should be sent.
+    bool process(const opus_int16 *frame, int samplesPerChannel);
+
+    void reset();
+
+    bool isActive() const { return m_hangover > 0; }
+    float noiseFloorDb() const { return m_noiseFloorDb; }
+
+private:
+    struct Biquad
+    {
+        float b0, b1, b2, a1, a2;
+        float z1 = 0.0f, z2 = 0.0f;
+
+        float process(float x)
+        {
+            float y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    // 2nd-order Butterworth sections at 48kHz
+    Biquad m_highPass{0.97261f, -1.94523f, 0.97261f, -1.94448f, 0.94598f}; // 300 Hz
+    Biquad m_lowPass{0.03734f, 0.07468f, 0.03734f, -1.38389f, 0.53325f};   // 3400 Hz
+
+    float m_noiseFloorDb = -60.0f;
+    int m_hangover = 0;
+};
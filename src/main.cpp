@@ -2,11 +2,27 @@
 #include <QFontDatabase>
 #include <QDebug>
 #include "ui/MainWindow.h"
+#include "utils/Metrics.h"
+#include "utils/Trace.h"
 
 int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
 
+    // CPPCORD_TRACE=<file.json>: record from startup, write a Chrome trace on exit
+    const QString tracePath = qEnvironmentVariable("CPPCORD_TRACE");
+    if (!tracePath.isEmpty())
+    {
+        Tracer::start();
+        qDebug() << "Tracing to" << tracePath;
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, [tracePath]() {
+            Tracer::stop();
+            if (Tracer::droppedEvents() > 0)
+                qWarning() << "Trace buffers filled up;" << Tracer::droppedEvents() << "events dropped";
+            Tracer::writeChromeJson(tracePath);
+        });
+    }
+
     // Set application info for QSettings (used by TokenStorage)
     QCoreApplication::setOrganizationName("CPPCord");
     QCoreApplication::setApplicationName("DiscordClient");
@@ -31,6 +47,16 @@ int main(int argc, char *argv[])
     QFont appFont("gg sans", 10);
     app.setFont(appFont);
 
+    // CPPCORD_METRICS_FILE=<file.jsonl>: append a metrics snapshot every few seconds
+    MetricsRecorder metricsRecorder;
+    const QString metricsPath = qEnvironmentVariable("CPPCORD_METRICS_FILE");
+    if (!metricsPath.isEmpty())
+    {
+        bool ok = false;
+        int intervalMs = qEnvironmentVariableIntValue("CPPCORD_METRICS_INTERVAL_MS", &ok);
+        metricsRecorder.start(metricsPath, ok ? intervalMs : MetricsRecorder::DEFAULT_INTERVAL_MS);
+    }
+
     MainWindow window;
     window.show();
 
@@ -1,4 +1,6 @@
 #include "DiscordClient.h"
+#include "utils/Trace.h"
+#include "utils/Metrics.h"
 #include <QNetworkRequest>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -7,13 +9,48 @@
 #include <QRandomGenerator>
 #include <QSysInfo>
 #include <QPixmap>
+#include <QImage>
+#include <QThreadPool>
 #include <algorithm> // for std::sort
 
+namespace
+{
+MetricCounter &s_iconDownloadsMetric = Metrics::counter("guild_icon.downloads");
+
+QString iconDiskKey(const QString &iconHash)
+{
+    return QString("icon/%1").arg(iconHash);
+}
+
+// Runs on m_iconPool; QImage rather than QPixmap so it is thread safe
+QImage decodeGuildIcon(const uchar *data, qint64 size)
+{
+    TRACE_SCOPE("image", "guild_icon_decode");
+    QImage image;
+    image.loadFromData(data, static_cast<int>(size));
+    return image;
+}
+}
+
 DiscordClient::DiscordClient(QObject *parent)
-    : QObject(parent), m_networkManager(new QNetworkAccessManager(this)), m_gateway(new GatewayClient(this)), m_fingerprint(generateFingerprint())
+    : QObject(parent), m_networkManager(new QNetworkAccessManager(this)), m_gateway(new GatewayClient(this)), m_fingerprint(generateFingerprint()),
+      m_iconCache("guild_icon", 16 * 1024 * 1024), m_iconPool(new QThreadPool(this))
 {
     connect(m_gateway, &GatewayClient::eventReceived, this, &DiscordClient::handleGatewayEvent);
     m_gateway->setDiscordClient(this);
+
+    // Index the icon cache before the first GUILD_CREATE needs it; the pool
+    // runs one task at a time, so lookups queue up behind the scan
+    m_iconPool->setMaxThreadCount(1);
+    m_iconPool->setObjectName("GuildIcons");
+    m_iconPool->start([this]() { m_iconCache.warmUp(); });
+}
+
+DiscordClient::~DiscordClient()
+{
+    // Icon tasks post back to this object; let running ones finish first
+    m_iconPool->clear();
+    m_iconPool->waitForDone();
 }
 
 void DiscordClient::loginWithToken(const QString &token)
@@ -607,6 +644,7 @@ void DiscordClient::handleReady(const QJsonObject &data)
 
 void DiscordClient::handleGuildCreate(const QJsonObject &data)
 {
+    TRACE_SCOPE("client", "handleGuildCreate");
     Guild guild;
     guild.id = data["id"].toString().toULongLong();
     guild.name = data["name"].toString();
@@ -798,27 +836,67 @@ QString DiscordClient::getGuildIconUrl(Snowflake guildId, const QString &iconHas
         .arg(extension);
 }
 
+void DiscordClient::setOffline(bool offline)
+{
+    m_offline = offline;
+    m_gateway->setOffline(offline);
+}
+
 void DiscordClient::downloadGuildIcon(Snowflake guildId, const QString &iconHash)
 {
-    if (iconHash.isEmpty())
+    if (iconHash.isEmpty() || m_offline)
+        return;
+
+    // READY and GUILD_CREATE can name hundreds of icons at once, so the disk
+    // lookup and decode run on m_iconPool; a miss starts the download here
+    m_iconPool->start([this, guildId, iconHash]()
+                      {
+        // Icon hashes change with the image, so a disk hit is always current
+        const QString key = iconDiskKey(iconHash);
+        DiskCache::Mapping cached = m_iconCache.read(key);
+        QImage icon = cached.isValid() ? decodeGuildIcon(cached.data(), cached.size()) : QImage();
+
+        // A copy that doesn't decode is deleted (unmapped first), so the
+        // download below replaces it instead of hitting write()'s
+        // same-size shortcut
+        if (cached.isValid() && icon.isNull())
+        {
+            qWarning() << "Cached icon for guild" << guildId << "does not decode, downloading it again";
+            cached = DiskCache::Mapping();
+            m_iconCache.remove(key);
+        }
+        QMetaObject::invokeMethod(this, [this, guildId, iconHash, icon]()
+                                  {
+            if (!icon.isNull())
+                setGuildIcon(guildId, icon);
+            else
+                fetchGuildIcon(guildId, iconHash); }, Qt::QueuedConnection); });
+}
+
+void DiscordClient::fetchGuildIcon(Snowflake guildId, const QString &iconHash)
+{
+    if (m_offline)
         return;
 
     QString iconUrl = getGuildIconUrl(guildId, iconHash);
     QNetworkRequest request(iconUrl);
+    s_iconDownloadsMetric.add();
 
     QNetworkReply *reply = m_networkManager->get(request);
-    connect(reply, &QNetworkReply::finished, this, [this, reply, guildId]()
+    connect(reply, &QNetworkReply::finished, this, [this, reply, guildId, iconHash]()
             {
         if (reply->error() == QNetworkReply::NoError)
         {
+            // Decoded, and kept on disk if it decodes, on the icon worker
             QByteArray imageData = reply->readAll();
-            QPixmap pixmap;
-            if (pixmap.loadFromData(imageData))
-            {
-                m_guildIcons[guildId] = pixmap;
-                emit guildIconLoaded(guildId, pixmap);
-                qDebug() << "Guild icon loaded for guild" << guildId;
-            }
+            m_iconPool->start([this, guildId, iconHash, imageData]()
+                              {
+                QImage icon = decodeGuildIcon(reinterpret_cast<const uchar *>(imageData.constData()), imageData.size());
+                if (icon.isNull())
+                    return;
+                m_iconCache.write(iconDiskKey(iconHash), imageData);
+                QMetaObject::invokeMethod(this, [this, guildId, icon]() { setGuildIcon(guildId, icon); },
+                                          Qt::QueuedConnection); });
         }
         else
         {
@@ -827,6 +905,14 @@ void DiscordClient::downloadGuildIcon(Snowflake guildId, const QString &iconHash
         reply->deleteLater(); });
 }
 
+void DiscordClient::setGuildIcon(Snowflake guildId, const QImage &icon)
+{
+    QPixmap pixmap = QPixmap::fromImage(icon);
+    m_guildIcons[guildId] = pixmap;
+    emit guildIconLoaded(guildId, pixmap);
+    qDebug() << "Guild icon loaded for guild" << guildId;
+}
+
 void DiscordClient::handleMessageCreate(const QJsonObject &data)
 {
     Message message;
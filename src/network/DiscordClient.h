@@ -14,6 +14,9 @@
 #include "Message.h"
 #include "GatewayClient.h"
 #include "utils/TokenStorage.h"
+#include "utils/DiskCache.h"
+
+class QThreadPool;
 
 class DiscordClient : public QObject
 {
@@ -21,6 +24,7 @@ class DiscordClient : public QObject
 
 public:
     explicit DiscordClient(QObject *parent = nullptr);
+    ~DiscordClient() override;
 
     // Auth methods
     void login(const QString &email, const QString &password);
@@ -46,6 +50,14 @@ public:
     const User *currentUser() const { return m_user.id != 0 ? &m_user : nullptr; }
     Snowflake getUserId() const { return m_user.id; }
 
+    // Gateway connection, e.g. for pointing it at a local stand-in server
+    GatewayClient *gateway() const { return m_gateway; }
+
+    // Offline: events are handled as usual, but nothing reaches the network
+    // (no voice connection, no icon downloads). For replaying captures.
+    void setOffline(bool offline);
+    bool isOffline() const { return m_offline; }
+
     // Voice
     class VoiceClient *getVoiceClient() const { return m_gateway->getVoiceClient(); }
     void joinVoiceChannel(Snowflake guildId, Snowflake channelId, bool mute = false, bool deaf = false);
@@ -85,10 +97,13 @@ signals:
     void callDeleted(Snowflake channelId);
 
 private:
+    friend struct BenchmarkAccess; // bench/BenchmarkAccess.h
+
     QNetworkAccessManager *m_networkManager;
     GatewayClient *m_gateway;
     QString m_token;
     QString m_fingerprint;
+    bool m_offline = false;
     TokenStorage m_tokenStorage;
 
     // State
@@ -96,6 +111,8 @@ private:
     QList<Channel> m_privateChannels;
     User m_user;
     QMap<Snowflake, QPixmap> m_guildIcons; // Cache for guild icons // Current user info
+    DiskCache m_iconCache;                 // Icon bytes by hash, so logins don't refetch them
+    QThreadPool *m_iconPool;               // Icon disk reads and decodes, off the GUI thread
 
     // Event handlers
     void handleGatewayEvent(const QString &eventName, const QJsonObject &data);
@@ -110,4 +127,6 @@ private:
     void handleLoginResponse(QNetworkReply *reply);
     void handleMFAResponse(QNetworkReply *reply);
     void handleUserInfoResponse(QNetworkReply *reply);
+    void fetchGuildIcon(Snowflake guildId, const QString &iconHash);
+    void setGuildIcon(Snowflake guildId, const QImage &icon);
 };
@@ -0,0 +1,223 @@
+#include "GatewayCapture.h"
+#include <QRegularExpression>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+
+namespace
+{
+constexpr int MAGIC_SIZE = 8;
+
+void appendVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80)
+    {
+        out.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+bool readVarint(const QByteArray &in, int &offset, quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && offset < in.size(); shift += 7)
+    {
+        quint8 byte = static_cast<quint8>(in.at(offset++));
+        value |= static_cast<quint64>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+}
+
+bool GatewayCaptureWriter::open(const QString &path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Cannot open gateway capture" << path << ":" << m_file.errorString();
+        return false;
+    }
+
+    m_file.write(MAGIC, MAGIC_SIZE);
+    m_block.clear();
+    m_block.reserve(BLOCK_SIZE + 4096);
+    m_lastTimestampNs = 0;
+    m_lastFlushNs = 0;
+    m_frames = 0;
+    m_bytesIn = 0;
+    m_bytesOut = 0;
+    return true;
+}
+
+void GatewayCaptureWriter::close()
+{
+    if (!m_file.isOpen())
+        return;
+
+    flushBlock();
+    m_bytesOut = m_file.pos();
+    m_file.close();
+}
+
+void GatewayCaptureWriter::append(qint64 timestampNs, const QByteArray &frame)
+{
+    if (!m_file.isOpen())
+        return;
+
+    // The first frame is the capture's time origin
+    if (m_frames == 0)
+    {
+        m_lastTimestampNs = timestampNs;
+        m_lastFlushNs = timestampNs;
+    }
+
+    QByteArray scrubbed = scrub(frame);
+    if (scrubbed.size() > MAX_FRAME_SIZE)
+    {
+        qWarning() << "Gateway capture skipped a" << scrubbed.size() << "byte frame";
+        return;
+    }
+    appendVarint(m_block, static_cast<quint64>(qMax<qint64>(0, timestampNs - m_lastTimestampNs)));
+    appendVarint(m_block, static_cast<quint64>(scrubbed.size()));
+    m_block.append(scrubbed);
+    m_lastTimestampNs = timestampNs;
+    m_frames++;
+    m_bytesIn += frame.size();
+
+    if (m_block.size() >= BLOCK_SIZE || timestampNs - m_lastFlushNs >= FLUSH_INTERVAL_NS)
+    {
+        flushBlock();
+        m_lastFlushNs = timestampNs;
+    }
+}
+
+void GatewayCaptureWriter::flushIfDue(qint64 timestampNs)
+{
+    if (!m_file.isOpen() || m_block.isEmpty() || timestampNs - m_lastFlushNs < FLUSH_INTERVAL_NS)
+        return;
+
+    flushBlock();
+    m_lastFlushNs = timestampNs;
+}
+
+bool GatewayCaptureWriter::flushBlock()
+{
+    if (m_block.isEmpty())
+        return true;
+
+    QByteArray compressed = qCompress(m_block, COMPRESSION_LEVEL);
+    uchar length[4];
+    qToBigEndian<quint32>(static_cast<quint32>(compressed.size()), length);
+
+    bool ok = m_file.write(reinterpret_cast<const char *>(length), 4) == 4 &&
+              m_file.write(compressed) == compressed.size() && m_file.flush();
+    if (!ok)
+        qWarning() << "Gateway capture write failed:" << m_file.errorString();
+    m_block.clear();
+    return ok;
+}
+
+QByteArray GatewayCaptureWriter::scrub(const QByteArray &frame)
+{
+    // Cheap check first: almost no frame mentions a token
+    if (!frame.contains("token"))
+        return frame;
+
+    static const QRegularExpression tokenField(R"re("(\w*token)"\s*:\s*"(?:[^"\\]|\\.)*")re");
+    QString text = QString::fromUtf8(frame);
+    text.replace(tokenField, R"("\1":"<scrubbed>")");
+    return text.toUtf8();
+}
+
+bool GatewayCaptureReader::isCapture(const QString &path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) && file.read(MAGIC_SIZE) == QByteArray(GatewayCaptureWriter::MAGIC, MAGIC_SIZE);
+}
+
+bool GatewayCaptureReader::open(const QString &path)
+{
+    m_file.setFileName(path);
+    m_block.clear();
+    m_offset = 0;
+    m_timestampNs = 0;
+    m_error.clear();
+
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        m_error = m_file.errorString();
+        return false;
+    }
+    if (m_file.read(MAGIC_SIZE) != QByteArray(GatewayCaptureWriter::MAGIC, MAGIC_SIZE))
+    {
+        m_error = "Not a gateway capture";
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool GatewayCaptureReader::readBlock()
+{
+    uchar length[4];
+    if (m_file.read(reinterpret_cast<char *>(length), 4) != 4)
+        return false; // Clean end of file
+
+    // A damaged length must not turn into a multi-GB allocation
+    quint32 size = qFromBigEndian<quint32>(length);
+    if (size > static_cast<quint64>(m_file.size() - m_file.pos()))
+    {
+        m_error = "Block length exceeds the file size";
+        return false;
+    }
+    QByteArray compressed = m_file.read(size);
+    if (compressed.size() != static_cast<qsizetype>(size) || size < 4)
+    {
+        m_error = "Damaged or truncated block";
+        return false;
+    }
+
+    // qUncompress allocates whatever its 4-byte size prefix claims
+    quint32 uncompressedSize = qFromBigEndian<quint32>(compressed.constData());
+    if (uncompressedSize > static_cast<quint32>(GatewayCaptureWriter::MAX_BLOCK_SIZE))
+    {
+        m_error = "Block size exceeds the capture format's maximum";
+        return false;
+    }
+    m_block = qUncompress(compressed);
+    m_offset = 0;
+    if (m_block.isEmpty())
+    {
+        // A crash can leave the last block short
+        m_error = "Damaged or truncated block";
+        return false;
+    }
+    return true;
+}
+
+bool GatewayCaptureReader::next(Frame &frame)
+{
+    if (!m_file.isOpen())
+        return false;
+    if (m_offset >= m_block.size() && !readBlock())
+        return false;
+
+    quint64 delta = 0;
+    quint64 length = 0;
+    if (!readVarint(m_block, m_offset, delta) || !readVarint(m_block, m_offset, length) ||
+        length > static_cast<quint64>(m_block.size() - m_offset))
+    {
+        m_error = "Damaged record";
+        return false;
+    }
+
+    m_timestampNs += static_cast<qint64>(delta);
+    frame.timestampNs = m_timestampNs;
+    frame.payload = m_block.mid(m_offset, static_cast<qsizetype>(length));
+    m_offset += static_cast<int>(length);
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// Capture files of raw gateway frames, for reproducing performance problems.
+//
+// Layout: an 8-byte magic, then zlib blocks of about BLOCK_SIZE input bytes
+// (never more than MAX_BLOCK_SIZE, which readers enforce), each stored as a big-endian 32-bit length followed by qCompress() output.
+// Inside a block every frame is a record of varint(delta ns since the
+// previous frame), varint(length) and the frame's UTF-8 text, so timestamps
+// cost a byte or two and the JSON compresses well across frames. Blocks are
+// written when full or FLUSH_INTERVAL_NS after the previous one, so a crash
+// loses a few seconds at most. The interval is checked on every append and by
+// flushIfDue(), which the owner calls from a timer so a quiet gateway's last
+// frames still reach the disk. Values of token fields are scrubbed before
+// anything reaches the file.
+class GatewayCaptureWriter
+{
+public:
+    static constexpr char MAGIC[] = "CCGWCAP1"; // 8 bytes, no terminator written
+    static constexpr int BLOCK_SIZE = 256 * 1024;
+    static constexpr int MAX_FRAME_SIZE = 64 * 1024 * 1024; // Larger frames are not recorded
+    // A block is flushed once it reaches BLOCK_SIZE, so its last frame can
+    // overshoot by one frame plus two varints
+    static constexpr int MAX_BLOCK_SIZE = BLOCK_SIZE + MAX_FRAME_SIZE + 20;
+    static constexpr qint64 FLUSH_INTERVAL_NS = 5000000000LL;
+    static constexpr int COMPRESSION_LEVEL = 1; // Runs on the GUI thread; JSON still shrinks ~5x
+
+    GatewayCaptureWriter() = default;
+    ~GatewayCaptureWriter() { close(); }
+    GatewayCaptureWriter(const GatewayCaptureWriter &) = delete;
+    GatewayCaptureWriter &operator=(const GatewayCaptureWriter &) = delete;
+
+    bool open(const QString &path);
+    bool isOpen() const { return m_file.isOpen(); }
+    void close();
+
+    // timestampNs is monotonic and must not decrease between calls
+    void append(qint64 timestampNs, const QByteArray &frame);
+    // Writes the pending block if FLUSH_INTERVAL_NS has passed since the last
+    // one; same clock as append()
+    void flushIfDue(qint64 timestampNs);
+
+    qint64 frames() const { return m_frames; }
+    qint64 bytesIn() const { return m_bytesIn; }
+    qint64 bytesOut() const { return m_file.isOpen() ? m_file.pos() : m_bytesOut; }
+    QString fileName() const { return m_file.fileName(); }
+
+    // Replace the values of "token" and "*_token" string fields
+    static QByteArray scrub(const QByteArray &frame);
+
+private:
+    bool flushBlock();
+
+    QFile m_file;
+    QByteArray m_block;
+    qint64 m_lastTimestampNs = 0;
+    qint64 m_lastFlushNs = 0;
+    qint64 m_frames = 0;
+    qint64 m_bytesIn = 0;
+    qint64 m_bytesOut = 0;
+};
+
+class GatewayCaptureReader
+{
+public:
+    struct Frame
+    {
+        qint64 timestampNs = 0; // Since the first frame
+        QByteArray payload;
+    };
+
+    static bool isCapture(const QString &path);
+
+    bool open(const QString &path);
+    // Returns false at the end of the capture or on a damaged block
+    bool next(Frame &frame);
+    QString errorString() const { return m_error; }
+
+private:
+    bool readBlock();
+
+    QFile m_file;
+    QByteArray m_block;
+    int m_offset = 0;
+    qint64 m_timestampNs = 0;
+    QString m_error;
+};
@@ -1,15 +1,54 @@
 #include "GatewayClient.h"
 #include "VoiceClient.h"
 #include "DiscordClient.h"
+#include "utils/Metrics.h"
+#include "utils/Trace.h"
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonValue>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QHostAddress>
 #include <QDebug>
 
+namespace
+{
+MetricCounter &s_framesMetric = Metrics::counter("gateway.frames");
+MetricCounter &s_bytesMetric = Metrics::counter("gateway.bytes");
+MetricCounter &s_dispatchesMetric = Metrics::counter("gateway.dispatches");
+MetricCounter &s_disconnectsMetric = Metrics::counter("gateway.disconnects");
+MetricCounter &s_reconnectsMetric = Metrics::counter("gateway.reconnects");
+LatencyHistogram &s_parseMetric = Metrics::histogram("gateway.parse");
+LatencyHistogram &s_frameMetric = Metrics::histogram("gateway.frame"); // Parse plus every handler
+}
+
+static const char *DEFAULT_GATEWAY_URL = "wss://gateway.discord.gg/?v=9&encoding=json";
+
+// CPPCORD_GATEWAY_URL points the app at a local stand-in gateway. IDENTIFY
+// carries the real token, so anything that isn't loopback is ignored.
+static QUrl initialGatewayUrl()
+{
+    if (!qEnvironmentVariableIsSet("CPPCORD_GATEWAY_URL"))
+        return QUrl(DEFAULT_GATEWAY_URL);
+
+    QUrl url(qEnvironmentVariable("CPPCORD_GATEWAY_URL"));
+    QString host = url.host();
+    if (host != QLatin1String("localhost") && !QHostAddress(host).isLoopback())
+    {
+        qWarning() << "Ignoring CPPCORD_GATEWAY_URL, only loopback hosts are allowed:" << host;
+        return QUrl(DEFAULT_GATEWAY_URL);
+    }
+    return url;
+}
+
 GatewayClient::GatewayClient(QObject *parent)
     : QObject(parent),
       m_socket(new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this)),
+      m_gatewayUrl(initialGatewayUrl()),
+      m_captureFlushTimer(new QTimer(this)),
       m_heartbeatTimer(new QTimer(this)),
+      m_heartbeatMonitor("gateway"),
+      m_reconnectTimer(new QTimer(this)),
       m_sequenceNumber(0),
       m_heartbeatInterval(0),
       m_voiceClient(new VoiceClient(this)),
@@ -17,15 +56,34 @@ GatewayClient::GatewayClient(QObject *parent)
 {
     connect(m_socket, &QWebSocket::connected, this, &GatewayClient::onConnected);
     connect(m_socket, &QWebSocket::disconnected, this, &GatewayClient::onDisconnected);
-    connect(m_socket, &QWebSocket::textMessageReceived, this, &GatewayClient::onTextMessageReceived);
+    connect(m_socket, QOverload<QAbstractSocket::SocketError>::of(&QWebSocket::error), this,
+            &GatewayClient::onSocketError);
+    connect(m_socket, &QWebSocket::textMessageReceived, this, &GatewayClient::processTextMessage);
 
     // SSL configuration if needed (usually QWebSocket handles this automatically for wss://)
 
     connect(m_heartbeatTimer, &QTimer::timeout, this, &GatewayClient::sendHeartbeat);
 
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &GatewayClient::attemptReconnect);
+
+    // Frames that arrive and then go quiet still reach the file on time
+    m_captureFlushTimer->setInterval(GatewayCaptureWriter::FLUSH_INTERVAL_NS / 1000000);
+    connect(m_captureFlushTimer, &QTimer::timeout, this,
+            [this]() { m_capture.flushIfDue(m_captureClock.nsecsElapsed()); });
+
+    if (qEnvironmentVariableIsSet("CPPCORD_GATEWAY_CAPTURE"))
+        startCapture(qEnvironmentVariable("CPPCORD_GATEWAY_CAPTURE"));
+
     // Connect voice server update to voice client
     connect(this, &GatewayClient::voiceServerUpdate, this, [this](const QString &token, Snowflake guildId, const QString &endpoint, const QString &sessionId)
             {
+                if (m_offline)
+                {
+                    qDebug() << "Voice server update ignored while offline";
+                    return;
+                }
+
                 qDebug() << "Voice server update received, connecting to voice gateway";
                 qDebug() << "Endpoint:" << endpoint << "Guild:" << guildId << "Session:" << sessionId;
 
@@ -35,21 +93,33 @@ GatewayClient::GatewayClient(QObject *parent)
                 m_voiceClient->connectToVoice(endpoint, token, sessionId, guildId, userId); });
 }
 
+GatewayClient::~GatewayClient()
+{
+    stopCapture();
+}
+
 void GatewayClient::connectToGateway(const QString &token)
 {
     m_token = token;
+    m_reconnecting = false;
+    m_reconnectAttempts = 0;
+    m_reconnectTimer->stop();
+    m_resumeOnHello = false;
     if (m_socket->state() == QAbstractSocket::ConnectedState)
     {
         m_socket->close();
     }
 
-    qDebug() << "Connecting to Discord Gateway...";
+    qDebug() << "Connecting to Discord Gateway..." << m_gatewayUrl.host();
     // Using v9 gateway
-    m_socket->open(QUrl("wss://gateway.discord.gg/?v=9&encoding=json"));
+    m_socket->open(m_gatewayUrl);
 }
 
 void GatewayClient::disconnectFromGateway()
 {
+    m_reconnecting = false;
+    m_reconnectAttempts = 0;
+    m_reconnectTimer->stop();
     m_heartbeatTimer->stop();
     m_socket->close();
 }
@@ -63,15 +133,116 @@ void GatewayClient::onConnected()
 void GatewayClient::onDisconnected()
 {
     qDebug() << "Gateway WebSocket disconnected!";
+    s_disconnectsMetric.add();
     m_heartbeatTimer->stop();
+    m_heartbeatMonitor.resetPending();
     emit disconnected();
+    m_closePending = false;
+
+    // Authentication and intent errors won't go away by retrying
+    int closeCode = m_socket->closeCode();
+    if (m_reconnecting && (closeCode == 4004 || (closeCode >= 4010 && closeCode <= 4014)))
+    {
+        qWarning() << "Gateway closed with" << closeCode << m_socket->closeReason() << "- not reconnecting";
+        m_reconnecting = false;
+    }
+
+    // A failed reconnect may already have rescheduled from onSocketError
+    if (m_reconnecting && !m_reconnectTimer->isActive())
+        scheduleReconnect();
 }
 
-void GatewayClient::onTextMessageReceived(const QString &message)
+void GatewayClient::onSocketError(QAbstractSocket::SocketError error)
+{
+    qWarning() << "Gateway WebSocket error:" << error << m_socket->errorString();
+
+    // A reconnect that never got as far as connecting doesn't emit
+    // disconnected(); schedule the next attempt from here instead
+    if (m_reconnecting && m_socket->state() == QAbstractSocket::UnconnectedState && !m_reconnectTimer->isActive())
+        scheduleReconnect();
+}
+
+void GatewayClient::scheduleReconnect()
+{
+    // The session's resume gateway may be the thing refusing us; after a few
+    // tries give the session up and identify afresh on the default gateway
+    if (m_reconnectAttempts >= MAX_RESUME_ATTEMPTS && !m_sessionId.isEmpty())
+    {
+        qWarning() << "Gateway resume failed after" << m_reconnectAttempts << "attempts, identifying afresh";
+        m_sessionId.clear();
+        m_resumeGatewayUrl = QUrl();
+    }
+
+    // 0, 1, 2, 4, 8 seconds between attempts, then doubling up to MAX_RECONNECT_DELAY_MS
+    int delayMs = m_reconnectAttempts == 0
+                      ? 0
+                      : static_cast<int>(qMin<qint64>(1000LL << qMin(m_reconnectAttempts - 1, 16), MAX_RECONNECT_DELAY_MS));
+    m_reconnectAttempts++;
+    m_resumeOnHello = !m_sessionId.isEmpty();
+    s_reconnectsMetric.add();
+    qDebug() << "Reconnecting to the gateway in" << delayMs << "ms (attempt" << m_reconnectAttempts
+             << "), resume:" << m_resumeOnHello;
+    m_reconnectTimer->start(delayMs);
+}
+
+void GatewayClient::attemptReconnect()
+{
+    // Resumes go to the session's own gateway when READY named one
+    QUrl url = m_resumeOnHello && m_resumeGatewayUrl.isValid() ? m_resumeGatewayUrl : m_gatewayUrl;
+    qDebug() << "Reconnecting to the gateway:" << url.host();
+    m_socket->open(url);
+}
+
+bool GatewayClient::startCapture(const QString &path)
+{
+    if (!m_capture.open(path))
+        return false;
+    m_captureClock.start();
+    m_captureFlushTimer->start();
+    qDebug() << "Recording gateway frames to" << path;
+    return true;
+}
+
+void GatewayClient::stopCapture()
+{
+    if (!m_capture.isOpen())
+        return;
+
+    m_captureFlushTimer->stop();
+    m_capture.close();
+    qDebug() << "Gateway capture" << m_capture.fileName() << "-" << m_capture.frames() << "frames,"
+             << m_capture.bytesIn() << "bytes compressed to" << m_capture.bytesOut();
+}
+
+void GatewayClient::processTextMessage(const QString &message)
 {
     // emit messageReceived(message); // Optional: raw message logging
+    TRACE_SCOPE("gateway", "frame");
+    MetricTimer frameTimer(s_frameMetric);
+
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    QByteArray utf8 = message.toUtf8();
+    if (m_capture.isOpen())
+    {
+        m_capture.append(m_captureClock.nsecsElapsed(), utf8);
+        parseTimer.restart(); // Keep the recording cost out of the parse figures
+    }
+    QJsonDocument doc;
+    {
+        TRACE_SCOPE("gateway", "parse");
+        doc = QJsonDocument::fromJson(utf8);
+    }
+    qint64 parseNs = parseTimer.nsecsElapsed();
+
+    m_frameStats.frames++;
+    m_frameStats.bytes += utf8.size();
+    m_frameStats.parseNsTotal += parseNs;
+    m_frameStats.parseNsMax = qMax(m_frameStats.parseNsMax, parseNs);
+    s_framesMetric.add();
+    s_bytesMetric.add(utf8.size());
+    s_parseMetric.record(parseNs);
 
-    QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8());
     if (doc.isNull() || !doc.isObject())
     {
         qDebug() << "Received invalid JSON from gateway";
@@ -100,20 +271,37 @@ void GatewayClient::handlePayload(const QJsonObject &payload)
         handleHello(payload["d"].toObject());
         break;
     case 11: // Heartbeat ACK
-        // qDebug() << "Heartbeat acknowledged";
+    {
+        int rttMs = m_heartbeatMonitor.ackReceived();
+        if (rttMs >= 0)
+            emit heartbeatRttMeasured(rttMs);
         break;
+    }
     case 1: // Heartbeat requested
-        sendHeartbeat();
+        writeHeartbeat();
         break;
     case 7: // Reconnect
         qDebug() << "Received Reconnect request";
-        m_socket->close(); // Simplistic reconnection strategy: close and let user/logic reconnect
+        reconnectForResume(4000, "Reconnect requested");
         break;
     case 9: // Invalid Session
-        qDebug() << "Invalid Session";
-        // Should verify if resumable, but for now just close
-        m_socket->close();
+    {
+        // d says whether the session can still be resumed; either way the
+        // gateway wants a random 1-5 s wait before the next attempt
+        bool resumable = payload["d"].toBool();
+        qDebug() << "Invalid Session, resumable:" << resumable;
+        if (!resumable)
+            m_sessionId.clear();
+        QTimer::singleShot(QRandomGenerator::global()->bounded(1000, 5000), this, [this]()
+                           {
+            if (m_socket->state() != QAbstractSocket::ConnectedState)
+                return;
+            if (m_sessionId.isEmpty())
+                sendIdentify();
+            else
+                sendResume(); });
         break;
+    }
     default:
         // qDebug() << "Unhandled OpCode:" << op;
         break;
@@ -134,8 +322,28 @@ void GatewayClient::handleHello(const QJsonObject &data)
     // Actually, you can identify immediately.
     // But you MUST heartbeat periodically.
 
-    // Let's send Identify now.
-    sendIdentify();
+    // Let's send Identify now (or Resume after a dropped connection).
+    if (m_resumeOnHello && !m_sessionId.isEmpty())
+        sendResume();
+    else
+        sendIdentify();
+    m_resumeOnHello = false;
+}
+
+void GatewayClient::sendResume()
+{
+    qDebug() << "Resuming gateway session" << m_sessionId << "at sequence" << m_sequenceNumber;
+
+    QJsonObject data;
+    data["token"] = m_token;
+    data["session_id"] = m_sessionId;
+    data["seq"] = m_sequenceNumber;
+
+    QJsonObject payload;
+    payload["op"] = 6; // Resume
+    payload["d"] = data;
+
+    m_socket->sendTextMessage(QJsonDocument(payload).toJson(QJsonDocument::Compact));
 }
 
 void GatewayClient::sendIdentify()
@@ -173,6 +381,42 @@ void GatewayClient::sendIdentify()
 
 void GatewayClient::sendHeartbeat()
 {
+    // No ACK since the previous heartbeat: the socket looks open but the
+    // connection is dead. Close with a non-1000 code so the session stays
+    // resumable, and reconnect once the close completes.
+    if (m_heartbeatMonitor.awaitingAck())
+    {
+        qWarning() << "Gateway heartbeat was not acknowledged, reconnecting";
+        m_heartbeatMonitor.recordZombie();
+        reconnectForResume(4000, "Heartbeat ACK timeout");
+        return;
+    }
+
+    writeHeartbeat();
+}
+
+void GatewayClient::reconnectForResume(int closeCode, const QString &reason)
+{
+    // A non-1000 close keeps the session resumable; onDisconnected reopens
+    // the socket and Hello sends Resume. A dead peer never answers the close
+    // handshake, so abort if it hasn't completed in time (but leave alone a
+    // reconnect that is already under way by then).
+    m_heartbeatTimer->stop();
+    m_reconnecting = true;
+    m_closePending = true;
+    m_socket->close(static_cast<QWebSocketProtocol::CloseCode>(closeCode), reason);
+    QTimer::singleShot(CLOSE_TIMEOUT_MS, this, [this]()
+                       {
+        if (m_closePending && m_socket->state() != QAbstractSocket::UnconnectedState)
+            m_socket->abort(); });
+}
+
+void GatewayClient::writeHeartbeat()
+{
+    // A heartbeat the gateway asked for shouldn't restart an outstanding one's clock
+    if (!m_heartbeatMonitor.awaitingAck())
+        m_heartbeatMonitor.heartbeatSent();
+
     QJsonObject payload;
     payload["op"] = 1;
     if (m_sequenceNumber == 0)
@@ -187,6 +431,7 @@ void GatewayClient::handleDispatch(const QJsonObject &payload)
 {
     QString eventName = payload["t"].toString();
     QJsonObject data = payload["d"].toObject();
+    s_dispatchesMetric.add();
 
     // Always emit the raw event for DiscordClient to process
     emit eventReceived(eventName, data);
@@ -195,6 +440,12 @@ void GatewayClient::handleDispatch(const QJsonObject &payload)
     {
         handleReady(data);
     }
+    else if (eventName == "RESUMED")
+    {
+        qDebug() << "Gateway session resumed after" << m_reconnectAttempts << "attempts";
+        m_reconnecting = false;
+        m_reconnectAttempts = 0;
+    }
     else if (eventName == "VOICE_STATE_UPDATE")
     {
         qDebug() << "VOICE_STATE_UPDATE raw data:" << QJsonDocument(data).toJson(QJsonDocument::Compact);
@@ -275,6 +526,15 @@ void GatewayClient::handleDispatch(const QJsonObject &payload)
 void GatewayClient::handleReady(const QJsonObject &data)
 {
     m_sessionId = data["session_id"].toString();
+    m_reconnecting = false;
+    m_reconnectAttempts = 0;
+
+    // Bare host; the version and encoding query carries over
+    QString resumeUrl = data["resume_gateway_url"].toString();
+    m_resumeGatewayUrl = resumeUrl.isEmpty() ? QUrl() : QUrl(resumeUrl);
+    if (m_resumeGatewayUrl.isValid())
+        m_resumeGatewayUrl.setQuery(m_gatewayUrl.query());
+
     QString username = data["user"].toObject()["username"].toString();
     qDebug() << "Gateway READY! Session ID:" << m_sessionId << "Logged in as:" << username;
 }
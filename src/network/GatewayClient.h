@@ -2,19 +2,58 @@
 #include <QObject>
 #include <QWebSocket>
 #include <QTimer>
+#include <QUrl>
+#include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include "Types.h"
+#include "GatewayCapture.h"
+#include "HeartbeatMonitor.h"
 class VoiceClient;
 class DiscordClient;
 class GatewayClient : public QObject
 {
     Q_OBJECT
 public:
+    // Cost of decoding incoming frames, for load testing
+    struct FrameStats
+    {
+        qint64 frames = 0;
+        qint64 bytes = 0;
+        qint64 parseNsTotal = 0;
+        qint64 parseNsMax = 0;
+    };
+
     explicit GatewayClient(QObject *parent = nullptr);
+    ~GatewayClient() override;
 
     void connectToGateway(const QString &token);
     void disconnectFromGateway();
+    bool isConnected() const { return m_socket->state() == QAbstractSocket::ConnectedState; }
+
+    // Defaults to Discord's gateway, or CPPCORD_GATEWAY_URL when it names a
+    // loopback host (a local stand-in gateway)
+    void setGatewayUrl(const QUrl &url) { m_gatewayUrl = url; }
+    QUrl gatewayUrl() const { return m_gatewayUrl; }
+
+    FrameStats frameStats() const { return m_frameStats; }
+    void resetFrameStats() { m_frameStats = FrameStats(); }
+
+    // Record every received frame to a capture file (see GatewayCapture.h).
+    // Off by default; CPPCORD_GATEWAY_CAPTURE=<path> turns it on at startup.
+    bool startCapture(const QString &path);
+    void stopCapture();
+    bool isCapturing() const { return m_capture.isOpen(); }
+
+    // Handle one raw frame as if it had arrived on the socket, for replay
+    void processTextMessage(const QString &message);
+
+    // Offline (replay): VOICE_SERVER_UPDATE no longer connects to voice
+    void setOffline(bool offline) { m_offline = offline; }
+    bool isOffline() const { return m_offline; }
+
+    // Heartbeat round trips over the last few heartbeats
+    HeartbeatMonitor::Summary heartbeatSummary() const { return m_heartbeatMonitor.summary(); }
 
     // Voice operations
     void joinVoiceChannel(Snowflake guildId, Snowflake channelId, bool mute = false, bool deaf = false);
@@ -28,6 +67,7 @@ signals:
     void messageReceived(const QString &message); // Kept for debug log
     void logMessage(const QString &msg);
     void eventReceived(const QString &eventName, const QJsonObject &data);
+    void heartbeatRttMeasured(int rttMs);
 
     // Voice signals
     void voiceStateUpdate(const QJsonObject &data);
@@ -41,12 +81,32 @@ signals:
 private slots:
     void onConnected();
     void onDisconnected();
-    void onTextMessageReceived(const QString &message);
-    void sendHeartbeat();
+    void onSocketError(QAbstractSocket::SocketError error);
+    void sendHeartbeat(); // Scheduled; drops a zombied connection instead
+    void attemptReconnect();
 
 private:
+    void scheduleReconnect();
+
+    static constexpr int MAX_RESUME_ATTEMPTS = 5; // Then identify afresh on m_gatewayUrl
+    static constexpr int MAX_RECONNECT_DELAY_MS = 30000;
+    static constexpr int CLOSE_TIMEOUT_MS = 3000; // A dead peer never answers the close handshake
+
     QWebSocket *m_socket;
+    QUrl m_gatewayUrl;
+    QUrl m_resumeGatewayUrl; // From READY; where a resumed session reconnects
+    FrameStats m_frameStats;
+    GatewayCaptureWriter m_capture;
+    QElapsedTimer m_captureClock;
+    QTimer *m_captureFlushTimer;
     QTimer *m_heartbeatTimer;
+    HeartbeatMonitor m_heartbeatMonitor;
+    QTimer *m_reconnectTimer;
+    int m_reconnectAttempts = 0;
+    bool m_reconnecting = false;  // Keep reopening the socket until READY or RESUMED
+    bool m_closePending = false;  // Our close handshake hasn't completed yet
+    bool m_resumeOnHello = false; // Resume the session instead of identifying
+    bool m_offline = false;
     QString m_token;
     int m_sequenceNumber;
     int m_heartbeatInterval;
@@ -68,4 +128,7 @@ private:
     void sendVoiceStateUpdate(Snowflake guildId, Snowflake channelId, bool mute, bool deaf);
 
     void sendIdentify();
+    void sendResume();
+    void reconnectForResume(int closeCode, const QString &reason);
+    void writeHeartbeat();
 };
@@ -0,0 +1,70 @@
+#include "HeartbeatMonitor.h"
+#include "utils/Metrics.h"
+#include <algorithm>
+
+HeartbeatMonitor::HeartbeatMonitor(const QString &metricPrefix)
+    : m_histogram(Metrics::histogram(metricPrefix + ".heartbeat_rtt")),
+      m_lastRttGauge(Metrics::gauge(metricPrefix + ".heartbeat_rtt_ms")),
+      m_zombieCounter(Metrics::counter(metricPrefix + ".zombie_connections"))
+{
+    m_samples.reserve(WINDOW);
+}
+
+void HeartbeatMonitor::recordZombie()
+{
+    m_zombieCounter.add();
+    m_sentTimer.invalidate();
+}
+
+int HeartbeatMonitor::ackReceived()
+{
+    if (!m_sentTimer.isValid())
+        return -1;
+
+    const qint64 rttNs = m_sentTimer.nsecsElapsed();
+    m_sentTimer.invalidate();
+    m_histogram.record(rttNs);
+
+    const int rttMs = static_cast<int>(rttNs / 1000000);
+    m_lastRttGauge.set(rttMs);
+    if (m_samples.size() < WINDOW)
+    {
+        m_samples.append(rttMs);
+    }
+    else
+    {
+        m_samples[m_nextSample] = rttMs;
+    }
+    m_nextSample = (m_nextSample + 1) % WINDOW;
+    return rttMs;
+}
+
+int HeartbeatMonitor::recentMedianMs() const
+{
+    const int count = qMin<int>(RECENT, m_samples.size());
+    if (count == 0)
+        return -1;
+
+    int recent[RECENT];
+    for (int i = 0; i < count; ++i)
+        recent[i] = m_samples.at((m_nextSample + WINDOW - 1 - i) % WINDOW);
+    std::sort(recent, recent + count);
+    return recent[count / 2];
+}
+
+HeartbeatMonitor::Summary HeartbeatMonitor::summary() const
+{
+    Summary summary;
+    summary.samples = m_samples.size();
+    if (m_samples.isEmpty())
+        return summary;
+
+    summary.lastMs = m_samples.at((m_nextSample + WINDOW - 1) % WINDOW);
+
+    QVector<int> sorted = m_samples;
+    std::sort(sorted.begin(), sorted.end());
+    summary.medianMs = sorted.at(sorted.size() / 2);
+    summary.p90Ms = sorted.at(qMin<int>(sorted.size() - 1, sorted.size() * 9 / 10));
+    summary.maxMs = sorted.last();
+    return summary;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+class LatencyHistogram;
+class MetricGauge;
+class MetricCounter;
+
+// Heartbeat round trips for one websocket session (gateway or voice).
+//
+// Each ACK yields an RTT sample, kept in a rolling window for the UI and
+// encoder and also recorded in the metrics registry as
+// "<prefix>.heartbeat_rtt". A heartbeat that comes due while the previous
+// one is still unacknowledged means the connection is zombied: the socket
+// may look open, but nothing is getting through.
+class HeartbeatMonitor
+{
+public:
+    static constexpr int WINDOW = 16;
+    static constexpr int RECENT = 3;
+
+    struct Summary
+    {
+        int samples = 0;
+        int lastMs = -1;
+        int medianMs = -1;
+        int p90Ms = -1;
+        int maxMs = -1;
+    };
+
+    explicit HeartbeatMonitor(const QString &metricPrefix);
+
+    // True while a heartbeat is unacknowledged. Checked before a scheduled
+    // heartbeat, true means the connection is zombied and should be dropped
+    // (then call recordZombie()).
+    bool awaitingAck() const { return m_sentTimer.isValid(); }
+    void recordZombie();
+
+    void heartbeatSent() { m_sentTimer.start(); }
+    // Returns the round trip in ms, or -1 for an ACK with nothing outstanding
+    int ackReceived();
+
+    // Forget the outstanding heartbeat, e.g. when the socket closes. The
+    // RTT window is kept across reconnects.
+    void resetPending() { m_sentTimer.invalidate(); }
+
+    Summary summary() const;
+
+    // Median of the last RECENT samples, or -1: follows a real change within
+    // a couple of heartbeats but ignores a single late ACK
+    int recentMedianMs() const;
+
+private:
+    QElapsedTimer m_sentTimer; // Valid while a heartbeat is unacknowledged
+    QVector<int> m_samples;    // Ring of the last WINDOW RTTs in ms
+    int m_nextSample = 0;
+    LatencyHistogram &m_histogram;
+    MetricGauge &m_lastRttGauge;
+    MetricCounter &m_zombieCounter;
+};
@@ -0,0 +1,101 @@
+#include "RtpPacket.h"
+#include <QtEndian>
+
+VoiceDatagramType classifyVoiceDatagram(const uchar *data, int size)
+{
+    if (size < 2)
+        return VoiceDatagramType::Invalid;
+
+    // IP discovery response: type 0x0002, length 70, 74 bytes total
+    if (size == 74 && data[0] == 0x00 && data[1] == 0x02 &&
+        qFromBigEndian<quint16>(data + 2) == 70)
+    {
+        return VoiceDatagramType::IpDiscovery;
+    }
+
+    if ((data[0] >> 6) != 2)
+        return VoiceDatagramType::Invalid;
+
+    // RTCP packet types 200-204 occupy the whole second byte; for RTP that
+    // range would be marker bit + payload types 72-76, which are reserved
+    // precisely so the two can be told apart (RFC 5761)
+    if (data[1] >= 200 && data[1] <= 204)
+        return VoiceDatagramType::Rtcp;
+
+    return VoiceDatagramType::Rtp;
+}
+
+bool RtpPacketView::parse(const uchar *packet, int packetSize)
+{
+    if (packetSize < FIXED_HEADER_SIZE || (packet[0] >> 6) != 2)
+        return false;
+
+    data = packet;
+    size = packetSize;
+
+    csrcCount = packet[0] & 0x0F;
+    hasExtension = (packet[0] & 0x10) != 0;
+    marker = (packet[1] & 0x80) != 0;
+    payloadType = packet[1] & 0x7F;
+    sequence = qFromBigEndian<quint16>(packet + 2);
+    timestamp = qFromBigEndian<quint32>(packet + 4);
+    ssrc = qFromBigEndian<quint32>(packet + 8);
+
+    headerSize = FIXED_HEADER_SIZE + csrcCount * 4;
+    extensionDataSize = 0;
+
+    if (hasExtension)
+    {
+        if (packetSize < headerSize + 4)
+            return false;
+
+        // Extension length is in 32-bit words and excludes the 4-byte header
+        extensionDataSize = qFromBigEndian<quint16>(packet + headerSize + 2) * 4;
+        headerSize += 4;
+    }
+
+    return packetSize >= headerSize;
+}
+
+bool RtcpPacketView::parse(const uchar *packet, int packetSize)
+{
+    if (packetSize < HEADER_SIZE || (packet[0] >> 6) != 2)
+        return false;
+
+    data = packet;
+    size = packetSize;
+    reportCount = packet[0] & 0x1F;
+    packetType = packet[1];
+    senderSsrc = qFromBigEndian<quint32>(packet + 4);
+    return true;
+}
+
+int RtcpPacketView::reportBlockCount(int bodySize) const
+{
+    // Sender reports carry 20 bytes of sender info before the blocks
+    int offset = packetType == SENDER_REPORT ? 20 : 0;
+    if (packetType != SENDER_REPORT && packetType != RECEIVER_REPORT)
+        return 0;
+
+    int available = (bodySize - offset) / 24;
+    return qBound(0, available, reportCount);
+}
+
+RtcpReportBlock RtcpPacketView::reportBlock(const uchar *body, quint8 packetType, int index)
+{
+    const uchar *block = body + (packetType == SENDER_REPORT ? 20 : 0) + index * 24;
+
+    RtcpReportBlock report;
+    report.ssrc = qFromBigEndian<quint32>(block);
+    report.fractionLost = block[4];
+
+    // 24-bit signed cumulative loss
+    qint32 lost = (block[5] << 16) | (block[6] << 8) | block[7];
+    if (lost & 0x800000)
+        lost |= ~0xFFFFFF;
+    report.cumulativeLost = lost;
+
+    report.extendedHighestSequence = qFromBigEndian<quint32>(block + 8);
+    report.jitter = qFromBigEndian<quint32>(block + 12);
+    return report;
+}
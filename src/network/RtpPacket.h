@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Zero-copy views over received voice datagrams.
+//
+// Each view validates the datagram once in parse() and records header
+// fields and offsets; the payload is never copied. The views point into the
+// caller's buffer and are only valid as long as that buffer is.
+
+enum class VoiceDatagramType
+{
+    Invalid,
+    IpDiscovery,
+    Rtp,
+    Rtcp
+};
+
+VoiceDatagramType classifyVoiceDatagram(const uchar *data, int size);
+
+struct RtpPacketView
+{
+    static constexpr int FIXED_HEADER_SIZE = 12;
+
+    const uchar *data = nullptr;
+    int size = 0;
+
+    quint8 payloadType = 0;
+    bool marker = false;
+    bool hasExtension = false;
+    int csrcCount = 0;
+    quint16 sequence = 0;
+    quint32 timestamp = 0;
+    quint32 ssrc = 0;
+
+    // Fixed header + CSRCs + the 4-byte extension header if present. In the
+    // rtpsize AEAD modes this is the additional authenticated data; the
+    // extension body is encrypted together with the payload.
+    int headerSize = 0;
+    int extensionDataSize = 0;
+
+    bool parse(const uchar *packet, int packetSize);
+
+    const uchar *payload() const { return data + headerSize; }
+    int payloadSize() const { return size - headerSize; }
+};
+
+struct RtcpReportBlock
+{
+    quint32 ssrc = 0;
+    quint8 fractionLost = 0; // Loss since the previous report, in 1/256 units
+    qint32 cumulativeLost = 0;
+    quint32 extendedHighestSequence = 0;
+    quint32 jitter = 0; // In RTP timestamp units
+};
+
+struct RtcpPacketView
+{
+    static constexpr int HEADER_SIZE = 8; // Common header + sender SSRC
+    static constexpr quint8 SENDER_REPORT = 200;
+    static constexpr quint8 RECEIVER_REPORT = 201;
+
+    const uchar *data = nullptr;
+    int size = 0;
+
+    quint8 packetType = 0;
+    int reportCount = 0;
+    quint32 senderSsrc = 0;
+
+    bool parse(const uchar *packet, int packetSize);
+
+    // Report blocks of a sender or receiver report (body must be plaintext)
+    int reportBlockCount(int bodySize) const;
+    static RtcpReportBlock reportBlock(const uchar *body, quint8 packetType, int index);
+};
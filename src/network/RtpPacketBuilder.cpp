@@ -0,0 +1,61 @@
+#include "RtpPacketBuilder.h"
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+
+void RtpPacketBuilder::setSession(const VoiceCipher *cipher, quint32 ssrc)
+{
+    m_cipher = cipher;
+    m_ssrc = ssrc;
+    m_nonce = 0;
+}
+
+void RtpPacketBuilder::reset()
+{
+    m_cipher = nullptr;
+    m_ssrc = 0;
+    m_nonce = 0;
+}
+
+int RtpPacketBuilder::build(const char *payload, int payloadSize, quint16 sequence, quint32 timestamp)
+{
+    if (!isReady())
+    {
+        qWarning() << "Cannot encrypt: secret key or mode not set";
+        return -1;
+    }
+
+    if (payloadSize < 0 || payloadSize > MAX_PAYLOAD_SIZE)
+    {
+        qWarning() << "Invalid voice payload size:" << payloadSize;
+        return -1;
+    }
+
+    // RTP header: version 2, no padding/extension/CSRC, payload type 120 (Opus)
+    unsigned char *header = m_buffer;
+    header[0] = 0x80;
+    header[1] = 0x78;
+    qToBigEndian(sequence, header + 2);
+    qToBigEndian(timestamp, header + 4);
+    qToBigEndian(m_ssrc, header + 8);
+
+    unsigned char *ciphertext = m_buffer + RTP_HEADER_SIZE;
+    unsigned char *tag = ciphertext + payloadSize;
+    unsigned char *nonceSuffix = tag + TAG_SIZE;
+    const unsigned char *plaintext = reinterpret_cast<const unsigned char *>(payload);
+
+    // Nonce: 4-byte big-endian counter followed by zero padding; the counter
+    // is appended to the packet so the receiver can rebuild it
+    m_nonce++;
+    unsigned char nonce[VoiceCipher::NONCE_SIZE] = {};
+    qToBigEndian(m_nonce, nonce);
+
+    if (m_cipher->encrypt(ciphertext, tag, plaintext, payloadSize, header, RTP_HEADER_SIZE, nonce) != 0)
+    {
+        qWarning() << "Voice packet encryption failed";
+        return -1;
+    }
+
+    std::memcpy(nonceSuffix, nonce, NONCE_SUFFIX_SIZE);
+    return RTP_HEADER_SIZE + payloadSize + TAG_SIZE + NONCE_SUFFIX_SIZE;
+}
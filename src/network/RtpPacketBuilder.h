@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QByteArray>
+#include "audio/OpusCodec.h"
+#include "VoiceCipher.h"
+
+// Builds encrypted RTP voice packets in a single reusable datagram buffer.
+//
+// Layout for the rtpsize AEAD modes:
+//   [12-byte RTP header][ciphertext][16-byte tag][4-byte nonce suffix]
+// The header is written in place, the cipher writes straight from the Opus
+// frame into the payload region, and the tag and nonce follow it. Nothing is
+// allocated per packet.
+class RtpPacketBuilder
+{
+public:
+    static constexpr int RTP_HEADER_SIZE = 12;
+    static constexpr int TAG_SIZE = 16;
+    static constexpr int NONCE_SUFFIX_SIZE = 4;
+    static constexpr int MAX_PAYLOAD_SIZE = OPUS_MAX_PACKET_SIZE;
+    static constexpr int MAX_DATAGRAM_SIZE = RTP_HEADER_SIZE + MAX_PAYLOAD_SIZE + TAG_SIZE + NONCE_SUFFIX_SIZE;
+
+    // The cipher is owned by the caller and shared with the receive path
+    void setSession(const VoiceCipher *cipher, quint32 ssrc);
+    void reset();
+    bool isReady() const { return m_cipher && m_cipher->isReady(); }
+
+    // Build and encrypt one packet. Returns the datagram size, or -1 on failure.
+    int build(const char *payload, int payloadSize, quint16 sequence, quint32 timestamp);
+
+    const char *data() const { return reinterpret_cast<const char *>(m_buffer); }
+
+private:
+    const VoiceCipher *m_cipher = nullptr;
+    quint32 m_ssrc = 0;
+    quint32 m_nonce = 0; // Incremental nonce, sent as the 4-byte suffix
+
+    alignas(16) unsigned char m_buffer[MAX_DATAGRAM_SIZE];
+};
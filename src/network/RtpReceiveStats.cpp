@@ -0,0 +1,145 @@
+#include "RtpReceiveStats.h"
+#include <cmath>
+
+void RtpReceiveStats::initSequence(Source &source, quint16 sequence)
+{
+    source.baseSeq = sequence;
+    source.maxSeq = sequence;
+    source.badSeq = SEQ_MOD + 1;
+    source.cycles = 0;
+    source.received = 0;
+    source.receivedPrior = 0;
+    source.expectedPrior = 0;
+}
+
+bool RtpReceiveStats::updateSequence(Source &source, quint16 sequence)
+{
+    quint16 delta = static_cast<quint16>(sequence - source.maxSeq);
+
+    // New sources are only trusted after MIN_SEQUENTIAL in-order packets
+    if (source.probation > 0)
+    {
+        if (sequence == static_cast<quint16>(source.maxSeq + 1))
+        {
+            source.probation--;
+            source.maxSeq = sequence;
+            if (source.probation == 0)
+            {
+                initSequence(source, sequence);
+                source.received++;
+                return true;
+            }
+        }
+        else
+        {
+            source.probation = MIN_SEQUENTIAL - 1;
+            source.maxSeq = sequence;
+        }
+        return false;
+    }
+
+    if (delta < MAX_DROPOUT)
+    {
+        // In order, possibly with a gap
+        if (sequence < source.maxSeq)
+        {
+            source.cycles += SEQ_MOD;
+        }
+        source.maxSeq = sequence;
+    }
+    else if (delta <= SEQ_MOD - MAX_MISORDER)
+    {
+        // Very large jump: accept it only if the next packet confirms it
+        if (sequence == source.badSeq)
+        {
+            initSequence(source, sequence);
+        }
+        else
+        {
+            source.badSeq = (sequence + 1) & (SEQ_MOD - 1);
+            return false;
+        }
+    }
+    // Otherwise a duplicate or reordered packet
+
+    source.received++;
+    return true;
+}
+
+void RtpReceiveStats::update(quint32 ssrc, quint16 sequence, quint32 rtpTimestamp, qint64 arrivalNs)
+{
+    auto it = m_sources.find(ssrc);
+    if (it == m_sources.end())
+    {
+        Source source;
+        initSequence(source, sequence);
+        source.maxSeq = static_cast<quint16>(sequence - 1);
+        it = m_sources.insert(ssrc, source);
+    }
+
+    Source &source = it.value();
+    if (!updateSequence(source, sequence))
+        return;
+
+    // Interarrival jitter: J += (|D| - J) / 16, with transit in timestamp units
+    qint64 arrival = arrivalNs * CLOCK_RATE / 1000000000LL;
+    qint64 transit = arrival - static_cast<qint64>(rtpTimestamp);
+    if (source.haveTransit)
+    {
+        qint64 d = transit - source.transit;
+        // Timestamps are 32-bit; fold wraparound back into range
+        d = static_cast<qint32>(static_cast<quint32>(d));
+        source.jitter += (std::abs(static_cast<double>(d)) - source.jitter) / 16.0;
+    }
+    source.transit = transit;
+    source.haveTransit = true;
+}
+
+RtpReceiveStats::Report RtpReceiveStats::report(quint32 ssrc)
+{
+    Report report;
+    report.ssrc = ssrc;
+
+    auto it = m_sources.find(ssrc);
+    if (it == m_sources.end() || it->probation > 0)
+        return report;
+
+    Source &source = it.value();
+    fillCumulative(source, report);
+    const qint64 expected = report.expected;
+
+    quint32 expectedInterval = static_cast<quint32>(expected) - source.expectedPrior;
+    quint32 receivedInterval = source.received - source.receivedPrior;
+    source.expectedPrior = static_cast<quint32>(expected);
+    source.receivedPrior = source.received;
+
+    qint64 lostInterval = static_cast<qint64>(expectedInterval) - receivedInterval;
+    if (expectedInterval > 0 && lostInterval > 0)
+    {
+        report.intervalLossFraction = static_cast<double>(lostInterval) / expectedInterval;
+    }
+    return report;
+}
+
+RtpReceiveStats::Report RtpReceiveStats::cumulativeReport(quint32 ssrc) const
+{
+    Report report;
+    report.ssrc = ssrc;
+
+    auto it = m_sources.constFind(ssrc);
+    if (it != m_sources.constEnd() && it->probation <= 0)
+        fillCumulative(it.value(), report);
+    return report;
+}
+
+void RtpReceiveStats::fillCumulative(const Source &source, Report &report)
+{
+    quint32 extendedMax = source.cycles + source.maxSeq;
+    qint64 expected = static_cast<qint64>(extendedMax) - source.baseSeq + 1;
+
+    report.extendedHighestSequence = extendedMax;
+    report.expected = expected;
+    report.received = source.received;
+    report.cumulativeLost = expected - source.received;
+    report.jitterMs = source.jitter * 1000.0 / CLOCK_RATE;
+}
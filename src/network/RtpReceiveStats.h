@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+
+// RFC 3550 receiver statistics, kept per SSRC.
+//
+// Sequence numbers are extended to 32 bits across wraparound (appendix A.1,
+// including the probation and large-jump resync rules) and interarrival
+// jitter is estimated as in appendix A.8. report() returns loss over the
+// interval since the previous report as well as cumulative figures.
+class RtpReceiveStats
+{
+public:
+    static constexpr int CLOCK_RATE = 48000;
+
+    struct Report
+    {
+        quint32 ssrc = 0;
+        quint32 extendedHighestSequence = 0;
+        qint64 expected = 0;
+        qint64 received = 0;
+        qint64 cumulativeLost = 0;
+        double intervalLossFraction = 0.0;
+        double jitterMs = 0.0;
+    };
+
+    void update(quint32 ssrc, quint16 sequence, quint32 rtpTimestamp, qint64 arrivalNs);
+    Report report(quint32 ssrc);
+    // Cumulative figures only; doesn't start a new report interval
+    Report cumulativeReport(quint32 ssrc) const;
+    QList<quint32> sources() const { return m_sources.keys(); }
+    void remove(quint32 ssrc) { m_sources.remove(ssrc); }
+    void clear() { m_sources.clear(); }
+
+private:
+    static constexpr quint32 MAX_DROPOUT = 3000;
+    static constexpr quint32 MAX_MISORDER = 100;
+    static constexpr int MIN_SEQUENTIAL = 2;
+    static constexpr quint32 SEQ_MOD = 1u << 16;
+
+    struct Source
+    {
+        quint16 maxSeq = 0;
+        quint32 cycles = 0;
+        quint32 baseSeq = 0;
+        quint32 badSeq = SEQ_MOD + 1;
+        int probation = MIN_SEQUENTIAL;
+        quint32 received = 0;
+        quint32 expectedPrior = 0;
+        quint32 receivedPrior = 0;
+        qint64 transit = 0;
+        bool haveTransit = false;
+        double jitter = 0.0; // In timestamp units
+    };
+
+    static void initSequence(Source &source, quint16 sequence);
+    static bool updateSequence(Source &source, quint16 sequence);
+    static void fillCumulative(const Source &source, Report &report);
+
+    QHash<quint32, Source> m_sources;
+};
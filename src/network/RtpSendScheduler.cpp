@@ -0,0 +1,182 @@
+#include "RtpSendScheduler.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstdlib>
+
+RtpSendScheduler::RtpSendScheduler(QObject *parent)
+    : QObject(parent),
+      m_timer(new QTimer(this)),
+      m_silenceFrame("\xF8\xFF\xFE", 3) // Opus silence frame
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    m_intervalDeviationUs.reserve(JITTER_HISTORY);
+
+    connect(m_timer, &QTimer::timeout, this, &RtpSendScheduler::onTick);
+}
+
+void RtpSendScheduler::start(quint32 initialTimestamp)
+{
+    stop();
+
+    m_timestampBase = initialTimestamp;
+    m_nextSlot = 0;
+    m_lastSendNs = -1;
+    m_lastSendSlot = -1;
+    m_intervalDeviationUs.clear();
+    m_deviationWritePos = 0;
+    m_clock.start();
+}
+
+void RtpSendScheduler::stop()
+{
+    m_timer->stop();
+    m_clock.invalidate();
+
+    for (QByteArray &frame : m_queue)
+    {
+        frame = QByteArray();
+    }
+    m_queueHead = 0;
+    m_queueCount = 0;
+    m_pendingSilence = 0;
+}
+
+void RtpSendScheduler::enqueue(const QByteArray &opus)
+{
+    if (!isRunning())
+        return;
+
+    if (m_queueCount == MAX_QUEUED_FRAMES)
+    {
+        // Capture is running ahead of the send clock; keep latency bounded
+        m_queueHead = (m_queueHead + 1) % MAX_QUEUED_FRAMES;
+        m_queueCount--;
+    }
+
+    m_queue[(m_queueHead + m_queueCount) % MAX_QUEUED_FRAMES] = opus;
+    m_queueCount++;
+    m_pendingSilence = 0; // Speech resumed before the trailing silence went out
+
+    if (!m_timer->isActive())
+    {
+        // Resume on the current slot; idle slots still advanced the timestamp
+        m_nextSlot = std::max(m_nextSlot, m_clock.nsecsElapsed() / FRAME_INTERVAL_NS);
+        onTick();
+    }
+}
+
+void RtpSendScheduler::endOfSpeech()
+{
+    if (!isRunning())
+        return;
+
+    m_pendingSilence = SILENCE_FRAME_COUNT;
+    if (!m_timer->isActive())
+    {
+        m_nextSlot = std::max(m_nextSlot, m_clock.nsecsElapsed() / FRAME_INTERVAL_NS);
+        onTick();
+    }
+}
+
+void RtpSendScheduler::onTick()
+{
+    if (!isRunning())
+        return;
+
+    qint64 nowNs = m_clock.nsecsElapsed();
+    qint64 currentSlot = nowNs / FRAME_INTERVAL_NS;
+
+    // If the event loop stalled, don't burst out every missed slot
+    if (currentSlot - m_nextSlot > MAX_CATCH_UP_SLOTS)
+    {
+        m_nextSlot = currentSlot - MAX_CATCH_UP_SLOTS;
+    }
+
+    bool sentAny = false;
+    while (m_nextSlot <= currentSlot && (m_queueCount > 0 || m_pendingSilence > 0))
+    {
+        quint32 timestamp = m_timestampBase + static_cast<quint32>(m_nextSlot) * SAMPLES_PER_FRAME;
+
+        if (m_queueCount > 0)
+        {
+            QByteArray frame = m_queue[m_queueHead];
+            m_queue[m_queueHead] = QByteArray(); // Release the pooled encoder buffer
+            m_queueHead = (m_queueHead + 1) % MAX_QUEUED_FRAMES;
+            m_queueCount--;
+            emit frameDue(frame, timestamp);
+        }
+        else
+        {
+            m_pendingSilence--;
+            emit frameDue(m_silenceFrame, timestamp);
+        }
+
+        recordSendTime(nowNs);
+        m_nextSlot++;
+        sentAny = true;
+    }
+
+    if (sentAny)
+    {
+        emit burstFinished();
+    }
+
+    scheduleNextTick();
+}
+
+void RtpSendScheduler::scheduleNextTick()
+{
+    if (m_queueCount == 0 && m_pendingSilence == 0)
+        return; // Idle until the next frame is queued
+
+    qint64 untilNextNs = m_nextSlot * FRAME_INTERVAL_NS - m_clock.nsecsElapsed();
+    int untilNextMs = static_cast<int>(std::max<qint64>(0, (untilNextNs + 999999) / 1000000));
+    m_timer->start(untilNextMs);
+}
+
+void RtpSendScheduler::recordSendTime(qint64 nowNs)
+{
+    // Only consecutive slots measure pacing; gaps after silence are expected
+    if (m_lastSendSlot == m_nextSlot - 1 && m_lastSendNs >= 0)
+    {
+        qint64 deviationUs = std::llabs(nowNs - m_lastSendNs - FRAME_INTERVAL_NS) / 1000;
+        qint32 sample = static_cast<qint32>(std::min<qint64>(deviationUs, INT32_MAX));
+
+        if (m_intervalDeviationUs.size() < JITTER_HISTORY)
+        {
+            m_intervalDeviationUs.append(sample);
+        }
+        else
+        {
+            m_intervalDeviationUs[m_deviationWritePos] = sample;
+            m_deviationWritePos = (m_deviationWritePos + 1) % JITTER_HISTORY;
+        }
+    }
+
+    m_lastSendNs = nowNs;
+    m_lastSendSlot = m_nextSlot;
+}
+
+RtpSendScheduler::JitterStats RtpSendScheduler::jitterStats() const
+{
+    JitterStats stats;
+    if (m_intervalDeviationUs.isEmpty())
+        return stats;
+
+    QVector<qint32> sorted = m_intervalDeviationUs;
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&sorted](double p)
+    {
+        int index = static_cast<int>(p * (sorted.size() - 1) + 0.5);
+        return static_cast<double>(sorted[index]);
+    };
+
+    stats.samples = sorted.size();
+    stats.p50Us = percentile(0.50);
+    stats.p95Us = percentile(0.95);
+    stats.p99Us = percentile(0.99);
+    stats.maxUs = sorted.last();
+    return stats;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QVector>
+
+// Paces outgoing voice frames on a monotonic 20ms clock.
+//
+// Capture delivers frames in bursts whenever the audio backend signals
+// readyRead, so frames are queued here and released one per 20ms slot. The
+// RTP timestamp is derived from the slot index rather than counted per frame,
+// so it keeps tracking the sample clock across suppressed silence. When speech
+// ends, five Opus silence frames are sent before the stream goes quiet.
+class RtpSendScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr qint64 FRAME_INTERVAL_NS = 20000000; // 20ms
+    static constexpr quint32 SAMPLES_PER_FRAME = 960;     // At 48kHz
+    static constexpr int MAX_QUEUED_FRAMES = 6;           // Drop oldest beyond 120ms
+    static constexpr int MAX_CATCH_UP_SLOTS = 2;
+    static constexpr int SILENCE_FRAME_COUNT = 5;
+    static constexpr int JITTER_HISTORY = 3000; // Last minute of send intervals
+
+    struct JitterStats
+    {
+        int samples = 0;
+        double p50Us = 0.0;
+        double p95Us = 0.0;
+        double p99Us = 0.0;
+        double maxUs = 0.0;
+    };
+
+    explicit RtpSendScheduler(QObject *parent = nullptr);
+
+    void start(quint32 initialTimestamp);
+    void stop();
+    bool isRunning() const { return m_clock.isValid(); }
+
+    void enqueue(const QByteArray &opus);
+    void endOfSpeech();
+
+    // Deviation of send intervals from the nominal 20ms
+    JitterStats jitterStats() const;
+
+signals:
+    void frameDue(const QByteArray &opus, quint32 timestamp);
+    void burstFinished(); // All frames due on this tick have been emitted
+
+private slots:
+    void onTick();
+
+private:
+    void scheduleNextTick();
+    void recordSendTime(qint64 nowNs);
+
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+    quint32 m_timestampBase = 0;
+    qint64 m_nextSlot = 0;
+
+    // Fixed ring of queued frames
+    QByteArray m_queue[MAX_QUEUED_FRAMES];
+    int m_queueHead = 0;
+    int m_queueCount = 0;
+
+    int m_pendingSilence = 0;
+    QByteArray m_silenceFrame;
+
+    qint64 m_lastSendNs = -1;
+    qint64 m_lastSendSlot = -1;
+    QVector<qint32> m_intervalDeviationUs;
+    int m_deviationWritePos = 0;
+};
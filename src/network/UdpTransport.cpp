@@ -0,0 +1,302 @@
+#include "UdpTransport.h"
+#include <QUdpSocket>
+#include <QSocketNotifier>
+#include <QDebug>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <arpa/inet.h>
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+UdpTransport::UdpTransport(QObject *parent)
+    : QObject(parent),
+      m_receiveSlab(new char[BATCH_SIZE * MAX_DATAGRAM_SIZE]),
+      m_sendSlab(new char[BATCH_SIZE * MAX_DATAGRAM_SIZE])
+{
+#ifdef Q_OS_LINUX
+    // Point the message headers at their slab slots once
+    for (int i = 0; i < BATCH_SIZE; ++i)
+    {
+        m_receiveIov[i].iov_base = m_receiveSlab.get() + i * MAX_DATAGRAM_SIZE;
+        m_receiveIov[i].iov_len = MAX_DATAGRAM_SIZE;
+        m_receiveHeaders[i].msg_hdr.msg_iov = &m_receiveIov[i];
+        m_receiveHeaders[i].msg_hdr.msg_iovlen = 1;
+
+        m_sendIov[i].iov_base = m_sendSlab.get() + i * MAX_DATAGRAM_SIZE;
+        m_sendHeaders[i].msg_hdr.msg_iov = &m_sendIov[i];
+        m_sendHeaders[i].msg_hdr.msg_iovlen = 1;
+        m_sendHeaders[i].msg_hdr.msg_name = &m_remoteSockaddr;
+        m_sendHeaders[i].msg_hdr.msg_namelen = sizeof(m_remoteSockaddr);
+    }
+#endif
+}
+
+UdpTransport::~UdpTransport()
+{
+    close();
+}
+
+bool UdpTransport::open()
+{
+    close();
+    m_stats = Stats();
+    m_openTimer.start();
+
+    if (qEnvironmentVariableIsEmpty("CPPCORD_DISABLE_NATIVE_UDP") && openNative())
+    {
+        qDebug() << "UDP transport: native recvmmsg/sendmmsg path";
+        return true;
+    }
+
+    return openQt();
+}
+
+bool UdpTransport::openQt()
+{
+    m_qtSocket = new QUdpSocket(this);
+    if (!m_qtSocket->bind(QHostAddress::Any, 0))
+    {
+        m_errorString = m_qtSocket->errorString();
+        delete m_qtSocket;
+        m_qtSocket = nullptr;
+        return false;
+    }
+
+    connect(m_qtSocket, &QUdpSocket::readyRead, this, &UdpTransport::readyRead);
+    qDebug() << "UDP transport: QUdpSocket path";
+    return true;
+}
+
+bool UdpTransport::openNative()
+{
+#ifdef Q_OS_LINUX
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        qWarning() << "Native UDP socket failed:" << std::strerror(errno);
+        return false;
+    }
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = 0;
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) < 0)
+    {
+        qWarning() << "Native UDP bind failed:" << std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    m_nativeFd = fd;
+    m_notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &UdpTransport::readyRead);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void UdpTransport::close()
+{
+    if (!isOpen())
+        return;
+
+    logStats();
+    closeNative();
+
+    if (m_qtSocket)
+    {
+        m_qtSocket->close();
+        delete m_qtSocket;
+        m_qtSocket = nullptr;
+    }
+
+    m_sendQueued = 0;
+}
+
+void UdpTransport::closeNative()
+{
+    delete m_notifier;
+    m_notifier = nullptr;
+
+#ifdef Q_OS_LINUX
+    if (m_nativeFd >= 0)
+    {
+        ::close(m_nativeFd);
+    }
+#endif
+    m_nativeFd = -1;
+    m_sendQueued = 0;
+}
+
+bool UdpTransport::isOpen() const
+{
+    return m_nativeFd >= 0 || m_qtSocket != nullptr;
+}
+
+bool UdpTransport::setRemote(const QString &ip, quint16 port)
+{
+    // Resolved once here instead of building a QHostAddress per packet
+    m_remoteAddress = QHostAddress(ip);
+    m_remotePort = port;
+
+    if (m_remoteAddress.isNull())
+    {
+        m_errorString = QString("Voice server address is not an IP address: %1").arg(ip);
+        return false;
+    }
+
+    // The QUdpSocket fallback is bound dual-stack; only the native socket
+    // is AF_INET with a cached sockaddr_in
+    if (!isNative())
+        return true;
+
+    // The native socket is AF_INET only, so an IPv6 voice server moves the
+    // transport over to the dual-stack QUdpSocket; the stats carry on
+    if (m_remoteAddress.protocol() != QAbstractSocket::IPv4Protocol)
+    {
+        qDebug() << "UDP transport: IPv6 voice server, switching to QUdpSocket path";
+        closeNative();
+        return openQt();
+    }
+
+#ifdef Q_OS_LINUX
+    m_remoteSockaddr = {};
+    m_remoteSockaddr.sin_family = AF_INET;
+    m_remoteSockaddr.sin_addr.s_addr = htonl(m_remoteAddress.toIPv4Address());
+    m_remoteSockaddr.sin_port = htons(port);
+#endif
+    return true;
+}
+
+bool UdpTransport::send(const char *data, int size)
+{
+    if (!isOpen() || size > MAX_DATAGRAM_SIZE)
+        return false;
+
+    if (m_qtSocket)
+    {
+        m_stats.sendSyscalls++;
+        if (m_qtSocket->writeDatagram(data, size, m_remoteAddress, m_remotePort) < 0)
+        {
+            m_errorString = m_qtSocket->errorString();
+            return false;
+        }
+        m_stats.packetsSent++;
+        return true;
+    }
+
+    if (m_sendQueued == BATCH_SIZE && !sendQueuedNative())
+        return false;
+
+    std::memcpy(m_sendSlab.get() + m_sendQueued * MAX_DATAGRAM_SIZE, data, size);
+    m_sendSizes[m_sendQueued++] = size;
+    return true;
+}
+
+void UdpTransport::flush()
+{
+    if (m_nativeFd >= 0 && m_sendQueued > 0)
+    {
+        sendQueuedNative();
+    }
+}
+
+bool UdpTransport::sendQueuedNative()
+{
+#ifdef Q_OS_LINUX
+    for (int i = 0; i < m_sendQueued; ++i)
+    {
+        m_sendIov[i].iov_len = m_sendSizes[i];
+    }
+
+    int offset = 0;
+    while (offset < m_sendQueued)
+    {
+        m_stats.sendSyscalls++;
+        int sent = ::sendmmsg(m_nativeFd, m_sendHeaders + offset, m_sendQueued - offset, 0);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            m_errorString = QString::fromLocal8Bit(std::strerror(errno));
+            qWarning() << "sendmmsg failed:" << m_errorString;
+            m_sendQueued = 0;
+            return false;
+        }
+        offset += sent;
+        m_stats.packetsSent += sent;
+    }
+#endif
+    m_sendQueued = 0;
+    return true;
+}
+
+int UdpTransport::receiveBatch()
+{
+    if (m_qtSocket)
+    {
+        // Counts the socket calls made. On Unix each of hasPendingDatagrams()
+        // and readDatagram() is one recvmsg() (a MSG_PEEK probe, then the
+        // read), but that is Qt's implementation, so the figure is logged as
+        // an estimate.
+        int count = 0;
+        while (count < BATCH_SIZE)
+        {
+            m_stats.receiveSyscalls++;
+            if (!m_qtSocket->hasPendingDatagrams())
+                break;
+            m_stats.receiveSyscalls++;
+            qint64 size = m_qtSocket->readDatagram(m_receiveSlab.get() + count * MAX_DATAGRAM_SIZE, MAX_DATAGRAM_SIZE);
+            if (size < 0)
+                break;
+            m_receiveSizes[count++] = static_cast<int>(size);
+        }
+        m_stats.packetsReceived += count;
+        return count;
+    }
+
+#ifdef Q_OS_LINUX
+    if (m_nativeFd < 0)
+        return 0;
+
+    m_stats.receiveSyscalls++;
+    int count = ::recvmmsg(m_nativeFd, m_receiveHeaders, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+    if (count < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            qWarning() << "recvmmsg failed:" << std::strerror(errno);
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        // Oversized datagrams are truncated by the kernel; mark them empty
+        bool truncated = (m_receiveHeaders[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+        m_receiveSizes[i] = truncated ? 0 : static_cast<int>(m_receiveHeaders[i].msg_len);
+    }
+    m_stats.packetsReceived += count;
+    return count;
+#else
+    return 0;
+#endif
+}
+
+void UdpTransport::logStats() const
+{
+    double seconds = m_openTimer.isValid() ? m_openTimer.elapsed() / 1000.0 : 0.0;
+    if (seconds <= 0.0)
+        return;
+
+    qDebug().noquote() << QString("UDP transport (%1): %2 recv syscalls/s for %3 packets/s, %4 send syscalls/s for %5 packets/s")
+                              .arg(isNative() ? "native" : "QUdpSocket, estimated")
+                              .arg(m_stats.receiveSyscalls / seconds, 0, 'f', 1)
+                              .arg(m_stats.packetsReceived / seconds, 0, 'f', 1)
+                              .arg(m_stats.sendSyscalls / seconds, 0, 'f', 1)
+                              .arg(m_stats.packetsSent / seconds, 0, 'f', 1);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <QObject>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <memory>
+
+class QUdpSocket;
+class QSocketNotifier;
+
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+// UDP socket for the voice media path.
+//
+// On Linux a native non-blocking socket is used: pending datagrams are
+// drained with recvmmsg() into a preallocated slab of packet buffers, queued
+// sends go out with one sendmmsg(), and the remote address is resolved once
+// into a cached sockaddr. Elsewhere, or if the native socket cannot be
+// created (or CPPCORD_DISABLE_NATIVE_UDP is set), the same interface is backed
+// by QUdpSocket.
+class UdpTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int BATCH_SIZE = 32;
+    static constexpr int MAX_DATAGRAM_SIZE = 4096; // Holds RtpPacketBuilder's largest, see VoiceClient.cpp
+
+    // On the QUdpSocket path the syscall figures count the socket calls
+    // made, assuming one syscall each
+    struct Stats
+    {
+        quint64 receiveSyscalls = 0;
+        quint64 sendSyscalls = 0;
+        quint64 packetsReceived = 0;
+        quint64 packetsSent = 0;
+    };
+
+    explicit UdpTransport(QObject *parent = nullptr);
+    ~UdpTransport();
+
+    // Bind to an ephemeral local port
+    bool open();
+    void close();
+    bool isOpen() const;
+    bool isNative() const { return m_nativeFd >= 0; }
+    QString errorString() const { return m_errorString; }
+
+    // Call after open(); an IPv6 remote moves the native path to QUdpSocket
+    bool setRemote(const QString &ip, quint16 port);
+
+    // Queue a datagram for the remote; flush() sends everything queued
+    bool send(const char *data, int size);
+    void flush();
+
+    // Read up to BATCH_SIZE pending datagrams. Returns how many were read;
+    // they stay valid until the next call.
+    int receiveBatch();
+    const char *datagram(int index) const { return m_receiveSlab.get() + index * MAX_DATAGRAM_SIZE; }
+    int datagramSize(int index) const { return m_receiveSizes[index]; }
+
+    const Stats &stats() const { return m_stats; }
+    void logStats() const;
+
+signals:
+    void readyRead();
+
+private:
+    bool openNative();
+    bool openQt();
+    void closeNative();
+    bool sendQueuedNative();
+
+    QUdpSocket *m_qtSocket = nullptr;
+    QSocketNotifier *m_notifier = nullptr;
+    int m_nativeFd = -1;
+
+    QHostAddress m_remoteAddress;
+    quint16 m_remotePort = 0;
+
+    std::unique_ptr<char[]> m_receiveSlab;
+    int m_receiveSizes[BATCH_SIZE] = {};
+
+    std::unique_ptr<char[]> m_sendSlab;
+    int m_sendSizes[BATCH_SIZE] = {};
+    int m_sendQueued = 0;
+
+#ifdef Q_OS_LINUX
+    sockaddr_in m_remoteSockaddr = {};
+    mmsghdr m_receiveHeaders[BATCH_SIZE] = {};
+    iovec m_receiveIov[BATCH_SIZE] = {};
+    mmsghdr m_sendHeaders[BATCH_SIZE] = {};
+    iovec m_sendIov[BATCH_SIZE] = {};
+#endif
+
+    Stats m_stats;
+    QElapsedTimer m_openTimer;
+    QString m_errorString;
+};
@@ -0,0 +1,127 @@
+#include "VoiceCipher.h"
+#include <QDebug>
+#include <algorithm>
+
+VoiceCipher::~VoiceCipher()
+{
+    reset();
+}
+
+VoiceCipher::Mode VoiceCipher::modeFromString(const QString &mode)
+{
+    if (mode == "aead_aes256_gcm_rtpsize")
+        return Mode::AesGcm;
+    if (mode == "aead_xchacha20_poly1305_rtpsize")
+        return Mode::XChaCha20;
+    return Mode::None;
+}
+
+QString VoiceCipher::modeName(Mode mode)
+{
+    switch (mode)
+    {
+    case Mode::AesGcm:
+        return "aead_aes256_gcm_rtpsize";
+    case Mode::XChaCha20:
+        return "aead_xchacha20_poly1305_rtpsize";
+    default:
+        return QString();
+    }
+}
+
+bool VoiceCipher::isAesGcmAvailable()
+{
+    // libsodium only implements AES-GCM on CPUs with AES-NI and PCLMUL; CPU
+    // features are detected by sodium_init(), which is safe to call repeatedly
+    if (sodium_init() < 0)
+        return false;
+    return crypto_aead_aes256gcm_is_available() != 0;
+}
+
+VoiceCipher::Mode VoiceCipher::selectMode(const QStringList &offeredModes)
+{
+    if (isAesGcmAvailable() && offeredModes.contains(modeName(Mode::AesGcm)))
+        return Mode::AesGcm;
+    if (offeredModes.contains(modeName(Mode::XChaCha20)))
+        return Mode::XChaCha20;
+    return Mode::None;
+}
+
+bool VoiceCipher::setSession(Mode mode, const QByteArray &secretKey)
+{
+    reset();
+
+    if (secretKey.size() != KEY_SIZE)
+    {
+        qWarning() << "Invalid voice secret key size:" << secretKey.size();
+        return false;
+    }
+
+    const unsigned char *key = reinterpret_cast<const unsigned char *>(secretKey.constData());
+
+    switch (mode)
+    {
+    case Mode::AesGcm:
+        if (!isAesGcmAvailable())
+        {
+            qWarning() << "AES-256-GCM selected but not supported by this CPU";
+            return false;
+        }
+        crypto_aead_aes256gcm_beforenm(&m_aesState, key);
+        m_encrypt = &VoiceCipher::encryptAesGcm;
+        m_decrypt = &VoiceCipher::decryptAesGcm;
+        break;
+    case Mode::XChaCha20:
+        std::copy(key, key + KEY_SIZE, m_key);
+        m_encrypt = &VoiceCipher::encryptXChaCha;
+        m_decrypt = &VoiceCipher::decryptXChaCha;
+        break;
+    default:
+        qWarning() << "Unsupported encryption mode";
+        return false;
+    }
+
+    m_mode = mode;
+    return true;
+}
+
+void VoiceCipher::reset()
+{
+    m_mode = Mode::None;
+    m_encrypt = nullptr;
+    m_decrypt = nullptr;
+    sodium_memzero(&m_aesState, sizeof(m_aesState));
+    sodium_memzero(m_key, sizeof(m_key));
+}
+
+int VoiceCipher::encryptAesGcm(const VoiceCipher &cipher, unsigned char *ciphertext, unsigned char *tag,
+                               const unsigned char *plaintext, unsigned long long length,
+                               const unsigned char *aad, unsigned long long aadLength, const unsigned char *nonce)
+{
+    return crypto_aead_aes256gcm_encrypt_detached_afternm(
+        ciphertext, tag, nullptr, plaintext, length, aad, aadLength, nullptr, nonce, &cipher.m_aesState);
+}
+
+int VoiceCipher::decryptAesGcm(const VoiceCipher &cipher, unsigned char *plaintext, const unsigned char *ciphertext,
+                               unsigned long long length, const unsigned char *tag,
+                               const unsigned char *aad, unsigned long long aadLength, const unsigned char *nonce)
+{
+    return crypto_aead_aes256gcm_decrypt_detached_afternm(
+        plaintext, nullptr, ciphertext, length, tag, aad, aadLength, nonce, &cipher.m_aesState);
+}
+
+int VoiceCipher::encryptXChaCha(const VoiceCipher &cipher, unsigned char *ciphertext, unsigned char *tag,
+                                const unsigned char *plaintext, unsigned long long length,
+                                const unsigned char *aad, unsigned long long aadLength, const unsigned char *nonce)
+{
+    return crypto_aead_xchacha20poly1305_ietf_encrypt_detached(
+        ciphertext, tag, nullptr, plaintext, length, aad, aadLength, nullptr, nonce, cipher.m_key);
+}
+
+int VoiceCipher::decryptXChaCha(const VoiceCipher &cipher, unsigned char *plaintext, const unsigned char *ciphertext,
+                                unsigned long long length, const unsigned char *tag,
+                                const unsigned char *aad, unsigned long long aadLength, const unsigned char *nonce)
+{
+    return crypto_aead_xchacha20poly1305_ietf_decrypt_detached(
+        plaintext, nullptr, ciphertext, length, tag, aad, aadLength, nonce, cipher.m_key);
+}
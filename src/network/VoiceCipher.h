@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <sodium.h>
+#include "utils/Trace.h"
+
+// AEAD cipher for voice packets, keyed once per voice session.
+//
+// For AES-256-GCM the key schedule is expanded once with beforenm() instead
+// of on every packet. The encrypt/decrypt implementation is chosen through
+// function pointers when the session description arrives, so the per-packet
+// path has no mode string comparisons. AES-GCM is only offered when the CPU
+// has hardware support; otherwise XChaCha20-Poly1305 is used.
+class VoiceCipher
+{
+public:
+    enum class Mode
+    {
+        None,
+        AesGcm,   // aead_aes256_gcm_rtpsize
+        XChaCha20 // aead_xchacha20_poly1305_rtpsize
+    };
+
+    static constexpr int KEY_SIZE = 32;
+    static constexpr int TAG_SIZE = 16;
+    static constexpr int NONCE_SIZE = crypto_aead_xchacha20poly1305_ietf_NPUBBYTES; // Large enough for both
+
+    VoiceCipher() = default;
+    ~VoiceCipher();
+    VoiceCipher(const VoiceCipher &) = delete;
+    VoiceCipher &operator=(const VoiceCipher &) = delete;
+
+    static Mode modeFromString(const QString &mode);
+    static QString modeName(Mode mode);
+    static bool isAesGcmAvailable();
+
+    // Best mode offered by the server that this machine can run
+    static Mode selectMode(const QStringList &offeredModes);
+
+    bool setSession(Mode mode, const QByteArray &secretKey);
+    void reset();
+
+    bool isReady() const { return m_encrypt != nullptr; }
+    Mode mode() const { return m_mode; }
+
+    // Detached AEAD. ciphertext may equal plaintext for in-place operation.
+    int encrypt(unsigned char *ciphertext, unsigned char *tag,
+                const unsigned char *plaintext, unsigned long long length,
+                const unsigned char *aad, unsigned long long aadLength,
+                const unsigned char *nonce) const
+    {
+        TRACE_SCOPE("voice", "aead_encrypt");
+        return m_encrypt(*this, ciphertext, tag, plaintext, length, aad, aadLength, nonce);
+    }
+
+    int decrypt(unsigned char *plaintext, const unsigned char *ciphertext, unsigned long long length,
+                const unsigned char *tag, const unsigned char *aad, unsigned long long aadLength,
+                const unsigned char *nonce) const
+    {
+        TRACE_SCOPE("voice", "aead_decrypt");
+        return m_decrypt(*this, plaintext, ciphertext, length, tag, aad, aadLength, nonce);
+    }
+
+private:
+    using EncryptFn = int (*)(const VoiceCipher &, unsigned char *, unsigned char *,
+                              const unsigned char *, unsigned long long,
+                              const unsigned char *, unsigned long long, const unsigned char *);
+    using DecryptFn = int (*)(const VoiceCipher &, unsigned char *, const unsigned char *, unsigned long long,
+                              const unsigned char *, const unsigned char *, unsigned long long,
+                              const unsigned char *);
+
+    static int encryptAesGcm(const VoiceCipher &cipher, unsigned char *ciphertext, unsigned char *tag,
+                             const unsigned char *plaintext, unsigned long long length,
+                             const unsigned char *aad, unsigned long long aadLength, const unsigned char *nonce);
+    static int decryptAesGcm(const VoiceCipher &cipher, unsigned char *plaintext, const unsigned char *ciphertext,
+                             unsigned long long length, const unsigned char *tag,
+                             const unsigned char *aad, unsigned long long aadLength, const unsigned char *nonce);
+    static int encryptXChaCha(const VoiceCipher &cipher, unsigned char *ciphertext, unsigned char *tag,
+                              const unsigned char *plaintext, unsigned long long length,
+                              const unsigned char *aad, unsigned long long aadLength, const unsigned char *nonce);
+    static int decryptXChaCha(const VoiceCipher &cipher, unsigned char *plaintext, const unsigned char *ciphertext,
+                              unsigned long long length, const unsigned char *tag,
+                              const unsigned char *aad, unsigned long long aadLength, const unsigned char *nonce);
+
+    Mode m_mode = Mode::None;
+    EncryptFn m_encrypt = nullptr;
+    DecryptFn m_decrypt = nullptr;
+
+    crypto_aead_aes256gcm_state m_aesState; // Expanded AES key schedule
+    unsigned char m_key[KEY_SIZE] = {};
+};
@@ -2,41 +2,33 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QDateTime>
-#include <QHostAddress>
 #include <QNetworkRequest>
+#include <QRandomGenerator>
+#include <QHostAddress>
 #include <QDebug>
 #include <sodium.h>
 #include <cstring>
 #include "../audio/OpusCodec.h"
+#include "utils/Metrics.h"
 
-// Helper function to get RTP header size for AAD (Additional Authenticated Data)
-// For rtpsize modes: includes base header + CSRCs + extension header (NOT extension data)
-static int getRtpHeaderSizeForAAD(const QByteArray &packet)
-{
-    if (packet.size() < 12)
-    {
-        return 12; // Minimum RTP header size
-    }
-
-    // Parse RTP header
-    quint8 byte0 = static_cast<quint8>(packet[0]);
-    quint8 cc = byte0 & 0x0F;                // CSRC count (bits 0-3)
-    bool hasExtension = (byte0 & 0x10) != 0; // Extension bit (bit 4)
-
-    int headerSize = 12;  // Basic RTP header
-    headerSize += cc * 4; // CSRC identifiers (4 bytes each)
+// Every packet the builder may produce has to fit through send()
+static_assert(RtpPacketBuilder::MAX_DATAGRAM_SIZE <= UdpTransport::MAX_DATAGRAM_SIZE,
+              "UdpTransport would reject the largest voice packet");
 
-    // For rtpsize modes: extension HEADER (4 bytes) is part of AAD, but extension DATA is encrypted
-    if (hasExtension && packet.size() >= headerSize + 4)
-    {
-        headerSize += 4; // Extension header only (profile + length)
-    }
-
-    return headerSize;
+namespace
+{
+MetricCounter &s_packetsSentMetric = Metrics::counter("voice.packets_sent");
+MetricCounter &s_sendFailuresMetric = Metrics::counter("voice.send_failures");
+MetricCounter &s_packetsReceivedMetric = Metrics::counter("voice.packets_received");
+MetricCounter &s_decryptFailuresMetric = Metrics::counter("voice.decrypt_failures");
+MetricGauge &s_downlinkLossMetric = Metrics::gauge("voice.downlink_loss_pct"); // Cumulative, all speakers
+MetricGauge &s_jitterMetric = Metrics::gauge("voice.jitter_ms");               // Worst speaker
+MetricGauge &s_uplinkLossMetric = Metrics::gauge("voice.uplink_loss_pct");     // From RTCP
 }
 
 VoiceClient::VoiceClient(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      m_heartbeatMonitor("voice")
 {
     // Initialize libsodium
     if (sodium_init() < 0)
@@ -45,8 +37,11 @@ VoiceClient::VoiceClient(QObject *parent)
     }
 
     m_webSocket = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
-    m_udpSocket = new QUdpSocket(this);
+    m_udpTransport = new UdpTransport(this);
     m_heartbeatTimer = new QTimer(this);
+    m_sendScheduler = new RtpSendScheduler(this);
+    m_resumeTimer = new QTimer(this);
+    m_resumeTimer->setSingleShot(true);
 
     connect(m_webSocket, &QWebSocket::connected, this, &VoiceClient::onWebSocketConnected);
     connect(m_webSocket, &QWebSocket::disconnected, this, &VoiceClient::onWebSocketDisconnected);
@@ -55,7 +50,10 @@ VoiceClient::VoiceClient(QObject *parent)
     connect(m_webSocket, QOverload<QAbstractSocket::SocketError>::of(&QWebSocket::error), this, &VoiceClient::onWebSocketError);
 
     connect(m_heartbeatTimer, &QTimer::timeout, this, &VoiceClient::sendHeartbeat);
-    connect(m_udpSocket, &QUdpSocket::readyRead, this, &VoiceClient::onUdpReadyRead);
+    connect(m_resumeTimer, &QTimer::timeout, this, &VoiceClient::attemptResume);
+    connect(m_udpTransport, &UdpTransport::readyRead, this, &VoiceClient::onUdpReadyRead);
+    connect(m_sendScheduler, &RtpSendScheduler::frameDue, this, &VoiceClient::transmitFrame);
+    connect(m_sendScheduler, &RtpSendScheduler::burstFinished, m_udpTransport, &UdpTransport::flush);
 }
 
 VoiceClient::~VoiceClient()
@@ -71,16 +69,48 @@ void VoiceClient::connectToVoice(const QString &endpoint, const QString &token,
     m_sessionId = sessionId;
     m_guildId = guildId;
     m_userId = userId;
+    m_closing = false;
+    m_resuming = false;
+    m_resumeAttempts = 0;
 
-    // Voice endpoint doesn't include protocol, prepend wss://
-    QString url = QString("wss://%1?v=%2").arg(m_endpoint).arg(VOICE_GATEWAY_VERSION);
-
+    QUrl url = voiceGatewayUrl();
     qDebug() << "Connecting to voice gateway:" << url;
-    m_webSocket->open(QUrl(url));
+    m_webSocket->open(url);
+}
+
+QUrl VoiceClient::voiceGatewayUrl() const
+{
+    // Voice endpoint doesn't include protocol, prepend wss://. Local test
+    // servers pass a full ws:// URL instead; that is only trusted for
+    // loopback hosts, anything else keeps its host but is forced onto wss://
+    // since IDENTIFY carries the voice token.
+    QString base = "wss://" + m_endpoint;
+    int schemeEnd = m_endpoint.indexOf("://");
+    if (schemeEnd >= 0)
+    {
+        QString host = QUrl(m_endpoint).host();
+        bool loopback = host == QLatin1String("localhost") || QHostAddress(host).isLoopback();
+        base = loopback ? m_endpoint : "wss://" + m_endpoint.mid(schemeEnd + 3);
+    }
+    return QUrl(QString("%1?v=%2").arg(base).arg(VOICE_GATEWAY_VERSION));
 }
 
 void VoiceClient::disconnectFromVoice()
 {
+    // A close we asked for must not be mistaken for a drop worth resuming
+    m_closing = true;
+    m_resuming = false;
+    m_resumeAttempts = 0;
+    m_resumeTimer->stop();
+
+    if (m_sendScheduler->isRunning())
+    {
+        RtpSendScheduler::JitterStats jitter = m_sendScheduler->jitterStats();
+        qDebug() << "RTP send interval jitter over" << jitter.samples << "intervals - p50:" << jitter.p50Us
+                 << "us p95:" << jitter.p95Us << "us p99:" << jitter.p99Us << "us max:" << jitter.maxUs << "us";
+        m_sendScheduler->stop();
+    }
+
     if (m_heartbeatTimer->isActive())
     {
         m_heartbeatTimer->stop();
@@ -91,21 +121,25 @@ void VoiceClient::disconnectFromVoice()
         m_webSocket->close();
     }
 
-    if (m_udpSocket->state() == QAbstractSocket::BoundState)
-    {
-        m_udpSocket->close();
-    }
+    m_udpTransport->close();
+    logReceiveStats();
+    m_receiveStats.clear();
 
     m_ssrc = 0;
     m_secretKey.clear();
+    m_packetBuilder.reset();
+    m_cipher.reset();
     m_lastSequence = -1;
+    m_speaking = false;
+    m_heartbeatMonitor.resetPending();
+    m_resumeElapsed.invalidate();
+    m_lastRttMs = -1;
+    m_uplinkLoss = -1.0;
 }
 
 void VoiceClient::sendAudio(const QByteArray &opusData)
 {
-    qDebug() << "sendAudio called with" << opusData.size() << "bytes";
-
-    if (!m_udpSocket || m_udpSocket->state() != QAbstractSocket::BoundState)
+    if (!m_udpTransport->isOpen())
     {
         qWarning() << "Cannot send audio: UDP socket not ready";
         return;
@@ -117,35 +151,64 @@ void VoiceClient::sendAudio(const QByteArray &opusData)
         return;
     }
 
-    // Increment sequence and timestamp
+    // Capture hands frames over in bursts; the scheduler releases them on time
+    m_sendScheduler->enqueue(opusData);
+}
+
+void VoiceClient::transmitFrame(const QByteArray &opusData, quint32 timestamp)
+{
+    if (!m_udpTransport->isOpen() || !m_packetBuilder.isReady())
+        return;
+
     m_audioSequence++;
-    m_audioTimestamp += OPUS_FRAME_SIZE; // 960 samples per 20ms frame
 
-    // Encrypt audio
-    QByteArray encrypted = encryptAudio(opusData, m_audioSequence, m_audioTimestamp);
-    if (encrypted.isEmpty())
+    // Encrypt straight into the reusable datagram buffer
+    int packetSize = m_packetBuilder.build(opusData.constData(), opusData.size(), m_audioSequence, timestamp);
+    if (packetSize < 0)
     {
         qWarning() << "Failed to encrypt audio";
         return;
     }
 
-    qDebug() << "Sending encrypted audio:" << encrypted.size() << "bytes, seq:" << m_audioSequence;
-
-    // Send over UDP
-    qint64 sent = m_udpSocket->writeDatagram(encrypted, QHostAddress(m_ip), m_port);
-    if (sent < 0)
+    // Queue for the UDP transport; the scheduler flushes once per tick
+    if (!m_udpTransport->send(m_packetBuilder.data(), packetSize))
     {
-        qWarning() << "Failed to send audio datagram:" << m_udpSocket->errorString();
+        qWarning() << "Failed to send audio datagram:" << m_udpTransport->errorString();
+        s_sendFailuresMetric.add();
+        return;
     }
+    s_packetsSentMetric.add();
 }
 
 void VoiceClient::setSelfMute(bool mute)
 {
     m_selfMute = mute;
-    // Update speaking state
-    if (m_ssrc != 0)
+    // Muting ends any active speech; unmuting waits for voice activity
+    if (mute)
+    {
+        setSpeaking(false);
+    }
+}
+
+void VoiceClient::setSpeaking(bool speaking)
+{
+    if (speaking && m_selfMute)
+        return;
+
+    if (speaking == m_speaking)
+        return;
+
+    m_speaking = speaking;
+
+    // Close the stream with silence frames so receivers don't interpolate
+    if (!speaking)
+    {
+        m_sendScheduler->endOfSpeech();
+    }
+
+    if (m_ssrc != 0 && m_webSocket->state() == QAbstractSocket::ConnectedState)
     {
-        sendSpeaking(m_selfMute ? 0 : 1);
+        sendSpeaking(speaking ? 1 : 0);
     }
 }
 
@@ -182,9 +245,69 @@ void VoiceClient::onWebSocketDisconnected()
     }
 
     m_heartbeatTimer->stop();
+    m_heartbeatMonitor.resetPending();
+    m_droppingZombie = false;
+
+    // A failed reconnect may already have rescheduled from onWebSocketError
+    if (m_resumeTimer->isActive())
+        return;
+
+    // The UDP socket, SSRC and session key are still valid after a websocket
+    // drop; resume the signalling session and let the media path carry on
+    if (!m_closing && m_cipher.isReady() && canResume(closeCode))
+    {
+        if (m_resumeAttempts < MAX_RESUME_ATTEMPTS)
+        {
+            if (!m_resuming)
+            {
+                m_resuming = true;
+                m_resumeElapsed.start();
+                m_audioRestored = false;
+            }
+
+            // 0, 1, 2, 4, 8 seconds between attempts
+            int delayMs = m_resumeAttempts == 0 ? 0 : 1000 << (m_resumeAttempts - 1);
+            m_resumeAttempts++;
+            qDebug() << "Voice gateway dropped, resuming in" << delayMs << "ms (attempt" << m_resumeAttempts << ")";
+            m_resumeTimer->start(delayMs);
+            return;
+        }
+
+        qWarning() << "Voice resume failed after" << m_resumeAttempts << "attempts";
+    }
+
+    if (!m_closing)
+    {
+        // Session can't be resumed; tear down the media path as well
+        disconnectFromVoice();
+    }
     emit disconnected();
 }
 
+bool VoiceClient::canResume(QWebSocketProtocol::CloseCode closeCode)
+{
+    switch (static_cast<int>(closeCode))
+    {
+    case 4004: // Authentication failed
+    case 4006: // Session no longer valid
+    case 4009: // Session timeout
+    case 4011: // Server not found
+    case 4012: // Unknown protocol
+    case 4014: // Disconnected (kicked, channel deleted, moved)
+    case 4016: // Unknown encryption mode
+        return false;
+    default:
+        return true;
+    }
+}
+
+void VoiceClient::attemptResume()
+{
+    QUrl url = voiceGatewayUrl();
+    qDebug() << "Reconnecting to voice gateway to resume:" << url;
+    m_webSocket->open(url);
+}
+
 void VoiceClient::onWebSocketTextMessageReceived(const QString &message)
 {
     QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8());
@@ -225,13 +348,39 @@ void VoiceClient::onWebSocketBinaryMessageReceived(const QByteArray &message)
 void VoiceClient::onWebSocketError(QAbstractSocket::SocketError error)
 {
     qWarning() << "Voice WebSocket error:" << error << m_webSocket->errorString();
+
+    // A reconnect that never got as far as connecting doesn't emit
+    // disconnected(); schedule the next attempt from here instead
+    if (m_resuming && m_webSocket->state() == QAbstractSocket::UnconnectedState && !m_resumeTimer->isActive())
+    {
+        onWebSocketDisconnected();
+        return;
+    }
+
     emit this->error(m_webSocket->errorString());
 }
 
 void VoiceClient::sendHeartbeat()
 {
+    // The previous heartbeat was never acknowledged: drop the zombied
+    // socket with a resumable close code and let the resume path take over
+    if (m_heartbeatMonitor.awaitingAck())
+    {
+        qWarning() << "Voice heartbeat was not acknowledged, reconnecting";
+        m_heartbeatMonitor.recordZombie();
+        m_heartbeatTimer->stop();
+        m_droppingZombie = true;
+        m_webSocket->close(static_cast<QWebSocketProtocol::CloseCode>(4000), "Heartbeat ACK timeout");
+        QTimer::singleShot(CLOSE_TIMEOUT_MS, this, [this]()
+                           {
+            if (m_droppingZombie && m_webSocket->state() != QAbstractSocket::UnconnectedState)
+                m_webSocket->abort(); });
+        return;
+    }
+
     qint64 nonce = QDateTime::currentMSecsSinceEpoch();
     m_lastHeartbeatNonce = nonce;
+    m_heartbeatMonitor.heartbeatSent();
 
     QJsonObject payload;
     payload["op"] = 3; // Heartbeat
@@ -322,6 +471,10 @@ void VoiceClient::handleOpcode(int opcode, const QJsonObject &data)
     case 4: // Session Description
         handleSessionDescription(data);
         break;
+    case 5: // Speaking: maps a remote user to the SSRC their audio uses
+        emit userSsrcMapped(data["user_id"].toString().toULongLong(),
+                            static_cast<quint32>(data["ssrc"].toVariant().toLongLong()));
+        break;
     case 6: // Heartbeat ACK
         handleHeartbeatAck(data);
         break;
@@ -331,6 +484,9 @@ void VoiceClient::handleOpcode(int opcode, const QJsonObject &data)
     case 9: // Resumed
         handleResumed();
         break;
+    case 13: // Client Disconnect
+        emit userDisconnected(data["user_id"].toString().toULongLong());
+        break;
     default:
         qDebug() << "Unhandled voice opcode:" << opcode;
         break;
@@ -355,13 +511,22 @@ void VoiceClient::handleReady(const QJsonObject &data)
     qDebug() << "Supported encryption modes:" << m_encryptionModes;
 
     // Bind UDP socket to any available port
-    if (!m_udpSocket->bind(QHostAddress::Any, 0))
+    if (!m_udpTransport->open())
     {
-        qWarning() << "Failed to bind UDP socket:" << m_udpSocket->errorString();
+        qWarning() << "Failed to bind UDP socket:" << m_udpTransport->errorString();
         emit error("Failed to bind UDP socket");
         return;
     }
 
+    if (!m_udpTransport->setRemote(m_ip, m_port))
+    {
+        qWarning() << "Invalid voice server address:" << m_udpTransport->errorString();
+        emit error("Invalid voice server address");
+        return;
+    }
+
+    m_receiveClock.start();
+
     // Perform IP discovery
     performIpDiscovery();
 }
@@ -383,11 +548,21 @@ void VoiceClient::handleSessionDescription(const QJsonObject &data)
              << "Key size:" << m_secretKey.size()
              << "DAVE version:" << m_daveProtocolVersion;
 
-    // Initialize nonce counter
-    m_audioNonce = 0;
+    // Expand the key once and pick the cipher implementation for this session
+    if (!m_cipher.setSession(VoiceCipher::modeFromString(m_selectedMode), m_secretKey))
+    {
+        qWarning() << "Failed to set up voice encryption for mode:" << m_selectedMode;
+        emit error("Unsupported voice encryption mode");
+        return;
+    }
+
+    // Key the packet builder (resets the nonce counter) and start the send
+    // clock with a random initial timestamp per RFC 3550
+    m_packetBuilder.setSession(&m_cipher, m_ssrc);
+    m_sendScheduler->start(QRandomGenerator::global()->generate());
 
-    // Send initial speaking state
-    sendSpeaking(m_selfMute ? 0 : 1);
+    // Announce our SSRC; voice activity flips the speaking flag from here on
+    sendSpeaking(m_speaking ? 1 : 0);
 
     emit connected();
     emit ready(m_ip, m_port, m_ssrc);
@@ -399,8 +574,15 @@ void VoiceClient::handleHello(const QJsonObject &data)
 
     qDebug() << "Voice Hello - Heartbeat interval:" << m_heartbeatInterval << "ms";
 
-    // Send Identify FIRST before heartbeating
-    sendIdentify();
+    // Send Identify (or Resume after a drop) FIRST before heartbeating
+    if (m_resuming)
+    {
+        sendResume();
+    }
+    else
+    {
+        sendIdentify();
+    }
 
     // Start heartbeat timer AFTER sending Identify
     m_heartbeatTimer->start(m_heartbeatInterval);
@@ -408,17 +590,37 @@ void VoiceClient::handleHello(const QJsonObject &data)
 
 void VoiceClient::handleResumed()
 {
-    qDebug() << "Voice connection resumed";
+    qDebug() << "Voice connection resumed after" << m_resumeElapsed.elapsed() << "ms";
+    m_resuming = false;
+    m_resumeAttempts = 0;
+
+    // The server replays anything after seq_ack; re-announce our speaking state
+    if (m_speaking)
+    {
+        sendSpeaking(1);
+    }
+
+    emit resumed();
     emit connected();
 }
 
 void VoiceClient::handleHeartbeatAck(const QJsonObject &data)
 {
     qint64 nonce = data["t"].toVariant().toLongLong();
-    if (nonce == m_lastHeartbeatNonce)
-    {
-        qDebug() << "Voice heartbeat acknowledged";
-    }
+    if (nonce != m_lastHeartbeatNonce)
+        return;
+
+    int rttMs = m_heartbeatMonitor.ackReceived();
+    if (rttMs < 0)
+        return;
+
+    qDebug() << "Voice heartbeat acknowledged, RTT:" << rttMs << "ms";
+    emit heartbeatRttMeasured(rttMs);
+
+    // The encoder steps down on one bad report, so give it the recent
+    // median rather than a single late ACK
+    m_lastRttMs = m_heartbeatMonitor.recentMedianMs();
+    emit networkStatsUpdated(m_uplinkLoss, m_lastRttMs);
 }
 
 void VoiceClient::performIpDiscovery()
@@ -445,10 +647,11 @@ void VoiceClient::performIpDiscovery()
 
     // Address and port are filled by the voice server
 
-    qint64 sent = m_udpSocket->writeDatagram(packet, QHostAddress(m_ip), m_port);
-    if (sent == -1)
+    bool sent = m_udpTransport->send(packet.constData(), packet.size());
+    m_udpTransport->flush();
+    if (!sent)
     {
-        qWarning() << "Failed to send IP discovery packet:" << m_udpSocket->errorString();
+        qWarning() << "Failed to send IP discovery packet:" << m_udpTransport->errorString();
         emit error("Failed to send IP discovery packet");
     }
     else
@@ -459,323 +662,208 @@ void VoiceClient::performIpDiscovery()
 
 void VoiceClient::onUdpReadyRead()
 {
-    while (m_udpSocket->hasPendingDatagrams())
+    // Drain everything pending in batches; each datagram lives in the
+    // transport's slab until the next batch, so wrap it without copying
+    int count;
+    while ((count = m_udpTransport->receiveBatch()) > 0)
     {
-        QByteArray datagram;
-        datagram.resize(m_udpSocket->pendingDatagramSize());
-
-        QHostAddress sender;
-        quint16 senderPort;
-        m_udpSocket->readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
-
-        // Check if this is an IP discovery response
-        if (datagram.size() == 74 && datagram[0] == 0x00 && datagram[1] == 0x02)
-        {
-            // Extract our external IP
-            QByteArray addressBytes = datagram.mid(8, 64);
-            int nullIndex = addressBytes.indexOf('\0');
-            QString externalIp = QString::fromUtf8(addressBytes.left(nullIndex));
-
-            // Extract our external port (big endian)
-            quint16 externalPort = qFromBigEndian<quint16>(reinterpret_cast<const uchar *>(datagram.constData() + 72));
-
-            qDebug() << "IP Discovery complete - External IP:" << externalIp << "Port:" << externalPort;
-
-            // Select encryption mode (prefer aead_aes256_gcm_rtpsize, fallback to aead_xchacha20_poly1305_rtpsize)
-            QString selectedMode;
-            if (m_encryptionModes.contains("aead_aes256_gcm_rtpsize"))
-            {
-                selectedMode = "aead_aes256_gcm_rtpsize";
-            }
-            else if (m_encryptionModes.contains("aead_xchacha20_poly1305_rtpsize"))
-            {
-                selectedMode = "aead_xchacha20_poly1305_rtpsize";
-            }
-            else
-            {
-                qWarning() << "No supported encryption mode available!";
-                emit error("No supported encryption mode");
-                return;
-            }
-
-            // Send Select Protocol
-            sendSelectProtocol(externalIp, externalPort, selectedMode);
-        }
-        else
+        for (int i = 0; i < count; ++i)
         {
-            // This is encrypted voice data - process all packets
-            qDebug() << "Received voice packet of size:" << datagram.size();
-
-            // Decrypt the audio
-            QByteArray decrypted = decryptAudio(datagram);
-            if (!decrypted.isEmpty())
-            {
-                emit audioDataReceived(decrypted);
-            }
-            else
+            int size = m_udpTransport->datagramSize(i);
+            if (size > 0)
             {
-                qDebug() << "Failed to decrypt audio packet";
+                handleDatagram(QByteArray::fromRawData(m_udpTransport->datagram(i), size));
             }
         }
     }
 }
 
-QByteArray VoiceClient::encryptAudio(const QByteArray &opus, quint16 sequence, quint32 timestamp)
+void VoiceClient::handleDatagram(const QByteArray &datagram)
 {
-    if (m_secretKey.isEmpty() || m_selectedMode.isEmpty())
-    {
-        qWarning() << "Cannot encrypt: secret key or mode not set";
-        return QByteArray();
-    }
-
-    // Build RTP header (12 bytes)
-    QByteArray rtpHeader(12, 0);
-    rtpHeader[0] = 0x80; // Version 2, no padding, no extension, no CSRC
-    rtpHeader[1] = 0x78; // Payload type 120 (Opus)
-
-    // Sequence number (big endian)
-    rtpHeader[2] = (sequence >> 8) & 0xFF;
-    rtpHeader[3] = sequence & 0xFF;
+    const uchar *data = reinterpret_cast<const uchar *>(datagram.constData());
 
-    // Timestamp (big endian)
-    rtpHeader[4] = (timestamp >> 24) & 0xFF;
-    rtpHeader[5] = (timestamp >> 16) & 0xFF;
-    rtpHeader[6] = (timestamp >> 8) & 0xFF;
-    rtpHeader[7] = timestamp & 0xFF;
+    switch (classifyVoiceDatagram(data, datagram.size()))
+    {
+    case VoiceDatagramType::IpDiscovery:
+    {
+        // Extract our external IP
+        QByteArray addressBytes = datagram.mid(8, 64);
+        int nullIndex = addressBytes.indexOf('\0');
+        QString externalIp = QString::fromUtf8(addressBytes.left(nullIndex));
 
-    // SSRC (big endian)
-    rtpHeader[8] = (m_ssrc >> 24) & 0xFF;
-    rtpHeader[9] = (m_ssrc >> 16) & 0xFF;
-    rtpHeader[10] = (m_ssrc >> 8) & 0xFF;
-    rtpHeader[11] = m_ssrc & 0xFF;
+        // Extract our external port (big endian)
+        quint16 externalPort = qFromBigEndian<quint16>(data + 72);
 
-    QByteArray result;
+        qDebug() << "IP Discovery complete - External IP:" << externalIp << "Port:" << externalPort;
 
-    if (m_selectedMode == "aead_aes256_gcm_rtpsize")
-    {
-        // Increment nonce counter (must match discord.js implementation)
-        m_audioNonce++;
-        if (m_audioNonce > 0xFFFFFFFF) // MAX_NONCE_SIZE = 2^32 - 1
+        // Select encryption mode: AES-GCM when the CPU has AES-NI, otherwise XChaCha20
+        QString selectedMode = VoiceCipher::modeName(VoiceCipher::selectMode(m_encryptionModes));
+        if (selectedMode.isEmpty())
         {
-            m_audioNonce = 0;
+            qWarning() << "No supported encryption mode available!";
+            emit error("No supported encryption mode");
+            return;
         }
 
-        // Create 12-byte nonce buffer: [4-byte counter (big-endian)][8 zero bytes]
-        unsigned char nonce[12];
-        std::memset(nonce, 0, 12);
-        qToBigEndian(m_audioNonce, nonce); // Write counter at beginning
-
-        // Encrypt: output = ciphertext + 16 byte tag
-        QByteArray ciphertext(opus.size() + crypto_aead_aes256gcm_ABYTES, 0);
-        unsigned long long ciphertext_len;
-
-        if (crypto_aead_aes256gcm_encrypt(
-                reinterpret_cast<unsigned char *>(ciphertext.data()),
-                &ciphertext_len,
-                reinterpret_cast<const unsigned char *>(opus.constData()),
-                opus.size(),
-                reinterpret_cast<const unsigned char *>(rtpHeader.constData()),
-                rtpHeader.size(),
-                nullptr,
-                nonce,
-                reinterpret_cast<const unsigned char *>(m_secretKey.constData())) != 0)
+        // Send Select Protocol
+        sendSelectProtocol(externalIp, externalPort, selectedMode);
+        break;
+    }
+    case VoiceDatagramType::Rtcp:
+    {
+        RtcpPacketView rtcp;
+        if (rtcp.parse(data, datagram.size()))
         {
-            qWarning() << "AES-GCM encryption failed";
-            return QByteArray();
+            handleRtcp(rtcp);
         }
-
-        ciphertext.resize(static_cast<int>(ciphertext_len));
-
-        // Append the 4-byte nonce padding (first 4 bytes of nonce buffer)
-        QByteArray nonceBytes(4, 0);
-        qToBigEndian(m_audioNonce, reinterpret_cast<uchar *>(nonceBytes.data()));
-
-        result = rtpHeader + ciphertext + nonceBytes;
+        break;
     }
-    else if (m_selectedMode == "aead_xchacha20_poly1305_rtpsize")
+    case VoiceDatagramType::Rtp:
     {
-        // AEAD XChaCha20-Poly1305 with RTP size nonce
-        // Nonce is 24 bytes: RTP header + 12 zero bytes
-        unsigned char nonce[24];
-        std::memcpy(nonce, rtpHeader.constData(), 12);
-        std::memset(nonce + 12, 0, 12);
-
-        // Encrypt: output = ciphertext + 16 byte tag
-        QByteArray ciphertext(opus.size() + crypto_aead_xchacha20poly1305_ietf_ABYTES, 0);
-        unsigned long long ciphertext_len;
+        RtpPacketView rtp;
+        if (!rtp.parse(data, datagram.size()))
+        {
+            qDebug() << "Dropping malformed RTP packet of" << datagram.size() << "bytes";
+            break;
+        }
 
-        if (crypto_aead_xchacha20poly1305_ietf_encrypt(
-                reinterpret_cast<unsigned char *>(ciphertext.data()),
-                &ciphertext_len,
-                reinterpret_cast<const unsigned char *>(opus.constData()),
-                opus.size(),
-                reinterpret_cast<const unsigned char *>(rtpHeader.constData()),
-                rtpHeader.size(),
-                nullptr,
-                nonce,
-                reinterpret_cast<const unsigned char *>(m_secretKey.constData())) != 0)
+        // The RTP header is sent in the clear, so statistics don't depend
+        // on the payload decrypting
+        m_receiveStats.update(rtp.ssrc, rtp.sequence, rtp.timestamp, m_receiveClock.nsecsElapsed());
+        s_packetsReceivedMetric.add();
+        if (++m_packetsSinceMetrics >= METRICS_PACKET_INTERVAL)
         {
-            qWarning() << "XChaCha20-Poly1305 encryption failed";
-            return QByteArray();
+            m_packetsSinceMetrics = 0;
+            publishReceiveMetrics();
         }
 
-        ciphertext.resize(static_cast<int>(ciphertext_len));
-        result = rtpHeader + ciphertext;
+        QByteArray decrypted = decryptAudio(rtp);
+        if (!decrypted.isEmpty())
+        {
+            if (!m_audioRestored && m_resumeElapsed.isValid())
+            {
+                m_audioRestored = true;
+                qDebug() << "Voice audio flowing" << m_resumeElapsed.elapsed() << "ms after gateway drop";
+            }
+            emit audioDataReceived(rtp.ssrc, decrypted);
+        }
+        else
+        {
+            qDebug() << "Failed to decrypt audio packet";
+            s_decryptFailuresMetric.add();
+        }
+        break;
     }
-    else
-    {
-        qWarning() << "Unsupported encryption mode:" << m_selectedMode;
-        return QByteArray();
+    case VoiceDatagramType::Invalid:
+        break;
     }
-
-    return result;
 }
 
-QByteArray VoiceClient::decryptAudio(const QByteArray &encrypted)
+QByteArray VoiceClient::decryptAudio(const RtpPacketView &packet)
 {
-    if (m_secretKey.isEmpty() || m_selectedMode.isEmpty())
+    if (!m_cipher.isReady())
     {
         qWarning() << "Cannot decrypt: secret key or mode not set";
         return QByteArray();
     }
 
-    if (encrypted.size() < 12)
+    // Packet structure: [RTP header + extension header][encrypted extension data + payload][16-byte tag][4-byte nonce]
+    int ciphertextSize = packet.payloadSize() - VoiceCipher::TAG_SIZE - 4;
+    if (ciphertextSize < packet.extensionDataSize)
     {
-        qWarning() << "Encrypted data too small (missing RTP header)";
+        qWarning() << "Packet too small for rtpsize mode";
         return QByteArray();
     }
-
-    // Calculate RTP header size for AAD (excludes extension data)
-    int rtpHeaderSize = getRtpHeaderSizeForAAD(encrypted);
-
-    // For rtpsize modes: the RTP header (base + CSRCs + extension header) is AAD
-    // Extension DATA and Opus payload are encrypted together
-    QByteArray rtpHeader = encrypted.left(rtpHeaderSize);
-
-    // Packet structure: [RTP header with extensions][encrypted data + tag][4-byte nonce]
-    if (encrypted.size() < rtpHeaderSize + 16 + 4)
+    if (ciphertextSize > static_cast<int>(sizeof(m_audioBuffer)))
     {
-        qWarning() << "Packet too small for rtpsize mode";
+        qWarning() << "Voice packet too large:" << packet.size << "bytes";
         return QByteArray();
     }
 
-    // Extract 4-byte nonce from end of packet
-    QByteArray nonceBytes = encrypted.right(4);
-
-    // Ciphertext + tag (everything between header and nonce suffix)
-    QByteArray ciphertext = encrypted.mid(rtpHeaderSize, encrypted.size() - rtpHeaderSize - 4);
+    const unsigned char *ciphertext = packet.payload();
+    const unsigned char *tag = ciphertext + ciphertextSize;
 
-    qDebug() << "Decrypting - Header size:" << rtpHeaderSize
-             << "Ciphertext+tag size:" << ciphertext.size()
-             << "Total packet:" << encrypted.size();
+    // Nonce: 4-byte suffix from the end of the packet, zero padded
+    unsigned char nonce[VoiceCipher::NONCE_SIZE] = {};
+    std::memcpy(nonce, packet.data + packet.size - 4, 4);
 
-    QByteArray decrypted;
-
-    if (m_selectedMode == "aead_aes256_gcm_rtpsize")
+    if (m_cipher.decrypt(m_audioBuffer, ciphertext, ciphertextSize,
+                         tag, packet.data, packet.headerSize, nonce) != 0)
     {
-        // AES-GCM nonce: 12 bytes with nonce counter copied as-is
-        unsigned char nonce[12];
-        std::memset(nonce, 0, 12);
-        std::memcpy(nonce, nonceBytes.constData(), 4);
-
-        if (ciphertext.size() < crypto_aead_aes256gcm_ABYTES)
-        {
-            qWarning() << "Ciphertext too small for AES-GCM";
-            return QByteArray();
-        }
+        qWarning() << "Voice packet decryption failed";
+        return QByteArray();
+    }
 
-        QByteArray plaintext(ciphertext.size() - crypto_aead_aes256gcm_ABYTES, 0);
-        unsigned long long plaintext_len;
-
-        if (crypto_aead_aes256gcm_decrypt(
-                reinterpret_cast<unsigned char *>(plaintext.data()),
-                &plaintext_len,
-                nullptr,
-                reinterpret_cast<const unsigned char *>(ciphertext.constData()),
-                ciphertext.size(),
-                reinterpret_cast<const unsigned char *>(rtpHeader.constData()),
-                rtpHeader.size(),
-                nonce,
-                reinterpret_cast<const unsigned char *>(m_secretKey.constData())) != 0)
-        {
-            qWarning() << "AES-GCM decryption failed";
-            return QByteArray();
-        }
+    // The extension header is authenticated in the clear but its data is
+    // encrypted with the payload; point past it to leave only the Opus frame.
+    // Wraps m_audioBuffer, so it is only valid until the next packet
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(m_audioBuffer) + packet.extensionDataSize,
+                                   ciphertextSize - packet.extensionDataSize);
+}
 
-        plaintext.resize(static_cast<int>(plaintext_len));
-        decrypted = plaintext;
-    }
-    else if (m_selectedMode == "aead_xchacha20_poly1305_rtpsize")
-    {
-        // XChaCha20 nonce: 24 bytes with nonce counter copied as-is
-        unsigned char nonce[24];
-        std::memset(nonce, 0, 24);
-        std::memcpy(nonce, nonceBytes.constData(), 4);
+void VoiceClient::handleRtcp(const RtcpPacketView &packet)
+{
+    if (!m_cipher.isReady())
+        return;
 
-        if (ciphertext.size() < crypto_aead_xchacha20poly1305_ietf_ABYTES)
-        {
-            qWarning() << "Ciphertext too small for XChaCha20-Poly1305";
-            return QByteArray();
-        }
+    // RTCP uses the same rtpsize layout as RTP with the 8-byte common
+    // header + sender SSRC as additional data
+    int ciphertextSize = packet.size - RtcpPacketView::HEADER_SIZE - VoiceCipher::TAG_SIZE - 4;
+    if (ciphertextSize <= 0 || ciphertextSize > static_cast<int>(sizeof(m_rtcpBuffer)))
+        return;
 
-        QByteArray plaintext(ciphertext.size() - crypto_aead_xchacha20poly1305_ietf_ABYTES, 0);
-        unsigned long long plaintext_len;
-
-        if (crypto_aead_xchacha20poly1305_ietf_decrypt(
-                reinterpret_cast<unsigned char *>(plaintext.data()),
-                &plaintext_len,
-                nullptr,
-                reinterpret_cast<const unsigned char *>(ciphertext.constData()),
-                ciphertext.size(),
-                reinterpret_cast<const unsigned char *>(rtpHeader.constData()),
-                rtpHeader.size(),
-                nonce,
-                reinterpret_cast<const unsigned char *>(m_secretKey.constData())) != 0)
-        {
-            qWarning() << "XChaCha20-Poly1305 decryption failed";
-            return QByteArray();
-        }
+    const unsigned char *ciphertext = packet.data + RtcpPacketView::HEADER_SIZE;
+    unsigned char nonce[VoiceCipher::NONCE_SIZE] = {};
+    std::memcpy(nonce, packet.data + packet.size - 4, 4);
 
-        plaintext.resize(static_cast<int>(plaintext_len));
-        decrypted = plaintext;
-    }
-    else
+    if (m_cipher.decrypt(m_rtcpBuffer, ciphertext, ciphertextSize, ciphertext + ciphertextSize,
+                         packet.data, RtcpPacketView::HEADER_SIZE, nonce) != 0)
     {
-        qWarning() << "Unsupported encryption mode:" << m_selectedMode;
-        return QByteArray();
+        return;
     }
 
-    qDebug() << "Successfully decrypted" << decrypted.size() << "bytes";
-
-    // Strip RTP extension DATA from the decrypted payload if present
-    // The extension HEADER is in AAD, but extension DATA is encrypted
-    if (encrypted.size() >= 12)
+    int blocks = packet.reportBlockCount(ciphertextSize);
+    for (int i = 0; i < blocks; ++i)
     {
-        quint8 byte0 = static_cast<quint8>(encrypted[0]);
-        quint8 cc = byte0 & 0x0F;
-        bool hasExtension = (byte0 & 0x10) != 0;
+        RtcpReportBlock block = RtcpPacketView::reportBlock(m_rtcpBuffer, packet.packetType, i);
+        if (block.ssrc != m_ssrc)
+            continue;
 
-        if (hasExtension)
-        {
-            int baseHeaderSize = 12 + (cc * 4);
+        // The server's view of our stream: feed its loss figure to the encoder
+        m_uplinkLoss = block.fractionLost / 256.0;
+        s_uplinkLossMetric.set(m_uplinkLoss * 100.0);
+        emit networkStatsUpdated(m_uplinkLoss, m_lastRttMs);
+    }
+}
 
-            // Read extension length from the original RTP header (in AAD)
-            if (encrypted.size() >= baseHeaderSize + 4)
-            {
-                quint16 extensionLength = qFromBigEndian<quint16>(
-                    reinterpret_cast<const uchar *>(encrypted.constData() + baseHeaderSize + 2));
+RtpReceiveStats::Report VoiceClient::receiveReport(quint32 ssrc)
+{
+    return m_receiveStats.report(ssrc);
+}
 
-                int extensionDataSize = extensionLength * 4; // Length is in 32-bit words
+void VoiceClient::publishReceiveMetrics()
+{
+    qint64 expected = 0;
+    qint64 lost = 0;
+    double jitterMs = 0.0;
+    for (quint32 ssrc : m_receiveStats.sources())
+    {
+        RtpReceiveStats::Report report = m_receiveStats.cumulativeReport(ssrc);
+        expected += report.expected;
+        lost += qMax<qint64>(0, report.cumulativeLost);
+        jitterMs = qMax(jitterMs, report.jitterMs);
+    }
+    s_downlinkLossMetric.set(expected > 0 ? 100.0 * lost / expected : 0.0);
+    s_jitterMetric.set(jitterMs);
+}
 
-                if (decrypted.size() >= extensionDataSize)
-                {
-                    // Skip the extension data, return only Opus payload
-                    decrypted = decrypted.mid(extensionDataSize);
-                    qDebug() << "Stripped" << extensionDataSize << "bytes of RTP extension data, Opus payload:" << decrypted.size() << "bytes";
-                }
-            }
-        }
+void VoiceClient::logReceiveStats()
+{
+    for (quint32 ssrc : m_receiveStats.sources())
+    {
+        RtpReceiveStats::Report report = m_receiveStats.report(ssrc);
+        qDebug() << "RTP receive stats for SSRC" << ssrc << "- received:" << report.received
+                 << "expected:" << report.expected << "lost:" << report.cumulativeLost
+                 << "jitter:" << report.jitterMs << "ms";
     }
-
-    return decrypted;
 }
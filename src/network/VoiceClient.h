@@ -4,8 +4,15 @@
 #include <QWebSocket>
 #include <QTimer>
 #include <QJsonObject>
-#include <QUdpSocket>
+#include <QElapsedTimer>
 #include "Types.h"
+#include "RtpSendScheduler.h"
+#include "RtpPacketBuilder.h"
+#include "VoiceCipher.h"
+#include "UdpTransport.h"
+#include "RtpPacket.h"
+#include "RtpReceiveStats.h"
+#include "HeartbeatMonitor.h"
 
 class AudioManager;
 
@@ -25,24 +32,44 @@ public:
     void setSelfMute(bool mute);
     void setSelfDeaf(bool deaf);
 
-    // Send Opus-encoded audio data
+    // Toggle the Speaking opcode as voice activity starts and stops
+    void setSpeaking(bool speaking);
+
+    // Queue Opus-encoded audio data; frames leave on the paced 20ms send clock
     void sendAudio(const QByteArray &opusData);
 
+    // RFC 3550 receive statistics for a remote SSRC since the previous call
+    RtpReceiveStats::Report receiveReport(quint32 ssrc);
+
+    // Voice gateway heartbeat round trips over the last few heartbeats
+    HeartbeatMonitor::Summary heartbeatSummary() const { return m_heartbeatMonitor.summary(); }
+
 signals:
     void connected();
     void disconnected();
+    void resumed(); // Signalling session resumed after a websocket drop
     void error(const QString &error);
     void ready(const QString &ip, quint16 port, quint32 ssrc);
-    void audioDataReceived(const QByteArray &opusData); // Decrypted Opus data from other users
+    // Decrypted Opus data from other users. The array wraps the receive
+    // decrypt buffer without copying it and is only valid during the emit;
+    // the next packet overwrites it. Connect directly and copy anything kept
+    // or handed to another thread.
+    void audioDataReceived(quint32 ssrc, const QByteArray &opusData);
+    void userSsrcMapped(Snowflake userId, quint32 ssrc);               // From the Speaking opcode
+    void userDisconnected(Snowflake userId);
+    void networkStatsUpdated(double lossFraction, int rttMs); // lossFraction < 0 when unknown
+    void heartbeatRttMeasured(int rttMs);
 
 private slots:
     void onWebSocketConnected();
     void onWebSocketDisconnected();
+    void attemptResume();
     void onWebSocketTextMessageReceived(const QString &message);
     void onWebSocketBinaryMessageReceived(const QByteArray &message);
     void onWebSocketError(QAbstractSocket::SocketError error);
     void sendHeartbeat();
     void onUdpReadyRead();
+    void transmitFrame(const QByteArray &opusData, quint32 timestamp);
 
 private:
     // WebSocket operations
@@ -50,6 +77,8 @@ private:
     void sendSelectProtocol(const QString &ip, quint16 port, const QString &mode);
     void sendSpeaking(int flags);
     void sendResume();
+    QUrl voiceGatewayUrl() const;
+    static bool canResume(QWebSocketProtocol::CloseCode closeCode);
 
     // Voice opcodes
     void handleOpcode(int opcode, const QJsonObject &data);
@@ -61,8 +90,11 @@ private:
 
     // UDP operations
     void performIpDiscovery();
-    QByteArray encryptAudio(const QByteArray &opus, quint16 sequence, quint32 timestamp);
-    QByteArray decryptAudio(const QByteArray &encrypted);
+    void handleDatagram(const QByteArray &datagram);
+    QByteArray decryptAudio(const RtpPacketView &packet);
+    void handleRtcp(const RtcpPacketView &packet);
+    void logReceiveStats();
+    void publishReceiveMetrics();
 
     // Voice gateway version 8 (recommended)
     static constexpr int VOICE_GATEWAY_VERSION = 8;
@@ -81,6 +113,7 @@ private:
     QStringList m_encryptionModes;
     QString m_selectedMode;
     QByteArray m_secretKey; // 32 bytes for encryption
+    VoiceCipher m_cipher;   // Keyed once per session from m_secretKey
     int m_daveProtocolVersion = 0;
 
     // State
@@ -91,15 +124,37 @@ private:
     // Heartbeat
     QTimer *m_heartbeatTimer = nullptr;
     int m_heartbeatInterval = 0;
+    static constexpr int CLOSE_TIMEOUT_MS = 3000; // A dead peer never answers the close handshake
     qint64 m_lastHeartbeatNonce = 0;
+    HeartbeatMonitor m_heartbeatMonitor; // RTT of m_lastHeartbeatNonce and zombie detection
+    int m_lastRttMs = -1;                // Recent median, for the encoder
+    double m_uplinkLoss = -1.0; // Fraction of our packets lost, once reported
     int m_lastSequence = -1; // For voice gateway v8 buffered resume
 
+    // Resume
+    static constexpr int MAX_RESUME_ATTEMPTS = 5;
+    QTimer *m_resumeTimer = nullptr;
+    bool m_closing = false;  // disconnectFromVoice() in progress, don't resume
+    bool m_resuming = false; // Send Resume instead of Identify on the next Hello
+    bool m_droppingZombie = false; // Closing a dead socket; abort if the close stalls
+    int m_resumeAttempts = 0;
+    QElapsedTimer m_resumeElapsed; // Since the last drop, for time-to-restore logging
+    bool m_audioRestored = false;
+
+    // Receive side
+    RtpReceiveStats m_receiveStats;
+    QElapsedTimer m_receiveClock;     // Arrival times for jitter estimation
+    unsigned char m_rtcpBuffer[1500]; // Decrypted RTCP body
+    unsigned char m_audioBuffer[UdpTransport::MAX_DATAGRAM_SIZE]; // Decrypted RTP payload, see audioDataReceived
+    static constexpr int METRICS_PACKET_INTERVAL = 50; // About once a second per speaker
+    int m_packetsSinceMetrics = 0;
+
     // Sockets
     QWebSocket *m_webSocket = nullptr;
-    QUdpSocket *m_udpSocket = nullptr;
+    UdpTransport *m_udpTransport = nullptr;
+    RtpSendScheduler *m_sendScheduler = nullptr;
 
-    // Audio sequence
+    // Audio sequence (timestamps come from the send scheduler's sample clock)
     quint16 m_audioSequence = 0;
-    quint32 m_audioTimestamp = 0;
-    quint32 m_audioNonce = 0; // Incremental nonce for encryption
+    RtpPacketBuilder m_packetBuilder; // Reusable datagram buffer and nonce counter
 };
@@ -0,0 +1,142 @@
+#include "DiagnosticsPanel.h"
+#include <QVBoxLayout>
+#include <QLabel>
+#include <QHeaderView>
+#include <QTableWidget>
+#include <QTimer>
+
+namespace
+{
+enum Column
+{
+    NameColumn,
+    ValueColumn,
+    RateColumn,
+    P50Column,
+    P99Column,
+    MaxColumn,
+    ColumnCount
+};
+
+QString formatDuration(qint64 ns)
+{
+    if (ns < 1000000)
+        return QString::number(ns / 1000.0, 'f', 1) + " us";
+    return QString::number(ns / 1000000.0, 'f', 2) + " ms";
+}
+
+QString formatValue(double value)
+{
+    if (value == static_cast<qint64>(value))
+        return QString::number(static_cast<qint64>(value));
+    return QString::number(value, 'f', 2);
+}
+}
+
+DiagnosticsPanel::DiagnosticsPanel(QWidget *parent)
+    : QWidget(parent),
+      m_table(new QTableWidget(0, ColumnCount, this)),
+      m_refreshTimer(new QTimer(this))
+{
+    setFixedWidth(460);
+    setStyleSheet("QWidget { background-color: #2F3136; color: #DCDDDE; }"
+                  "QHeaderView::section { background-color: #202225; color: #B9BBBE; border: none; padding: 4px; }"
+                  "QTableWidget { border: none; gridline-color: #202225; font-family: monospace; font-size: 11px; }");
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(8, 8, 8, 8);
+
+    QLabel *title = new QLabel("Diagnostics", this);
+    title->setStyleSheet("QLabel { font-weight: bold; color: #FFFFFF; }");
+    layout->addWidget(title);
+
+    m_table->setHorizontalHeaderLabels({"Metric", "Value", "/s", "p50", "p99", "Max"});
+    m_table->verticalHeader()->hide();
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionMode(QAbstractItemView::NoSelection);
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_table->horizontalHeader()->setSectionResizeMode(NameColumn, QHeaderView::Stretch);
+    layout->addWidget(m_table);
+
+    m_refreshTimer->setInterval(REFRESH_INTERVAL_MS);
+    connect(m_refreshTimer, &QTimer::timeout, this, &DiagnosticsPanel::refresh);
+}
+
+void DiagnosticsPanel::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    refresh();
+    m_refreshTimer->start();
+}
+
+void DiagnosticsPanel::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    m_refreshTimer->stop();
+
+    // Rates start over on the next show rather than averaging the hidden time
+    m_sinceRefresh.invalidate();
+    m_previousCounters.clear();
+}
+
+void DiagnosticsPanel::refresh()
+{
+    const QList<Metrics::Entry> entries = Metrics::snapshot();
+    const double seconds = m_sinceRefresh.isValid() ? m_sinceRefresh.restart() / 1000.0 : 0.0;
+    if (!m_sinceRefresh.isValid())
+        m_sinceRefresh.start();
+
+    auto rate = [&](const QString &name, double total) {
+        auto previous = m_previousCounters.constFind(name);
+        QString text = (seconds > 0.0 && previous != m_previousCounters.constEnd())
+                           ? QString::number((total - previous.value()) / seconds, 'f', 1)
+                           : QString();
+        m_previousCounters[name] = total;
+        return text;
+    };
+
+    m_table->setRowCount(entries.size());
+    for (int row = 0; row < entries.size(); ++row)
+    {
+        const Metrics::Entry &entry = entries.at(row);
+        QString cells[ColumnCount];
+        cells[NameColumn] = entry.name;
+
+        switch (entry.kind)
+        {
+        case Metrics::Kind::Counter:
+            cells[ValueColumn] = formatValue(entry.value);
+            cells[RateColumn] = rate(entry.name, entry.value);
+            break;
+        case Metrics::Kind::Gauge:
+            cells[ValueColumn] = formatValue(entry.value);
+            break;
+        case Metrics::Kind::Histogram:
+        {
+            const LatencyHistogram::Snapshot &h = entry.histogram;
+            cells[ValueColumn] = QString::number(h.count);
+            cells[RateColumn] = rate(entry.name, static_cast<double>(h.count));
+            if (h.count > 0)
+            {
+                cells[P50Column] = formatDuration(h.percentileNs(0.50));
+                cells[P99Column] = formatDuration(h.percentileNs(0.99));
+                cells[MaxColumn] = formatDuration(h.maxNs);
+            }
+            break;
+        }
+        }
+
+        for (int column = 0; column < ColumnCount; ++column)
+        {
+            QTableWidgetItem *item = m_table->item(row, column);
+            if (!item)
+            {
+                item = new QTableWidgetItem;
+                if (column != NameColumn)
+                    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                m_table->setItem(row, column, item);
+            }
+            item->setText(cells[column]);
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QWidget>
+#include <QHash>
+#include <QElapsedTimer>
+#include "utils/Metrics.h"
+
+class QTableWidget;
+class QTimer;
+
+// Live view of the metrics registry: counters with their rate since the
+// previous refresh, gauges, and latency percentiles. Refreshes once a second
+// while visible and costs nothing while hidden.
+class DiagnosticsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    static constexpr int REFRESH_INTERVAL_MS = 1000;
+
+    explicit DiagnosticsPanel(QWidget *parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    void refresh();
+
+    QTableWidget *m_table;
+    QTimer *m_refreshTimer;
+    QHash<QString, double> m_previousCounters;
+    QElapsedTimer m_sinceRefresh;
+};
@@ -1,8 +1,11 @@
 #include "MainWindow.h"
 #include "LoginDialog.h"
 #include "SettingsDialog.h"
+#include "DiagnosticsPanel.h"
 #include "network/VoiceClient.h"
 #include "utils/DiscordMarkdown.h"
+#include "utils/Metrics.h"
+#include "utils/Trace.h"
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QWidget>
@@ -14,9 +17,22 @@
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QNetworkReply>
-#include <QBuffer>
 #include <QLocale>
 #include <QTimer>
+#include <QShortcut>
+#include <QMenu>
+#include <QSlider>
+#include <QWidgetAction>
+
+namespace
+{
+LatencyHistogram &s_displayMessagesMetric = Metrics::histogram("ui.display_messages");
+MetricGauge &s_messagesShownMetric = Metrics::gauge("ui.messages_shown");
+
+// Channel list rows for voice participants carry the user id here
+constexpr int VOICE_USER_ROLE = Qt::UserRole + 1;
+constexpr float SPEAKING_LEVEL = 0.02f; // Stream peak that counts as talking
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
@@ -49,11 +65,21 @@ MainWindow::MainWindow(QWidget *parent)
     m_noAnswerTimer->setInterval(300000); // 5 minutes
     connect(m_noAnswerTimer, &QTimer::timeout, this, &MainWindow::onNoAnswerTimeout);
 
+    m_avatarRefreshTimer = new QTimer(this);
+    m_avatarRefreshTimer->setSingleShot(true);
+    m_avatarRefreshTimer->setInterval(30); // A couple of frames
+    connect(m_avatarRefreshTimer, &QTimer::timeout, this, &MainWindow::displayMessages);
+
+    m_voiceLevelTimer = new QTimer(this);
+    m_voiceLevelTimer->setInterval(100);
+    connect(m_voiceLevelTimer, &QTimer::timeout, this, &MainWindow::updateVoiceUserLevels);
+
     // Initialize audio manager
     if (!m_audioManager->initialize())
     {
         qWarning() << "Failed to initialize audio manager";
     }
+    m_audioManager->loadVolumeSettings();
 
     setupUI();
     connectSignals();
@@ -173,6 +199,11 @@ void MainWindow::setupUI()
     QHBoxLayout *topBarLayout = new QHBoxLayout(topBar);
     topBarLayout->setContentsMargins(16, 0, 16, 0);
 
+    m_pingLabel = new QLabel(topBar);
+    m_pingLabel->setStyleSheet("QLabel { color: #B9BBBE; border: none; }");
+    m_pingLabel->hide(); // Until the first heartbeat is acknowledged
+    topBarLayout->addWidget(m_pingLabel);
+
     topBarLayout->addStretch();
 
     m_callBtn = new QPushButton("📞 Call", topBar);
@@ -183,6 +214,16 @@ void MainWindow::setupUI()
     m_callBtn->hide(); // Hidden by default, shown for DM channels
     topBarLayout->addWidget(m_callBtn);
 
+    m_diagnosticsBtn = new QPushButton("📈", topBar);
+    m_diagnosticsBtn->setCheckable(true);
+    m_diagnosticsBtn->setStyleSheet(
+        "QPushButton { background-color: transparent; color: #B9BBBE; border-radius: 4px; padding: 4px; font-size: 16px; }"
+        "QPushButton:hover { background-color: #4F545C; }"
+        "QPushButton:checked { background-color: #4F545C; }");
+    m_diagnosticsBtn->setFixedSize(32, 32);
+    m_diagnosticsBtn->setToolTip("Diagnostics (Ctrl+Shift+D)");
+    topBarLayout->addWidget(m_diagnosticsBtn);
+
     chatLayout->addWidget(topBar);
 
     // Message display with scroll to bottom button
@@ -220,6 +261,11 @@ void MainWindow::setupUI()
     chatLayout->addWidget(m_messageInput);
     mainLayout->addWidget(chatPanel);
 
+    // 4. Diagnostics (far right, toggled)
+    m_diagnosticsPanel = new DiagnosticsPanel(m_centralWidget);
+    m_diagnosticsPanel->hide();
+    mainLayout->addWidget(m_diagnosticsPanel);
+
     setCentralWidget(m_centralWidget);
 
     // Try auto-login after UI is set up
@@ -231,12 +277,21 @@ void MainWindow::connectSignals()
     connect(m_guildList, &QListWidget::itemClicked, this, &MainWindow::onGuildSelected);
     connect(m_channelList, &QListWidget::itemClicked, this, &MainWindow::onChannelSelected);
     connect(m_channelList, &QListWidget::itemDoubleClicked, this, &MainWindow::onChannelDoubleClicked);
+    m_channelList->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(m_channelList, &QListWidget::customContextMenuRequested, this, &MainWindow::showChannelContextMenu);
     connect(m_scrollToBottomBtn, &QPushButton::clicked, this, &MainWindow::scrollToBottom);
     connect(m_logoutBtn, &QPushButton::clicked, this, &MainWindow::onLogoutClicked);
     connect(m_settingsBtn, &QPushButton::clicked, this, &MainWindow::onSettingsClicked);
     connect(m_muteBtn, &QPushButton::clicked, this, &MainWindow::onMuteToggled);
     connect(m_deafenBtn, &QPushButton::clicked, this, &MainWindow::onDeafenToggled);
     connect(m_callBtn, &QPushButton::clicked, this, &MainWindow::onCallButtonClicked);
+    connect(m_diagnosticsBtn, &QPushButton::clicked, this, &MainWindow::toggleDiagnostics);
+
+    // Ping indicator from measured heartbeat round trips
+    connect(m_client->gateway(), &GatewayClient::heartbeatRttMeasured, this, &MainWindow::updatePingIndicator);
+    connect(m_client->gateway(), &GatewayClient::disconnected, this, &MainWindow::updatePingIndicator);
+    connect(m_client->getVoiceClient(), &VoiceClient::heartbeatRttMeasured, this, &MainWindow::updatePingIndicator);
+    connect(new QShortcut(QKeySequence("Ctrl+Shift+D"), this), &QShortcut::activated, this, &MainWindow::toggleDiagnostics);
 
     // Voice client connections
     connect(m_client->getVoiceClient(), &VoiceClient::ready, this, &MainWindow::onVoiceReady);
@@ -248,9 +303,19 @@ void MainWindow::connectSignals()
 
     // Audio manager connections - send audio to voice client
     connect(m_audioManager, &AudioManager::opusDataReady, m_client->getVoiceClient(), &VoiceClient::sendAudio);
-
-    // Voice client audio received - play it
-    connect(m_client->getVoiceClient(), &VoiceClient::audioDataReceived, m_audioManager, &AudioManager::addOpusData);
+    connect(m_audioManager, &AudioManager::speakingChanged, m_client->getVoiceClient(), &VoiceClient::setSpeaking);
+    connect(m_client->getVoiceClient(), &VoiceClient::networkStatsUpdated, m_audioManager, &AudioManager::updateNetworkStats);
+
+    // Voice client audio received - play it. Direct: the packet is only
+    // valid during the emit (see audioDataReceived)
+    connect(m_client->getVoiceClient(), &VoiceClient::audioDataReceived, m_audioManager, &AudioManager::addOpusData,
+            Qt::DirectConnection);
+    connect(m_client->getVoiceClient(), &VoiceClient::userSsrcMapped, m_audioManager, &AudioManager::mapUserSsrc);
+    connect(m_client->getVoiceClient(), &VoiceClient::userDisconnected, m_audioManager, &AudioManager::removeUser);
+    connect(m_audioManager, &AudioManager::voiceUsersChanged, this, [this]()
+            {
+        if (m_isInVoice)
+            updateChannelList(); });
 
     // Avatar cache connections - refresh display when avatars load
     connect(m_avatarCache, &AvatarCache::avatarReady, this, [this](Snowflake userId)
@@ -266,10 +331,10 @@ void MainWindow::connectSignals()
             }
         }
 
-        if (needsRefresh)
+        if (needsRefresh && !m_avatarRefreshTimer->isActive())
         {
-            // Refresh the display to show the new avatar
-            displayMessages();
+            // Refresh the display to show the new avatar, once for a burst
+            m_avatarRefreshTimer->start();
         } });
 
     // Scroll detection for loading more messages and showing/hiding scroll button
@@ -638,6 +703,9 @@ void MainWindow::updateChannelList()
             QListWidgetItem *item = new QListWidgetItem(name);
             item->setData(Qt::UserRole, QString::number(dm.id));
             m_channelList->addItem(item);
+
+            if (m_isInVoice && dm.id == m_currentVoiceChannelId)
+                addVoiceUserItems();
         }
     }
     else
@@ -686,6 +754,9 @@ void MainWindow::updateChannelList()
                         }
 
                         m_channelList->addItem(item);
+
+                        if (c.isVoice() && m_isInVoice && c.id == m_currentVoiceChannelId)
+                            addVoiceUserItems();
                     }
                 }
                 break;
@@ -694,6 +765,95 @@ void MainWindow::updateChannelList()
     }
 }
 
+void MainWindow::addVoiceUserItems()
+{
+    // Under the connected channel; right-click for the user's volume
+    for (Snowflake userId : m_audioManager->voiceUsers())
+    {
+        QListWidgetItem *item = new QListWidgetItem("        " + voiceUserName(userId));
+        item->setData(VOICE_USER_ROLE, QString::number(userId));
+        item->setFlags(Qt::ItemIsEnabled);
+        item->setForeground(QColor(150, 150, 150));
+        m_channelList->addItem(item);
+    }
+}
+
+QString MainWindow::voiceUserName(Snowflake userId) const
+{
+    for (const Channel &dm : m_client->getPrivateChannels())
+    {
+        for (const User &recipient : dm.recipients)
+        {
+            if (recipient.id == userId)
+                return recipient.username;
+        }
+    }
+
+    for (const Message &message : m_currentMessages)
+    {
+        if (message.author.id == userId)
+            return message.author.username;
+    }
+
+    return QString("User %1").arg(userId);
+}
+
+void MainWindow::updateVoiceUserLevels()
+{
+    if (!m_isInVoice)
+    {
+        m_voiceLevelTimer->stop();
+        return;
+    }
+
+    for (int row = 0; row < m_channelList->count(); ++row)
+    {
+        QListWidgetItem *item = m_channelList->item(row);
+        QVariant userId = item->data(VOICE_USER_ROLE);
+        if (!userId.isValid())
+            continue;
+
+        bool speaking = m_audioManager->userLevel(userId.toULongLong()) > SPEAKING_LEVEL;
+        item->setForeground(speaking ? QColor(67, 181, 129) : QColor(150, 150, 150));
+    }
+}
+
+void MainWindow::showChannelContextMenu(const QPoint &pos)
+{
+    QListWidgetItem *item = m_channelList->itemAt(pos);
+    if (!item || !item->data(VOICE_USER_ROLE).isValid())
+        return;
+
+    Snowflake userId = item->data(VOICE_USER_ROLE).toULongLong();
+
+    QMenu menu(this);
+    QWidget *volumeWidget = new QWidget(&menu);
+    QHBoxLayout *volumeLayout = new QHBoxLayout(volumeWidget);
+    QLabel *volumeLabel = new QLabel(volumeWidget);
+    QSlider *volumeSlider = new QSlider(Qt::Horizontal, volumeWidget);
+    volumeSlider->setRange(0, 200);
+    volumeSlider->setValue(qRound(m_audioManager->userVolume(userId) * 100.0f));
+    volumeSlider->setMinimumWidth(150);
+    volumeLabel->setText(QString("User Volume: %1%").arg(volumeSlider->value()));
+    volumeLayout->addWidget(volumeLabel);
+    volumeLayout->addWidget(volumeSlider);
+
+    // Applies while dragging so the user can hear the change
+    connect(volumeSlider, &QSlider::valueChanged, this, [this, userId, volumeLabel](int percent)
+            {
+        volumeLabel->setText(QString("User Volume: %1%").arg(percent));
+        m_audioManager->setUserVolume(userId, percent / 100.0f); });
+
+    QWidgetAction *volumeAction = new QWidgetAction(&menu);
+    volumeAction->setDefaultWidget(volumeWidget);
+    menu.addAction(volumeAction);
+    menu.addAction("Reset Volume", this, [volumeSlider]()
+                   { volumeSlider->setValue(100); });
+
+    menu.exec(m_channelList->viewport()->mapToGlobal(pos));
+    m_audioManager->saveVolumeSettings();
+}
+
 void MainWindow::showLoginDialog()
 {
     LoginDialog *dialog = new LoginDialog(this);
@@ -849,6 +1009,10 @@ void MainWindow::addMessage(const Message &message)
 
 void MainWindow::displayMessages()
 {
+    TRACE_SCOPE("ui", "displayMessages");
+    MetricTimer displayTimer(s_displayMessagesMetric);
+    s_messagesShownMetric.set(m_currentMessages.size());
+
     // Temporarily block scroll signals to prevent auto-loading while rendering
     QScrollBar *scrollBar = m_messageLog->verticalScrollBar();
     bool wasBlocked = scrollBar->blockSignals(true);
@@ -954,19 +1118,10 @@ QString MainWindow::formatMessageHtml(const Message &msg, bool grouped)
         return html;
     }
 
-    // Get avatar as base64 data URL or use default
-    QString avatarData;
-    QPixmap avatar = m_avatarCache->getAvatar(msg.author.id, msg.author.avatar);
+    // Avatar as a PNG data URL (encoded on a decode worker) or the default
+    QString avatarData = m_avatarCache->getAvatarDataUrl(msg.author.id, msg.author.avatar);
 
-    if (!avatar.isNull())
-    {
-        QByteArray ba;
-        QBuffer buffer(&ba);
-        buffer.open(QIODevice::WriteOnly);
-        avatar.save(&buffer, "PNG");
-        avatarData = QString("data:image/png;base64,%1").arg(QString(ba.toBase64()));
-    }
-    else
+    if (avatarData.isEmpty())
     {
         // Default gray circle with first letter of username
         avatarData = "data:image/svg+xml;base64," + QString::fromLatin1(
@@ -1076,6 +1231,7 @@ void MainWindow::onVoiceReady()
     m_deafenBtn->setEnabled(true);
     m_muteBtn->setChecked(m_isMuted);
     m_deafenBtn->setChecked(m_isDeafened);
+    m_voiceLevelTimer->start();
 
     if (!m_isMuted && !m_isDeafened)
     {
@@ -1087,6 +1243,7 @@ void MainWindow::updateVoiceUI()
 {
     // Update channel list to show voice connection status
     updateChannelList();
+    updatePingIndicator();
 }
 
 void MainWindow::onMuteToggled()
@@ -1194,19 +1351,76 @@ void MainWindow::onLogoutClicked()
 
 void MainWindow::onSettingsClicked()
 {
-    SettingsDialog settingsDialog(this);
+    // The dialog applies volume changes live; Cancel puts the old one back
+    float previousVolume = m_audioManager->outputVolume();
+    SettingsDialog settingsDialog(m_audioManager, this);
 
     if (settingsDialog.exec() == QDialog::Accepted)
     {
         QString inputDevice = settingsDialog.getSelectedInputDevice();
         QString outputDevice = settingsDialog.getSelectedOutputDevice();
 
-        qDebug() << "Audio settings saved - Input:" << inputDevice << "Output:" << outputDevice;
+        qDebug() << "Audio settings saved - Input:" << inputDevice << "Output:" << outputDevice
+                 << "Volume:" << m_audioManager->outputVolume();
+        m_audioManager->saveVolumeSettings();
 
         // TODO: Apply device changes to AudioManager
         // For now, just log the selection
     }
+    else
+    {
+        m_audioManager->setOutputVolume(previousVolume);
+    }
+}
+void MainWindow::toggleDiagnostics()
+{
+    m_diagnosticsPanel->setVisible(!m_diagnosticsPanel->isVisible());
+    m_diagnosticsBtn->setChecked(m_diagnosticsPanel->isVisible());
+}
+
+void MainWindow::updatePingIndicator()
+{
+    auto describe = [](const char *name, const HeartbeatMonitor::Summary &summary) {
+        if (summary.samples == 0)
+            return QString("%1: no heartbeats yet").arg(name);
+        return QString("%1: %2 ms (median %3 ms, p90 %4 ms, max %5 ms over %6 heartbeats)")
+            .arg(name)
+            .arg(summary.lastMs)
+            .arg(summary.medianMs)
+            .arg(summary.p90Ms)
+            .arg(summary.maxMs)
+            .arg(summary.samples);
+    };
+
+    const HeartbeatMonitor::Summary gateway = m_client->gateway()->heartbeatSummary();
+    const HeartbeatMonitor::Summary voice = m_client->getVoiceClient()->heartbeatSummary();
+    const bool gatewayUp = m_client->gateway()->isConnected();
+    const bool useVoice = (m_isInVoice || m_isInCall) && voice.samples > 0;
+    const int rttMs = useVoice ? voice.lastMs : gateway.lastMs;
+
+    if (!gatewayUp)
+    {
+        m_pingLabel->setText("● offline");
+        m_pingLabel->setStyleSheet("QLabel { color: #72767D; border: none; }");
+    }
+    else if (rttMs >= 0)
+    {
+        const char *color = rttMs < 100 ? "#3BA55D" : rttMs < 250 ? "#FAA61A" : "#ED4245";
+        m_pingLabel->setText(QString("● %1 ms").arg(rttMs));
+        m_pingLabel->setStyleSheet(QString("QLabel { color: %1; border: none; }").arg(color));
+    }
+    else
+    {
+        return;
+    }
+
+    QStringList tooltip = {describe("Gateway", gateway)};
+    if (m_isInVoice || m_isInCall)
+        tooltip.append(describe("Voice", voice));
+    m_pingLabel->setToolTip(tooltip.join('\n'));
+    m_pingLabel->show();
 }
+
 void MainWindow::onCallButtonClicked()
 {
     // Check if we're in a DM channel
@@ -14,6 +14,8 @@
 #include "utils/TokenStorage.h"
 #include "utils/AvatarCache.h"
 
+class DiagnosticsPanel;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -41,7 +43,10 @@ private:
     QPushButton *m_muteBtn;
     QPushButton *m_deafenBtn;
     QPushButton *m_callBtn; // Call/Leave Call button for DMs
+    QPushButton *m_diagnosticsBtn;
+    DiagnosticsPanel *m_diagnosticsPanel; // Hidden until toggled
     QLabel *m_usernameLabel;
+    QLabel *m_pingLabel; // Heartbeat RTT: voice while in a call, else gateway
 
     // State
     Snowflake m_selectedGuildId;
@@ -63,6 +68,12 @@ private:
     QTimer *m_noAnswerTimer;
     Snowflake m_currentCallChannelId;
 
+    // Coalesces avatarReady redraws; decodes finish one by one
+    QTimer *m_avatarRefreshTimer;
+
+    // Highlights voice participants who are speaking, while in voice
+    QTimer *m_voiceLevelTimer;
+
     void setupUI();
     void connectSignals();
     void showLoginDialog();
@@ -71,6 +82,10 @@ private:
 
     void updateGuildList();
     void updateChannelList();
+    void addVoiceUserItems();
+    QString voiceUserName(Snowflake userId) const;
+    void updateVoiceUserLevels();
+    void showChannelContextMenu(const QPoint &pos);
     void sortGuildList();
     void updateMessageInputPermissions();
     QString formatMessageHtml(const Message &msg, bool grouped = false);
@@ -101,4 +116,6 @@ private:
     // Logout
     void onLogoutClicked();
     void onSettingsClicked();
+    void toggleDiagnostics();
+    void updatePingIndicator();
 };
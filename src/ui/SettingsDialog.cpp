@@ -8,9 +8,11 @@
 #include <QDebug>
 #include <QtMath>
 #include <cmath>
+#include "audio/DspKernels.h"
+#include "audio/AudioManager.h"
 
-SettingsDialog::SettingsDialog(QWidget *parent)
-    : QDialog(parent), m_audioSource(nullptr), m_audioSink(nullptr), m_audioInputDevice(nullptr), m_audioOutputDevice(nullptr), m_isTestingInput(false), m_isTestingOutput(false)
+SettingsDialog::SettingsDialog(AudioManager *audioManager, QWidget *parent)
+    : QDialog(parent), m_audioManager(audioManager), m_audioSource(nullptr), m_audioSink(nullptr), m_audioInputDevice(nullptr), m_audioOutputDevice(nullptr), m_isTestingInput(false), m_isTestingOutput(false)
 {
     setWindowTitle("Settings");
     setMinimumSize(600, 400);
@@ -25,6 +27,10 @@ SettingsDialog::SettingsDialog(QWidget *parent)
 
     setupUI();
     loadAudioDevices();
+
+    // In a call the meter shows what the mixer is playing
+    if (m_audioManager->isPlaying())
+        m_outputLevelTimer->start();
 }
 
 SettingsDialog::~SettingsDialog()
@@ -94,6 +100,24 @@ void SettingsDialog::setupUI()
 
     audioLayout->addLayout(outputDeviceLayout);
 
+    // Master volume, applied by the mixer after the per-user volumes
+    QHBoxLayout *outputVolumeLayout = new QHBoxLayout();
+    outputVolumeLayout->addWidget(new QLabel("Output Volume:", audioGroup));
+
+    m_outputVolumeSlider = new QSlider(Qt::Horizontal, audioGroup);
+    m_outputVolumeSlider->setRange(0, 200);
+    m_outputVolumeSlider->setValue(qRound(m_audioManager->outputVolume() * 100.0f));
+    m_outputVolumeSlider->setMinimumWidth(300);
+    outputVolumeLayout->addWidget(m_outputVolumeSlider);
+
+    m_outputVolumeLabel = new QLabel(audioGroup);
+    m_outputVolumeLabel->setFixedWidth(50);
+    m_outputVolumeLabel->setText(QString("%1%").arg(m_outputVolumeSlider->value()));
+    outputVolumeLayout->addWidget(m_outputVolumeLabel);
+    outputVolumeLayout->addStretch();
+
+    audioLayout->addLayout(outputVolumeLayout);
+
     // Output status and level
     m_outputStatusLabel = new QLabel("Status: Not detected", audioGroup);
     m_outputStatusLabel->setStyleSheet("color: #ED4245;");
@@ -146,6 +170,7 @@ void SettingsDialog::setupUI()
             this, &SettingsDialog::onOutputDeviceChanged);
     connect(m_testInputBtn, &QPushButton::clicked, this, &SettingsDialog::onTestInputClicked);
     connect(m_testOutputBtn, &QPushButton::clicked, this, &SettingsDialog::onTestOutputClicked);
+    connect(m_outputVolumeSlider, &QSlider::valueChanged, this, &SettingsDialog::onOutputVolumeChanged);
     connect(m_refreshDevicesBtn, &QPushButton::clicked, this, &SettingsDialog::refreshDevices);
     connect(m_saveBtn, &QPushButton::clicked, this, &QDialog::accept);
     connect(m_cancelBtn, &QPushButton::clicked, this, &QDialog::reject);
@@ -261,6 +286,12 @@ void SettingsDialog::onOutputDeviceChanged(int index)
     Q_UNUSED(index);
 }
 
+void SettingsDialog::onOutputVolumeChanged(int percent)
+{
+    m_outputVolumeLabel->setText(QString("%1%").arg(percent));
+    m_audioManager->setOutputVolume(percent / 100.0f);
+}
+
 void SettingsDialog::onTestInputClicked()
 {
     if (m_isTestingInput)
@@ -298,15 +329,11 @@ void SettingsDialog::onTestInputClicked()
         return;
     }
 
-    QAudioFormat format;
-    format.setSampleRate(48000);
-    format.setChannelCount(2);
-    format.setSampleFormat(QAudioFormat::Int16);
-
-    if (!inputDevice.isFormatSupported(format))
+    QAudioFormat format = AudioFormatConverter::negotiate(inputDevice);
+    if (!m_inputConverter.configure(format, AudioFormatConverter::Direction::Capture))
     {
-        qDebug() << "Audio format not supported, trying default format";
-        format = inputDevice.preferredFormat();
+        qDebug() << "No supported audio format for input device";
+        return;
     }
 
     m_audioSource = new QAudioSource(inputDevice, format, this);
@@ -366,20 +393,16 @@ void SettingsDialog::onTestOutputClicked()
         return;
     }
 
-    QAudioFormat format;
-    format.setSampleRate(48000);
-    format.setChannelCount(2);
-    format.setSampleFormat(QAudioFormat::Int16);
-
-    if (!outputDevice.isFormatSupported(format))
+    QAudioFormat format = AudioFormatConverter::negotiate(outputDevice);
+    if (!AudioFormatConverter::isConvertible(format))
     {
-        qDebug() << "Audio format not supported, trying default format";
-        format = outputDevice.preferredFormat();
+        qDebug() << "No supported audio format for output device";
+        return;
     }
 
     m_audioSink = new QAudioSink(outputDevice, format, this);
 
-    ToneGenerator *generator = new ToneGenerator(this);
+    ToneGenerator *generator = new ToneGenerator(format, this);
     generator->start();
     m_audioOutputDevice = generator;
 
@@ -430,6 +453,9 @@ void SettingsDialog::stopOutputTest()
         }
 
         m_isTestingOutput = false;
+
+        if (m_audioManager->isPlaying())
+            m_outputLevelTimer->start();
     }
 }
 
@@ -444,23 +470,25 @@ void SettingsDialog::updateInputLevel()
 
     QByteArray buffer = m_audioInputDevice->read(qMin(len, qint64(4096)));
 
-    const qint16 *samples = reinterpret_cast<const qint16 *>(buffer.constData());
-    int sampleCount = buffer.size() / 2;
+    float rms = 0.0f;
+    m_inputConverter.push(buffer.constData(), buffer.size(), [&rms](const opus_int16 *pcm, int frames) {
+        rms = qMax(rms, DspKernels::measure(pcm, frames * OPUS_CHANNELS).rms);
+    });
 
-    qint64 sum = 0;
-    for (int i = 0; i < sampleCount; ++i)
-    {
-        sum += samples[i] * samples[i];
-    }
-
-    float rms = std::sqrt(static_cast<float>(sum) / sampleCount);
-    float level = qMin(rms / 32768.0f * 10.0f, 1.0f);
+    float level = qMin(rms * 10.0f, 1.0f);
 
     setInputLevel(level);
 }
 
 void SettingsDialog::updateOutputLevel()
 {
+    // In a call: the mixer's real output, after the master volume
+    if (!m_isTestingOutput)
+    {
+        setOutputLevel(m_audioManager->outputLevel());
+        return;
+    }
+
     static float phase = 0.0f;
     phase += 0.1f;
     if (phase > 1.0f)
@@ -471,9 +499,10 @@ void SettingsDialog::updateOutputLevel()
 }
 
 // ToneGenerator implementation
-ToneGenerator::ToneGenerator(QObject *parent)
+ToneGenerator::ToneGenerator(const QAudioFormat &format, QObject *parent)
     : QIODevice(parent), m_pos(0)
 {
+    m_converter.configure(format, AudioFormatConverter::Direction::Playback);
 }
 
 void ToneGenerator::start()
@@ -488,22 +517,19 @@ void ToneGenerator::stop()
 
 qint64 ToneGenerator::readData(char *data, qint64 maxlen)
 {
-    qint16 *out = reinterpret_cast<qint16 *>(data);
-    qint64 samples = maxlen / 4;
-
-    for (qint64 i = 0; i < samples; ++i)
-    {
-        float t = static_cast<float>(m_pos) / SAMPLE_RATE;
-        float sample = std::sin(2.0f * M_PI * FREQUENCY * t) * 0.3f;
-        qint16 value = static_cast<qint16>(sample * 32767.0f);
-
-        out[i * 2] = value;
-        out[i * 2 + 1] = value;
+    return m_converter.pull(data, maxlen, [this](opus_int16 *out, int frames) {
+        for (int i = 0; i < frames; ++i)
+        {
+            float t = static_cast<float>(m_pos) / SAMPLE_RATE;
+            float sample = std::sin(2.0f * M_PI * FREQUENCY * t) * 0.3f;
+            qint16 value = static_cast<qint16>(sample * 32767.0f);
 
-        m_pos++;
-    }
+            out[i * 2] = value;
+            out[i * 2 + 1] = value;
 
-    return maxlen;
+            m_pos++;
+        }
+    });
 }
 
 qint64 ToneGenerator::writeData(const char *data, qint64 len)
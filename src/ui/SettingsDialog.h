@@ -5,18 +5,24 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QProgressBar>
+#include <QSlider>
 #include <QMediaDevices>
 #include <QAudioSource>
 #include <QAudioSink>
 #include <QTimer>
 #include <QIODevice>
+#include "audio/AudioFormatConverter.h"
+
+class AudioManager;
 
 class SettingsDialog : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit SettingsDialog(QWidget *parent = nullptr);
+    // Output volume changes apply to audioManager live; the caller saves or
+    // reverts them depending on how the dialog closes
+    explicit SettingsDialog(AudioManager *audioManager, QWidget *parent = nullptr);
     ~SettingsDialog();
 
     QString getSelectedInputDevice() const;
@@ -33,17 +39,24 @@ private slots:
     void onOutputDeviceChanged(int index);
     void onTestInputClicked();
     void onTestOutputClicked();
+    void onOutputVolumeChanged(int percent);
     void refreshDevices();
 
 private:
     void setupUI();
     void loadAudioDevices();
 
+    AudioManager *m_audioManager;
+
     // Audio device selection
     QComboBox *m_inputDeviceCombo;
     QComboBox *m_outputDeviceCombo;
     QPushButton *m_refreshDevicesBtn;
 
+    // Master output volume, 0-200%
+    QSlider *m_outputVolumeSlider;
+    QLabel *m_outputVolumeLabel;
+
     // Audio level indicators
     QProgressBar *m_inputLevelBar;
     QProgressBar *m_outputLevelBar;
@@ -65,6 +78,7 @@ private:
     QTimer *m_outputLevelTimer;
     QIODevice *m_audioInputDevice;
     QIODevice *m_audioOutputDevice;
+    AudioFormatConverter m_inputConverter; // Meters the same audio a call would capture
 
     bool m_isTestingInput;
     bool m_isTestingOutput;
@@ -80,7 +94,8 @@ class ToneGenerator : public QIODevice
 {
     Q_OBJECT
 public:
-    explicit ToneGenerator(QObject *parent = nullptr);
+    // Renders in the Opus domain and converts to the device format, like playback
+    explicit ToneGenerator(const QAudioFormat &format, QObject *parent = nullptr);
 
     void start();
     void stop();
@@ -91,6 +106,7 @@ public:
 
 private:
     qint64 m_pos;
+    AudioFormatConverter m_converter;
     static constexpr int SAMPLE_RATE = 48000;
     static constexpr int FREQUENCY = 440; // A4 note
 };
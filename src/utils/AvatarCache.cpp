@@ -1,23 +1,51 @@
 #include "AvatarCache.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <QPainter>
 #include <QPainterPath>
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QBuffer>
+#include <QThreadPool>
 #include <QDebug>
 
+namespace
+{
+MetricCounter &s_hitsMetric = Metrics::counter("avatar.hits");
+MetricCounter &s_missesMetric = Metrics::counter("avatar.misses");
+MetricCounter &s_downloadsMetric = Metrics::counter("avatar.downloads");
+MetricCounter &s_downloadFailuresMetric = Metrics::counter("avatar.download_failures");
+MetricCounter &s_evictionsMetric = Metrics::counter("avatar.evictions");
+MetricGauge &s_entriesMetric = Metrics::gauge("avatar.entries");
+MetricGauge &s_queueMetric = Metrics::gauge("avatar.download_queue"); // Queued plus in flight
+LatencyHistogram &s_decodeMetric = Metrics::histogram("avatar.decode");   // On a decode worker
+LatencyHistogram &s_lookupMetric = Metrics::histogram("avatar.get_avatar"); // GUI thread, per call
+MetricGauge &s_decodesInFlightMetric = Metrics::gauge("avatar.decodes_in_flight");
+}
+
 AvatarCache::AvatarCache(int maxCacheSize, QObject *parent)
     : QObject(parent),
       m_networkManager(new QNetworkAccessManager(this)),
+      m_diskCache("avatar"),
       m_maxCacheSize(maxCacheSize),
-      m_maxConcurrentDownloads(10) // Download max 10 avatars at once
+      m_maxConcurrentDownloads(10), // Download max 10 avatars at once
+      m_decodePool(new QThreadPool(this)),
+      m_syncDecode(qEnvironmentVariableIsSet("CPPCORD_AVATAR_SYNC_DECODE"))
 {
+    m_decodePool->setMaxThreadCount(DECODE_THREADS);
+    m_decodePool->setObjectName("AvatarDecode");
+
+    // Index the disk tier on a worker, ahead of the first disk lookup there
+    m_decodePool->start([this]() { m_diskCache.warmUp(); });
     qDebug() << "AvatarCache initialized with LRU max size:" << m_maxCacheSize
              << "Max concurrent downloads:" << m_maxConcurrentDownloads;
 }
 
 AvatarCache::~AvatarCache()
 {
+    // Decodes post back to this object; let running ones finish first
+    m_decodePool->clear();
+    m_decodePool->waitForDone();
 }
 
 QString AvatarCache::getAvatarUrl(Snowflake userId, const QString &avatarHash) const
@@ -33,41 +61,33 @@ QString AvatarCache::getAvatarUrl(Snowflake userId, const QString &avatarHash) c
         .arg(extension);
 }
 
-void AvatarCache::updateLRU(Snowflake userId)
-{
-    // Remove from current position if exists
-    m_lruList.removeAll(userId);
-
-    // Add to front (most recently used)
-    m_lruList.prepend(userId);
-}
-
 void AvatarCache::evictOldest()
 {
-    while (m_cache.size() >= m_maxCacheSize && !m_lruList.isEmpty())
+    Snowflake oldestUserId = 0;
+    while (m_cache.size() >= m_maxCacheSize && m_cache.removeOldest(&oldestUserId))
     {
-        Snowflake oldestUserId = m_lruList.takeLast();
-        m_cache.remove(oldestUserId);
+        s_evictionsMetric.add();
         qDebug() << "LRU: Evicted avatar for user" << oldestUserId;
     }
 }
 
-QPixmap AvatarCache::decodeAvatar(const QByteArray &compressedData) const
+QImage AvatarCache::decodeAvatar(const QByteArray &compressedData, int size)
 {
+    TRACE_SCOPE("image", "avatar_decode");
+    MetricTimer decodeTimer(s_decodeMetric);
     if (compressedData.isEmpty())
-        return QPixmap();
+        return QImage();
 
     // Load from compressed data
-    QPixmap source;
+    QImage source;
     if (!source.loadFromData(compressedData))
     {
         qWarning() << "Failed to decode compressed avatar data";
-        return QPixmap();
+        return QImage();
     }
 
-    // Create circular version (40x40 for message display)
-    const int size = 40;
-    QPixmap rounded(size, size);
+    // Create circular version (size x size for message display)
+    QImage rounded(size, size, QImage::Format_ARGB32_Premultiplied);
     rounded.fill(Qt::transparent);
 
     QPainter painter(&rounded);
@@ -75,7 +95,7 @@ QPixmap AvatarCache::decodeAvatar(const QByteArray &compressedData) const
     painter.setRenderHint(QPainter::SmoothPixmapTransform);
 
     // Scale source to fit
-    QPixmap scaled = source.scaled(size, size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    QImage scaled = source.scaled(size, size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
 
     // Center the scaled image
     int x = (scaled.width() - size) / 2;
@@ -87,57 +107,228 @@ QPixmap AvatarCache::decodeAvatar(const QByteArray &compressedData) const
     painter.setClipPath(path);
 
     // Draw the scaled image
-    painter.drawPixmap(-x, -y, scaled);
+    painter.drawImage(-x, -y, scaled);
+    painter.end();
 
     return rounded;
 }
 
-QPixmap AvatarCache::getAvatar(Snowflake userId, const QString &avatarHash)
+void AvatarCache::startDecode(Snowflake userId, CachedAvatar &cached)
 {
-    if (avatarHash.isEmpty())
-        return QPixmap();
+    if (cached.hasDecoded || cached.decoding)
+        return;
 
-    // Check if in cache
-    if (m_cache.contains(userId))
+    cached.decoding = true;
+    cached.decodeTicket = ++m_nextDecodeTicket;
+    const quint64 ticket = cached.decodeTicket;
+    const QByteArray compressedData = cached.compressedData; // Shared, not copied
+    const QString key = cached.onDisk ? QString() : diskKey(cached.avatarHash);
+    s_decodesInFlightMetric.set(++m_decodesInFlight);
+
+    // The old behaviour, decoding in the caller (a render), so one build
+    // gives before and after figures
+    if (m_syncDecode)
     {
-        CachedAvatar &cached = m_cache[userId];
+        QImage image = decodeAvatar(compressedData, AVATAR_SIZE);
+        QString dataUrl = encodeDataUrl(image);
+        if (!image.isNull() && !key.isEmpty())
+            m_diskCache.write(key, compressedData);
+        finishDecode(userId, ticket, image, dataUrl, false);
+        return;
+    }
 
-        // Update LRU (mark as recently used)
-        updateLRU(userId);
+    // The destructor waits for the pool, so workers never outlive this
+    m_decodePool->start([this, userId, ticket, compressedData, key]()
+                        {
+        QImage image = decodeAvatar(compressedData, AVATAR_SIZE);
+        QString dataUrl = encodeDataUrl(image);
+
+        // Only content known to decode reaches the disk tier, written here
+        // so the save, fsync and any eviction stay off the GUI thread
+        if (!image.isNull() && !key.isEmpty())
+            m_diskCache.write(key, compressedData);
+        QMetaObject::invokeMethod(this, [this, userId, ticket, image, dataUrl]()
+                                  { finishDecode(userId, ticket, image, dataUrl); }, Qt::QueuedConnection); });
+}
 
-        // If not decoded yet, decode now
-        if (!cached.hasDecoded)
-        {
-            cached.decodedPixmap = decodeAvatar(cached.compressedData);
-            cached.hasDecoded = true;
-        }
+QString AvatarCache::encodeDataUrl(const QImage &image)
+{
+    if (image.isNull())
+        return QString();
 
-        return cached.decodedPixmap;
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return QStringLiteral("data:image/png;base64,") + QString::fromLatin1(png.toBase64());
+}
+
+void AvatarCache::finishDecode(Snowflake userId, quint64 ticket, const QImage &image, const QString &dataUrl,
+                               bool notify)
+{
+    s_decodesInFlightMetric.set(--m_decodesInFlight);
+
+    // Evicted or replaced while decoding
+    CachedAvatar *cached = m_cache.peek(userId);
+    if (!cached || cached->decodeTicket != ticket)
+        return;
+
+    // Undecodable download: drop the entry rather than mark it done with
+    // nothing to show, and remember it so renders don't keep retrying it
+    if (image.isNull())
+    {
+        m_undecodable.insert(cached->avatarHash);
+        m_cache.remove(userId);
+        s_entriesMetric.set(m_cache.size());
+        return;
     }
 
-    // Not cached - add to queue or start download
-    if (!m_pendingDownloads.contains(userId))
+    // The worker has written it to the disk tier
+    cached->onDisk = true;
+
+    cached->decoding = false;
+    cached->hasDecoded = true;
+    cached->decodedPixmap = QPixmap::fromImage(image);
+    cached->dataUrl = dataUrl;
+    if (notify)
+        emit avatarReady(userId);
+}
+
+QPixmap AvatarCache::getAvatar(Snowflake userId, const QString &avatarHash)
+{
+    CachedAvatar *cached = lookup(userId, avatarHash);
+    return cached ? cached->decodedPixmap : QPixmap();
+}
+
+QString AvatarCache::getAvatarDataUrl(Snowflake userId, const QString &avatarHash)
+{
+    CachedAvatar *cached = lookup(userId, avatarHash);
+    return cached ? cached->dataUrl : QString();
+}
+
+AvatarCache::CachedAvatar *AvatarCache::lookup(Snowflake userId, const QString &avatarHash)
+{
+    if (avatarHash.isEmpty() || m_undecodable.contains(avatarHash))
+        return nullptr;
+    MetricTimer lookupTimer(s_lookupMetric);
+
+    // Check if in cache (the lookup also marks it as recently used)
+    CachedAvatar *cached = m_cache.find(userId);
+    if (cached)
     {
-        // Check if already in queue
-        bool inQueue = false;
-        for (const auto &pair : m_downloadQueue)
+        s_hitsMetric.add();
+    }
+    else
+    {
+        s_missesMetric.add();
+
+        // Already on its way; don't count a disk miss on every redraw
+        if (m_diskLoads.contains(userId) || m_pendingDownloads.contains(userId) || m_queuedIds.contains(userId))
+            return nullptr;
+
+        // The disk tier is checked on a worker, which queues a download on a
+        // miss; avatarReady follows either way
+        startDiskLoad(userId, avatarHash);
+        return nullptr;
+    }
+
+    // Not decoded yet: hand it to a worker and show the placeholder until
+    // avatarReady, rather than decoding in the middle of a render
+    startDecode(userId, *cached);
+
+    // A synchronous decode that failed has dropped the entry
+    return m_syncDecode ? m_cache.peek(userId) : cached;
+}
+
+QString AvatarCache::diskKey(const QString &avatarHash)
+{
+    // Same size as getAvatarUrl requests
+    return QString("avatar/%1/64").arg(avatarHash);
+}
+
+AvatarCache::CachedAvatar &AvatarCache::storeAvatar(Snowflake userId, const QString &avatarHash,
+                                                     const QByteArray &compressedData, bool onDisk)
+{
+    // Evict oldest if needed before adding
+    if (m_cache.size() >= m_maxCacheSize)
+    {
+        evictOldest();
+    }
+
+    // Store compressed data
+    CachedAvatar cached;
+    cached.compressedData = compressedData;
+    cached.avatarHash = avatarHash;
+    cached.onDisk = onDisk;
+    cached.hasDecoded = false; // Decoded on a worker when needed
+
+    CachedAvatar &stored = m_cache.insert(userId, cached);
+    s_entriesMetric.set(m_cache.size());
+    return stored;
+}
+
+void AvatarCache::startDiskLoad(Snowflake userId, const QString &avatarHash)
+{
+    m_diskLoads.insert(userId);
+    s_decodesInFlightMetric.set(++m_decodesInFlight);
+
+    // Hashing the key, mapping the file and decoding all stay off the GUI
+    // thread. The destructor waits for the pool, so workers never outlive this.
+    m_decodePool->start([this, userId, avatarHash]()
+                        {
+        const QString key = diskKey(avatarHash);
+        DiskCache::Mapping mapping = m_diskCache.read(key);
+        const bool found = mapping.isValid();
+        QImage image;
+        QString dataUrl;
+        if (found)
         {
-            if (pair.first == userId)
-            {
-                inQueue = true;
-                break;
-            }
+            // Decoded straight from the mapping, without copying the file
+            image = decodeAvatar(QByteArray::fromRawData(reinterpret_cast<const char *>(mapping.data()), mapping.size()),
+                                 AVATAR_SIZE);
+            dataUrl = encodeDataUrl(image);
         }
 
-        if (!inQueue)
+        // A bad disk copy is deleted here (unmapped first) and fetched again
+        if (found && image.isNull())
         {
-            // Add to queue and process
-            m_downloadQueue.append(qMakePair(userId, avatarHash));
-            processDownloadQueue();
+            mapping = DiskCache::Mapping();
+            m_diskCache.remove(key);
         }
+        QMetaObject::invokeMethod(this, [this, userId, avatarHash, found, image, dataUrl]()
+                                  { finishDiskLoad(userId, avatarHash, found, image, dataUrl); }, Qt::QueuedConnection); });
+}
+
+void AvatarCache::finishDiskLoad(Snowflake userId, const QString &avatarHash, bool found, const QImage &image,
+                                 const QString &dataUrl)
+{
+    s_decodesInFlightMetric.set(--m_decodesInFlight);
+    m_diskLoads.remove(userId);
+    if (m_cache.contains(userId))
+        return;
+
+    if (found && image.isNull())
+        qWarning() << "Cached avatar for user" << userId << "does not decode, downloading it again";
+
+    if (image.isNull())
+    {
+        enqueueDownload(userId, avatarHash);
+        processDownloadQueue();
+        return;
     }
 
-    return QPixmap(); // Return null, will signal when ready
+    // The disk copy backs this entry, so only the decoded forms are kept
+    CachedAvatar &cached = storeAvatar(userId, avatarHash, QByteArray(), true);
+    cached.hasDecoded = true;
+    cached.decodedPixmap = QPixmap::fromImage(image);
+    cached.dataUrl = dataUrl;
+    emit avatarReady(userId);
+}
+
+void AvatarCache::enqueueDownload(Snowflake userId, const QString &avatarHash)
+{
+    m_downloadQueue.append(qMakePair(userId, avatarHash));
+    m_queuedIds.insert(userId);
 }
 
 bool AvatarCache::hasAvatar(Snowflake userId) const
@@ -152,28 +343,16 @@ void AvatarCache::preloadAvatars(const QMap<Snowflake, QString> &userAvatars)
         Snowflake userId = it.key();
         QString avatarHash = it.value();
 
-        if (avatarHash.isEmpty())
+        if (avatarHash.isEmpty() || m_undecodable.contains(avatarHash))
             continue;
 
-        // Only add to queue if not cached and not already pending/queued
-        if (!m_cache.contains(userId) && !m_pendingDownloads.contains(userId))
-        {
-            // Check if already in queue
-            bool inQueue = false;
-            for (const auto &pair : m_downloadQueue)
-            {
-                if (pair.first == userId)
-                {
-                    inQueue = true;
-                    break;
-                }
-            }
+        // Only look it up if not cached and not already loading/pending/queued
+        if (m_cache.contains(userId) || m_diskLoads.contains(userId) || m_pendingDownloads.contains(userId)
+            || m_queuedIds.contains(userId))
+            continue;
 
-            if (!inQueue)
-            {
-                m_downloadQueue.append(qMakePair(userId, avatarHash));
-            }
-        }
+        // Disk misses are queued for download by finishDiskLoad
+        startDiskLoad(userId, avatarHash);
     }
 
     // Process the queue
@@ -186,14 +365,16 @@ void AvatarCache::processDownloadQueue()
     while (!m_downloadQueue.isEmpty() && m_pendingDownloads.size() < m_maxConcurrentDownloads)
     {
         auto pair = m_downloadQueue.takeFirst();
+        m_queuedIds.remove(pair.first);
         startDownload(pair.first, pair.second);
     }
+    s_queueMetric.set(m_downloadQueue.size() + m_pendingDownloads.size());
 }
 
 void AvatarCache::clearCache()
 {
     m_cache.clear();
-    m_lruList.clear();
+    s_entriesMetric.set(0);
     qDebug() << "Avatar cache cleared";
 }
 
@@ -204,6 +385,7 @@ void AvatarCache::startDownload(Snowflake userId, const QString &avatarHash)
         return;
 
     m_pendingDownloads.insert(userId);
+    s_downloadsMetric.add();
 
     QNetworkRequest request(url);
     request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
@@ -212,7 +394,7 @@ void AvatarCache::startDownload(Snowflake userId, const QString &avatarHash)
 
     QNetworkReply *reply = m_networkManager->get(request);
 
-    connect(reply, &QNetworkReply::finished, this, [this, reply, userId]()
+    connect(reply, &QNetworkReply::finished, this, [this, reply, userId, avatarHash]()
             {
         m_pendingDownloads.remove(userId);
 
@@ -222,27 +404,19 @@ void AvatarCache::startDownload(Snowflake userId, const QString &avatarHash)
 
             if (!compressedData.isEmpty())
             {
-                // Evict oldest if needed before adding
-                if (m_cache.size() >= m_maxCacheSize)
-                {
-                    evictOldest();
-                }
-
-                // Store compressed data
-                CachedAvatar cached;
-                cached.compressedData = compressedData;
-                cached.hasDecoded = false;  // Decode lazily when needed
-
-                m_cache[userId] = cached;
-                updateLRU(userId);
-
-                // Notify that avatar is ready
-                emit avatarReady(userId);
+                // Written to disk by finishDecode once it is known to decode;
+                // avatarReady follows then too
+                CachedAvatar &cached = storeAvatar(userId, avatarHash, compressedData, false);
+                if (m_syncDecode)
+                    emit avatarReady(userId); // The next render decodes it
+                else
+                    startDecode(userId, cached);
             }
         }
         else
         {
             qWarning() << "Avatar download failed for user:" << userId << "-" << reply->errorString();
+            s_downloadFailuresMetric.add();
         }
 
         reply->deleteLater();
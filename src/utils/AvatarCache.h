@@ -1,6 +1,7 @@
 #pragma once
 #include <QObject>
 #include <QPixmap>
+#include <QImage>
 #include <QByteArray>
 #include <QList>
 #include <QHash>
@@ -8,30 +9,47 @@
 #include <QString>
 #include <QNetworkAccessManager>
 #include "models/Snowflake.h"
+#include "LruCache.h"
+#include "DiskCache.h"
 
 /**
  * @brief Discord-style avatar cache with LRU eviction and compressed storage
  *
  * Features:
- * - LRU cache with max 300 avatars (~3-8 MB RAM)
+ * - LRU cache with max 300 avatars (~3-8 MB RAM), O(1) touch and evict
  * - Stores compressed PNG data (~5-20KB each)
- * - Lazy decoding only when rendering
+ * - Lazy decoding only when rendering, on worker threads (placeholder until ready)
+ * - PNG data URLs for the HTML message view encoded on the same workers
+ * - Downloads persisted to a disk tier, so warm starts need no network; disk
+ *   lookups run on the decode workers and decode straight from the mapping
  * - Async downloads never block UI
  */
+class QThreadPool;
+
 class AvatarCache : public QObject
 {
     Q_OBJECT
 
 public:
+    static constexpr int AVATAR_SIZE = 40; // Rendered diameter in px
+    static constexpr int DECODE_THREADS = 2;
+
     explicit AvatarCache(int maxCacheSize = 300, QObject *parent = nullptr);
     ~AvatarCache();
 
     /**
-     * @brief Get avatar if cached, otherwise trigger async download
-     * @return Decoded circular avatar, or null if not ready
+     * @brief Get avatar if decoded, otherwise trigger async download/decode
+     * @return Decoded circular avatar, or null if not ready (callers draw
+     *         their placeholder and redraw on avatarReady)
      */
     QPixmap getAvatar(Snowflake userId, const QString &avatarHash);
 
+    /**
+     * @brief Same lookup as getAvatar, as a "data:image/png;base64," URL
+     * @return Empty if not ready; encoded once per decode, never on the caller
+     */
+    QString getAvatarDataUrl(Snowflake userId, const QString &avatarHash);
+
     /**
      * @brief Check if avatar is cached
      */
@@ -47,29 +65,60 @@ public:
      */
     void clearCache();
 
+    /**
+     * @brief Decode, scale and circular-mask one avatar; thread safe
+     */
+    static QImage decodeAvatar(const QByteArray &compressedData, int size = AVATAR_SIZE);
+
+    /**
+     * @brief PNG-encode a decoded avatar as a data URL; thread safe
+     */
+    static QString encodeDataUrl(const QImage &image);
+
 signals:
     void avatarReady(Snowflake userId);
 
 private:
     struct CachedAvatar
     {
-        QByteArray compressedData; // ~5-20 KB compressed
+        QByteArray compressedData; // ~5-20 KB compressed; empty for disk hits
+        QString avatarHash;        // Disk tier key
+        bool onDisk = false;       // Downloads are persisted once they decode
         QPixmap decodedPixmap;     // Cached decoded version
+        QString dataUrl;           // decodedPixmap as a PNG data URL
         bool hasDecoded = false;
+        bool decoding = false;     // Queued or running on m_decodePool
+        quint64 decodeTicket = 0;  // Matches the result to this entry
     };
 
     QNetworkAccessManager *m_networkManager;
-    QHash<Snowflake, CachedAvatar> m_cache;
-    QList<Snowflake> m_lruList; // Most recent at front
+    LruCache<Snowflake, CachedAvatar> m_cache; // Touched on every hit, so O(1)
+    DiskCache m_diskCache;                     // Keyed by avatar hash, survives restarts
+    QSet<Snowflake> m_diskLoads; // Disk tier lookups running on m_decodePool
     QSet<Snowflake> m_pendingDownloads;
     QList<QPair<Snowflake, QString>> m_downloadQueue; // Queue for batched downloads
+    QSet<Snowflake> m_queuedIds;                      // Ids in m_downloadQueue
+    QSet<QString> m_undecodable;                      // Downloaded hashes that failed to decode
     int m_maxCacheSize;
     int m_maxConcurrentDownloads;
+    QThreadPool *m_decodePool;
+    bool m_syncDecode; // CPPCORD_AVATAR_SYNC_DECODE: decode in getAvatar, as before the workers
+    quint64 m_nextDecodeTicket = 0;
+    int m_decodesInFlight = 0;
 
     QString getAvatarUrl(Snowflake userId, const QString &avatarHash) const;
-    void updateLRU(Snowflake userId);
+    CachedAvatar *lookup(Snowflake userId, const QString &avatarHash);
     void evictOldest();
-    QPixmap decodeAvatar(const QByteArray &compressedData) const;
+    CachedAvatar &storeAvatar(Snowflake userId, const QString &avatarHash, const QByteArray &compressedData,
+                              bool onDisk);
+    void startDiskLoad(Snowflake userId, const QString &avatarHash);
+    void finishDiskLoad(Snowflake userId, const QString &avatarHash, bool found, const QImage &image,
+                        const QString &dataUrl);
+    static QString diskKey(const QString &avatarHash);
+    void enqueueDownload(Snowflake userId, const QString &avatarHash);
+    void startDecode(Snowflake userId, CachedAvatar &cached);
+    void finishDecode(Snowflake userId, quint64 ticket, const QImage &image, const QString &dataUrl,
+                      bool notify = true);
     void startDownload(Snowflake userId, const QString &avatarHash);
     void processDownloadQueue();
 };
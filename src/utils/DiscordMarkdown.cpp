@@ -1,4 +1,5 @@
 #include "DiscordMarkdown.h"
+#include "Trace.h"
 #include <QRegularExpression>
 
 QString DiscordMarkdown::escapeHtml(const QString &text)
@@ -159,6 +160,7 @@ QString DiscordMarkdown::autoLinkUrls(const QString &text)
 
 QString DiscordMarkdown::toHtml(const QString &markdown)
 {
+    TRACE_SCOPE("ui", "markdown_toHtml");
     if (markdown.isEmpty())
         return QString();
 
@@ -0,0 +1,229 @@
+#include "DiskCache.h"
+#include "Metrics.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QDebug>
+
+namespace
+{
+constexpr int FILE_NAME_LENGTH = 40; // Hex SHA-1
+}
+
+DiskCache::DiskCache(const QString &name, qint64 maxBytes)
+    : m_directory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" + name),
+      m_maxBytes(maxBytes),
+      m_hitsMetric(Metrics::counter(name + ".disk_hits")),
+      m_missesMetric(Metrics::counter(name + ".disk_misses")),
+      m_hitRateMetric(Metrics::gauge(name + ".disk_hit_rate_pct")),
+      m_bytesMetric(Metrics::gauge(name + ".disk_bytes"))
+{
+}
+
+DiskCache::~DiskCache()
+{
+    flushUseTimes();
+}
+
+QString DiskCache::fileName(const QString &key)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+void DiskCache::warmUp()
+{
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+}
+
+qint64 DiskCache::totalBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_totalBytes;
+}
+
+void DiskCache::ensureLoaded()
+{
+    if (m_loaded)
+        return;
+    m_loaded = true;
+
+    QDir dir(m_directory);
+    if (!dir.exists() && !QDir().mkpath(m_directory))
+    {
+        qWarning() << "Cannot create disk cache directory" << m_directory;
+        return;
+    }
+
+    // Oldest first, so the most recently used file ends up at the front
+    const QFileInfoList entries = dir.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QFileInfo &entry : entries)
+    {
+        // Anything that isn't a SHA-1 name is a temporary file left behind
+        // by an interrupted write
+        if (entry.fileName().size() != FILE_NAME_LENGTH)
+        {
+            QFile::remove(entry.absoluteFilePath());
+            continue;
+        }
+        m_files.insert(entry.fileName(), entry.size());
+        m_totalBytes += entry.size();
+    }
+
+    evictToFit(0);
+    m_bytesMetric.set(m_totalBytes);
+    qDebug() << "Disk cache" << m_directory << "holds" << m_files.size() << "files," << m_totalBytes << "bytes";
+}
+
+void DiskCache::recordLookup(bool hit)
+{
+    m_lookups++;
+    if (hit)
+    {
+        m_hits++;
+        m_hitsMetric.add();
+    }
+    else
+    {
+        m_missesMetric.add();
+    }
+    m_hitRateMetric.set(100.0 * m_hits / m_lookups);
+}
+
+DiskCache::Mapping DiskCache::read(const QString &key)
+{
+    Mapping mapping;
+    const QString name = fileName(key);
+    {
+        QMutexLocker locker(&m_mutex);
+        ensureLoaded();
+        if (!m_files.find(name))
+        {
+            recordLookup(false);
+            return mapping;
+        }
+    }
+
+    // Opening and mapping happen unlocked, so a slow disk only holds up
+    // this reader
+    auto file = std::make_unique<QFile>(m_directory + "/" + name);
+    const uchar *data = nullptr;
+    if (file->open(QIODevice::ReadOnly) && file->size() > 0)
+        data = file->map(0, file->size());
+
+    QMutexLocker locker(&m_mutex);
+    if (!data)
+    {
+        // Deleted or truncated behind our back
+        qWarning() << "Disk cache entry unreadable, dropping:" << file->fileName();
+        file->close();
+        dropEntry(name);
+        recordLookup(false);
+        return mapping;
+    }
+
+    // Persisted for the next run's eviction by flushUseTimes()
+    m_useTimes.insert(name, QDateTime::currentMSecsSinceEpoch());
+
+    mapping.m_size = file->size();
+    mapping.m_data = data;
+    mapping.m_file = std::move(file);
+    recordLookup(true);
+    return mapping;
+}
+
+void DiskCache::flushUseTimes()
+{
+    QHash<QString, qint64> useTimes;
+    {
+        QMutexLocker locker(&m_mutex);
+        useTimes.swap(m_useTimes);
+    }
+
+    for (auto it = useTimes.constBegin(); it != useTimes.constEnd(); ++it)
+    {
+        // Setting the time needs write access on Windows (FILE_WRITE_ATTRIBUTES).
+        // Entries evicted since their use are simply gone.
+        QFile file(m_directory + "/" + it.key());
+        if (!file.open(QIODevice::ReadWrite | QIODevice::ExistingOnly))
+            continue;
+        if (!file.setFileTime(QDateTime::fromMSecsSinceEpoch(it.value(), Qt::UTC), QFileDevice::FileModificationTime))
+            qWarning() << "Disk cache could not update use time:" << file.fileName() << file.errorString();
+    }
+}
+
+bool DiskCache::write(const QString &key, const QByteArray &data)
+{
+    if (data.isEmpty() || data.size() > m_maxBytes)
+        return false;
+
+    const QString name = fileName(key);
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    if (qint64 *size = m_files.find(name))
+    {
+        // Same key means same content; nothing to write, but it was just
+        // used, so note that for the next run's eviction
+        if (*size == data.size())
+        {
+            m_useTimes.insert(name, QDateTime::currentMSecsSinceEpoch());
+            return true;
+        }
+        m_totalBytes -= *size;
+        m_files.remove(name);
+    }
+
+    evictToFit(data.size());
+
+    QSaveFile file(m_directory + "/" + name);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+    {
+        qWarning() << "Disk cache write failed:" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    m_files.insert(name, data.size());
+    m_totalBytes += data.size();
+    m_bytesMetric.set(m_totalBytes);
+    return true;
+}
+
+void DiskCache::remove(const QString &key)
+{
+    const QString name = fileName(key);
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    dropEntry(name);
+}
+
+void DiskCache::dropEntry(const QString &name)
+{
+    // Already evicted, possibly while a reader had it open
+    qint64 *size = m_files.peek(name);
+    if (!size)
+        return;
+
+    m_totalBytes -= *size;
+    m_files.remove(name);
+    m_useTimes.remove(name);
+    if (!QFile::remove(m_directory + "/" + name))
+        qWarning() << "Disk cache could not remove" << name;
+    m_bytesMetric.set(m_totalBytes);
+}
+
+void DiskCache::evictToFit(qint64 incoming)
+{
+    QString oldest;
+    qint64 size = 0;
+    while (m_totalBytes + incoming > m_maxBytes && m_files.removeOldest(&oldest, &size))
+    {
+        m_totalBytes -= size;
+        m_useTimes.remove(oldest);
+        if (!QFile::remove(m_directory + "/" + oldest))
+            qWarning() << "Disk cache could not evict" << oldest;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <memory>
+#include "LruCache.h"
+
+class MetricCounter;
+class MetricGauge;
+
+// Content-addressed file store for downloaded images, kept across runs.
+//
+// Keys are CDN asset hashes (which change whenever the image does), so an
+// entry never goes stale and only has to be evicted for space. Files are
+// named by the SHA-1 of the key and read through a memory mapping. Use order
+// is kept in file modification times, and the least recently used files are
+// deleted once the directory grows past maxBytes. Reads only note the use
+// time; flushUseTimes() (run by the destructor) writes them out in one batch.
+// The directory is scanned on first use, so an unused cache costs nothing;
+// owners that will use it call warmUp() at startup so the scan doesn't land
+// in a render. All methods are thread safe, so lookups can run on workers.
+//
+// Publishes "<prefix>.disk_hits", "<prefix>.disk_misses",
+// "<prefix>.disk_hit_rate_pct" and "<prefix>.disk_bytes".
+class DiskCache
+{
+public:
+    static constexpr qint64 DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+
+    // A read-only mapping of one entry; the data stays valid while it lives
+    class Mapping
+    {
+    public:
+        bool isValid() const { return m_data != nullptr; }
+        const uchar *data() const { return m_data; }
+        qint64 size() const { return m_size; }
+
+    private:
+        friend class DiskCache;
+        std::unique_ptr<QFile> m_file;
+        const uchar *m_data = nullptr;
+        qint64 m_size = 0;
+    };
+
+    // name is both the subdirectory of the app cache location and the
+    // metric prefix ("avatar" -> <cache>/avatar, avatar.disk_hits)
+    explicit DiskCache(const QString &name, qint64 maxBytes = DEFAULT_MAX_BYTES);
+    ~DiskCache();
+    Q_DISABLE_COPY(DiskCache)
+
+    // Scans the directory now rather than on the first read or write
+    void warmUp();
+
+    // Maps the entry and marks it recently used; invalid on a miss
+    Mapping read(const QString &key);
+    bool write(const QString &key, const QByteArray &data);
+
+    // Deletes an entry, e.g. one whose content turned out to be unusable
+    void remove(const QString &key);
+
+    // Writes the use times noted since the last flush to the files
+    void flushUseTimes();
+
+    QString directory() const { return m_directory; }
+    qint64 totalBytes() const;
+
+private:
+    // Callers hold m_mutex
+    void ensureLoaded();
+    void evictToFit(qint64 incoming);
+    void recordLookup(bool hit);
+    void dropEntry(const QString &name);
+    static QString fileName(const QString &key);
+
+    QString m_directory;
+    qint64 m_maxBytes;
+    mutable QMutex m_mutex; // Index and counters; file contents are read unlocked
+    bool m_loaded = false;
+    LruCache<QString, qint64> m_files; // File name -> size, most recent first
+    QHash<QString, qint64> m_useTimes; // File name -> last use (ms since epoch), not yet on disk
+    qint64 m_totalBytes = 0;
+    qint64 m_hits = 0;
+    qint64 m_lookups = 0;
+
+    MetricCounter &m_hitsMetric;
+    MetricCounter &m_missesMetric;
+    MetricGauge &m_hitRateMetric;
+    MetricGauge &m_bytesMetric;
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <QHash>
+#include <QtGlobal>
+#include <utility>
+
+// Key/value map that remembers use order, with O(1) lookup, touch, insert
+// and eviction. Entries are heap nodes on an intrusive doubly linked list
+// (most recent at the head) indexed by a hash of key to node, so moving an
+// entry to the front is a few pointer swaps rather than a list scan.
+//
+// Not thread safe; owners use it from a single thread. Pointers returned by
+// find() stay valid until that entry is removed or evicted.
+template <typename Key, typename Value>
+class LruCache
+{
+public:
+    LruCache() = default;
+    ~LruCache() { clear(); }
+    Q_DISABLE_COPY(LruCache)
+
+    int size() const { return m_index.size(); }
+    bool isEmpty() const { return m_index.isEmpty(); }
+    bool contains(const Key &key) const { return m_index.contains(key); }
+
+    // Looks up an entry and marks it most recently used; null if absent
+    Value *find(const Key &key)
+    {
+        Node *node = m_index.value(key, nullptr);
+        if (!node)
+            return nullptr;
+        moveToFront(node);
+        return &node->value;
+    }
+
+    // Looks up an entry without changing the use order
+    Value *peek(const Key &key)
+    {
+        Node *node = m_index.value(key, nullptr);
+        return node ? &node->value : nullptr;
+    }
+
+    // Adds or replaces an entry as the most recently used one
+    Value &insert(const Key &key, Value value)
+    {
+        Node *&slot = m_index[key];
+        if (slot)
+        {
+            slot->value = std::move(value);
+            moveToFront(slot);
+            return slot->value;
+        }
+
+        slot = new Node{key, std::move(value)};
+        linkFront(slot);
+        return slot->value;
+    }
+
+    bool remove(const Key &key)
+    {
+        Node *node = m_index.take(key);
+        if (!node)
+            return false;
+        unlink(node);
+        delete node;
+        return true;
+    }
+
+    // Removes the least recently used entry, reporting it
+    bool removeOldest(Key *key = nullptr, Value *value = nullptr)
+    {
+        if (!m_tail)
+            return false;
+        Node *node = m_tail;
+        if (key)
+            *key = node->key;
+        if (value)
+            *value = std::move(node->value);
+        m_index.remove(node->key);
+        unlink(node);
+        delete node;
+        return true;
+    }
+
+    void clear()
+    {
+        Node *node = m_head;
+        while (node)
+        {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+        m_head = m_tail = nullptr;
+        m_index.clear();
+    }
+
+private:
+    struct Node
+    {
+        Key key;
+        Value value;
+        Node *prev = nullptr;
+        Node *next = nullptr;
+    };
+
+    void linkFront(Node *node)
+    {
+        node->prev = nullptr;
+        node->next = m_head;
+        if (m_head)
+            m_head->prev = node;
+        m_head = node;
+        if (!m_tail)
+            m_tail = node;
+    }
+
+    void unlink(Node *node)
+    {
+        if (node->prev)
+            node->prev->next = node->next;
+        else
+            m_head = node->next;
+        if (node->next)
+            node->next->prev = node->prev;
+        else
+            m_tail = node->prev;
+        node->prev = node->next = nullptr;
+    }
+
+    void moveToFront(Node *node)
+    {
+        if (node == m_head)
+            return;
+        unlink(node);
+        linkFront(node);
+    }
+
+    QHash<Key, Node *> m_index;
+    Node *m_head = nullptr; // Most recently used
+    Node *m_tail = nullptr; // Next to evict
+};
@@ -0,0 +1,241 @@
+#include "Metrics.h"
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QTimer>
+#include <QDebug>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <map>
+#include <memory>
+
+namespace
+{
+struct Registry
+{
+    QMutex mutex;
+    std::map<QString, std::unique_ptr<MetricCounter>> counters;
+    std::map<QString, std::unique_ptr<MetricGauge>> gauges;
+    std::map<QString, std::unique_ptr<LatencyHistogram>> histograms;
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+template <typename T>
+T &lookup(std::map<QString, std::unique_ptr<T>> &metrics, const QString &name)
+{
+    QMutexLocker locker(&registry().mutex);
+    std::unique_ptr<T> &metric = metrics[name];
+    if (!metric)
+        metric = std::make_unique<T>();
+    return *metric;
+}
+
+double micros(qint64 ns)
+{
+    return ns / 1000.0;
+}
+}
+
+int LatencyHistogram::bucketIndex(qint64 ns)
+{
+    if (ns < SUB_BUCKETS)
+        return static_cast<int>(qMax<qint64>(0, ns));
+
+    const quint64 value = qMin<quint64>(static_cast<quint64>(ns), (quint64(1) << MAX_EXPONENT) - 1);
+    const int exponent = 63 - qCountLeadingZeroBits(value);
+    const int shift = exponent - SUB_BUCKET_BITS;
+    const int sub = static_cast<int>((value >> shift) & (SUB_BUCKETS - 1));
+    return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+qint64 LatencyHistogram::bucketLowerBound(int index)
+{
+    if (index < SUB_BUCKETS)
+        return index;
+    const int group = index / SUB_BUCKETS;
+    return static_cast<qint64>(SUB_BUCKETS + index % SUB_BUCKETS) << (group - 1);
+}
+
+qint64 LatencyHistogram::bucketWidth(int index)
+{
+    return index < SUB_BUCKETS ? 1 : qint64(1) << (index / SUB_BUCKETS - 1);
+}
+
+void LatencyHistogram::record(qint64 ns)
+{
+    ns = qMax<qint64>(0, ns);
+    m_buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    m_sumNs.fetch_add(ns, std::memory_order_relaxed);
+
+    qint64 max = m_maxNs.load(std::memory_order_relaxed);
+    while (ns > max && !m_maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    // Not atomic as a whole: a concurrent record may show up in some fields
+    // and not others, which is fine for monitoring
+    Snapshot snapshot;
+    snapshot.buckets.resize(BUCKET_COUNT);
+    for (int i = 0; i < BUCKET_COUNT; ++i)
+    {
+        snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.sumNs = m_sumNs.load(std::memory_order_relaxed);
+    snapshot.maxNs = m_maxNs.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+qint64 LatencyHistogram::Snapshot::percentileNs(double fraction) const
+{
+    if (count == 0)
+        return 0;
+
+    const qint64 rank = qMax<qint64>(1, static_cast<qint64>(qBound(0.0, fraction, 1.0) * count + 0.5));
+    qint64 seen = 0;
+    for (int i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets.at(i);
+        if (seen >= rank)
+            return qMin(maxNs, bucketLowerBound(i) + bucketWidth(i) / 2);
+    }
+    return maxNs;
+}
+
+MetricCounter &Metrics::counter(const QString &name)
+{
+    return lookup(registry().counters, name);
+}
+
+MetricGauge &Metrics::gauge(const QString &name)
+{
+    return lookup(registry().gauges, name);
+}
+
+LatencyHistogram &Metrics::histogram(const QString &name)
+{
+    return lookup(registry().histograms, name);
+}
+
+QList<Metrics::Entry> Metrics::snapshot()
+{
+    QList<Entry> entries;
+    {
+        Registry &metrics = registry();
+        QMutexLocker locker(&metrics.mutex);
+        for (const auto &[name, counter] : metrics.counters)
+            entries.append({name, Kind::Counter, static_cast<double>(counter->value()), {}});
+        for (const auto &[name, gauge] : metrics.gauges)
+            entries.append({name, Kind::Gauge, gauge->value(), {}});
+        for (const auto &[name, histogram] : metrics.histograms)
+            entries.append({name, Kind::Histogram, 0.0, histogram->snapshot()});
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.name < b.name; });
+    return entries;
+}
+
+QJsonObject Metrics::toJson(const QList<Entry> &entries)
+{
+    QJsonObject counters;
+    QJsonObject gauges;
+    QJsonObject histograms;
+
+    for (const Entry &entry : entries)
+    {
+        switch (entry.kind)
+        {
+        case Kind::Counter:
+            counters[entry.name] = static_cast<qint64>(entry.value);
+            break;
+        case Kind::Gauge:
+            gauges[entry.name] = entry.value;
+            break;
+        case Kind::Histogram:
+        {
+            const LatencyHistogram::Snapshot &h = entry.histogram;
+            QJsonObject summary;
+            summary["count"] = h.count;
+            summary["mean_us"] = micros(static_cast<qint64>(h.meanNs()));
+            summary["p50_us"] = micros(h.percentileNs(0.50));
+            summary["p90_us"] = micros(h.percentileNs(0.90));
+            summary["p99_us"] = micros(h.percentileNs(0.99));
+            summary["max_us"] = micros(h.maxNs);
+            histograms[entry.name] = summary;
+            break;
+        }
+        }
+    }
+
+    QJsonObject json;
+    json["counters"] = counters;
+    json["gauges"] = gauges;
+    json["histograms"] = histograms;
+    return json;
+}
+
+MetricsRecorder::MetricsRecorder(QObject *parent)
+    : QObject(parent),
+      m_timer(new QTimer(this))
+{
+    connect(m_timer, &QTimer::timeout, this, &MetricsRecorder::writeSnapshot);
+}
+
+MetricsRecorder::~MetricsRecorder()
+{
+    stop();
+}
+
+bool MetricsRecorder::start(const QString &path, int intervalMs)
+{
+    stop();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+    {
+        qWarning() << "Cannot open metrics file" << path << ":" << m_file.errorString();
+        return false;
+    }
+
+    m_uptime.start();
+    m_timer->start(qMax(100, intervalMs));
+    qDebug() << "Writing metrics snapshots to" << path << "every" << m_timer->interval() << "ms";
+    return true;
+}
+
+void MetricsRecorder::stop()
+{
+    if (!m_file.isOpen())
+        return;
+
+    // Final snapshot, so short sessions still leave a record
+    writeSnapshot();
+    m_timer->stop();
+    m_file.close();
+}
+
+bool MetricsRecorder::writeSnapshot()
+{
+    if (!m_file.isOpen())
+        return false;
+
+    QJsonObject json = Metrics::toJson(Metrics::snapshot());
+    json["time"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    json["uptime_ms"] = m_uptime.elapsed();
+
+    QByteArray line = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    if (m_file.write(line) != line.size() || !m_file.flush())
+    {
+        qWarning() << "Metrics snapshot write failed:" << m_file.errorString();
+        return false;
+    }
+    return true;
+}
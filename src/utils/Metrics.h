@@ -0,0 +1,143 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <atomic>
+
+class QTimer;
+
+// Process-wide runtime metrics, looked up by name.
+//
+// Publishing is a relaxed atomic operation, so the audio and network threads
+// can record on their hot paths; only the first lookup of a name takes a
+// lock. Metrics live until exit, so look one up once and keep the reference
+// (a function-local static works well). Names are "<area>.<what>", with the
+// unit as a suffix when the value isn't a plain count ("voice.jitter_ms").
+class MetricCounter
+{
+public:
+    void add(qint64 amount = 1) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+    qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> m_value{0};
+};
+
+class MetricGauge
+{
+public:
+    void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+    double value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> m_value{0.0};
+};
+
+// HDR-style histogram of durations in nanoseconds. Buckets are log-linear:
+// exact below SUB_BUCKETS, then SUB_BUCKETS per power of two (about 6%
+// relative precision) up to 2^MAX_EXPONENT ns (~18 minutes). Recording is a
+// handful of relaxed atomic adds; larger values land in the last bucket.
+class LatencyHistogram
+{
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_EXPONENT = 40;
+    static constexpr int BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    struct Snapshot
+    {
+        qint64 count = 0;
+        qint64 sumNs = 0;
+        qint64 maxNs = 0;
+        QList<qint64> buckets;
+
+        double meanNs() const { return count > 0 ? static_cast<double>(sumNs) / count : 0.0; }
+        // Midpoint of the bucket holding the given fraction (0..1) of samples
+        qint64 percentileNs(double fraction) const;
+    };
+
+    void record(qint64 ns);
+    Snapshot snapshot() const;
+
+    static int bucketIndex(qint64 ns);
+    static qint64 bucketLowerBound(int index);
+    static qint64 bucketWidth(int index);
+
+private:
+    std::atomic<qint64> m_buckets[BUCKET_COUNT] = {};
+    std::atomic<qint64> m_sumNs{0};
+    std::atomic<qint64> m_maxNs{0};
+};
+
+// Records the lifetime of the scope into a histogram
+class MetricTimer
+{
+public:
+    explicit MetricTimer(LatencyHistogram &histogram) : m_histogram(histogram) { m_timer.start(); }
+    ~MetricTimer() { m_histogram.record(m_timer.nsecsElapsed()); }
+    MetricTimer(const MetricTimer &) = delete;
+    MetricTimer &operator=(const MetricTimer &) = delete;
+
+private:
+    LatencyHistogram &m_histogram;
+    QElapsedTimer m_timer;
+};
+
+class Metrics
+{
+public:
+    static MetricCounter &counter(const QString &name);
+    static MetricGauge &gauge(const QString &name);
+    static LatencyHistogram &histogram(const QString &name);
+
+    enum class Kind
+    {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    struct Entry
+    {
+        QString name;
+        Kind kind = Kind::Counter;
+        double value = 0.0; // Counter or gauge
+        LatencyHistogram::Snapshot histogram;
+    };
+
+    // Every registered metric, sorted by name
+    static QList<Entry> snapshot();
+
+    // {"counters":{...},"gauges":{...},"histograms":{name:{count,mean_us,p50_us,...}}}
+    static QJsonObject toJson(const QList<Entry> &entries);
+};
+
+// Appends a JSON snapshot of every metric to a file at a fixed interval
+// (one object per line), for offline analysis of a session.
+class MetricsRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int DEFAULT_INTERVAL_MS = 5000;
+
+    explicit MetricsRecorder(QObject *parent = nullptr);
+    ~MetricsRecorder() override;
+
+    bool start(const QString &path, int intervalMs = DEFAULT_INTERVAL_MS);
+    void stop();
+    bool isRecording() const { return m_file.isOpen(); }
+
+    // Write one snapshot now
+    bool writeSnapshot();
+
+private:
+    QFile m_file;
+    QTimer *m_timer;
+    QElapsedTimer m_uptime;
+};
@@ -0,0 +1,239 @@
+#include "Trace.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QDebug>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+std::atomic<bool> Tracer::s_enabled{false};
+
+namespace
+{
+struct Event
+{
+    const char *category;
+    const char *name;
+    qint64 startNs;
+    qint64 durationNs;
+};
+
+// Written only by its owning thread. count is published with release so the
+// exporter sees complete events; a stale generation means the buffer still
+// holds an earlier session and is emptied on the next record.
+struct ThreadBuffer
+{
+    std::unique_ptr<Event[]> events{new Event[Tracer::EVENTS_PER_THREAD]};
+    std::atomic<int> count{0};
+    std::atomic<qint64> dropped{0};
+    std::atomic<quint64> generation{0};
+    std::atomic<bool> inUse{true};
+    int threadId = 0;
+    QString threadName;
+};
+
+std::atomic<quint64> s_generation{0};
+std::atomic<qint64> s_originNs{0};
+
+// Buffers live until exit; a buffer whose thread has finished is handed to
+// the next new thread once its events belong to an old session
+QMutex &registryMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+std::vector<std::unique_ptr<ThreadBuffer>> &registry()
+{
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    return buffers;
+}
+
+QString currentThreadName(int threadId)
+{
+    QThread *thread = QThread::currentThread();
+    if (!thread->objectName().isEmpty())
+        return thread->objectName();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+        return QStringLiteral("Main thread");
+    return QStringLiteral("Thread %1").arg(threadId);
+}
+
+ThreadBuffer *acquireBuffer()
+{
+    QMutexLocker locker(&registryMutex());
+    auto &buffers = registry();
+    const quint64 generation = s_generation.load(std::memory_order_acquire);
+
+    ThreadBuffer *buffer = nullptr;
+    for (const auto &candidate : buffers)
+    {
+        if (!candidate->inUse.load(std::memory_order_acquire) &&
+            candidate->generation.load(std::memory_order_relaxed) != generation)
+        {
+            buffer = candidate.get();
+            buffer->inUse.store(true, std::memory_order_relaxed);
+            break;
+        }
+    }
+    if (!buffer)
+    {
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = buffers.back().get();
+        buffer->threadId = static_cast<int>(buffers.size());
+    }
+    buffer->threadName = currentThreadName(buffer->threadId);
+    return buffer;
+}
+
+// Releases the thread's buffer when the thread exits
+struct BufferHolder
+{
+    ThreadBuffer *buffer = nullptr;
+    ~BufferHolder()
+    {
+        if (buffer)
+            buffer->inUse.store(false, std::memory_order_release);
+    }
+};
+
+thread_local BufferHolder t_holder;
+
+void appendEscaped(QByteArray &out, const char *text)
+{
+    for (const char *c = text; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            out.append('\\');
+        out.append(*c);
+    }
+}
+
+void appendMicros(QByteArray &out, qint64 ns)
+{
+    out.append(QByteArray::number(ns / 1000.0, 'f', 3));
+}
+}
+
+void Tracer::start()
+{
+    s_originNs.store(nowNs(), std::memory_order_relaxed);
+    s_generation.fetch_add(1, std::memory_order_acq_rel);
+    s_enabled.store(true, std::memory_order_release);
+}
+
+void Tracer::stop()
+{
+    s_enabled.store(false, std::memory_order_release);
+}
+
+qint64 Tracer::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Tracer::record(const char *category, const char *name, qint64 startNs, qint64 endNs)
+{
+    ThreadBuffer *buffer = t_holder.buffer;
+    if (!buffer)
+        buffer = t_holder.buffer = acquireBuffer();
+
+    const quint64 generation = s_generation.load(std::memory_order_acquire);
+    if (buffer->generation.load(std::memory_order_relaxed) != generation)
+    {
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+        buffer->generation.store(generation, std::memory_order_release);
+    }
+
+    const int index = buffer->count.load(std::memory_order_relaxed);
+    if (index >= EVENTS_PER_THREAD)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->events[index] = {category, name, startNs, endNs - startNs};
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+qint64 Tracer::droppedEvents()
+{
+    QMutexLocker locker(&registryMutex());
+    const quint64 generation = s_generation.load(std::memory_order_acquire);
+    qint64 dropped = 0;
+    for (const auto &buffer : registry())
+    {
+        if (buffer->generation.load(std::memory_order_acquire) == generation)
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+bool Tracer::writeChromeJson(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Cannot write trace" << path << ":" << file.errorString();
+        return false;
+    }
+
+    QMutexLocker locker(&registryMutex());
+    const quint64 generation = s_generation.load(std::memory_order_acquire);
+    const qint64 originNs = s_originNs.load(std::memory_order_relaxed);
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+
+    QByteArray out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" + pid + ",\"args\":{\"name\":\"cppcord\"}}";
+    qint64 written = 0;
+
+    for (const auto &buffer : registry())
+    {
+        if (buffer->generation.load(std::memory_order_acquire) != generation)
+            continue;
+        const int count = buffer->count.load(std::memory_order_acquire);
+        const QByteArray tid = QByteArray::number(buffer->threadId);
+
+        out += ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pid + ",\"tid\":" + tid +
+               ",\"args\":{\"name\":\"";
+        appendEscaped(out, buffer->threadName.toUtf8().constData());
+        out += "\"}}";
+
+        for (int i = 0; i < count; ++i)
+        {
+            const Event &event = buffer->events[i];
+            out += ",\n{\"ph\":\"X\",\"cat\":\"";
+            appendEscaped(out, event.category);
+            out += "\",\"name\":\"";
+            appendEscaped(out, event.name);
+            out += "\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"ts\":";
+            appendMicros(out, qMax<qint64>(0, event.startNs - originNs));
+            out += ",\"dur\":";
+            appendMicros(out, event.durationNs);
+            out += '}';
+        }
+        written += count;
+
+        // Keep memory bounded on long traces
+        if (out.size() > (1 << 20))
+        {
+            file.write(out);
+            out.clear();
+        }
+    }
+    out += "\n]}\n";
+
+    bool ok = file.write(out) == out.size();
+    file.close();
+    if (!ok)
+    {
+        qWarning() << "Trace write failed:" << file.errorString();
+        return false;
+    }
+    qDebug() << "Wrote" << written << "trace events to" << path;
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+// Scoped timing trace, exported as Chrome trace-event JSON (chrome://tracing,
+// ui.perfetto.dev).
+//
+// Each thread records into its own fixed-size buffer: a TraceScope costs two
+// clock reads and a store, with no locks or allocation after the thread's
+// first event. A full buffer drops further events until the next start().
+// Names and categories must be string literals (they are stored as
+// pointers). Build with CPPCORD_ENABLE_TRACING=OFF to compile the macros out;
+// otherwise a scope costs one relaxed load while tracing is stopped.
+class Tracer
+{
+public:
+    static constexpr int EVENTS_PER_THREAD = 1 << 16;
+
+    // Discards earlier events and starts recording
+    static void start();
+    static void stop();
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Events of the current session from every thread; call after stop()
+    static bool writeChromeJson(const QString &path);
+    static qint64 droppedEvents();
+
+    static qint64 nowNs();
+    static void record(const char *category, const char *name, qint64 startNs, qint64 endNs);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+class TraceScope
+{
+public:
+    TraceScope(const char *category, const char *name)
+        : m_category(category), m_name(name), m_startNs(Tracer::isEnabled() ? Tracer::nowNs() : -1)
+    {
+    }
+    ~TraceScope()
+    {
+        if (m_startNs >= 0)
+            Tracer::record(m_category, m_name, m_startNs, Tracer::nowNs());
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_category;
+    const char *m_name;
+    qint64 m_startNs;
+};
+
+#define CPPCORD_TRACE_CONCAT_INNER(a, b) a##b
+#define CPPCORD_TRACE_CONCAT(a, b) CPPCORD_TRACE_CONCAT_INNER(a, b)
+
+#ifdef CPPCORD_TRACING
+#define TRACE_SCOPE(category, name) TraceScope CPPCORD_TRACE_CONCAT(traceScope_, __LINE__)(category, name)
+#else
+#define TRACE_SCOPE(category, name) ((void)0)
+#endif
@@ -0,0 +1,66 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <cstdio>
+#include <limits>
+#include "FakeGatewayServer.h"
+#include "SyntheticPayloads.h"
+
+// Standalone stand-in gateway. Point the app at it with
+// CPPCORD_GATEWAY_URL=<printed url> and log in with any token.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("cppcord_fake_gateway");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Local stand-in for the Discord gateway");
+    parser.addHelpOption();
+    QCommandLineOption portOption("port", "Port to listen on (default 8990).", "port", "8990");
+    QCommandLineOption guildsOption("guilds", "Guilds in the synthetic READY (default 20).", "count", "20");
+    QCommandLineOption membersOption("members", "Members per guild (default 100).", "count", "100");
+    QCommandLineOption rateOption("rate", "MESSAGE_CREATE events per second after READY (default 0).", "per-second", "0");
+    QCommandLineOption countOption("count", "Events to send per session (default: unlimited).", "count", "0");
+    QCommandLineOption replayOption("replay", "Replay dispatches from a gateway capture or JSON Lines file instead.", "file");
+    QCommandLineOption heartbeatOption("heartbeat-ms", "Heartbeat interval sent in HELLO.", "ms",
+                                       QString::number(FakeGatewayServer::DEFAULT_HEARTBEAT_INTERVAL_MS));
+    QCommandLineOption dropAcksOption("drop-acks", "Never ack heartbeats, so the client detects a zombied connection.");
+    parser.addOptions({portOption, guildsOption, membersOption, rateOption, countOption, replayOption, heartbeatOption,
+                       dropAcksOption});
+    parser.process(app);
+
+    SyntheticPayloads::ReadyShape shape;
+    shape.guilds = qMax(0, parser.value(guildsOption).toInt());
+    shape.membersPerGuild = qMax(1, parser.value(membersOption).toInt());
+    const double rate = parser.value(rateOption).toDouble();
+    const qint64 count = parser.value(countOption).toLongLong();
+
+    QList<FakeGatewayServer::Event> replay;
+    if (parser.isSet(replayOption) && !FakeGatewayServer::loadRecording(parser.value(replayOption), replay))
+        return 1;
+
+    FakeGatewayServer server;
+    server.setKeepSendLog(false);
+    server.setHeartbeatInterval(parser.value(heartbeatOption).toInt());
+    server.setAckHeartbeats(!parser.isSet(dropAcksOption));
+    server.setReadyPayload(SyntheticPayloads::ready(shape));
+    if (!server.listen(static_cast<quint16>(parser.value(portOption).toUInt())))
+        return 1;
+
+    QObject::connect(&server, &FakeGatewayServer::identified, &server, [&](const QString &sessionId) {
+        std::printf("%s identified\n", qPrintable(sessionId));
+        if (!replay.isEmpty())
+            server.startReplay(replay, rate);
+        else if (rate > 0.0)
+            server.startStream([shape](qint64 index) {
+                return FakeGatewayServer::Event{"MESSAGE_CREATE", SyntheticPayloads::messageCreate(shape, index), 0};
+            }, count > 0 ? count : std::numeric_limits<qint64>::max(), rate);
+    });
+    QObject::connect(&server, &FakeGatewayServer::streamFinished, &server, [&]() {
+        std::printf("Stream finished, %lld dispatches sent\n", static_cast<long long>(server.sentCount()));
+    });
+
+    std::printf("Listening on %s\n", qPrintable(server.url().toString()));
+    std::printf("Run the app with CPPCORD_GATEWAY_URL=%s\n", qPrintable(server.url().toString()));
+    std::fflush(stdout);
+    return app.exec();
+}
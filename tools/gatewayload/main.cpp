@@ -0,0 +1,212 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QHash>
+#include <QDebug>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include "network/DiscordClient.h"
+#include "network/GatewayClient.h"
+#include "FakeGatewayServer.h"
+#include "ProcessStats.h"
+#include "SyntheticPayloads.h"
+
+// Load test for GatewayClient + DiscordClient against an in-process fake
+// gateway: a READY of configurable size, then a MESSAGE_CREATE firehose (or
+// a replayed recording). Reports the client's JSON parse cost per frame,
+// event-to-UI latency (dispatch sent -> DiscordClient done emitting the
+// signals the UI consumes) per event type, and resident memory growth.
+namespace
+{
+void quietMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context);
+    if (type == QtCriticalMsg || type == QtFatalMsg)
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+double megabytes(qint64 bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+double percentileMs(const QList<qint64> &sorted, double fraction)
+{
+    if (sorted.isEmpty())
+        return 0.0;
+    qsizetype index = qMin(sorted.size() - 1, static_cast<qsizetype>(fraction * sorted.size()));
+    return sorted.at(index) / 1e6;
+}
+
+void printParseStats(const char *label, const GatewayClient::FrameStats &stats)
+{
+    if (stats.frames == 0)
+        return;
+    double seconds = stats.parseNsTotal / 1e9;
+    std::printf("%-8s parse: %lld frames, %.1f MB, avg %.1f us, max %.1f us, %.0f MB/s\n", label,
+                static_cast<long long>(stats.frames), megabytes(stats.bytes),
+                stats.parseNsTotal / 1e3 / stats.frames, stats.parseNsMax / 1e3,
+                seconds > 0.0 ? megabytes(stats.bytes) / seconds : 0.0);
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("cppcord_gateway_load");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Gateway load test against a local fake gateway");
+    parser.addHelpOption();
+    QCommandLineOption guildsOption("guilds", "Guilds in READY (default 100).", "count", "100");
+    QCommandLineOption membersOption("members", "Members per guild (default 100).", "count", "100");
+    QCommandLineOption rateOption("rate", "Events per second after READY (default 5000; replay: 0 = recorded spacing).",
+                                  "per-second", "5000");
+    QCommandLineOption durationOption("duration", "Firehose length in seconds (default 10).", "seconds", "10");
+    QCommandLineOption replayOption("replay", "Replay dispatches from a gateway capture or JSON Lines file instead of the firehose.", "file");
+    QCommandLineOption verboseOption("verbose", "Keep the client's log output.");
+    parser.addOptions({guildsOption, membersOption, rateOption, durationOption, replayOption, verboseOption});
+    parser.process(app);
+
+    if (!parser.isSet(verboseOption))
+        qInstallMessageHandler(quietMessageHandler);
+
+    SyntheticPayloads::ReadyShape shape;
+    shape.guilds = qMax(0, parser.value(guildsOption).toInt());
+    shape.membersPerGuild = qMax(1, parser.value(membersOption).toInt());
+    const double rate = parser.value(rateOption).toDouble();
+    const double duration = qMax(0.0, parser.value(durationOption).toDouble());
+
+    QList<FakeGatewayServer::Event> replay;
+    if (parser.isSet(replayOption) && !FakeGatewayServer::loadRecording(parser.value(replayOption), replay))
+        return 1;
+
+    const qint64 rssStart = ProcessStats::residentBytes();
+
+    FakeGatewayServer server;
+    server.setReadyPayload(SyntheticPayloads::ready(shape));
+    if (!server.listen())
+        return 1;
+
+    DiscordClient client;
+    GatewayClient *gateway = client.gateway();
+    gateway->setGatewayUrl(server.url());
+
+    // Connected after DiscordClient's own handler, so it runs once the
+    // client has finished with the event. Dispatches arrive in send order.
+    QHash<QString, QList<qint64>> latencies;
+    qint64 handled = 0;
+    qint64 rssAfterReady = -1;
+    qint64 rssPeak = rssStart;
+    qint64 streamStartNs = 0;
+    qint64 streamEndNs = 0;
+    bool streamDone = false;
+    bool reported = false;
+    GatewayClient::FrameStats readyStats;
+
+    auto report = [&]() {
+        if (reported)
+            return;
+        reported = true;
+        const qint64 rssEnd = ProcessStats::residentBytes();
+        const auto &sent = server.sent();
+        std::printf("\nREADY: %d guilds, %.1f MB\n", shape.guilds, megabytes(sent.isEmpty() ? 0 : sent.first().bytes));
+        printParseStats("READY", readyStats);
+
+        const qint64 streamed = sent.size() - 1;
+        if (streamed > 0)
+        {
+            double seconds = (streamEndNs - streamStartNs) / 1e9;
+            std::printf("Stream: %lld events in %.2f s (%.0f/s)\n", static_cast<long long>(streamed), seconds,
+                        seconds > 0.0 ? streamed / seconds : 0.0);
+            printParseStats("Stream", gateway->frameStats());
+        }
+        if (handled < sent.size())
+            std::printf("Warning: %lld of %lld dispatches were never handled\n",
+                        static_cast<long long>(sent.size() - handled), static_cast<long long>(sent.size()));
+
+        std::printf("\n%-24s %8s %10s %10s %10s\n", "event-to-UI", "count", "p50 ms", "p99 ms", "max ms");
+        QStringList names = latencies.keys();
+        names.sort();
+        for (const QString &name : names)
+        {
+            QList<qint64> &series = latencies[name];
+            std::sort(series.begin(), series.end());
+            std::printf("%-24s %8lld %10.3f %10.3f %10.3f\n", qPrintable(name), static_cast<long long>(series.size()),
+                        percentileMs(series, 0.5), percentileMs(series, 0.99), series.last() / 1e6);
+        }
+
+        if (rssStart >= 0)
+        {
+            std::printf("\nMemory (RSS): start %.1f MB, after READY %.1f MB, end %.1f MB, peak %.1f MB\n",
+                        megabytes(rssStart), megabytes(rssAfterReady), megabytes(rssEnd), megabytes(rssPeak));
+            std::printf("Growth: READY %+.1f MB, stream %+.1f MB\n", megabytes(rssAfterReady - rssStart),
+                        megabytes(rssEnd - rssAfterReady));
+        }
+        std::fflush(stdout);
+        app.quit();
+    };
+
+    auto finishIfDrained = [&]() {
+        if (streamDone && handled >= server.sentCount())
+            report();
+    };
+
+    QObject::connect(gateway, &GatewayClient::eventReceived, &app, [&](const QString &eventName, const QJsonObject &) {
+        const qint64 now = FakeGatewayServer::nowNs();
+        const auto &sent = server.sent();
+        if (handled >= sent.size())
+            return;
+        const FakeGatewayServer::Sent &dispatch = sent.at(handled++);
+        if (dispatch.name != eventName)
+            qCritical() << "Dispatch order mismatch:" << dispatch.name << "sent," << eventName << "handled";
+        latencies[dispatch.name].append(now - dispatch.sentNs);
+
+        if (eventName == "READY")
+        {
+            rssAfterReady = ProcessStats::residentBytes();
+            readyStats = gateway->frameStats();
+            gateway->resetFrameStats();
+
+            streamStartNs = FakeGatewayServer::nowNs();
+            if (!replay.isEmpty())
+                server.startReplay(replay, rate);
+            else if (rate > 0.0 && duration > 0.0)
+                server.startStream([shape](qint64 index) {
+                    return FakeGatewayServer::Event{"MESSAGE_CREATE", SyntheticPayloads::messageCreate(shape, index), 0};
+                }, static_cast<qint64>(rate * duration), rate);
+            else
+            {
+                streamEndNs = streamStartNs;
+                streamDone = true;
+            }
+        }
+        finishIfDrained();
+    });
+
+    QObject::connect(&server, &FakeGatewayServer::streamFinished, &app, [&]() {
+        streamEndNs = FakeGatewayServer::nowNs();
+        streamDone = true;
+        finishIfDrained();
+    });
+
+    QTimer memorySampler;
+    QObject::connect(&memorySampler, &QTimer::timeout, &app, [&]() {
+        rssPeak = qMax(rssPeak, ProcessStats::residentBytes());
+    });
+    memorySampler.start(250);
+
+    // Give up if the client stops making progress
+    double streamSeconds = duration;
+    if (!replay.isEmpty())
+        streamSeconds = rate > 0.0 ? replay.size() / rate : replay.last().offsetNs / 1e9;
+    const int timeoutMs = static_cast<int>((streamSeconds + 60.0) * 1000.0);
+    QTimer::singleShot(timeoutMs, &app, [&]() {
+        std::fprintf(stderr, "Timed out after %d ms\n", timeoutMs);
+        report();
+    });
+
+    std::printf("Fake gateway on %s, READY with %d guilds\n", qPrintable(server.url().toString()), shape.guilds);
+    client.loginWithToken("load-test-token");
+    return app.exec();
+}
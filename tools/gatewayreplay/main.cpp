@@ -0,0 +1,180 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QHash>
+#include <QDebug>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include "network/DiscordClient.h"
+#include "network/GatewayCapture.h"
+#include "network/GatewayClient.h"
+#include "FakeGatewayServer.h"
+
+// Headless replay of a gateway capture (CPPCORD_GATEWAY_CAPTURE) through
+// GatewayClient + DiscordClient, without a socket. Frames go in back to back
+// or at their recorded spacing, with the client offline; the report is the
+// time each frame spent in the client (parse, dispatch and every slot
+// DiscordClient runs for it), grouped by event type.
+namespace
+{
+void quietMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context);
+    if (type == QtCriticalMsg || type == QtFatalMsg)
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+double percentileUs(const QList<qint64> &sorted, double fraction)
+{
+    if (sorted.isEmpty())
+        return 0.0;
+    qsizetype index = qMin(sorted.size() - 1, static_cast<qsizetype>(fraction * sorted.size()));
+    return sorted.at(index) / 1e3;
+}
+
+struct Series
+{
+    QList<qint64> ns;
+    qint64 totalNs = 0;
+};
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("cppcord_gateway_replay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replay a gateway capture through the client and time each event");
+    parser.addHelpOption();
+    parser.addPositionalArgument("capture", "Capture file written with CPPCORD_GATEWAY_CAPTURE.");
+    QCommandLineOption originalSpeedOption("original-speed",
+                                           "Feed frames at their recorded spacing instead of back to back.");
+    QCommandLineOption verboseOption("verbose", "Keep the client's log output.");
+    parser.addOptions({originalSpeedOption, verboseOption});
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+    if (!parser.isSet(verboseOption))
+        qInstallMessageHandler(quietMessageHandler);
+
+    GatewayCaptureReader reader;
+    if (!reader.open(parser.positionalArguments().first()))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(reader.errorString()));
+        return 1;
+    }
+
+    QList<GatewayCaptureReader::Frame> frames;
+    GatewayCaptureReader::Frame frame;
+    while (reader.next(frame))
+        frames.append(frame);
+    if (!reader.errorString().isEmpty())
+        std::fprintf(stderr, "Capture ends early: %s\n", qPrintable(reader.errorString()));
+    if (frames.isEmpty())
+    {
+        std::fprintf(stderr, "Capture holds no frames\n");
+        return 1;
+    }
+
+    // Offline keeps captured VOICE_SERVER_UPDATEs and guild icons off the
+    // network, so the timings are client work only
+    DiscordClient client;
+    client.setOffline(true);
+    GatewayClient *gateway = client.gateway();
+    gateway->stopCapture(); // Don't record the replay if the env var is set
+
+    // eventReceived fires inside processTextMessage, naming the frame in flight
+    const QString otherLabel = QStringLiteral("(other opcodes)");
+    QString currentEvent;
+    QObject::connect(gateway, &GatewayClient::eventReceived, &app, [&](const QString &eventName, const QJsonObject &) {
+        currentEvent = eventName;
+    });
+
+    QHash<QString, Series> series;
+    QList<qint64> lateness;
+    auto feed = [&](const GatewayCaptureReader::Frame &f) {
+        const QString text = QString::fromUtf8(f.payload); // The socket hands over a QString too
+        currentEvent = otherLabel;
+        const qint64 start = FakeGatewayServer::nowNs();
+        gateway->processTextMessage(text);
+        const qint64 elapsed = FakeGatewayServer::nowNs() - start;
+        Series &s = series[currentEvent];
+        s.ns.append(elapsed);
+        s.totalNs += elapsed;
+    };
+
+    auto report = [&](qint64 wallNs) {
+        gateway->disconnectFromGateway(); // Stops the heartbeat timer HELLO started
+
+        std::printf("%lld frames in %.2f s (capture spans %.2f s)\n", static_cast<long long>(frames.size()),
+                    wallNs / 1e9, frames.last().timestampNs / 1e9);
+        const GatewayClient::FrameStats stats = gateway->frameStats();
+        if (stats.frames > 0)
+            std::printf("Parse: %.1f MB, avg %.1f us, max %.1f us\n", stats.bytes / (1024.0 * 1024.0),
+                        stats.parseNsTotal / 1e3 / stats.frames, stats.parseNsMax / 1e3);
+        if (!lateness.isEmpty())
+        {
+            std::sort(lateness.begin(), lateness.end());
+            std::printf("Schedule lateness: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", percentileUs(lateness, 0.5) / 1e3,
+                        percentileUs(lateness, 0.99) / 1e3, lateness.last() / 1e6);
+        }
+
+        // Most expensive event types first
+        QStringList names = series.keys();
+        std::sort(names.begin(), names.end(), [&](const QString &a, const QString &b) {
+            return series[a].totalNs > series[b].totalNs;
+        });
+        std::printf("\n%-28s %8s %10s %10s %10s %10s %10s\n", "event", "count", "total ms", "mean us", "p50 us",
+                    "p99 us", "max us");
+        for (const QString &name : names)
+        {
+            Series &s = series[name];
+            std::sort(s.ns.begin(), s.ns.end());
+            std::printf("%-28s %8lld %10.2f %10.1f %10.1f %10.1f %10.1f\n", qPrintable(name),
+                        static_cast<long long>(s.ns.size()), s.totalNs / 1e6, s.totalNs / 1e3 / s.ns.size(),
+                        percentileUs(s.ns, 0.5), percentileUs(s.ns, 0.99), s.ns.last() / 1e3);
+        }
+        std::fflush(stdout);
+    };
+
+    const qint64 wallStart = FakeGatewayServer::nowNs();
+    if (!parser.isSet(originalSpeedOption))
+    {
+        for (qsizetype i = 0; i < frames.size(); ++i)
+        {
+            feed(frames.at(i));
+            // Let queued connections and deleteLater run as they would live
+            if ((i & 255) == 255)
+                QCoreApplication::processEvents();
+        }
+        QCoreApplication::processEvents();
+        report(FakeGatewayServer::nowNs() - wallStart);
+        return 0;
+    }
+
+    // Original speed: wake for each frame at its recorded offset from the start
+    qsizetype next = 0;
+    QTimer pacer;
+    pacer.setSingleShot(true);
+    pacer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&pacer, &QTimer::timeout, &app, [&]() {
+        qint64 now = FakeGatewayServer::nowNs() - wallStart;
+        while (next < frames.size() && frames.at(next).timestampNs <= now)
+        {
+            lateness.append(now - frames.at(next).timestampNs);
+            feed(frames.at(next++));
+            now = FakeGatewayServer::nowNs() - wallStart;
+        }
+        if (next < frames.size())
+        {
+            pacer.start(static_cast<int>(qMax<qint64>(0, (frames.at(next).timestampNs - now) / 1000000)));
+            return;
+        }
+        report(FakeGatewayServer::nowNs() - wallStart);
+        app.quit();
+    });
+    pacer.start(0);
+    return app.exec();
+}
@@ -0,0 +1,308 @@
+#include "FakeGatewayServer.h"
+#include "SyntheticPayloads.h"
+#include "network/GatewayCapture.h"
+#include <QWebSocket>
+#include <QWebSocketServer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDebug>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+constexpr int MAX_EVENTS_PER_TICK = 1000; // Keeps one late tick from starving the event loop
+}
+
+FakeGatewayServer::FakeGatewayServer(QObject *parent)
+    : QObject(parent), m_server(new QWebSocketServer("cppcord-fake-gateway", QWebSocketServer::NonSecureMode, this))
+{
+    connect(m_server, &QWebSocketServer::newConnection, this, &FakeGatewayServer::onNewConnection);
+
+    m_streamTimer.setTimerType(Qt::PreciseTimer);
+    m_streamTimer.setInterval(1);
+    connect(&m_streamTimer, &QTimer::timeout, this, &FakeGatewayServer::onStreamTick);
+}
+
+FakeGatewayServer::~FakeGatewayServer()
+{
+    close();
+    qDeleteAll(m_sessions);
+}
+
+bool FakeGatewayServer::listen(quint16 port)
+{
+    if (!m_server->listen(QHostAddress::LocalHost, port))
+    {
+        qWarning() << "Fake gateway failed to listen:" << m_server->errorString();
+        return false;
+    }
+    qDebug() << "Fake gateway listening on" << url().toString();
+    return true;
+}
+
+void FakeGatewayServer::close()
+{
+    stopStream();
+    // close() can emit disconnected synchronously, which edits m_connections
+    const QList<QWebSocket *> sockets = m_connections.keys();
+    for (QWebSocket *socket : sockets)
+        socket->close();
+    m_server->close();
+}
+
+QUrl FakeGatewayServer::url() const
+{
+    return QUrl(QString("ws://127.0.0.1:%1/?v=9&encoding=json").arg(m_server->serverPort()));
+}
+
+qint64 FakeGatewayServer::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void FakeGatewayServer::onNewConnection()
+{
+    while (QWebSocket *socket = m_server->nextPendingConnection())
+    {
+        m_connections.insert(socket, Connection());
+        connect(socket, &QWebSocket::textMessageReceived, this,
+                [this, socket](const QString &message) { onTextMessage(socket, message); });
+        connect(socket, &QWebSocket::disconnected, this, [this, socket]() { onDisconnected(socket); });
+
+        QJsonObject hello;
+        hello["heartbeat_interval"] = m_heartbeatIntervalMs;
+        sendOp(socket, 10, hello);
+    }
+}
+
+void FakeGatewayServer::onDisconnected(QWebSocket *socket)
+{
+    m_connections.remove(socket);
+    socket->deleteLater();
+}
+
+void FakeGatewayServer::onTextMessage(QWebSocket *socket, const QString &message)
+{
+    QJsonObject payload = QJsonDocument::fromJson(message.toUtf8()).object();
+    switch (payload["op"].toInt(-1))
+    {
+    case 1: // Heartbeat
+        m_heartbeats++;
+        if (m_ackHeartbeats)
+            sendOp(socket, 11, QJsonValue());
+        break;
+    case 2: // Identify
+        handleIdentify(socket);
+        break;
+    case 6: // Resume
+        handleResume(socket, payload["d"].toObject());
+        break;
+    default: // Presence and voice state updates need no answer here
+        break;
+    }
+}
+
+void FakeGatewayServer::handleIdentify(QWebSocket *socket)
+{
+    Session *session = new Session;
+    session->id = QString("fake-session-%1").arg(m_nextSessionId++);
+    m_sessions.insert(session->id, session);
+    m_connections[socket].session = session;
+
+    QJsonObject ready = m_ready;
+    if (ready.isEmpty())
+    {
+        ready["v"] = 9;
+        ready["user"] = SyntheticPayloads::user(SyntheticPayloads::SELF_ID);
+        ready["guilds"] = QJsonArray();
+        ready["private_channels"] = QJsonArray();
+    }
+    ready["session_id"] = session->id;
+
+    sendDispatch(socket, session, "READY", ready);
+    emit identified(session->id);
+}
+
+void FakeGatewayServer::handleResume(QWebSocket *socket, const QJsonObject &data)
+{
+    Session *session = m_sessions.value(data["session_id"].toString());
+    int sequence = data["seq"].toInt();
+
+    // Everything after the client's last sequence must still be buffered
+    if (!session || sequence < session->backlogFirstSequence - 1 || sequence > session->sequence)
+    {
+        sendOp(socket, 9, false);
+        return;
+    }
+
+    m_connections[socket].session = session;
+    int replayed = 0;
+    for (int s = sequence + 1; s <= session->sequence; ++s)
+    {
+        socket->sendTextMessage(QString::fromUtf8(session->backlog.at(s - session->backlogFirstSequence)));
+        replayed++;
+    }
+    sendDispatch(socket, session, "RESUMED", QJsonObject());
+    emit resumed(session->id, replayed);
+}
+
+void FakeGatewayServer::sendOp(QWebSocket *socket, int op, const QJsonValue &data)
+{
+    QJsonObject payload;
+    payload["op"] = op;
+    payload["d"] = data;
+    socket->sendTextMessage(QString::fromUtf8(QJsonDocument(payload).toJson(QJsonDocument::Compact)));
+}
+
+void FakeGatewayServer::sendDispatch(QWebSocket *socket, Session *session, const QString &name,
+                                     const QJsonObject &data)
+{
+    QJsonObject payload;
+    payload["op"] = 0;
+    payload["s"] = ++session->sequence;
+    payload["t"] = name;
+    payload["d"] = data;
+    QByteArray frame = QJsonDocument(payload).toJson(QJsonDocument::Compact);
+
+    session->backlog.append(frame);
+    if (session->backlog.size() > RESUME_BACKLOG)
+    {
+        session->backlog.removeFirst();
+        session->backlogFirstSequence++;
+    }
+
+    m_sentCount++;
+    if (m_keepSendLog)
+        m_sent.append({name, nowNs(), static_cast<int>(frame.size())});
+    socket->sendTextMessage(QString::fromUtf8(frame));
+}
+
+void FakeGatewayServer::dispatch(const QString &name, const QJsonObject &data)
+{
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        if (it->session)
+            sendDispatch(it.key(), it->session, name, data);
+    }
+}
+
+void FakeGatewayServer::requestReconnect()
+{
+    for (auto it = m_connections.cbegin(); it != m_connections.cend(); ++it)
+        sendOp(it.key(), 7, QJsonValue());
+}
+
+void FakeGatewayServer::startStream(const Generator &generator, qint64 count, double eventsPerSecond)
+{
+    stopStream();
+    m_generator = generator;
+    m_streamCount = count;
+    m_streamRate = eventsPerSecond;
+    m_streamNext = 0;
+    m_streamClock.start();
+    m_streamTimer.start();
+}
+
+void FakeGatewayServer::startReplay(const QList<Event> &events, double eventsPerSecond)
+{
+    stopStream();
+    m_replay = events;
+    m_streamCount = events.size();
+    m_streamRate = eventsPerSecond;
+    m_streamNext = 0;
+    m_streamClock.start();
+    m_streamTimer.start();
+}
+
+void FakeGatewayServer::stopStream()
+{
+    m_streamTimer.stop();
+    m_generator = nullptr;
+    m_replay.clear();
+}
+
+void FakeGatewayServer::onStreamTick()
+{
+    const qint64 elapsedNs = m_streamClock.nsecsElapsed();
+
+    qint64 due = m_streamCount;
+    if (m_streamRate > 0.0)
+        due = qMin(m_streamCount, static_cast<qint64>(std::floor(elapsedNs * 1e-9 * m_streamRate)) + 1);
+
+    for (int sent = 0; m_streamNext < due && sent < MAX_EVENTS_PER_TICK; ++sent)
+    {
+        if (m_generator)
+        {
+            Event event = m_generator(m_streamNext);
+            dispatch(event.name, event.data);
+        }
+        else
+        {
+            const Event &event = m_replay.at(m_streamNext);
+            if (m_streamRate <= 0.0 && event.offsetNs > elapsedNs)
+                break;
+            dispatch(event.name, event.data);
+        }
+        m_streamNext++;
+    }
+
+    if (m_streamNext >= m_streamCount)
+    {
+        stopStream();
+        emit streamFinished();
+    }
+}
+
+bool FakeGatewayServer::loadRecording(const QString &path, QList<Event> &events)
+{
+    auto appendDispatch = [&events](const QByteArray &frame, qint64 offsetNs) {
+        QJsonObject payload = QJsonDocument::fromJson(frame).object();
+        if (payload["op"].toInt(-1) == 0)
+            events.append({payload["t"].toString(), payload["d"].toObject(), offsetNs});
+    };
+
+    if (GatewayCaptureReader::isCapture(path))
+    {
+        GatewayCaptureReader reader;
+        if (!reader.open(path))
+        {
+            qWarning() << "Cannot open" << path << ":" << reader.errorString();
+            return false;
+        }
+
+        // Replay offsets start at the first dispatch, not at HELLO
+        GatewayCaptureReader::Frame frame;
+        qint64 firstNs = -1;
+        while (reader.next(frame))
+        {
+            qsizetype before = events.size();
+            appendDispatch(frame.payload, frame.timestampNs - qMax<qint64>(0, firstNs));
+            if (firstNs < 0 && events.size() > before)
+            {
+                firstNs = frame.timestampNs;
+                events.last().offsetNs = 0;
+            }
+        }
+        if (!reader.errorString().isEmpty())
+            qWarning() << "Capture" << path << "ends early:" << reader.errorString();
+        return true;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Cannot open" << path << ":" << file.errorString();
+        return false;
+    }
+
+    while (!file.atEnd())
+    {
+        QByteArray line = file.readLine().trimmed();
+        if (!line.isEmpty())
+            appendDispatch(line, 0);
+    }
+    return true;
+}
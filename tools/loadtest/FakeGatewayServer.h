@@ -0,0 +1,141 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QUrl>
+#include <functional>
+
+class QWebSocket;
+class QWebSocketServer;
+
+// Local stand-in for the Discord gateway, for load tests without the real
+// service.
+//
+// Speaks the subset of the protocol GatewayClient uses: HELLO on connect,
+// IDENTIFY answered with a configurable READY, heartbeats acknowledged, and
+// RESUME replaying the dispatches a session missed (or INVALID_SESSION when
+// they are no longer buffered). Dispatch streams are paced on a precise 1ms
+// tick, sending however many events are due, so rates well above 1000/s
+// hold on average. Streams come from a generator (synthetic events) or a
+// list of recorded payloads, sent at a fixed rate or with their original
+// spacing.
+//
+// The send time of every dispatch is kept, on the same monotonic clock as
+// nowNs(), so an in-process harness can pair it with the client's handling.
+class FakeGatewayServer : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int DEFAULT_HEARTBEAT_INTERVAL_MS = 41250;
+    static constexpr int RESUME_BACKLOG = 4096; // Dispatches kept per session
+
+    // One queued dispatch; offsetNs only matters for original-speed replay
+    struct Event
+    {
+        QString name;
+        QJsonObject data;
+        qint64 offsetNs = 0;
+    };
+
+    // Produces the index-th event of a synthetic stream
+    using Generator = std::function<Event(qint64 index)>;
+
+    struct Sent
+    {
+        QString name;
+        qint64 sentNs = 0;
+        int bytes = 0;
+    };
+
+    explicit FakeGatewayServer(QObject *parent = nullptr);
+    ~FakeGatewayServer() override;
+
+    bool listen(quint16 port = 0); // 0 picks a free port
+    void close();
+    QUrl url() const;
+
+    void setHeartbeatInterval(int ms) { m_heartbeatIntervalMs = ms; }
+    void setReadyPayload(const QJsonObject &ready) { m_ready = ready; }
+    // Stop acking heartbeats, so clients see a zombied connection
+    void setAckHeartbeats(bool ack) { m_ackHeartbeats = ack; }
+
+    // Send one dispatch to every identified session
+    void dispatch(const QString &name, const QJsonObject &data);
+
+    // Paced streams; a new stream replaces the running one
+    void startStream(const Generator &generator, qint64 count, double eventsPerSecond);
+    void startReplay(const QList<Event> &events, double eventsPerSecond); // <= 0: original spacing
+    void stopStream();
+    bool isStreaming() const { return m_streamTimer.isActive(); }
+
+    // Ask clients to reconnect (opcode 7), e.g. to exercise RESUME
+    void requestReconnect();
+
+    // The send log grows with every dispatch; long-running servers can turn it off
+    void setKeepSendLog(bool keep) { m_keepSendLog = keep; }
+    const QList<Sent> &sent() const { return m_sent; }
+    qint64 sentCount() const { return m_sentCount; }
+    qint64 heartbeats() const { return m_heartbeats; }
+    int sessionCount() const { return m_connections.size(); }
+
+    // Recorded dispatches from a gateway capture (with their original
+    // timing) or a JSON Lines file of payloads ({"op":0,"t":...,"d":...},
+    // no timing). Non-dispatch frames are skipped. Returns false if the file
+    // can't be read.
+    static bool loadRecording(const QString &path, QList<Event> &events);
+
+    static qint64 nowNs();
+
+signals:
+    void identified(const QString &sessionId);
+    void resumed(const QString &sessionId, int replayed);
+    void streamFinished();
+
+private:
+    struct Session
+    {
+        QString id;
+        int sequence = 0;
+        QList<QByteArray> backlog; // Last RESUME_BACKLOG dispatch frames
+        int backlogFirstSequence = 1;
+    };
+
+    struct Connection
+    {
+        Session *session = nullptr; // Null until IDENTIFY or RESUME
+    };
+
+    void onNewConnection();
+    void onTextMessage(QWebSocket *socket, const QString &message);
+    void onDisconnected(QWebSocket *socket);
+    void handleIdentify(QWebSocket *socket);
+    void handleResume(QWebSocket *socket, const QJsonObject &data);
+    void sendOp(QWebSocket *socket, int op, const QJsonValue &data);
+    void sendDispatch(QWebSocket *socket, Session *session, const QString &name, const QJsonObject &data);
+    void onStreamTick();
+
+    QWebSocketServer *m_server;
+    QHash<QWebSocket *, Connection> m_connections;
+    QHash<QString, Session *> m_sessions; // Kept after disconnect for RESUME
+    int m_nextSessionId = 1;
+    int m_heartbeatIntervalMs = DEFAULT_HEARTBEAT_INTERVAL_MS;
+    qint64 m_heartbeats = 0;
+    bool m_ackHeartbeats = true;
+    QJsonObject m_ready;
+
+    QTimer m_streamTimer;
+    QElapsedTimer m_streamClock;
+    Generator m_generator;
+    QList<Event> m_replay;
+    qint64 m_streamCount = 0;
+    qint64 m_streamNext = 0;
+    double m_streamRate = 0.0; // Events per second; <= 0 replays offsets
+
+    bool m_keepSendLog = true;
+    QList<Sent> m_sent;
+    qint64 m_sentCount = 0;
+};
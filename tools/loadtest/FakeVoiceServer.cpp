@@ -0,0 +1,373 @@
+#include "FakeVoiceServer.h"
+#include "FakeGatewayServer.h"
+#include "audio/OpusCodec.h"
+#include "audio/DspKernels.h"
+#include "network/RtpPacket.h"
+#include <QWebSocket>
+#include <QWebSocketServer>
+#include <QUdpSocket>
+#include <QNetworkDatagram>
+#include <QTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+#include <QDebug>
+#include <sodium.h>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr qint64 FRAME_NS = 20000000;
+constexpr int IP_DISCOVERY_SIZE = 74;
+constexpr int MAX_FRAMES_PER_TICK = 10; // Catch up after a stall without flooding
+}
+
+FakeVoiceServer::FakeVoiceServer(QObject *parent)
+    : QObject(parent),
+      m_webSocketServer(new QWebSocketServer("cppcord-fake-voice", QWebSocketServer::NonSecureMode, this)),
+      m_udpSocket(new QUdpSocket(this)),
+      m_tickTimer(new QTimer(this))
+{
+    if (VoiceCipher::isAesGcmAvailable())
+        m_modes.append(VoiceCipher::modeName(VoiceCipher::Mode::AesGcm));
+    m_modes.append(VoiceCipher::modeName(VoiceCipher::Mode::XChaCha20));
+
+    connect(m_webSocketServer, &QWebSocketServer::newConnection, this, &FakeVoiceServer::onNewConnection);
+    connect(m_udpSocket, &QUdpSocket::readyRead, this, &FakeVoiceServer::onUdpReadyRead);
+
+    m_tickTimer->setTimerType(Qt::PreciseTimer);
+    m_tickTimer->setInterval(1);
+    connect(m_tickTimer, &QTimer::timeout, this, &FakeVoiceServer::onTick);
+}
+
+FakeVoiceServer::~FakeVoiceServer() = default;
+
+bool FakeVoiceServer::listen()
+{
+    if (!m_webSocketServer->listen(QHostAddress::LocalHost))
+    {
+        qWarning() << "Fake voice server failed to listen:" << m_webSocketServer->errorString();
+        return false;
+    }
+    if (!m_udpSocket->bind(QHostAddress::LocalHost))
+    {
+        qWarning() << "Fake voice server failed to bind UDP:" << m_udpSocket->errorString();
+        return false;
+    }
+    return true;
+}
+
+QString FakeVoiceServer::endpoint() const
+{
+    return QString("ws://127.0.0.1:%1/").arg(m_webSocketServer->serverPort());
+}
+
+QString FakeVoiceServer::selectedMode() const
+{
+    return m_selectedMode;
+}
+
+void FakeVoiceServer::onNewConnection()
+{
+    while (QWebSocket *socket = m_webSocketServer->nextPendingConnection())
+    {
+        if (m_client)
+        {
+            // A reconnecting client replaces the old connection
+            m_client->disconnect(this);
+            m_client->deleteLater();
+        }
+        m_client = socket;
+        connect(socket, &QWebSocket::textMessageReceived, this, &FakeVoiceServer::onTextMessage);
+        connect(socket, &QWebSocket::disconnected, this, &FakeVoiceServer::onDisconnected);
+
+        QJsonObject hello;
+        hello["heartbeat_interval"] = HEARTBEAT_INTERVAL_MS;
+        sendOp(8, hello);
+    }
+}
+
+void FakeVoiceServer::onDisconnected()
+{
+    // Media keeps flowing while the client resumes the signalling session
+    if (m_client == sender())
+    {
+        m_client->deleteLater();
+        m_client = nullptr;
+    }
+}
+
+void FakeVoiceServer::onTextMessage(const QString &message)
+{
+    QJsonObject payload = QJsonDocument::fromJson(message.toUtf8()).object();
+    QJsonObject data = payload["d"].toObject();
+
+    switch (payload["op"].toInt(-1))
+    {
+    case 0: // Identify
+        handleIdentify();
+        break;
+    case 1: // Select Protocol
+        handleSelectProtocol(data);
+        break;
+    case 3: // Heartbeat: echo the nonce
+    {
+        QJsonObject ack;
+        ack["t"] = data["t"];
+        sendOp(6, ack);
+        break;
+    }
+    case 7: // Resume
+        m_mediaHeld = false;
+        sendOp(9, QJsonObject());
+        break;
+    default: // Speaking and DAVE opcodes need no answer here
+        break;
+    }
+}
+
+void FakeVoiceServer::sendOp(int op, const QJsonObject &data)
+{
+    if (!m_client)
+        return;
+
+    QJsonObject payload;
+    payload["op"] = op;
+    payload["d"] = data;
+    payload["seq"] = ++m_sequence;
+    m_client->sendTextMessage(QString::fromUtf8(QJsonDocument(payload).toJson(QJsonDocument::Compact)));
+}
+
+void FakeVoiceServer::handleIdentify()
+{
+    QJsonObject ready;
+    ready["ssrc"] = static_cast<qint64>(CLIENT_SSRC);
+    ready["ip"] = "127.0.0.1";
+    ready["port"] = m_udpSocket->localPort();
+    ready["modes"] = QJsonArray::fromStringList(m_modes);
+    sendOp(2, ready);
+}
+
+void FakeVoiceServer::handleSelectProtocol(const QJsonObject &data)
+{
+    m_selectedMode = data["data"].toObject()["mode"].toString();
+    VoiceCipher::Mode mode = VoiceCipher::modeFromString(m_selectedMode);
+
+    QByteArray key(VoiceCipher::KEY_SIZE, Qt::Uninitialized);
+    randombytes_buf(key.data(), key.size());
+    if (!m_modes.contains(m_selectedMode) || !m_cipher.setSession(mode, key))
+    {
+        qWarning() << "Fake voice server: unsupported mode" << m_selectedMode;
+        m_client->close(static_cast<QWebSocketProtocol::CloseCode>(4016), "Unknown encryption mode");
+        return;
+    }
+
+    QJsonArray secretKey;
+    for (char byte : key)
+        secretKey.append(static_cast<int>(static_cast<uchar>(byte)));
+
+    QJsonObject description;
+    description["mode"] = m_selectedMode;
+    description["secret_key"] = secretKey;
+    description["dave_protocol_version"] = 0;
+    sendOp(4, description);
+
+    // Map every speaker's SSRC to a user, as the real server does
+    for (int i = 0; i < m_speakerCount; ++i)
+    {
+        QJsonObject speaking;
+        speaking["user_id"] = QString::number(FIRST_SPEAKER_USER_ID + i);
+        speaking["ssrc"] = static_cast<qint64>(FIRST_SPEAKER_SSRC + i);
+        speaking["speaking"] = 1;
+        sendOp(5, speaking);
+    }
+
+    emit sessionStarted(m_selectedMode);
+    startStreaming();
+}
+
+void FakeVoiceServer::encodeSpeakerFrames(Speaker &speaker, int index)
+{
+    // Speaker 0 is the silent probe with one loud burst per period; the
+    // others talk quietly on their own pitch so the mix stays below the
+    // probe's level
+    OpusEncoder encoder;
+    encoder.initialize();
+
+    std::vector<float> samples(OPUS_FRAME_SIZE * OPUS_CHANNELS);
+    std::vector<opus_int16> pcm(samples.size());
+    const double frequency = 220.0 * (index + 1);
+    const float amplitude = index == 0 ? 0.8f : 0.02f;
+    const double pi = std::acos(-1.0);
+
+    for (int frame = 0; frame < PROBE_PERIOD_FRAMES; ++frame)
+    {
+        for (int i = 0; i < OPUS_FRAME_SIZE; ++i)
+        {
+            double t = static_cast<double>(frame * OPUS_FRAME_SIZE + i) / OPUS_SAMPLE_RATE;
+            bool audible = index != 0 || frame == 0;
+            float sample = audible ? amplitude * static_cast<float>(std::sin(2.0 * pi * frequency * t)) : 0.0f;
+            samples[i * OPUS_CHANNELS] = sample;
+            samples[i * OPUS_CHANNELS + 1] = sample;
+        }
+        DspKernels::floatToInt16(samples.data(), pcm.data(), static_cast<int>(samples.size()));
+
+        QByteArray packet;
+        encoder.encode(pcm.data(), packet);
+        speaker.frames.append(packet);
+    }
+}
+
+void FakeVoiceServer::startStreaming()
+{
+    if (m_tickTimer->isActive())
+    {
+        // New session key after a reconnect; keep the running streams
+        for (auto &speaker : m_speakers)
+            speaker->builder.setSession(&m_cipher, speaker->ssrc);
+        return;
+    }
+
+    m_speakers.clear();
+    for (int i = 0; i < m_speakerCount; ++i)
+    {
+        auto speaker = std::make_unique<Speaker>();
+        speaker->ssrc = FIRST_SPEAKER_SSRC + i;
+        speaker->builder.setSession(&m_cipher, speaker->ssrc);
+        encodeSpeakerFrames(*speaker, i);
+        m_speakers.push_back(std::move(speaker));
+    }
+
+    m_nextFrame = 0;
+    m_timestampBase = static_cast<quint32>(m_random());
+    m_streamStartNs.store(FakeGatewayServer::nowNs(), std::memory_order_release);
+    m_tickTimer->start();
+}
+
+void FakeVoiceServer::stopStreaming()
+{
+    m_tickTimer->stop();
+    m_pending = {};
+}
+
+void FakeVoiceServer::dropConnection(bool holdMedia)
+{
+    if (!m_client)
+        return;
+
+    m_mediaHeld = holdMedia;
+    m_client->close(static_cast<QWebSocketProtocol::CloseCode>(4015),
+                    holdMedia ? "Simulated voice server crash" : "Simulated signalling failure");
+}
+
+void FakeVoiceServer::queueDatagram(const char *data, int size, qint64 dueNs)
+{
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    if (chance(m_random) < m_impairment.loss)
+    {
+        m_stats.packetsDropped++;
+        return;
+    }
+
+    qint64 deliverNs = dueNs;
+    if (m_impairment.jitterMs > 0)
+    {
+        std::uniform_int_distribution<qint64> jitter(0, m_impairment.jitterMs * qint64(1000000));
+        deliverNs += jitter(m_random);
+    }
+    if (chance(m_random) < m_impairment.reorder)
+    {
+        // Held back until just after the speaker's next frame
+        deliverNs += FRAME_NS + 1;
+        m_stats.packetsReordered++;
+    }
+
+    m_pending.push({deliverNs, m_pendingOrder++, QByteArray(data, size)});
+}
+
+void FakeVoiceServer::onTick()
+{
+    const qint64 start = streamStartNs();
+    const qint64 now = FakeGatewayServer::nowNs();
+
+    // Frames whose mouth time has come, from every speaker
+    for (int built = 0; built < MAX_FRAMES_PER_TICK && start + m_nextFrame * FRAME_NS <= now; ++built)
+    {
+        const qint64 dueNs = start + m_nextFrame * FRAME_NS;
+        const quint32 timestamp = m_timestampBase + static_cast<quint32>(m_nextFrame * OPUS_FRAME_SIZE);
+        const QByteArray *frame = nullptr;
+        for (auto &speaker : m_speakers)
+        {
+            frame = &speaker->frames.at(static_cast<int>(m_nextFrame % PROBE_PERIOD_FRAMES));
+            int size = speaker->builder.build(frame->constData(), frame->size(), static_cast<quint16>(m_nextFrame),
+                                              timestamp);
+            // Held frames are never sent; the client sees them as lost
+            if (size > 0 && !m_mediaHeld)
+                queueDatagram(speaker->builder.data(), size, dueNs);
+        }
+        m_nextFrame++;
+    }
+
+    // Until the client's address is known from IP discovery, nothing leaves
+    while (!m_pending.empty() && m_pending.top().deliverNs <= now)
+    {
+        if (m_clientPort != 0)
+        {
+            const QByteArray &datagram = m_pending.top().datagram;
+            m_udpSocket->writeDatagram(datagram, m_clientAddress, m_clientPort);
+            m_stats.packetsSent++;
+        }
+        m_pending.pop();
+    }
+}
+
+void FakeVoiceServer::onUdpReadyRead()
+{
+    while (m_udpSocket->hasPendingDatagrams())
+    {
+        QNetworkDatagram datagram = m_udpSocket->receiveDatagram(RtpPacketBuilder::MAX_DATAGRAM_SIZE);
+        QByteArray bytes = datagram.data();
+        const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+
+        // IP discovery request: type 0x0001, length 70
+        if (bytes.size() == IP_DISCOVERY_SIZE && qFromBigEndian<quint16>(data) == 0x0001)
+        {
+            // Answer with the address the request came from
+            m_clientAddress = datagram.senderAddress();
+            m_clientPort = static_cast<quint16>(datagram.senderPort());
+
+            QByteArray response(IP_DISCOVERY_SIZE, 0);
+            uchar *out = reinterpret_cast<uchar *>(response.data());
+            qToBigEndian<quint16>(0x0002, out);
+            qToBigEndian<quint16>(70, out + 2);
+            std::memcpy(out + 4, data + 4, 4); // SSRC
+            QByteArray address = m_clientAddress.toString().toLatin1().left(63);
+            std::memcpy(out + 8, address.constData(), address.size());
+            qToBigEndian<quint16>(m_clientPort, out + 72);
+            m_udpSocket->writeDatagram(response, m_clientAddress, m_clientPort);
+            continue;
+        }
+
+        if (classifyVoiceDatagram(data, bytes.size()) == VoiceDatagramType::Rtp)
+        {
+            m_stats.uplinkPackets++;
+            RtpPacketView rtp;
+            int ciphertextSize = 0;
+            if (rtp.parse(data, bytes.size()))
+                ciphertextSize = rtp.payloadSize() - VoiceCipher::TAG_SIZE - RtpPacketBuilder::NONCE_SUFFIX_SIZE;
+
+            unsigned char nonce[VoiceCipher::NONCE_SIZE] = {};
+            if (ciphertextSize > 0)
+                std::memcpy(nonce, rtp.data + rtp.size - RtpPacketBuilder::NONCE_SUFFIX_SIZE,
+                            RtpPacketBuilder::NONCE_SUFFIX_SIZE);
+            if (ciphertextSize <= 0 || !m_cipher.isReady() ||
+                m_cipher.decrypt(m_uplinkBuffer, rtp.payload(), ciphertextSize, rtp.payload() + ciphertextSize,
+                                 rtp.data, rtp.headerSize, nonce) != 0)
+            {
+                m_stats.uplinkDecryptFailures++;
+            }
+        }
+    }
+}
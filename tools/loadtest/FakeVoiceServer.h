@@ -0,0 +1,154 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QList>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+#include "network/VoiceCipher.h"
+#include "network/RtpPacketBuilder.h"
+
+class QTimer;
+class QUdpSocket;
+class QWebSocket;
+class QWebSocketServer;
+
+// Local stand-in for a Discord voice server, for throughput and latency tests.
+//
+// Speaks the voice gateway handshake VoiceClient expects (Hello, Ready, IP
+// discovery over UDP, Select Protocol, Session Description, heartbeats and
+// Resume) with either AEAD mode, then streams N simulated speakers to the
+// client over loopback UDP. Each speaker loops one second of pre-encoded
+// Opus, so the server's own cost per packet is just RTP framing and
+// encryption. Packets can be dropped, reordered or delayed by random jitter
+// before they are sent.
+//
+// Speaker 0 is a latency probe: silent except for a loud burst at the start
+// of every PROBE_PERIOD_FRAMES frames. Frame n is "spoken" at
+// streamStartNs() + n * 20ms on the FakeGatewayServer::nowNs() clock, so a
+// harness that detects the burst at its output knows the mouth time.
+// Uplink RTP from the client is decrypted and counted. dropConnection()
+// simulates a server-side websocket failure, with or without a media outage,
+// for resume tests.
+//
+// The server is meant to run on its own thread: configure it, move it, then
+// call listen() through a queued/blocking invocation.
+class FakeVoiceServer : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr quint32 CLIENT_SSRC = 1;
+    static constexpr quint32 FIRST_SPEAKER_SSRC = 1000; // Speaker i uses FIRST_SPEAKER_SSRC + i
+    static constexpr quint64 FIRST_SPEAKER_USER_ID = 500000000000000000ULL;
+    static constexpr int PROBE_PERIOD_FRAMES = 50; // One burst per second
+    static constexpr int HEARTBEAT_INTERVAL_MS = 13750;
+
+    struct Impairment
+    {
+        double loss = 0.0;    // Probability a packet is dropped
+        double reorder = 0.0; // Probability a packet is held back behind the next one
+        int jitterMs = 0;     // Extra delay, uniform in [0, jitterMs]
+    };
+
+    // Counters are updated on the server thread and safe to read anywhere
+    struct Stats
+    {
+        std::atomic<qint64> packetsSent{0};
+        std::atomic<qint64> packetsDropped{0};
+        std::atomic<qint64> packetsReordered{0};
+        std::atomic<qint64> uplinkPackets{0};
+        std::atomic<qint64> uplinkDecryptFailures{0};
+    };
+
+    explicit FakeVoiceServer(QObject *parent = nullptr);
+    ~FakeVoiceServer() override;
+
+    // Configure before listen()
+    void setSpeakers(int count) { m_speakerCount = qMax(1, count); }
+    void setModes(const QStringList &modes) { m_modes = modes; } // Offered in Ready; default: every mode we can run
+    void setImpairment(const Impairment &impairment) { m_impairment = impairment; }
+    void setSeed(quint32 seed) { m_random.seed(seed); }
+
+    // Websocket and UDP on 127.0.0.1. Returns false if either can't bind.
+    Q_INVOKABLE bool listen();
+    Q_INVOKABLE void stopStreaming();
+    // Close the client's websocket with 4015, so it may resume. With
+    // holdMedia the server acts as if it crashed and sends no media until the
+    // client's Resume; without it only signalling fails and UDP keeps flowing.
+    Q_INVOKABLE void dropConnection(bool holdMedia);
+
+    // Endpoint to hand to VoiceClient::connectToVoice(); valid after listen()
+    QString endpoint() const;
+
+    const Stats &stats() const { return m_stats; }
+    qint64 streamStartNs() const { return m_streamStartNs.load(std::memory_order_acquire); } // 0 until streaming
+    QString selectedMode() const;
+
+signals:
+    void sessionStarted(const QString &mode);
+
+private:
+    struct Speaker
+    {
+        quint32 ssrc = 0;
+        RtpPacketBuilder builder;
+        QList<QByteArray> frames; // One second of Opus, looped
+    };
+
+    struct Pending
+    {
+        qint64 deliverNs = 0;
+        quint64 order = 0; // Keeps equal deadlines in send order
+        QByteArray datagram;
+
+        bool operator>(const Pending &other) const
+        {
+            return deliverNs != other.deliverNs ? deliverNs > other.deliverNs : order > other.order;
+        }
+    };
+
+    void onNewConnection();
+    void onTextMessage(const QString &message);
+    void onDisconnected();
+    void onUdpReadyRead();
+    void handleIdentify();
+    void handleSelectProtocol(const QJsonObject &data);
+    void sendOp(int op, const QJsonObject &data);
+    void startStreaming();
+    void encodeSpeakerFrames(Speaker &speaker, int index);
+    void onTick();
+    void queueDatagram(const char *data, int size, qint64 dueNs);
+
+    QWebSocketServer *m_webSocketServer;
+    QUdpSocket *m_udpSocket;
+    QTimer *m_tickTimer;
+    QWebSocket *m_client = nullptr; // One client at a time
+    int m_sequence = 0;
+
+    QStringList m_modes;
+    QString m_selectedMode;
+    VoiceCipher m_cipher;
+    QHostAddress m_clientAddress;
+    quint16 m_clientPort = 0;
+
+    int m_speakerCount = 1;
+    std::vector<std::unique_ptr<Speaker>> m_speakers;
+    qint64 m_nextFrame = 0;
+    quint32 m_timestampBase = 0;
+    std::atomic<qint64> m_streamStartNs{0};
+    bool m_mediaHeld = false; // From dropConnection(true) until Resume
+
+    Impairment m_impairment;
+    std::mt19937 m_random{1};
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> m_pending;
+    quint64 m_pendingOrder = 0;
+
+    Stats m_stats;
+    unsigned char m_uplinkBuffer[RtpPacketBuilder::MAX_DATAGRAM_SIZE];
+};
@@ -0,0 +1,63 @@
+#include "ProcessStats.h"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_MACOS)
+#include <mach/mach.h>
+#include <time.h>
+#elif defined(Q_OS_LINUX)
+#include <QFile>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace ProcessStats
+{
+qint64 residentBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return -1;
+    return static_cast<qint64>(counters.WorkingSetSize);
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return -1;
+    return static_cast<qint64>(info.resident_size);
+#elif defined(Q_OS_LINUX)
+    // statm: total and resident size, in pages
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+qint64 threadCpuNs()
+{
+#if defined(Q_OS_WIN)
+    FILETIME creation, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exited, &kernel, &user))
+        return -1;
+    auto ticks = [](const FILETIME &time) {
+        return (static_cast<qint64>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (ticks(kernel) + ticks(user)) * 100; // 100ns units
+#elif defined(Q_OS_MACOS) || defined(Q_OS_LINUX)
+    timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+        return -1;
+    return static_cast<qint64>(time.tv_sec) * 1000000000 + time.tv_nsec;
+#else
+    return -1;
+#endif
+}
+} // namespace ProcessStats
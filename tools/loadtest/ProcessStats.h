@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Resource usage of the current process, for load-test reports
+namespace ProcessStats
+{
+// Resident set size in bytes, or -1 where unsupported
+qint64 residentBytes();
+
+// CPU time (user + system) consumed by the calling thread, or -1
+qint64 threadCpuNs();
+} // namespace ProcessStats
@@ -0,0 +1,208 @@
+#include "SyntheticPayloads.h"
+#include <QJsonArray>
+#include <QDateTime>
+#include "models/Guild.h"
+
+namespace SyntheticPayloads
+{
+namespace
+{
+constexpr quint64 GUILD_ID_BASE = 200000000000000000ULL;
+constexpr quint64 GUILD_ID_STRIDE = 100000; // Room for the guild's roles and channels
+constexpr quint64 ROLE_OFFSET = 1000;
+constexpr quint64 CHANNEL_OFFSET = 10000;
+
+QString snowflake(quint64 id)
+{
+    return QString::number(id);
+}
+
+QJsonObject overwrite(quint64 id, int type, quint64 allow, quint64 deny)
+{
+    QJsonObject object;
+    object["id"] = snowflake(id);
+    object["type"] = type;
+    object["allow"] = snowflake(allow);
+    object["deny"] = snowflake(deny);
+    return object;
+}
+
+// Channel ids within a guild: each category is followed by its channels
+quint64 channelId(const ReadyShape &shape, int guild, int category, int channel)
+{
+    return guildId(guild) + CHANNEL_OFFSET + static_cast<quint64>(category) * (shape.channelsPerCategory + 1) +
+           (channel < 0 ? 0 : channel + 1);
+}
+} // namespace
+
+quint64 guildId(int guild)
+{
+    return GUILD_ID_BASE + static_cast<quint64>(guild) * GUILD_ID_STRIDE;
+}
+
+int textChannelsPerGuild(const ReadyShape &shape)
+{
+    return shape.categoriesPerGuild * shape.channelsPerCategory;
+}
+
+quint64 textChannelId(const ReadyShape &shape, int guild, int channel)
+{
+    return channelId(shape, guild, channel / shape.channelsPerCategory, channel % shape.channelsPerCategory);
+}
+
+QJsonObject user(quint64 id)
+{
+    QJsonObject object;
+    object["id"] = snowflake(id);
+    object["username"] = QString("user%1").arg(id % 100000);
+    object["discriminator"] = "0";
+    object["avatar"] = QString("a1b2c3d4e5f6%1").arg(id % 10000);
+    return object;
+}
+
+QJsonObject guild(const ReadyShape &shape, int index)
+{
+    const quint64 id = guildId(index);
+    QJsonObject object;
+    object["id"] = snowflake(id);
+    object["name"] = QString("Guild %1").arg(index);
+    object["owner_id"] = snowflake(SELF_ID + 1 + index);
+    object["joined_at"] = QDateTime::fromSecsSinceEpoch(1704067200 + index * 3600LL, Qt::UTC).toString(Qt::ISODate);
+
+    // @everyone shares the guild id; the other roles add moderation bits
+    QJsonArray roles;
+    for (int r = 0; r < shape.rolesPerGuild; ++r)
+    {
+        QJsonObject role;
+        role["id"] = snowflake(r == 0 ? id : id + ROLE_OFFSET + r);
+        role["name"] = r == 0 ? QString("@everyone") : QString("Role %1").arg(r);
+        quint64 permissions = Permissions::VIEW_CHANNEL | Permissions::SEND_MESSAGES | Permissions::READ_MESSAGE_HISTORY;
+        if (r > 0)
+            permissions |= 1ULL << (13 + r % 8);
+        role["permissions"] = snowflake(permissions);
+        role["position"] = r;
+        roles.append(role);
+    }
+    object["roles"] = roles;
+
+    QJsonArray members;
+    const int otherRoles = qMax(1, shape.rolesPerGuild - 1);
+    for (int m = 0; m < shape.membersPerGuild; ++m)
+    {
+        quint64 userId = m == shape.membersPerGuild / 2 ? SELF_ID : SELF_ID + 10000 + index * 1000ULL + m;
+        QJsonObject member;
+        member["user"] = user(userId);
+        QJsonArray memberRoles;
+        for (int r = 1; r <= 3 && shape.rolesPerGuild > 1; ++r)
+            memberRoles.append(snowflake(id + ROLE_OFFSET + (m + r * 7) % otherRoles + 1));
+        member["roles"] = memberRoles;
+        members.append(member);
+    }
+    object["members"] = members;
+
+    // Odd categories hide their channels from @everyone and let one role
+    // back in, so permission checks see both outcomes
+    QJsonArray channels;
+    for (int c = 0; c < shape.categoriesPerGuild; ++c)
+    {
+        const quint64 categoryId = channelId(shape, index, c, -1);
+        QJsonObject category;
+        category["id"] = snowflake(categoryId);
+        category["type"] = 4;
+        category["name"] = QString("Category %1").arg(c);
+        category["position"] = shape.categoriesPerGuild - c;
+        channels.append(category);
+
+        for (int t = 0; t < shape.channelsPerCategory; ++t)
+        {
+            const quint64 textId = channelId(shape, index, c, t);
+            QJsonObject channel;
+            channel["id"] = snowflake(textId);
+            channel["type"] = 0;
+            channel["name"] = QString("channel-%1-%2").arg(c).arg(t);
+            channel["topic"] = "Synthetic channel";
+            channel["position"] = shape.channelsPerCategory - t;
+            channel["parent_id"] = snowflake(categoryId);
+            channel["last_message_id"] = snowflake(textId * 7);
+
+            QJsonArray overwrites;
+            if (c % 2 == 1)
+            {
+                overwrites.append(overwrite(id, 0, 0, Permissions::VIEW_CHANNEL));
+                overwrites.append(overwrite(id + ROLE_OFFSET + c, 0, Permissions::VIEW_CHANNEL, 0));
+            }
+            if (t % 3 == 0)
+                overwrites.append(overwrite(SELF_ID, 1, 0, Permissions::SEND_MESSAGES));
+            channel["permission_overwrites"] = overwrites;
+            channels.append(channel);
+        }
+    }
+    object["channels"] = channels;
+    return object;
+}
+
+QJsonObject ready(const ReadyShape &shape, const QString &sessionId)
+{
+    QJsonObject object;
+    object["v"] = 9;
+    object["session_id"] = sessionId;
+    object["user"] = user(SELF_ID);
+
+    QJsonArray privateChannels;
+    for (int i = 0; i < shape.privateChannels; ++i)
+    {
+        QJsonObject channel;
+        channel["id"] = snowflake(300000000000000000ULL + i);
+        channel["type"] = 1;
+        channel["last_message_id"] = snowflake(310000000000000000ULL + i);
+        QJsonArray recipients;
+        recipients.append(user(SELF_ID + 500000 + i));
+        channel["recipients"] = recipients;
+        privateChannels.append(channel);
+    }
+    object["private_channels"] = privateChannels;
+
+    QJsonArray guilds;
+    for (int g = 0; g < shape.guilds; ++g)
+        guilds.append(guild(shape, g));
+    object["guilds"] = guilds;
+    return object;
+}
+
+QJsonObject messageCreate(const ReadyShape &shape, quint64 messageId)
+{
+    const int guildIndex = static_cast<int>(messageId % qMax(1, shape.guilds));
+    const int channel = static_cast<int>((messageId / 7) % qMax(1, textChannelsPerGuild(shape)));
+    const QList<QString> &samples = sampleMessages();
+
+    QJsonObject object;
+    object["id"] = snowflake(400000000000000000ULL + messageId);
+    object["type"] = 0;
+    object["channel_id"] = snowflake(textChannelId(shape, guildIndex, channel));
+    object["guild_id"] = snowflake(guildId(guildIndex));
+    object["author"] = user(SELF_ID + 10000 + guildIndex * 1000ULL + messageId % qMax(1, shape.membersPerGuild));
+    object["content"] = samples.at(static_cast<int>(messageId % samples.size()));
+    object["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    object["tts"] = false;
+    object["mention_everyone"] = false;
+    object["mentions"] = QJsonArray();
+    object["attachments"] = QJsonArray();
+    object["embeds"] = QJsonArray();
+    return object;
+}
+
+const QList<QString> &sampleMessages()
+{
+    static const QList<QString> messages = {
+        "hey, is anyone around?",
+        "**bold**, *italic*, __underline__, ~~strike~~ and `inline code` in one line",
+        "check https://example.com/docs/getting-started and <https://example.org/no-embed>",
+        "> quoted reply\n> on two lines\nand my answer with ||a spoiler||",
+        "# Heading\n- first item\n- second item with **bold**\n- third",
+        "```cpp\nint main()\n{\n    return 0;\n}\n```\nthat should compile",
+        "[masked link](https://example.com) plus <tag> & \"quotes\" that need escaping",
+        QString("long message ").repeated(40),
+    };
+    return messages;
+}
+} // namespace SyntheticPayloads
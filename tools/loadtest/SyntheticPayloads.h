@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+
+// Generated gateway dispatch payloads for benchmarks and load tests.
+//
+// Payloads follow the shape of the real events closely enough to run
+// through DiscordClient's handlers: guilds have @everyone plus moderation
+// roles, the current user's member entry, categories of text channels and
+// permission overwrites that hide some categories. Ids are deterministic,
+// so a MESSAGE_CREATE can target a channel of a generated READY. Guilds have
+// no icon hash, so handling them never starts downloads.
+namespace SyntheticPayloads
+{
+constexpr quint64 SELF_ID = 100000000000000001ULL;
+
+struct ReadyShape
+{
+    int guilds = 20;
+    int rolesPerGuild = 30;
+    int membersPerGuild = 100;
+    int categoriesPerGuild = 6;
+    int channelsPerCategory = 9;
+    int privateChannels = 40;
+};
+
+quint64 guildId(int guild);
+quint64 textChannelId(const ReadyShape &shape, int guild, int channel); // channel < textChannelsPerGuild()
+int textChannelsPerGuild(const ReadyShape &shape);
+
+QJsonObject user(quint64 id);
+QJsonObject guild(const ReadyShape &shape, int index);
+QJsonObject ready(const ReadyShape &shape, const QString &sessionId = QStringLiteral("synthetic-session"));
+
+// A guild message of one of several markdown styles, picked by the id
+QJsonObject messageCreate(const ReadyShape &shape, quint64 messageId);
+
+// Sample chat lines covering the markdown features
+const QList<QString> &sampleMessages();
+} // namespace SyntheticPayloads
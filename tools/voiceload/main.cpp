@@ -0,0 +1,360 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include "network/VoiceClient.h"
+#include "audio/AudioMixer.h"
+#include "FakeGatewayServer.h"
+#include "FakeVoiceServer.h"
+#include "ProcessStats.h"
+
+// End-to-end voice receive test against a fake voice server on its own
+// thread. VoiceClient receives N speakers over loopback UDP, received frames
+// are decoded into an AudioMixer and the mixer is pulled at the 48kHz device
+// rate as a sink would. Reports loss and jitter as the client saw them,
+// mouth-to-ear latency of the probe speaker (its burst "spoken" on the
+// server -> heard at the mixer output; device buffering not included) and
+// the main thread's CPU, which carries the whole receive/mix pipeline.
+// --drop-ws and --crash-ws close the websocket halfway through and report
+// drop -> Resumed. With --drop-ws UDP media keeps flowing, as the resume is
+// meant to allow, and the report adds the longest gap in the mixed audio
+// after the drop. With --crash-ws the server also holds media until the
+// client resumes, and the report adds drop -> first mixed audio.
+namespace
+{
+constexpr int PULL_FRAMES = 240;          // 5ms, the detection resolution
+constexpr int MAX_PULL_FRAMES = 48000 / 4; // Catch-up limit after a stall
+constexpr float PROBE_ON = 0.3f;
+constexpr float PROBE_OFF = 0.05f;
+constexpr qint64 WARMUP_NS = 1000000000; // Let the playout buffers prime
+constexpr float SILENT_LEVEL = 0.002f;   // Mix drained after a drop
+constexpr float AUDIBLE_LEVEL = 0.01f;   // Quiet speakers are ~0.02 peak
+
+// --crash-ws: the mix must go silent (buffers drained) before the first
+// audible pull counts as restored audio
+enum class DropPhase
+{
+    None,
+    Draining,
+    Silent,
+    Restored
+};
+
+int totalUnderruns(const AudioMixer &mixer)
+{
+    int underruns = 0;
+    const auto streamStats = mixer.streamStats();
+    for (const PlaybackBuffer::Stats &stream : streamStats)
+        underruns += stream.underruns;
+    return underruns;
+}
+
+void quietMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context);
+    if (type == QtCriticalMsg || type == QtFatalMsg)
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+double percentileMs(const QList<qint64> &sorted, double fraction)
+{
+    if (sorted.isEmpty())
+        return 0.0;
+    qsizetype index = qMin(sorted.size() - 1, static_cast<qsizetype>(fraction * sorted.size()));
+    return sorted.at(index) / 1e6;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("cppcord_voice_load");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Voice receive/mix load test against a local fake voice server");
+    parser.addHelpOption();
+    QCommandLineOption speakersOption("speakers", "Simulated speakers (default 4).", "count", "4");
+    QCommandLineOption durationOption("duration", "Measured seconds after warm-up (default 10).", "seconds", "10");
+    QCommandLineOption lossOption("loss", "Packet loss in percent (default 0).", "percent", "0");
+    QCommandLineOption reorderOption("reorder", "Reordered packets in percent (default 0).", "percent", "0");
+    QCommandLineOption jitterOption("jitter-ms", "Random extra delay up to <ms> (default 0).", "ms", "0");
+    QCommandLineOption modeOption("mode", "Encryption mode to offer: aes256gcm or xchacha20 (default: both).", "mode");
+    QCommandLineOption seedOption("seed", "Seed for the network impairments (default 1).", "seed", "1");
+    QCommandLineOption dropOption("drop-ws", "Drop the websocket halfway through while media keeps flowing; time the "
+                                             "resume and report any gap in the mixed audio. Needs two or more "
+                                             "speakers, as the probe speaker is mostly silent.");
+    QCommandLineOption crashOption("crash-ws", "Drop the websocket halfway through and hold media until the client "
+                                               "resumes; time the resume and the audio restore. Audio restore is "
+                                               "timed on any speaker, so use two or more for 5 ms resolution.");
+    QCommandLineOption verboseOption("verbose", "Keep the client's log output.");
+    parser.addOptions({speakersOption, durationOption, lossOption, reorderOption, jitterOption, modeOption, seedOption,
+                       dropOption, crashOption, verboseOption});
+    parser.process(app);
+
+    if (parser.isSet(dropOption) && parser.isSet(crashOption))
+    {
+        std::fprintf(stderr, "--drop-ws and --crash-ws are exclusive\n");
+        return 1;
+    }
+
+    if (!parser.isSet(verboseOption))
+        qInstallMessageHandler(quietMessageHandler);
+
+    const int speakers = qMax(1, parser.value(speakersOption).toInt());
+    const qint64 durationNs = static_cast<qint64>(qMax(1.0, parser.value(durationOption).toDouble()) * 1e9);
+
+    FakeVoiceServer::Impairment impairment;
+    impairment.loss = qBound(0.0, parser.value(lossOption).toDouble() / 100.0, 1.0);
+    impairment.reorder = qBound(0.0, parser.value(reorderOption).toDouble() / 100.0, 1.0);
+    impairment.jitterMs = qMax(0, parser.value(jitterOption).toInt());
+
+    auto *server = new FakeVoiceServer;
+    server->setSpeakers(speakers);
+    server->setImpairment(impairment);
+    server->setSeed(parser.value(seedOption).toUInt());
+    if (parser.isSet(modeOption))
+    {
+        QString mode = parser.value(modeOption);
+        if (mode == "aes256gcm" && !VoiceCipher::isAesGcmAvailable())
+        {
+            std::fprintf(stderr, "AES-256-GCM is not available on this CPU\n");
+            return 1;
+        }
+        if (mode != "aes256gcm" && mode != "xchacha20")
+        {
+            std::fprintf(stderr, "Unknown mode \"%s\"\n", qPrintable(mode));
+            return 1;
+        }
+        server->setModes({VoiceCipher::modeName(mode == "aes256gcm" ? VoiceCipher::Mode::AesGcm
+                                                                    : VoiceCipher::Mode::XChaCha20)});
+    }
+
+    QThread serverThread;
+    serverThread.setObjectName("fake-voice-server");
+    server->moveToThread(&serverThread);
+    QObject::connect(&serverThread, &QThread::finished, server, &QObject::deleteLater);
+    serverThread.start();
+
+    bool listening = false;
+    QMetaObject::invokeMethod(server, "listen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, listening));
+    auto shutdownServer = [&]() {
+        serverThread.quit();
+        serverThread.wait();
+    };
+    if (!listening)
+    {
+        shutdownServer();
+        return 1;
+    }
+
+    VoiceClient voice;
+    AudioMixer mixer;
+    mixer.open(QIODevice::ReadOnly);
+
+    qint64 packetsReceived = 0;
+    QObject::connect(&voice, &VoiceClient::audioDataReceived, &mixer, [&](quint32 ssrc, const QByteArray &opus) {
+        packetsReceived++;
+        mixer.addPacket(ssrc, opus);
+    });
+
+    // Measurement window: [measureStartNs, measureStartNs + durationNs)
+    qint64 measureStartNs = 0;
+    qint64 cpuStartNs = 0;
+    qint64 packetsAtStart = 0;
+    QList<qint64> mouthToEar;
+    bool probeArmed = false;
+
+    // --drop-ws/--crash-ws timeline on the FakeGatewayServer::nowNs() clock
+    const bool crashWebSocket = parser.isSet(crashOption);
+    const bool dropWebSocket = parser.isSet(dropOption) || crashWebSocket;
+    DropPhase dropPhase = DropPhase::None;
+    qint64 dropNs = 0;
+    qint64 resumedNs = 0;
+    qint64 audioRestoredNs = 0;
+
+    // --drop-ws: inaudible pulls in a row since the drop, the longest such
+    // run, and underruns counted before the drop
+    int gapPulls = 0;
+    int longestGapPulls = 0;
+    int underrunsAtDrop = 0;
+    QObject::connect(&voice, &VoiceClient::resumed, &app, [&]() {
+        if (dropNs != 0 && resumedNs == 0)
+            resumedNs = FakeGatewayServer::nowNs();
+    });
+
+    // Pull the mixer at the device rate, PULL_FRAMES at a time
+    QElapsedTimer playClock;
+    qint64 framesPulled = 0;
+    char pullBuffer[PULL_FRAMES * PlaybackBuffer::BYTES_PER_FRAME];
+    const quint32 probeSsrc = FakeVoiceServer::FIRST_SPEAKER_SSRC;
+    const qint64 periodNs = FakeVoiceServer::PROBE_PERIOD_FRAMES * qint64(20000000);
+
+    QTimer pullTimer;
+    pullTimer.setTimerType(Qt::PreciseTimer);
+    pullTimer.setInterval(PULL_FRAMES * 1000 / OPUS_SAMPLE_RATE);
+    QObject::connect(&pullTimer, &QTimer::timeout, &app, [&]() {
+        qint64 due = playClock.nsecsElapsed() * OPUS_SAMPLE_RATE / 1000000000 - framesPulled;
+        due = qMin<qint64>(due, MAX_PULL_FRAMES);
+        for (; due >= PULL_FRAMES; due -= PULL_FRAMES)
+        {
+            mixer.read(pullBuffer, sizeof(pullBuffer));
+            framesPulled += PULL_FRAMES;
+
+            if (dropNs != 0 && !crashWebSocket)
+            {
+                gapPulls = mixer.outputLevel() < AUDIBLE_LEVEL ? gapPulls + 1 : 0;
+                longestGapPulls = qMax(longestGapPulls, gapPulls);
+            }
+
+            if (dropPhase == DropPhase::Draining && mixer.outputLevel() < SILENT_LEVEL)
+            {
+                dropPhase = DropPhase::Silent;
+            }
+            else if (dropPhase == DropPhase::Silent && mixer.outputLevel() > AUDIBLE_LEVEL)
+            {
+                dropPhase = DropPhase::Restored;
+                audioRestoredNs = FakeGatewayServer::nowNs();
+            }
+
+            // The burst is heard when the probe stream's level jumps
+            float level = mixer.streamLevel(probeSsrc);
+            if (level < PROBE_OFF)
+            {
+                probeArmed = true;
+            }
+            else if (probeArmed && level > PROBE_ON)
+            {
+                probeArmed = false;
+                const qint64 heardNs = FakeGatewayServer::nowNs();
+                const qint64 streamStart = server->streamStartNs();
+                if (measureStartNs != 0 && heardNs >= measureStartNs && streamStart != 0)
+                {
+                    // Latency is well under a period, so the burst is the latest one spoken
+                    qint64 spokenNs = streamStart + (heardNs - streamStart) / periodNs * periodNs;
+                    mouthToEar.append(heardNs - spokenNs);
+                }
+            }
+        }
+    });
+
+    auto report = [&]() {
+        const qint64 cpuNs = ProcessStats::threadCpuNs() - cpuStartNs;
+        const qint64 wallNs = FakeGatewayServer::nowNs() - measureStartNs;
+        const qint64 packets = packetsReceived - packetsAtStart;
+        pullTimer.stop();
+        QMetaObject::invokeMethod(server, "stopStreaming", Qt::BlockingQueuedConnection);
+
+        const FakeVoiceServer::Stats &stats = server->stats();
+        std::printf("\nMode %s, %d speakers, loss %.1f%%, reorder %.1f%%, jitter 0-%d ms, %.1f s measured\n",
+                    qPrintable(server->selectedMode()), speakers, impairment.loss * 100.0, impairment.reorder * 100.0,
+                    impairment.jitterMs, wallNs / 1e9);
+        std::printf("Server:   %lld packets sent, %lld dropped, %lld reordered\n",
+                    static_cast<long long>(stats.packetsSent.load()), static_cast<long long>(stats.packetsDropped.load()),
+                    static_cast<long long>(stats.packetsReordered.load()));
+
+        qint64 received = 0;
+        qint64 lost = 0;
+        double jitterMs = 0.0;
+        for (int i = 0; i < speakers; ++i)
+        {
+            RtpReceiveStats::Report receive = voice.receiveReport(FakeVoiceServer::FIRST_SPEAKER_SSRC + i);
+            received += receive.received;
+            lost += receive.cumulativeLost;
+            jitterMs += receive.jitterMs / speakers;
+        }
+        std::printf("Client:   %lld packets received, %lld lost, mean jitter %.2f ms\n",
+                    static_cast<long long>(received), static_cast<long long>(lost), jitterMs);
+
+        int underruns = 0;
+        int skips = 0;
+        const auto streamStats = mixer.streamStats();
+        for (const PlaybackBuffer::Stats &stream : streamStats)
+        {
+            underruns += stream.underruns;
+            skips += stream.skips;
+        }
+        std::printf("Playback: %d underruns, %d latency resets across %lld streams\n", underruns, skips,
+                    static_cast<long long>(streamStats.size()));
+
+        std::sort(mouthToEar.begin(), mouthToEar.end());
+        if (mouthToEar.isEmpty())
+            std::printf("Mouth-to-ear: no probe bursts detected\n");
+        else
+            std::printf("Mouth-to-ear (%lld bursts): p50 %.1f ms, p95 %.1f ms, max %.1f ms\n",
+                        static_cast<long long>(mouthToEar.size()), percentileMs(mouthToEar, 0.5),
+                        percentileMs(mouthToEar, 0.95), mouthToEar.last() / 1e6);
+
+        if (dropWebSocket)
+        {
+            if (dropNs == 0)
+            {
+                std::printf("WS drop:  not performed\n");
+            }
+            else
+            {
+                auto sinceDrop = [&](qint64 ns) {
+                    return ns ? QString("after %1 ms").arg((ns - dropNs) / 1e6, 0, 'f', 1) : QString("never");
+                };
+                if (crashWebSocket)
+                {
+                    std::printf("WS crash: Resumed %s, mixed audio back %s\n", qPrintable(sinceDrop(resumedNs)),
+                                qPrintable(sinceDrop(audioRestoredNs)));
+                }
+                else
+                {
+                    // A gap-free resume keeps the mix audible throughout
+                    std::printf("WS drop:  Resumed %s, longest audio gap %d ms, %d underruns since the drop\n",
+                                qPrintable(sinceDrop(resumedNs)), longestGapPulls * PULL_FRAMES * 1000 / OPUS_SAMPLE_RATE,
+                                totalUnderruns(mixer) - underrunsAtDrop);
+                }
+            }
+        }
+
+        if (cpuStartNs >= 0 && wallNs > 0)
+            std::printf("Receive/mix CPU: %.2f%% of one core, %.1f us per received packet (%.0f packets/s)\n",
+                        100.0 * cpuNs / wallNs, packets > 0 ? cpuNs / 1e3 / packets : 0.0, packets * 1e9 / wallNs);
+        std::fflush(stdout);
+
+        voice.disconnectFromVoice();
+        app.quit();
+    };
+
+    QObject::connect(&voice, &VoiceClient::ready, &app, [&]() {
+        mixer.clear();
+        playClock.start();
+        framesPulled = 0;
+        pullTimer.start();
+
+        QTimer::singleShot(WARMUP_NS / 1000000, &app, [&]() {
+            measureStartNs = FakeGatewayServer::nowNs();
+            cpuStartNs = ProcessStats::threadCpuNs();
+            packetsAtStart = packetsReceived;
+            QTimer::singleShot(durationNs / 1000000, &app, report);
+
+            if (dropWebSocket)
+            {
+                QTimer::singleShot(durationNs / 2000000, &app, [&]() {
+                    dropNs = FakeGatewayServer::nowNs();
+                    underrunsAtDrop = totalUnderruns(mixer);
+                    if (crashWebSocket)
+                        dropPhase = DropPhase::Draining;
+                    QMetaObject::invokeMethod(server, "dropConnection", Qt::QueuedConnection,
+                                              Q_ARG(bool, crashWebSocket));
+                });
+            }
+        });
+    });
+    QObject::connect(&voice, &VoiceClient::error, &app, [&](const QString &message) {
+        std::fprintf(stderr, "Voice error: %s\n", qPrintable(message));
+        app.exit(1);
+    });
+
+    std::printf("Fake voice server on %s, %d speakers\n", qPrintable(server->endpoint()), speakers);
+    voice.connectToVoice(server->endpoint(), "voice-load-token", "voice-load-session", 1, 2);
+    int result = app.exec();
+
+    shutdownServer();
+    return result;
+}